@@ -0,0 +1,556 @@
+#include <time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "jep_utils/huffman.h"
+
+/* the smallest corpus */
+#define CORPUS_MIN_SIZE 1024
+
+/* the largest corpus unless another is given */
+#define CORPUS_DEFAULT_MAX (32 * 1024 * 1024)
+
+/* the largest corpus that can be asked for */
+#define CORPUS_MAX_SIZE (1024 * 1024 * 1024)
+
+/* each corpus size is this many times the one before it */
+#define CORPUS_SIZE_STEP 32
+
+/* the number of bytes processed in each timed run */
+#define BENCH_VOLUME (16 * 1024 * 1024)
+
+/* the number of timed runs, of which the best is reported */
+#define BENCH_RUNS 3
+
+/* the percentage by which a result may fall behind its baseline */
+#define BENCH_TOLERANCE 10.0
+
+/* the most results that a baseline can hold */
+#define BASELINE_MAX 256
+
+
+
+
+/**
+ * A corpus is a named generator of deterministic input.
+ */
+typedef struct corpus {
+	const char* name;                              // The name of the corpus
+	void (*generate)(jep_byte*, size_t, uint32_t); // Fills an array
+}corpus;
+
+/**
+ * A result is one line of the report.
+ */
+typedef struct result {
+	char corpus[16];    // The name of the corpus
+	unsigned long size; // The number of raw bytes
+	unsigned long enc;  // The number of encoded bytes
+	double ratio;       // The raw size over the encoded size
+	double encode;      // The encoding throughput in MB/s
+	double decode;      // The decoding throughput in MB/s
+	long peak;          // The peak resident memory in KB
+}result;
+
+
+
+
+/**
+ * Advances a linear congruential generator.
+ */
+static uint32_t next(uint32_t* x)
+{
+	*x = *x * 1664525U + 1013904223U;
+
+	return *x;
+}
+
+/**
+ * Copies as much of a string as fits into an array.
+ * Returns the number of bytes copied.
+ */
+static size_t put(jep_byte* dest, size_t n, const char* s)
+{
+	size_t len;
+
+	len = strlen(s);
+
+	if (len > n)
+		len = n;
+
+	memcpy(dest, s, len);
+
+	return len;
+}
+
+/**
+ * Fills an array with English-like text. Common words are chosen far
+ * more often than rare ones, and the words form sentences and lines.
+ */
+static void generate_text(jep_byte* dest, size_t n, uint32_t seed)
+{
+	static const char* words[] = {
+		"the", "of", "and", "to", "a", "in", "is", "it", "that", "was",
+		"for", "on", "with", "as", "he", "she", "they", "be", "at", "by",
+		"this", "had", "not", "are", "but", "from", "or", "have", "an",
+		"which", "one", "you", "were", "her", "all", "their", "there",
+		"been", "when", "who", "will", "more", "would", "time", "about",
+		"could", "people", "into", "only", "other", "new", "some", "what",
+		"after", "first", "never", "house", "water", "between", "story",
+		"because", "without", "however", "something"
+	};
+	size_t pos;
+	uint32_t x;
+	uint32_t w;
+	uint32_t count;
+
+	x = seed;
+	pos = 0;
+	count = 0;
+
+	while (pos < n)
+	{
+		// Halve the range for every leading one bit,
+		// so that earlier words are much more common.
+		w = next(&x);
+		w = (w >> 26) >> (next(&x) >> 30);
+
+		pos += put(dest + pos, n - pos, words[w]);
+		count++;
+
+		if (count % 97 == 0)
+			pos += put(dest + pos, n - pos, ".\n");
+		else if (count % 13 == 0)
+			pos += put(dest + pos, n - pos, ". ");
+		else
+			pos += put(dest + pos, n - pos, " ");
+	}
+}
+
+/**
+ * Fills an array with JSON records that share their keys and
+ * draw their values from small sets.
+ */
+static void generate_json(jep_byte* dest, size_t n, uint32_t seed)
+{
+	static const char* tags[] = { "admin", "guest", "staff", "owner" };
+	char record[160];
+	size_t pos;
+	uint32_t x;
+	uint32_t id;
+
+	x = seed;
+	pos = 0;
+	id = 0;
+
+	while (pos < n)
+	{
+		next(&x);
+		sprintf(record, "{\"id\":%u,\"name\":\"user%u\",\"score\":%u,"
+			"\"active\":%s,\"tags\":[\"%s\",\"%s\"]}\n",
+			id++, (x >> 8) % 1000, (x >> 20) % 100,
+			(x >> 4) % 3 ? "true" : "false",
+			tags[(x >> 12) % 4], tags[(x >> 14) % 4]);
+
+		pos += put(dest + pos, n - pos, record);
+	}
+}
+
+/**
+ * Fills an array with bytes in which every value is equally likely,
+ * which resembles encrypted or compressed data.
+ */
+static void generate_random(jep_byte* dest, size_t n, uint32_t seed)
+{
+	size_t i;
+	uint32_t x;
+
+	x = seed;
+
+	for (i = 0; i < n; i++)
+		dest[i] = (jep_byte)(next(&x) >> 24);
+}
+
+/**
+ * Fills an array with bytes whose frequencies fall off geometrically,
+ * so that each one is half as likely as the one before it.
+ */
+static void generate_skewed(jep_byte* dest, size_t n, uint32_t seed)
+{
+	size_t i;
+	uint32_t x;
+	jep_byte b;
+
+	x = seed;
+
+	for (i = 0; i < n; i++)
+	{
+		next(&x);
+		b = 0;
+		while (b < 24 && (x >> (31 - b)) & 1)
+			b++;
+
+		dest[i] = (jep_byte)('a' + b);
+	}
+}
+
+/**
+ * Fills an array with a single repeated byte.
+ */
+static void generate_run(jep_byte* dest, size_t n, uint32_t seed)
+{
+	memset(dest, 'a' + seed % 26, n);
+}
+
+static const corpus corpora[] = {
+	{ "text", generate_text },
+	{ "json", generate_json },
+	{ "random", generate_random },
+	{ "skewed", generate_skewed },
+	{ "run", generate_run }
+};
+
+
+
+
+/**
+ * Reads a monotonic clock in seconds.
+ */
+static double now()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/**
+ * Reads the peak resident memory of this process in KB.
+ */
+static long peak_memory()
+{
+	struct rusage usage;
+
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+
+#ifdef __APPLE__
+	// macOS reports bytes rather than kilobytes.
+	return usage.ru_maxrss / 1024;
+#else
+	return usage.ru_maxrss;
+#endif
+}
+
+/**
+ * Reads a report written by an earlier run to compare results against.
+ * Returns the number of results read, or -1 if the file cannot be opened.
+ */
+static int read_baseline(const char* path, result* results, int max)
+{
+	FILE* file;
+	char line[256];
+	int count;
+	result* r;
+
+	file = fopen(path, "r");
+
+	if (file == NULL)
+		return -1;
+
+	count = 0;
+
+	while (count < max && fgets(line, sizeof(line), file) != NULL)
+	{
+		r = &(results[count]);
+
+		// The heading and any other line that is not a result
+		// is skipped.
+		if (sscanf(line, "%15[^,],%lu,%lu,%lf,%lf,%lf,%ld", r->corpus,
+			&(r->size), &(r->enc), &(r->ratio), &(r->encode), &(r->decode),
+			&(r->peak)) == 7)
+		{
+			count++;
+		}
+	}
+
+	fclose(file);
+
+	return count;
+}
+
+/**
+ * Compares a result with its baseline, if there is one, and describes
+ * each regression on the standard error stream.
+ * Returns 1 if the result regressed, or 0 otherwise.
+ */
+static int regressed(const result* r, const result* baseline, int count,
+	double tolerance)
+{
+	const result* b;
+	double floor;
+	int res;
+	int i;
+
+	b = NULL;
+	for (i = 0; i < count && b == NULL; i++)
+	{
+		if (!strcmp(baseline[i].corpus, r->corpus)
+			&& baseline[i].size == r->size)
+		{
+			b = &(baseline[i]);
+		}
+	}
+
+	if (b == NULL)
+		return 0;
+
+	res = 0;
+	floor = 1.0 - tolerance / 100.0;
+
+	// The encoding is deterministic, so any growth is a regression.
+	if (r->enc > b->enc)
+	{
+		fprintf(stderr, "regression: %s %lu encoded %lu bytes, was %lu\n",
+			r->corpus, r->size, r->enc, b->enc);
+		res = 1;
+	}
+
+	if (r->encode < b->encode * floor)
+	{
+		fprintf(stderr, "regression: %s %lu encode %.2f MB/s, was %.2f\n",
+			r->corpus, r->size, r->encode, b->encode);
+		res = 1;
+	}
+
+	if (r->decode < b->decode * floor)
+	{
+		fprintf(stderr, "regression: %s %lu decode %.2f MB/s, was %.2f\n",
+			r->corpus, r->size, r->decode, b->decode);
+		res = 1;
+	}
+
+	return res;
+}
+
+/**
+ * Generates a corpus and times jep_huff_encode and jep_huff_decode on it.
+ * Each timed run repeats the operation until about BENCH_VOLUME bytes
+ * are processed, so that small corpora are timed as precisely as
+ * large ones.
+ * Returns 1 if the corpus decoded to the original bytes, or 0 otherwise.
+ */
+static int bench_corpus(const corpus* c, size_t size, result* r)
+{
+	jep_byte_buffer* raw;
+	jep_byte_buffer* encoded;
+	jep_byte_buffer* decoded;
+	size_t reps;
+	size_t k;
+	double start;
+	double t;
+	int ok;
+	int i;
+
+	raw = jep_create_byte_buffer();
+
+	if (raw == NULL)
+		return 0;
+
+	free(raw->buffer);
+	raw->buffer = jep_alloc(jep_byte, size);
+
+	if (raw->buffer == NULL)
+	{
+		free(raw);
+		return 0;
+	}
+
+	raw->cap = raw->size = size;
+	c->generate(raw->buffer, size, 12345);
+
+	reps = size < BENCH_VOLUME ? BENCH_VOLUME / size : 1;
+
+	strcpy(r->corpus, c->name);
+	r->size = (unsigned long)size;
+	r->encode = 0;
+	r->decode = 0;
+
+	encoded = NULL;
+	ok = 1;
+
+	for (i = 0; ok && i < BENCH_RUNS; i++)
+	{
+		start = now();
+		for (k = 0; ok && k < reps; k++)
+		{
+			jep_destroy_byte_buffer(encoded);
+			encoded = jep_huff_encode(raw);
+			ok = encoded != NULL;
+		}
+		t = now() - start;
+
+		if (t > 0 && (double)size * reps / t / 1e6 > r->encode)
+			r->encode = (double)size * reps / t / 1e6;
+	}
+
+	for (i = 0; ok && i < BENCH_RUNS; i++)
+	{
+		start = now();
+		for (k = 0; ok && k < reps; k++)
+		{
+			decoded = jep_huff_decode(encoded);
+			ok = decoded != NULL && decoded->size == size
+				&& !memcmp(decoded->buffer, raw->buffer, size);
+			jep_destroy_byte_buffer(decoded);
+		}
+		t = now() - start;
+
+		if (t > 0 && (double)size * reps / t / 1e6 > r->decode)
+			r->decode = (double)size * reps / t / 1e6;
+	}
+
+	if (ok)
+	{
+		r->enc = (unsigned long)encoded->size;
+		r->ratio = (double)size / (double)encoded->size;
+	}
+
+	r->peak = peak_memory();
+
+	jep_destroy_byte_buffer(encoded);
+	jep_destroy_byte_buffer(raw);
+
+	return ok;
+}
+
+/**
+ * Prints the command line options.
+ */
+static void usage(const char* name)
+{
+	fprintf(stderr, "usage: %s [-m max_size] [-b baseline] [-t tolerance]\n"
+		"  -m  the largest corpus in bytes, from %d to %d (default %d)\n"
+		"  -b  a report from an earlier run to check for regressions\n"
+		"  -t  the percentage by which throughput may fall (default %.0f)\n",
+		name, CORPUS_MIN_SIZE, CORPUS_MAX_SIZE, CORPUS_DEFAULT_MAX,
+		BENCH_TOLERANCE);
+}
+
+/**
+ * Generates corpora of each kind at sizes from 1 KB up to the largest
+ * size, and reports the size and speed of Huffman Coding on each one
+ * as comma-separated values.
+ *
+ * Each corpus runs in its own process, so that its peak memory is not
+ * hidden by the corpora before it. If a baseline is given, the exit
+ * status is 1 when any result regressed beyond the tolerance, and
+ * 2 when any corpus failed to decode.
+ */
+int main(int argc, char** argv)
+{
+	result baseline[BASELINE_MAX];
+	result r;
+	const char* path;
+	unsigned long max;
+	double tolerance;
+	size_t size;
+	size_t c;
+	pid_t pid;
+	int status;
+	int count;
+	int res;
+	int i;
+
+	max = CORPUS_DEFAULT_MAX;
+	tolerance = BENCH_TOLERANCE;
+	path = NULL;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-m") && i + 1 < argc)
+		{
+			max = strtoul(argv[++i], NULL, 10);
+		}
+		else if (!strcmp(argv[i], "-b") && i + 1 < argc)
+		{
+			path = argv[++i];
+		}
+		else if (!strcmp(argv[i], "-t") && i + 1 < argc)
+		{
+			tolerance = strtod(argv[++i], NULL);
+		}
+		else
+		{
+			usage(argv[0]);
+			return 2;
+		}
+	}
+
+	if (max < CORPUS_MIN_SIZE || max > CORPUS_MAX_SIZE)
+	{
+		usage(argv[0]);
+		return 2;
+	}
+
+	count = 0;
+
+	if (path != NULL)
+	{
+		count = read_baseline(path, baseline, BASELINE_MAX);
+
+		if (count < 0)
+		{
+			fprintf(stderr, "cannot read %s\n", path);
+			return 2;
+		}
+	}
+
+	printf("corpus,size,encoded,ratio,encode_mbps,decode_mbps,peak_kb\n");
+
+	res = 0;
+
+	for (c = 0; c < sizeof(corpora) / sizeof(corpora[0]); c++)
+	{
+		for (size = CORPUS_MIN_SIZE; size <= max; size *= CORPUS_SIZE_STEP)
+		{
+			// Anything buffered would otherwise be written twice.
+			fflush(stdout);
+			pid = fork();
+
+			if (pid < 0)
+				return 2;
+
+			if (pid == 0)
+			{
+				if (!bench_corpus(&(corpora[c]), size, &r))
+				{
+					fprintf(stderr, "%s %lu did not decode\n",
+						corpora[c].name, (unsigned long)size);
+					exit(2);
+				}
+
+				printf("%s,%lu,%lu,%.4f,%.2f,%.2f,%ld\n", r.corpus, r.size,
+					r.enc, r.ratio, r.encode, r.decode, r.peak);
+
+				exit(regressed(&r, baseline, count, tolerance));
+			}
+
+			if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status))
+				status = 2;
+			else
+				status = WEXITSTATUS(status);
+
+			if (status > res)
+				res = status;
+
+			// The largest size may not be a step from the smallest.
+			if (size < max && size * CORPUS_SIZE_STEP > max)
+				size = max / CORPUS_SIZE_STEP;
+		}
+	}
+
+	return res;
+}
@@ -0,0 +1,149 @@
+#include <time.h>
+
+#include "jep_utils/histogram.h"
+#include "jep_utils/huffman.h"
+
+/* the number of bytes of generated input */
+#define BENCH_SIZE (16 * 1024 * 1024)
+
+/* the number of times each operation is repeated */
+#define BENCH_RUNS 5
+
+
+
+
+/**
+ * Reads a monotonic clock in seconds.
+ */
+static double now()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/**
+ * Counts bytes into an array of Huffman symbols, one byte at a time.
+ * This is how jep_huff_encode counted bytes before it used
+ * jep_byte_histogram.
+ */
+static int count_symbols(const jep_byte* src, size_t n, uint32_t* counts)
+{
+	jep_huff_sym bytes[JEP_HISTOGRAM_SIZE];
+	size_t i;
+
+	for (i = 0; i < JEP_HISTOGRAM_SIZE; i++)
+		bytes[i].f = 0;
+
+	for (i = 0; i < n; i++)
+		bytes[src[i]].f++;
+
+	for (i = 0; i < JEP_HISTOGRAM_SIZE; i++)
+		counts[i] = bytes[i].f;
+
+	return 1;
+}
+
+/**
+ * Counts bytes into a single array of counters, one byte at a time.
+ */
+static int count_single(const jep_byte* src, size_t n, uint32_t* counts)
+{
+	size_t i;
+
+	memset(counts, 0, sizeof(uint32_t) * JEP_HISTOGRAM_SIZE);
+
+	for (i = 0; i < n; i++)
+		counts[src[i]]++;
+
+	return 1;
+}
+
+/**
+ * Times a counting routine over several runs and reports the best
+ * throughput. Returns 1 if every run agreed with the expected counts,
+ * or 0 otherwise.
+ */
+static int bench_count(const char* name,
+	int (*count)(const jep_byte*, size_t, uint32_t*),
+	const jep_byte* src,
+	const uint32_t* expected)
+{
+	uint32_t counts[JEP_HISTOGRAM_SIZE];
+	double start;
+	double best;
+	double t;
+	int ok;
+	int i;
+
+	ok = 1;
+	best = 0;
+
+	for (i = 0; i < BENCH_RUNS; i++)
+	{
+		start = now();
+		count(src, BENCH_SIZE, counts);
+		t = now() - start;
+
+		if (memcmp(counts, expected, sizeof(counts)))
+			ok = 0;
+
+		if (i == 0 || t < best)
+			best = t;
+	}
+
+	printf("  %-12s %10.2f MB/s%s\n", name,
+		best > 0.0 ? (BENCH_SIZE / (1024.0 * 1024.0)) / best : 0.0,
+		ok ? "" : "  (MISMATCH)");
+
+	return ok;
+}
+
+int main(int argc, char** argv)
+{
+	jep_byte* src;
+	uint32_t expected[JEP_HISTOGRAM_SIZE];
+	uint32_t x;
+	size_t i;
+	int ok;
+	int k;
+
+	src = jep_alloc(jep_byte, BENCH_SIZE);
+
+	if (src == NULL)
+		return 1;
+
+	ok = 1;
+
+	for (k = 0; k < 3; k++)
+	{
+		// A single repeated byte is the worst case for one table,
+		// since every increment depends on the one before it.
+		x = 12345;
+		for (i = 0; i < BENCH_SIZE; i++)
+		{
+			x = x * 1664525U + 1013904223U;
+
+			if (k == 0)
+				src[i] = 'a';
+			else if (k == 1)
+				src[i] = (jep_byte)('a' + ((x >> 28) & 3));
+			else
+				src[i] = (jep_byte)(x >> 24);
+		}
+
+		printf("%s\n", k == 0 ? "one byte" : k == 1 ? "four bytes" : "random");
+
+		count_single(src, BENCH_SIZE, expected);
+
+		ok &= bench_count("symbols", count_symbols, src, expected);
+		ok &= bench_count("one table", count_single, src, expected);
+		ok &= bench_count("histogram", jep_byte_histogram, src, expected);
+	}
+
+	free(src);
+
+	return ok ? 0 : 1;
+}
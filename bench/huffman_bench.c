@@ -0,0 +1,772 @@
+#include <time.h>
+
+#include "jep_utils/huffman.h"
+#include "jep_utils/lz.h"
+
+/* the number of bytes of generated input */
+#define BENCH_SIZE (4 * 1024 * 1024)
+
+/* the number of times each operation is repeated */
+#define BENCH_RUNS 5
+
+/* the number of bytes in each small message */
+#define BENCH_MESSAGE 4096
+
+
+
+
+/**
+ * Fills an array with pseudo-random bytes whose frequencies fall off
+ * geometrically, which loosely resembles natural language text.
+ * The same seed always produces the same bytes.
+ *
+ * Params:
+ *   jep_byte - an array to receive the bytes
+ *   size_t - the number of bytes to generate
+ *   uint32_t - the seed of the generator
+ */
+static void generate_skewed(jep_byte* dest, size_t n, uint32_t seed)
+{
+	size_t i;
+	uint32_t x;
+	jep_byte b;
+
+	x = seed;
+
+	for (i = 0; i < n; i++)
+	{
+		// Count the leading one bits of a linear congruential
+		// generator so that each symbol is half as likely as
+		// the one before it.
+		x = x * 1664525U + 1013904223U;
+		b = 0;
+		while (b < 24 && (x >> (31 - b)) & 1)
+			b++;
+
+		dest[i] = (jep_byte)('a' + b);
+	}
+}
+
+/**
+ * Fills an array with pseudo-random bytes in which every value is
+ * equally likely, which resembles encrypted or compressed data.
+ *
+ * Params:
+ *   jep_byte - an array to receive the bytes
+ *   size_t - the number of bytes to generate
+ *   uint32_t - the seed of the generator
+ */
+static void generate_uniform(jep_byte* dest, size_t n, uint32_t seed)
+{
+	size_t i;
+	uint32_t x;
+
+	x = seed;
+
+	for (i = 0; i < n; i++)
+	{
+		x = x * 1664525U + 1013904223U;
+		dest[i] = (jep_byte)(x >> 24);
+	}
+}
+
+/**
+ * Fills an array with pseudo-random bytes of which about nine in ten
+ * are the same value and the rest are spread over sixteen others.
+ * A Huffman code spends a whole bit on the common byte, which carries
+ * much less information than that.
+ *
+ * Params:
+ *   jep_byte - an array to receive the bytes
+ *   size_t - the number of bytes to generate
+ *   uint32_t - the seed of the generator
+ */
+static void generate_dominant(jep_byte* dest, size_t n, uint32_t seed)
+{
+	size_t i;
+	uint32_t x;
+
+	x = seed;
+
+	for (i = 0; i < n; i++)
+	{
+		x = x * 1664525U + 1013904223U;
+		dest[i] = (x >> 24) < 230 ? 'e' : (jep_byte)('A' + (x >> 16) % 16);
+	}
+}
+
+/**
+ * Fills an array with lines that resemble structured logs, in which
+ * most bytes are predictable from the bytes before them.
+ *
+ * Params:
+ *   jep_byte - an array to receive the bytes
+ *   size_t - the number of bytes to generate
+ *   uint32_t - the seed of the generator
+ */
+static void generate_log(jep_byte* dest, size_t n, uint32_t seed)
+{
+	static const char* levels[] = { "INFO", "INFO", "INFO", "WARN", "DEBUG", "ERROR" };
+	static const char* paths[] = { "/v1/items", "/v1/users", "/v2/orders", "/health" };
+	char line[160];
+	size_t pos;
+	size_t len;
+	uint32_t x;
+	uint32_t t;
+
+	x = seed;
+	t = 0;
+	pos = 0;
+
+	while (pos < n)
+	{
+		x = x * 1664525U + 1013904223U;
+		t += (x >> 28) + 1;
+
+		len = (size_t)sprintf(line,
+			"2026-10-16T%02u:%02u:%02u.%03uZ level=%s svc=api req=%08x "
+			"path=%s/%u status=%u ms=%u\n",
+			(t / 3600000) % 24, (t / 60000) % 60, (t / 1000) % 60, t % 1000,
+			levels[(x >> 8) % 6], x * 2654435761U, paths[(x >> 12) % 4],
+			(x >> 16) % 1000, (x >> 20) % 16 ? 200 : 404, (x >> 4) % 250);
+
+		if (len > n - pos)
+			len = n - pos;
+
+		memcpy(dest + pos, line, len);
+		pos += len;
+	}
+}
+
+/**
+ * Decodes Huffman Coding data by walking the tree one bit at a time.
+ * This is the reference implementation that the table decoder
+ * in jep_huff_decode replaced.
+ *
+ * Params:
+ *   jep_byte_buffer - a collection of encoded bytes
+ *
+ * Returns:
+ *   jep_byte_buffer - the decoded bytes or NULL on failure
+ */
+static jep_byte_buffer* tree_walk_decode(jep_byte_buffer* encoded)
+{
+	jep_byte_buffer* raw;
+	jep_huff_code* hc;
+	jep_huff_node* root;
+	jep_huff_node* leaf;
+	uint32_t byte;
+	uint32_t bit;
+	uint32_t i;
+
+	hc = jep_huff_read(encoded);
+
+	if (hc == NULL)
+		return NULL;
+
+	raw = jep_create_byte_buffer();
+
+	if (raw == NULL)
+	{
+		jep_destroy_huff_code(hc);
+		return NULL;
+	}
+
+	root = hc->tree->nodes;
+	leaf = root;
+	bit = byte = 0;
+
+	for (i = 0; i <= hc->data->bit_count; i++)
+	{
+		if (bit == CHAR_BIT)
+		{
+			byte++;
+			bit = 0;
+		}
+
+		if (leaf->sym.w == 0)
+		{
+			jep_append_byte(raw, leaf->sym.b);
+			leaf = root;
+			i--;
+		}
+		else if (hc->data->bytes[byte] & (1 << bit++))
+		{
+			leaf = leaf->leaf_1;
+		}
+		else
+		{
+			leaf = leaf->leaf_2;
+		}
+	}
+
+	jep_destroy_huff_code(hc);
+
+	return raw;
+}
+
+/**
+ * Reads a monotonic clock in seconds.
+ * Wall time is measured rather than processor time so that work
+ * spread across several threads is not counted more than once.
+ */
+static double now()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/**
+ * Converts a number of bytes processed in a number of seconds
+ * into megabytes per second.
+ */
+static double mb_per_sec(size_t n, double sec)
+{
+	if (sec <= 0.0)
+		return 0.0;
+
+	return ((double)n / (1024.0 * 1024.0)) / sec;
+}
+
+/**
+ * Times a decoder over several runs and reports the best throughput.
+ * If no encoded bytes are given, the raw bytes are encoded first.
+ * Returns 1 if every run reproduced the original bytes, or 0 otherwise.
+ */
+static int bench_decoder(const char* name,
+	jep_byte_buffer* (*decode)(jep_byte_buffer*),
+	jep_byte_buffer* encoded,
+	jep_byte_buffer* raw)
+{
+	jep_byte_buffer* decoded;
+	jep_byte_buffer* owned;
+	double start;
+	double best;
+	double t;
+	int ok;
+	int i;
+
+	owned = NULL;
+
+	if (encoded == NULL)
+	{
+		encoded = owned = jep_huff_encode(raw);
+
+		if (encoded == NULL)
+			return 0;
+	}
+
+	ok = 1;
+	best = 0;
+
+	for (i = 0; i < BENCH_RUNS; i++)
+	{
+		start = now();
+		decoded = decode(encoded);
+		t = now() - start;
+
+		if (decoded == NULL || decoded->size != raw->size
+			|| memcmp(decoded->buffer, raw->buffer, raw->size))
+		{
+			ok = 0;
+		}
+
+		jep_destroy_byte_buffer(decoded);
+
+		if (i == 0 || t < best)
+			best = t;
+	}
+
+	printf("%-12s %10.2f MB/s%s\n", name, mb_per_sec(raw->size, best),
+		ok ? "" : "  (MISMATCH)");
+
+	jep_destroy_byte_buffer(owned);
+
+	return ok;
+}
+
+/**
+ * Compares the size and speed of structured text encoded with a single
+ * table and with a context model.
+ * Returns 1 if both decoded to the original bytes, or 0 otherwise.
+ */
+static int bench_context(jep_byte_buffer* raw)
+{
+	jep_byte_buffer* plain;
+	jep_byte_buffer* context;
+	double start;
+	double enc;
+	int ok;
+
+	start = now();
+	plain = jep_huff_encode(raw);
+	enc = now() - start;
+
+	if (plain == NULL)
+		return 0;
+
+	printf("log          %10lu bytes %10.2f MB/s\n", (unsigned long)plain->size,
+		mb_per_sec(raw->size, enc));
+
+	start = now();
+	context = jep_huff_encode_context(raw);
+	enc = now() - start;
+
+	if (context == NULL)
+	{
+		jep_destroy_byte_buffer(plain);
+		return 0;
+	}
+
+	printf("log context  %10lu bytes %10.2f MB/s\n", (unsigned long)context->size,
+		mb_per_sec(raw->size, enc));
+
+	ok = bench_decoder("log", jep_huff_decode, plain, raw);
+	ok &= bench_decoder("log context", jep_huff_decode, context, raw);
+
+	jep_destroy_byte_buffer(plain);
+	jep_destroy_byte_buffer(context);
+
+	return ok;
+}
+
+/**
+ * Times the decoding of a block protected by a checksum, which is
+ * verified before the block is decoded.
+ * Returns 1 if it decoded to the original bytes, or 0 otherwise.
+ */
+static int bench_checked(jep_byte_buffer* raw)
+{
+	jep_byte_buffer* checked;
+	int ok;
+
+	checked = jep_huff_encode_checked(raw);
+
+	if (checked == NULL)
+		return 0;
+
+	ok = bench_decoder("checked", jep_huff_decode, checked, raw);
+
+	jep_destroy_byte_buffer(checked);
+
+	return ok;
+}
+
+/**
+ * Compares encoding many small messages with a context model when each
+ * call allocates its own model and output, and when an arena keeps them.
+ * Returns 1 if every message was encoded, or 0 otherwise.
+ */
+static int bench_arena(jep_byte_buffer* raw)
+{
+	jep_huff_arena* arena;
+	jep_byte_buffer* encoded;
+	jep_byte_buffer msg;
+	double start;
+	double fresh;
+	double pooled;
+	size_t off;
+	int ok;
+
+	arena = jep_create_huff_arena();
+
+	if (arena == NULL)
+		return 0;
+
+	ok = 1;
+	msg.size = msg.cap = BENCH_MESSAGE;
+
+	start = now();
+	for (off = 0; ok && off + BENCH_MESSAGE <= raw->size; off += BENCH_MESSAGE)
+	{
+		msg.buffer = raw->buffer + off;
+		encoded = jep_huff_encode_context(&msg);
+		ok = encoded != NULL;
+		jep_destroy_byte_buffer(encoded);
+	}
+	fresh = now() - start;
+
+	start = now();
+	for (off = 0; ok && off + BENCH_MESSAGE <= raw->size; off += BENCH_MESSAGE)
+	{
+		msg.buffer = raw->buffer + off;
+		ok = jep_huff_arena_encode_context(arena, &msg) != NULL;
+	}
+	pooled = now() - start;
+
+	printf("%-12s %10.2f MB/s\n", "msg context", mb_per_sec(raw->size, fresh));
+	printf("%-12s %10.2f MB/s\n", "msg arena", mb_per_sec(raw->size, pooled));
+
+	jep_destroy_huff_arena(arena);
+
+	return ok;
+}
+
+/**
+ * Compares the size and speed of bytes encoded with Huffman codes
+ * and with ANS.
+ * Returns 1 if both decoded to the original bytes, or 0 otherwise.
+ */
+static int bench_ans(const char* name, jep_byte_buffer* raw)
+{
+	jep_byte_buffer* huff;
+	jep_byte_buffer* ans;
+	char label[32];
+	double start;
+	double enc;
+	int ok;
+
+	huff = jep_huff_encode(raw);
+
+	if (huff == NULL)
+		return 0;
+
+	start = now();
+	ans = jep_huff_encode_ans(raw);
+	enc = now() - start;
+
+	if (ans == NULL)
+	{
+		jep_destroy_byte_buffer(huff);
+		return 0;
+	}
+
+	sprintf(label, "%s huff", name);
+	printf("%-12s %10lu bytes\n", label, (unsigned long)huff->size);
+	ok = bench_decoder(label, jep_huff_decode, huff, raw);
+
+	sprintf(label, "%s ans", name);
+	printf("%-12s %10lu bytes %10.2f MB/s\n", label, (unsigned long)ans->size,
+		mb_per_sec(raw->size, enc));
+	ok &= bench_decoder(label, jep_huff_decode, ans, raw);
+
+	jep_destroy_byte_buffer(huff);
+	jep_destroy_byte_buffer(ans);
+
+	return ok;
+}
+
+/**
+ * Decompresses an LZ frame for bench_decoder.
+ */
+static jep_byte_buffer* lz_decode(jep_byte_buffer* encoded)
+{
+	return jep_lz_decompress(encoded);
+}
+
+/**
+ * Compares the size and speed of text compressed with LZ77 at the
+ * fastest, default, and smallest levels.
+ * Returns 1 if every level decoded to the original bytes, or 0 otherwise.
+ */
+static int bench_lz(jep_byte_buffer* raw)
+{
+	static const uint32_t levels[] = {
+		JEP_LZ_MIN_LEVEL, JEP_LZ_DEFAULT_LEVEL, JEP_LZ_MAX_LEVEL
+	};
+	jep_byte_buffer* lz;
+	char name[16];
+	double start;
+	double enc;
+	int ok;
+	int i;
+
+	ok = 1;
+
+	for (i = 0; i < 3; i++)
+	{
+		start = now();
+		lz = jep_lz_compress(raw, levels[i]);
+		enc = now() - start;
+
+		if (lz == NULL)
+			return 0;
+
+		sprintf(name, "log lz %u", levels[i]);
+		printf("%-12s %10lu bytes %10.2f MB/s\n", name, (unsigned long)lz->size,
+			mb_per_sec(raw->size, enc));
+
+		ok &= bench_decoder(name, lz_decode, lz, raw);
+
+		jep_destroy_byte_buffer(lz);
+	}
+
+	return ok;
+}
+
+/**
+ * Times encoding and decoding into arrays owned by the caller over
+ * several runs and reports the best throughput of each.
+ * Returns 1 if every run reproduced the original bytes, or 0 otherwise.
+ */
+static int bench_into(jep_byte_buffer* raw)
+{
+	jep_byte* encoded;
+	jep_byte* decoded;
+	size_t enc_size;
+	size_t dec_size;
+	double start;
+	double best_enc;
+	double best_dec;
+	double enc;
+	double dec;
+	int ok;
+	int i;
+
+	encoded = jep_alloc(jep_byte, jep_huff_compress_bound(raw->size));
+	decoded = jep_alloc(jep_byte, raw->size);
+
+	if (encoded == NULL || decoded == NULL)
+	{
+		free(encoded);
+		free(decoded);
+		return 0;
+	}
+
+	ok = 1;
+	best_enc = best_dec = 0;
+
+	for (i = 0; i < BENCH_RUNS; i++)
+	{
+		start = now();
+		if (!jep_huff_encode_to(raw->buffer, raw->size, encoded,
+			jep_huff_compress_bound(raw->size), &enc_size))
+		{
+			ok = 0;
+			break;
+		}
+		enc = now() - start;
+
+		start = now();
+		if (!jep_huff_decode_to(encoded, enc_size, decoded, raw->size,
+			&dec_size) || dec_size != raw->size
+			|| memcmp(decoded, raw->buffer, raw->size))
+		{
+			ok = 0;
+		}
+		dec = now() - start;
+
+		if (i == 0 || enc < best_enc)
+			best_enc = enc;
+
+		if (i == 0 || dec < best_dec)
+			best_dec = dec;
+	}
+
+	printf("%-12s %10.2f MB/s %10.2f MB/s%s\n", "into",
+		mb_per_sec(raw->size, best_enc), mb_per_sec(raw->size, best_dec),
+		ok ? "" : "  (MISMATCH)");
+
+	free(encoded);
+	free(decoded);
+
+	return ok;
+}
+
+/**
+ * Times the compression and decompression of a file into another file.
+ * The files are written to the current directory and removed afterwards.
+ * Returns 1 if every run reproduced the original bytes, or 0 otherwise.
+ */
+static int bench_files(jep_byte_buffer* raw)
+{
+	const char* raw_path = "huff_bench.raw";
+	const char* huff_path = "huff_bench.huff";
+	const char* out_path = "huff_bench.out";
+	jep_byte* decoded;
+	double start;
+	double best_enc;
+	double best_dec;
+	double enc;
+	double dec;
+	FILE* f;
+	int ok;
+	int i;
+
+	f = fopen(raw_path, "wb");
+	decoded = jep_alloc(jep_byte, raw->size);
+
+	ok = f != NULL && decoded != NULL
+		&& fwrite(raw->buffer, 1, raw->size, f) == raw->size;
+
+	if (f != NULL && fclose(f) != 0)
+		ok = 0;
+
+	best_enc = best_dec = 0;
+
+	for (i = 0; ok && i < BENCH_RUNS; i++)
+	{
+		start = now();
+		ok = jep_huff_compress_file(raw_path, huff_path);
+		enc = now() - start;
+
+		start = now();
+		ok = ok && jep_huff_decompress_file(huff_path, out_path);
+		dec = now() - start;
+
+		f = ok ? fopen(out_path, "rb") : NULL;
+
+		if (f == NULL || fread(decoded, 1, raw->size, f) != raw->size
+			|| fgetc(f) != EOF || memcmp(decoded, raw->buffer, raw->size))
+		{
+			ok = 0;
+		}
+
+		if (f != NULL)
+			fclose(f);
+
+		if (i == 0 || enc < best_enc)
+			best_enc = enc;
+
+		if (i == 0 || dec < best_dec)
+			best_dec = dec;
+	}
+
+	printf("%-12s %10.2f MB/s %10.2f MB/s%s\n", "file",
+		mb_per_sec(raw->size, best_enc), mb_per_sec(raw->size, best_dec),
+		ok ? "" : "  (MISMATCH)");
+
+	remove(raw_path);
+	remove(huff_path);
+	remove(out_path);
+	free(decoded);
+
+	return ok;
+}
+
+/**
+ * Times the encoding and decoding of an indexed container with a number
+ * of threads over several runs and reports the best throughput of each.
+ * Returns 1 if every run reproduced the original bytes, or 0 otherwise.
+ */
+static int bench_blocks(uint32_t threads, jep_byte_buffer* raw)
+{
+	jep_byte_buffer* encoded;
+	jep_byte_buffer* decoded;
+	double start;
+	double best_enc;
+	double best_dec;
+	double enc;
+	double dec;
+	int ok;
+	int i;
+
+	ok = 1;
+	best_enc = best_dec = 0;
+
+	for (i = 0; i < BENCH_RUNS; i++)
+	{
+		start = now();
+		encoded = jep_huff_encode_blocks(raw, 0, threads);
+		enc = now() - start;
+
+		start = now();
+		decoded = encoded != NULL ? jep_huff_decode_blocks(encoded, threads) : NULL;
+		dec = now() - start;
+
+		if (decoded == NULL || decoded->size != raw->size
+			|| memcmp(decoded->buffer, raw->buffer, raw->size))
+		{
+			ok = 0;
+		}
+
+		jep_destroy_byte_buffer(encoded);
+		jep_destroy_byte_buffer(decoded);
+
+		if (i == 0 || enc < best_enc)
+			best_enc = enc;
+
+		if (i == 0 || dec < best_dec)
+			best_dec = dec;
+	}
+
+	printf("blocks x%-4u %10.2f MB/s %10.2f MB/s%s\n", threads,
+		mb_per_sec(raw->size, best_enc), mb_per_sec(raw->size, best_dec),
+		ok ? "" : "  (MISMATCH)");
+
+	return ok;
+}
+
+int main(int argc, char** argv)
+{
+	jep_byte_buffer* raw;
+	jep_byte_buffer* encoded;
+	double start;
+	uint32_t threads;
+	int ok;
+
+	raw = jep_create_byte_buffer();
+
+	if (raw == NULL)
+		return 1;
+
+	free(raw->buffer);
+	raw->buffer = jep_alloc(jep_byte, BENCH_SIZE);
+
+	if (raw->buffer == NULL)
+	{
+		free(raw);
+		return 1;
+	}
+
+	raw->cap = raw->size = BENCH_SIZE;
+	generate_skewed(raw->buffer, raw->size, 12345);
+
+	start = now();
+	encoded = jep_huff_encode(raw);
+
+	if (encoded == NULL)
+	{
+		jep_destroy_byte_buffer(raw);
+		return 1;
+	}
+
+	printf("input        %10lu bytes\n", (unsigned long)raw->size);
+	printf("encoded      %10lu bytes\n", (unsigned long)encoded->size);
+	printf("encode       %10.2f MB/s\n", mb_per_sec(raw->size, now() - start));
+
+	ok = bench_decoder("tree walk", tree_walk_decode, encoded, raw);
+	ok &= bench_decoder("table", jep_huff_decode, encoded, raw);
+	ok &= bench_checked(raw);
+	ok &= bench_ans("skew", raw);
+
+	// The frequencies above are powers of two, which a Huffman code
+	// matches exactly. When one byte is far more likely than any power
+	// of two allows for, ANS spends less than a bit on it.
+	generate_dominant(raw->buffer, raw->size, 12345);
+	ok &= bench_ans("peaked", raw);
+
+	// Random bytes are stored and a repeated byte is written as a run,
+	// so both decode at the speed of a copy.
+	generate_uniform(raw->buffer, raw->size, 12345);
+	ok &= bench_decoder("stored", jep_huff_decode, NULL, raw);
+
+	memset(raw->buffer, 'a', raw->size);
+	ok &= bench_decoder("run", jep_huff_decode, NULL, raw);
+
+	// A context model chooses a table for each byte by the byte
+	// before it, which suits text with a regular structure.
+	generate_log(raw->buffer, raw->size, 12345);
+	ok &= bench_context(raw);
+	ok &= bench_arena(raw);
+
+	// Repeated keys and prefixes are replaced by references
+	// to their earlier copies.
+	ok &= bench_lz(raw);
+
+	generate_skewed(raw->buffer, raw->size, 12345);
+
+	printf("%-12s %15s %15s\n", "", "encode", "decode");
+	ok &= bench_into(raw);
+	ok &= bench_files(raw);
+	for (threads = 1; threads <= 8; threads *= 2)
+		ok &= bench_blocks(threads, raw);
+
+	jep_destroy_byte_buffer(encoded);
+	jep_destroy_byte_buffer(raw);
+
+	return ok ? 0 : 1;
+}
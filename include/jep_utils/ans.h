@@ -0,0 +1,134 @@
+#ifndef JEP_ANS_H
+#define JEP_ANS_H
+
+#include "jep_utils.h"
+#include "byte_buffer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+
+
+/* the number of bits in the state of the coder */
+#define JEP_ANS_TABLE_BITS 11
+
+/* the number of states of the coder */
+#define JEP_ANS_TABLE_SIZE (1 << JEP_ANS_TABLE_BITS)
+
+
+
+
+/**
+ * Determines the largest number of bytes that jep_ans_encode_to can
+ * write for a number of raw bytes.
+ * Returns 0 if that many bytes cannot be encoded as a single frame.
+ *
+ * An ANS frame begins with the number of raw bytes as a 32-bit little
+ * endian integer, followed by the frequency of each byte scaled to
+ * JEP_ANS_TABLE_SIZE, and the final states of the encoder. The bytes
+ * take turns between four states, and each state writes its bits to
+ * its own bitstream, so the frame ends with the number of bits in each
+ * bitstream and then the bitstreams one after another.
+ *
+ * Params:
+ *   size_t - the number of raw bytes
+ *
+ * Returns:
+ *   size_t - the largest possible size of the frame
+ */
+JEP_UTILS_API size_t JEP_UTILS_CALL
+jep_ans_bound(size_t n);
+
+/**
+ * Encodes an array of bytes as an ANS frame using table-based
+ * asymmetric numeral systems (tANS).
+ * Unlike Huffman Coding, a byte can cost a fraction of a bit, so very
+ * common bytes are encoded in less space than any code could give them.
+ * No memory is allocated.
+ * Fails if the frame does not fit within the capacity.
+ *
+ * Params:
+ *   jep_byte - an array of raw bytes
+ *   size_t - the number of raw bytes
+ *   jep_byte - an array to receive the frame
+ *   size_t - the capacity of the array
+ *   size_t - a pointer to receive the size of the frame
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+JEP_UTILS_API int JEP_UTILS_CALL
+jep_ans_encode_to(const jep_byte* src, size_t n, jep_byte* dest, size_t cap,
+	size_t* size);
+
+/**
+ * Decodes an ANS frame into memory provided by the caller.
+ * No memory is allocated.
+ * Fails if the frame is damaged or the decoded bytes do not fit
+ * within the capacity.
+ *
+ * Params:
+ *   jep_byte - an array holding a frame
+ *   size_t - the number of bytes in the array
+ *   jep_byte - an array to receive the decoded bytes
+ *   size_t - the capacity of the array
+ *   size_t - a pointer to receive the number of decoded bytes
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+JEP_UTILS_API int JEP_UTILS_CALL
+jep_ans_decode_to(const jep_byte* src, size_t n, jep_byte* dest, size_t cap,
+	size_t* size);
+
+/**
+ * Determines the number of bytes that an ANS frame decodes to.
+ * The header of the frame is checked, so a frame whose frequencies,
+ * states, or bits are damaged, or which cannot hold as many bytes as
+ * it claims, fails before any room is made for its bytes.
+ * No memory is allocated.
+ *
+ * Params:
+ *   jep_byte - an array holding a frame
+ *   size_t - the number of bytes in the array
+ *   size_t - a pointer to receive the number of decoded bytes
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+JEP_UTILS_API int JEP_UTILS_CALL
+jep_ans_measure(const jep_byte* src, size_t n, size_t* count);
+
+/**
+ * Encodes a series of bytes as an ANS frame.
+ * Returns NULL on failure.
+ *
+ * Params:
+ *   jep_byte_buffer - a collection of raw, unencoded bytes
+ *
+ * Returns:
+ *   jep_byte_buffer - a collection of bytes holding the frame
+ */
+JEP_UTILS_API jep_byte_buffer* JEP_UTILS_CALL
+jep_ans_encode(jep_byte_buffer* raw);
+
+/**
+ * Decodes an ANS frame.
+ * Returns NULL on failure.
+ *
+ * Params:
+ *   jep_byte_buffer - a collection of bytes holding a frame
+ *
+ * Returns:
+ *   jep_byte_buffer - the decoded bytes
+ */
+JEP_UTILS_API jep_byte_buffer* JEP_UTILS_CALL
+jep_ans_decode(jep_byte_buffer* encoded);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
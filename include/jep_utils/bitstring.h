@@ -3,6 +3,10 @@
 
 #include "jep_utils.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 
 
 
@@ -106,4 +110,8 @@ jep_set_bit(jep_bitstring* bs, int index, unsigned int value);
 JEP_UTILS_API int JEP_UTILS_CALL
 jep_pop_bit(jep_bitstring* bs);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif
@@ -3,6 +3,10 @@
 
 #include "jep_utils.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 
 
 
@@ -96,4 +100,8 @@ jep_remove_byte_at(jep_byte_buffer* bb, size_t index);
 JEP_UTILS_API int JEP_UTILS_CALL
 jep_clear_byte_buffer(jep_byte_buffer* bb);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif
@@ -4,6 +4,10 @@
 #include "jep_utils.h"
 #include "character.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 
 
 
@@ -97,4 +101,8 @@ jep_remove_char_at(jep_char_buffer* cb, size_t index);
 JEP_UTILS_API int JEP_UTILS_CALL
 jep_clear_char_buffer(jep_char_buffer* cb);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif
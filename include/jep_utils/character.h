@@ -4,6 +4,10 @@
 #include "jep_utils.h"
 #include "unicode.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 
 
 
@@ -59,4 +63,8 @@ typedef jep_code_point jep_char;
 JEP_UTILS_API int JEP_UTILS_CALL
 jep_char_cmp(jep_char a, jep_char b);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif
@@ -0,0 +1,35 @@
+#ifndef JEP_CRC_H
+#define JEP_CRC_H
+
+#include "jep_utils.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+
+
+/**
+ * Computes the CRC-32C (Castagnoli) checksum of an array of bytes.
+ * A checksum can be computed in pieces by passing the result of one
+ * call as the initial value of the next. The first call starts at 0.
+ * Eight bytes are folded into the checksum at a time with a separate
+ * table for each, so no step waits on more than one table lookup.
+ *
+ * Params:
+ *   uint32_t - the checksum of the preceding bytes, or 0
+ *   jep_byte - an array of bytes
+ *   size_t - the number of bytes
+ *
+ * Returns:
+ *   uint32_t - the checksum of the preceding bytes and the array
+ */
+JEP_UTILS_API uint32_t JEP_UTILS_CALL
+jep_crc32c(uint32_t crc, const jep_byte* src, size_t n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef JEP_HISTOGRAM_H
+#define JEP_HISTOGRAM_H
+
+#include "jep_utils.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+
+
+/* the number of counters in a byte histogram */
+#define JEP_HISTOGRAM_SIZE (UCHAR_MAX + 1)
+
+
+
+
+/**
+ * Counts the number of times that each byte value occurs in an array
+ * of bytes. The counters are overwritten rather than added to.
+ * Large inputs are counted into several separate tables that are
+ * combined at the end, so that a run of the same byte does not make
+ * each increment wait for the one before it.
+ * Fails if the counters could overflow.
+ *
+ * Params:
+ *   jep_byte - an array of bytes
+ *   size_t - the number of bytes
+ *   uint32_t - an array of JEP_HISTOGRAM_SIZE counters
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+JEP_UTILS_API int JEP_UTILS_CALL
+jep_byte_histogram(const jep_byte* src, size_t n, uint32_t* counts);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -5,6 +5,26 @@
 #include "bitstring.h"
 #include "byte_buffer.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+
+
+/* the longest code that the encoder can be asked to produce */
+#define JEP_HUFF_MAX_CODE_LENGTH 32
+
+/* the longest code produced by jep_huff_encode */
+#define JEP_HUFF_DEFAULT_CODE_LENGTH 11
+
+/* the number of raw bytes in each block of a Huffman stream */
+#define JEP_HUFF_DEFAULT_BLOCK_SIZE (128 * 1024)
+
+/* the entropy coders that a Huffman stream can encode blocks with */
+#define JEP_HUFF_CODER_HUFFMAN 0
+#define JEP_HUFF_CODER_ANS 1
+
 
 
 
@@ -33,26 +53,26 @@ typedef struct jep_huff_dict {
 
 /**
  * A Huffman node is a single element in a Huffman tree.
+ * A node with a weight of 0 is a terminal node.
  */
 typedef struct jep_huff_node {
     jep_huff_sym sym;
     struct jep_huff_node* leaf_1;
     struct jep_huff_node* leaf_2;
-    struct jep_huff_node* next;
-    struct jep_huff_node* prev;
 }jep_huff_node;
 
 /**
  * A Huffman tree is an arrangment of Huffman symbols based on their
  * frequency of occurrence in the source.
- * The symbols are wrapped in nodes which are linked together into a
- * list referred to as a Huffman tree.
+ * The symbols are wrapped in nodes which are stored together in a
+ * single array. The first node in the array is the root node.
  * The tree can be traversed to determine the bit string code for a
  * symbol in a terminal node.
  */
 typedef struct jep_huff_tree {
-    jep_huff_node* nodes;
-    jep_huff_node* tail;
+    jep_huff_node* nodes; /* node array beginning with the root */
+    uint32_t count;       /* number of nodes in use             */
+    uint32_t cap;         /* number of nodes allocated          */
 }jep_huff_tree;
 
 /**
@@ -65,11 +85,81 @@ typedef struct jep_huff_code {
     jep_bitstring* data;
 }jep_huff_code;
 
+/**
+ * A Huffman stream encodes or decodes data one block at a time so that
+ * the whole input never has to be held in memory.
+ * When encoding, each block of raw bytes is written with its own
+ * dictionary as soon as it is full. When decoding, blocks with a
+ * single code table or several bitstreams, and stored blocks, are
+ * decoded as their bytes arrive. Other blocks are collected until the
+ * entire block is available.
+ */
+typedef struct jep_huff_stream {
+    jep_byte_buffer* pending; /* bytes of an incomplete block     */
+    size_t block_size;        /* number of raw bytes per block    */
+    uint32_t limit;           /* longest code written in a block  */
+    uint32_t coder;           /* entropy coder of the next block  */
+    int checked;              /* 1 if blocks carry a checksum     */
+    void* partial;            /* a block decoded as it arrives    */
+}jep_huff_stream;
+
+/**
+ * A Huffman table is a dictionary that is shared by many messages.
+ * Every byte value has a code, so any message can be encoded with it.
+ * A table is usually trained from samples of the messages it will
+ * encode and then written once, apart from the messages. Since the
+ * messages do not contain a dictionary, each one only costs its
+ * length and its bits.
+ */
+typedef struct jep_huff_table {
+    jep_huff_dict* dict; /* canonical codes for every byte value  */
+    void* lookup;        /* the encoding and decoding tables      */
+}jep_huff_table;
+
+/**
+ * Huffman statistics describe how a series of bytes was encoded.
+ * The time spent in each phase is only measured when the library is
+ * built with JEP_HUFF_STATS defined. Otherwise the timings are 0, and
+ * encoding and decoding never read the clock.
+ */
+typedef struct jep_huff_stats {
+    uint32_t counts[UCHAR_MAX + 1]; /* occurrences of each byte       */
+    double entropy;                 /* fewest bits per byte possible  */
+    double average_length;          /* bits per byte of coded data    */
+    uint32_t max_length;            /* longest code in bits           */
+    size_t raw_bytes;               /* number of raw bytes            */
+    size_t header_bytes;            /* bytes of headers and lengths   */
+    size_t payload_bytes;           /* bytes of coded data            */
+    uint64_t count_ns;              /* time spent counting bytes      */
+    uint64_t tree_ns;               /* time spent building the tree   */
+    uint64_t code_ns;               /* time spent assigning codes     */
+    uint64_t pack_ns;               /* time spent packing bits        */
+    uint64_t decode_ns;             /* time spent decoding            */
+}jep_huff_stats;
+
+/**
+ * A Huffman arena holds the memory used to encode and decode many
+ * small messages, one after another. The output and scratch space are
+ * allocated by the first call that needs them and are kept when the
+ * arena is reset, so later calls of a similar size allocate nothing.
+ */
+typedef struct jep_huff_arena {
+    jep_byte_buffer* output; /* bytes produced by the latest call */
+    void* model;             /* scratch space of context models   */
+}jep_huff_arena;
+
 
 
 
 /**
  * Encodes a series of bytes as a bitstring using Huffman Coding.
+ * The bitcodes are canonical, so the output only needs to describe
+ * the length of each code.
+ * Larger inputs are divided into four segments whose bitstreams are
+ * stored one after another, so that they can be decoded together.
+ * Bytes that Huffman Coding cannot make smaller are stored as they are,
+ * and a single repeated byte is written once with its count.
+ * An empty series is written as an empty stored block.
  * Returns NULL on failure.
  *
  * Params:
@@ -82,8 +172,144 @@ typedef struct jep_huff_code {
 JEP_UTILS_API jep_byte_buffer* JEP_UTILS_CALL
 jep_huff_encode(jep_byte_buffer* raw);
 
+/**
+ * Encodes a series of bytes using Huffman Coding such that no code is
+ * longer than the specified number of bits.
+ * Keeping codes short allows them to be decoded with a small table
+ * at the cost of a slightly larger output.
+ * jep_huff_encode uses a limit of JEP_HUFF_DEFAULT_CODE_LENGTH.
+ * Returns NULL on failure, or if the limit is less than 1, greater than
+ * JEP_HUFF_MAX_CODE_LENGTH, or too short to give every unique byte
+ * its own code.
+ *
+ * Params:
+ *   jep_byte_buffer - a collection of raw, unencoded bytes
+ *   uint32_t - the maximum length of a code in bits
+ *
+ * Returns:
+ *   jep_byte_buffer - a collection of bytes of data encoded with
+ *     Huffman Coding.
+ */
+JEP_UTILS_API jep_byte_buffer* JEP_UTILS_CALL
+jep_huff_encode_limited(jep_byte_buffer* raw, uint32_t limit);
+
+/**
+ * Encodes a series of bytes using several code tables, choosing the
+ * table for each byte by the byte before it.
+ * Data in which each byte depends on the one before it, such as text
+ * and structured logs, is encoded in fewer bits than with a single
+ * table. Previous bytes that are followed by similar bytes share one
+ * of up to eight tables, and the map from previous bytes to tables
+ * is written along with the tables.
+ * If the tables would not make the output smaller, the bytes are
+ * encoded as they would be by jep_huff_encode. Either way, the output
+ * can be decoded by jep_huff_decode.
+ * Returns NULL on failure.
+ *
+ * Params:
+ *   jep_byte_buffer - a collection of raw, unencoded bytes
+ *
+ * Returns:
+ *   jep_byte_buffer - a collection of encoded bytes
+ */
+JEP_UTILS_API jep_byte_buffer* JEP_UTILS_CALL
+jep_huff_encode_context(jep_byte_buffer* raw);
+
+/**
+ * Encodes a series of bytes as a single block using table-based
+ * asymmetric numeral systems instead of Huffman codes.
+ * The frequencies of the bytes are kept to within 1/2048, so bytes that
+ * make up most of the input cost much less than the single bit that
+ * their Huffman code would. The output can be decoded by
+ * jep_huff_decode. See ans.h for the format of the block's frame.
+ * Returns NULL on failure.
+ *
+ * Params:
+ *   jep_byte_buffer - a collection of raw, unencoded bytes
+ *
+ * Returns:
+ *   jep_byte_buffer - a collection of encoded bytes
+ */
+JEP_UTILS_API jep_byte_buffer* JEP_UTILS_CALL
+jep_huff_encode_ans(jep_byte_buffer* raw);
+
+/**
+ * Encodes a series of bytes like jep_huff_encode and protects the
+ * block with a checksum.
+ * A checked block begins with the bytes 0x4A 0x03 0x08, followed by
+ * the size of the block inside it and the CRC-32C of that block's
+ * bytes, both as 32-bit little endian integers, and then the block.
+ * Decoding verifies the checksum before anything is decoded and fails
+ * if it does not match, so damage is reported rather than decoded into
+ * the wrong bytes. The checksum costs 11 bytes.
+ * Returns NULL on failure.
+ *
+ * Params:
+ *   jep_byte_buffer - a collection of raw, unencoded bytes
+ *
+ * Returns:
+ *   jep_byte_buffer - a collection of encoded bytes
+ */
+JEP_UTILS_API jep_byte_buffer* JEP_UTILS_CALL
+jep_huff_encode_checked(jep_byte_buffer* raw);
+
+/**
+ * Encodes a series of bytes as an indexed container of blocks.
+ * Each block has its own dictionary, so the blocks are encoded
+ * independently on several threads. The container begins with an index
+ * of the offset of every block.
+ * Returns NULL on failure.
+ *
+ * Params:
+ *   jep_byte_buffer - a collection of raw, unencoded bytes
+ *   size_t - the number of raw bytes per block, or 0 to use
+ *     JEP_HUFF_DEFAULT_BLOCK_SIZE
+ *   uint32_t - the number of threads, or 0 for one per processor
+ *
+ * Returns:
+ *   jep_byte_buffer - an indexed container of encoded blocks
+ */
+JEP_UTILS_API jep_byte_buffer* JEP_UTILS_CALL
+jep_huff_encode_blocks(jep_byte_buffer* raw, size_t block_size, uint32_t threads);
+
+/**
+ * Decodes an indexed container produced by jep_huff_encode_blocks.
+ * The size of every block is known from the index, so the blocks are
+ * decoded independently on several threads directly into the output.
+ * Returns NULL on failure.
+ *
+ * Params:
+ *   jep_byte_buffer - an indexed container of encoded blocks
+ *   uint32_t - the number of threads, or 0 for one per processor
+ *
+ * Returns:
+ *   jep_byte_buffer - a collection of raw, unencoded bytes
+ */
+JEP_UTILS_API jep_byte_buffer* JEP_UTILS_CALL
+jep_huff_decode_blocks(jep_byte_buffer* encoded, uint32_t threads);
+
+/**
+ * Decodes the block of an indexed container that contains the raw byte
+ * at the specified offset. No other block is read.
+ * Returns NULL on failure, or if the offset is beyond the end of the
+ * raw data.
+ *
+ * Params:
+ *   jep_byte_buffer - an indexed container of encoded blocks
+ *   size_t - the offset of a byte in the raw data
+ *   size_t - a pointer to receive the offset of the first byte of the
+ *     block in the raw data, or NULL
+ *
+ * Returns:
+ *   jep_byte_buffer - the raw bytes of the block
+ */
+JEP_UTILS_API jep_byte_buffer* JEP_UTILS_CALL
+jep_huff_decode_at(jep_byte_buffer* encoded, size_t offset, size_t* start);
+
 /**
  * Decodes a bitstring containing data encoded with Huffman Coding.
+ * Indexed containers produced by jep_huff_encode_blocks are also
+ * accepted.
  * Returns NULL on failure.
  *
  * Params:
@@ -96,8 +322,104 @@ jep_huff_encode(jep_byte_buffer* raw);
 JEP_UTILS_API jep_byte_buffer* JEP_UTILS_CALL
 jep_huff_decode(jep_byte_buffer* encoded);
 
+/**
+ * Determines the largest number of bytes that jep_huff_encode_to
+ * can write for a number of raw bytes.
+ * Returns 0 if that many bytes cannot be encoded as a single block.
+ *
+ * Params:
+ *   size_t - the number of raw bytes
+ *
+ * Returns:
+ *   size_t - the largest possible size of the encoded block
+ */
+JEP_UTILS_API size_t JEP_UTILS_CALL
+jep_huff_compress_bound(size_t n);
+
+/**
+ * Encodes an array of bytes into memory provided by the caller.
+ * The output is the same as that of jep_huff_encode, but no memory
+ * is allocated.
+ * Fails if the capacity is less than jep_huff_compress_bound of the
+ * number of raw bytes and the block might not fit.
+ *
+ * Params:
+ *   jep_byte - an array of raw bytes
+ *   size_t - the number of raw bytes
+ *   jep_byte - an array to receive the encoded bytes
+ *   size_t - the capacity of the array
+ *   size_t - a pointer to receive the number of encoded bytes
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+JEP_UTILS_API int JEP_UTILS_CALL
+jep_huff_encode_to(const jep_byte* src, size_t n, jep_byte* dest, size_t cap,
+	size_t* size);
+
+/**
+ * Decodes an encoded block or indexed container into memory provided
+ * by the caller. No memory is allocated unless the data was written
+ * in the original format, which lists every bit of every code.
+ * Fails if the decoded bytes do not fit within the capacity.
+ *
+ * Params:
+ *   jep_byte - an array of encoded bytes
+ *   size_t - the number of encoded bytes
+ *   jep_byte - an array to receive the decoded bytes
+ *   size_t - the capacity of the array
+ *   size_t - a pointer to receive the number of decoded bytes
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+JEP_UTILS_API int JEP_UTILS_CALL
+jep_huff_decode_to(const jep_byte* src, size_t n, jep_byte* dest, size_t cap,
+	size_t* size);
+
+/**
+ * Encodes a series of bytes like jep_huff_encode and describes how
+ * they were encoded.
+ * Blocks of stored bytes have no codes, so their length is 0 and their
+ * bytes are payload. A run block is all header.
+ * Returns NULL on failure.
+ *
+ * Params:
+ *   jep_byte_buffer - a collection of raw, unencoded bytes
+ *   jep_huff_stats - the statistics to be filled
+ *
+ * Returns:
+ *   jep_byte_buffer - a collection of encoded bytes
+ */
+JEP_UTILS_API jep_byte_buffer* JEP_UTILS_CALL
+jep_huff_encode_stats(jep_byte_buffer* raw, jep_huff_stats* stats);
+
+/**
+ * Decodes a series of bytes like jep_huff_decode and describes how
+ * they were encoded.
+ * Only blocks with a single code table and blocks of stored bytes or
+ * runs are divided into header and payload. The bytes of any other
+ * encoding are all counted as payload.
+ * Returns NULL on failure.
+ *
+ * Params:
+ *   jep_byte_buffer - a collection of encoded bytes
+ *   jep_huff_stats - the statistics to be filled
+ *
+ * Returns:
+ *   jep_byte_buffer - the decoded bytes
+ */
+JEP_UTILS_API jep_byte_buffer* JEP_UTILS_CALL
+jep_huff_decode_stats(jep_byte_buffer* encoded, jep_huff_stats* stats);
+
 /**
  * Reads data encoded with Huffman Coding from a byte buffer.
+ * Both the canonical format and the original format, which lists
+ * every bit of every code, can be read. If the data was divided into
+ * several bitstreams, they are joined into a single bitstring.
+ * Stored blocks and blocks of a single repeated byte have no codes,
+ * so they cannot be read. Neither can blocks with several code tables,
+ * blocks encoded with ANS, or checked blocks.
  *
  * Params:
  *   jep_byte_buffer - a collection of encoded bytes
@@ -111,6 +433,12 @@ jep_huff_read(jep_byte_buffer* raw);
 /**
  * Writes data encoded with Huffman Coding to a byte buffer.
  * The data should be preceded by the bitcode dictionary.
+ * If the bitcodes are canonical, the dictionary is written as a header
+ * followed by the length of each code, and the data is preceded by the
+ * number of bytes that it decodes to so that a decoder can make room
+ * for all of them at once. Otherwise, it is written in the
+ * original format.
+ * Fails if the data cannot be decoded with the canonical codes.
  *
  * Params:
  *   huff_code - a Huffman Coding context
@@ -131,4 +459,363 @@ jep_huff_write(jep_huff_code* hc, jep_byte_buffer* buffer);
 JEP_UTILS_API void JEP_UTILS_CALL
 jep_destroy_huff_code(jep_huff_code* hc);
 
+/**
+ * Creates a Huffman stream for encoding.
+ * The encoded stream is a series of blocks, each of which has the same
+ * format as the output of jep_huff_encode. At most one block of raw
+ * bytes is held by the stream at any time.
+ * Returns NULL on failure.
+ *
+ * Params:
+ *   size_t - the number of raw bytes per block, or 0 to use
+ *     JEP_HUFF_DEFAULT_BLOCK_SIZE
+ *
+ * Returns:
+ *   jep_huff_stream - a new Huffman stream
+ */
+JEP_UTILS_API jep_huff_stream* JEP_UTILS_CALL
+jep_huff_encode_init(size_t block_size);
+
+/**
+ * Adds raw bytes to a Huffman stream.
+ * Each block that is filled is encoded and appended to the output
+ * buffer. The output buffer can be emptied between calls by setting
+ * its size to 0, which keeps its memory for the blocks that follow.
+ *
+ * Params:
+ *   jep_huff_stream - a Huffman stream created for encoding
+ *   jep_byte - an array of raw bytes
+ *   size_t - the number of raw bytes
+ *   jep_byte_buffer - a byte buffer to receive the encoded blocks
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+JEP_UTILS_API int JEP_UTILS_CALL
+jep_huff_encode_update(jep_huff_stream* stream, const jep_byte* src, size_t n,
+	jep_byte_buffer* out);
+
+/**
+ * Encodes any raw bytes remaining in a Huffman stream as a final block
+ * and appends it to the output buffer.
+ * The stream may then be used to encode new data.
+ *
+ * Params:
+ *   jep_huff_stream - a Huffman stream created for encoding
+ *   jep_byte_buffer - a byte buffer to receive the final block
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+JEP_UTILS_API int JEP_UTILS_CALL
+jep_huff_encode_finish(jep_huff_stream* stream, jep_byte_buffer* out);
+
+/**
+ * Selects the entropy coder of the blocks that a Huffman stream
+ * encodes from now on. Blocks that have already been encoded keep
+ * their coder, so a single stream can mix blocks of each kind.
+ * New streams use JEP_HUFF_CODER_HUFFMAN.
+ * Fails if the coder is not one of the JEP_HUFF_CODER values.
+ *
+ * Params:
+ *   jep_huff_stream - a Huffman stream created for encoding
+ *   uint32_t - JEP_HUFF_CODER_HUFFMAN or JEP_HUFF_CODER_ANS
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+JEP_UTILS_API int JEP_UTILS_CALL
+jep_huff_encode_select(jep_huff_stream* stream, uint32_t coder);
+
+/**
+ * Chooses whether the blocks that a Huffman stream encodes from now on
+ * are protected by a checksum, as in jep_huff_encode_checked.
+ * New streams do not add checksums.
+ *
+ * Params:
+ *   jep_huff_stream - a Huffman stream created for encoding
+ *   int - 1 to add a checksum to each block or 0 otherwise
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+JEP_UTILS_API int JEP_UTILS_CALL
+jep_huff_encode_checksum(jep_huff_stream* stream, int checked);
+
+/**
+ * Creates a Huffman stream for decoding.
+ * The stream can decode the output of a Huffman stream used for
+ * encoding, or of jep_huff_encode. At most one encoded block is
+ * held by the stream at any time, and blocks that are decoded as they
+ * arrive only hold their header and a few kilobytes of state.
+ * Returns NULL on failure.
+ *
+ * Returns:
+ *   jep_huff_stream - a new Huffman stream
+ */
+JEP_UTILS_API jep_huff_stream* JEP_UTILS_CALL
+jep_huff_decode_init();
+
+/**
+ * Adds encoded bytes to a Huffman stream.
+ * Every byte that can be decoded is appended to the output buffer,
+ * including the first part of a block whose last bytes have not
+ * arrived. Blocks may be split across any number of calls.
+ * If decoding fails, the stream should be destroyed.
+ *
+ * Params:
+ *   jep_huff_stream - a Huffman stream created for decoding
+ *   jep_byte - an array of encoded bytes
+ *   size_t - the number of encoded bytes
+ *   jep_byte_buffer - a byte buffer to receive the decoded bytes
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+JEP_UTILS_API int JEP_UTILS_CALL
+jep_huff_decode_update(jep_huff_stream* stream, const jep_byte* src, size_t n,
+	jep_byte_buffer* out);
+
+/**
+ * Ends the decoding of a Huffman stream.
+ * Fails if the encoded data ended in the middle of a block.
+ * The stream may then be used to decode new data.
+ *
+ * Params:
+ *   jep_huff_stream - a Huffman stream created for decoding
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+JEP_UTILS_API int JEP_UTILS_CALL
+jep_huff_decode_finish(jep_huff_stream* stream);
+
+/**
+ * Frees the resources allocated for a Huffman stream.
+ *
+ * Params:
+ *   jep_huff_stream - a Huffman stream
+ */
+JEP_UTILS_API void JEP_UTILS_CALL
+jep_destroy_huff_stream(jep_huff_stream* stream);
+
+/**
+ * Compresses a file into another file.
+ * The output is the same series of blocks that a Huffman stream with
+ * blocks of JEP_HUFF_DEFAULT_BLOCK_SIZE bytes writes, so it can also be
+ * decoded with jep_huff_decode_init. The input is mapped into memory
+ * rather than read, and the blocks are written in large batches.
+ * Fails if either file cannot be opened, or if both paths name the same
+ * file. On failure, the output file is removed.
+ *
+ * Params:
+ *   char - the path of the file to compress
+ *   char - the path of the file to receive the blocks
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+JEP_UTILS_API int JEP_UTILS_CALL
+jep_huff_compress_file(const char* src_path, const char* dest_path);
+
+/**
+ * Decompresses a file holding a series of blocks, such as the output of
+ * jep_huff_compress_file or of a Huffman stream, into another file.
+ * The input is mapped into memory, and every block is decoded straight
+ * from it. Decoded bytes are written in large batches, and run, stored,
+ * and coded blocks that hold more than a batch are decoded a piece at
+ * a time, so a block that claims a huge size is not decoded into memory.
+ * Fails if either file cannot be opened, if both paths name the same
+ * file, if a block is damaged, or if the last block is incomplete.
+ * On failure, the output file is removed.
+ *
+ * Params:
+ *   char - the path of the file to decompress
+ *   char - the path of the file to receive the decoded bytes
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+JEP_UTILS_API int JEP_UTILS_CALL
+jep_huff_decompress_file(const char* src_path, const char* dest_path);
+
+/**
+ * Trains a Huffman table from samples of the messages it will encode.
+ * The codes are based on the combined frequency of each byte in the
+ * samples. Bytes that do not appear in any sample still receive a code,
+ * and no code is longer than JEP_HUFF_DEFAULT_CODE_LENGTH.
+ * Returns NULL on failure.
+ *
+ * Params:
+ *   jep_byte_buffer - an array of sample messages
+ *   size_t - the number of samples
+ *
+ * Returns:
+ *   jep_huff_table - a new Huffman table
+ */
+JEP_UTILS_API jep_huff_table* JEP_UTILS_CALL
+jep_huff_train(jep_byte_buffer** samples, size_t count);
+
+/**
+ * Writes the dictionary of a Huffman table to a byte buffer so that
+ * it can be stored or sent separately from the messages.
+ *
+ * Params:
+ *   jep_huff_table - a Huffman table
+ *   jep_byte_buffer - a byte buffer to receive the table
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+JEP_UTILS_API int JEP_UTILS_CALL
+jep_huff_write_table(jep_huff_table* table, jep_byte_buffer* out);
+
+/**
+ * Reads a Huffman table that was written by jep_huff_write_table.
+ * Returns NULL on failure, or if the buffer contains anything other
+ * than a single table.
+ *
+ * Params:
+ *   jep_byte_buffer - a byte buffer containing a table
+ *
+ * Returns:
+ *   jep_huff_table - a new Huffman table
+ */
+JEP_UTILS_API jep_huff_table* JEP_UTILS_CALL
+jep_huff_read_table(jep_byte_buffer* encoded);
+
+/**
+ * Encodes a message with a Huffman table and appends it to a byte
+ * buffer. The message consists of the number of raw bytes followed by
+ * the encoded bits, and can only be decoded with the same table.
+ * Once the output has grown to fit the largest message, encoding
+ * does not allocate any memory.
+ *
+ * Params:
+ *   jep_huff_table - a Huffman table
+ *   jep_byte - an array of raw bytes
+ *   size_t - the number of raw bytes
+ *   jep_byte_buffer - a byte buffer to receive the message
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+JEP_UTILS_API int JEP_UTILS_CALL
+jep_huff_encode_shared(jep_huff_table* table, const jep_byte* src, size_t n,
+	jep_byte_buffer* out);
+
+/**
+ * Decodes a message that was encoded with a Huffman table and appends
+ * the raw bytes to a byte buffer.
+ * The array must hold exactly one message. If decoding fails,
+ * the size of the output is unchanged.
+ *
+ * Params:
+ *   jep_huff_table - the Huffman table used to encode the message
+ *   jep_byte - an array holding the encoded message
+ *   size_t - the number of encoded bytes
+ *   jep_byte_buffer - a byte buffer to receive the raw bytes
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+JEP_UTILS_API int JEP_UTILS_CALL
+jep_huff_decode_shared(jep_huff_table* table, const jep_byte* src, size_t n,
+	jep_byte_buffer* out);
+
+/**
+ * Frees the resources allocated for a Huffman table.
+ *
+ * Params:
+ *   jep_huff_table - a Huffman table
+ */
+JEP_UTILS_API void JEP_UTILS_CALL
+jep_destroy_huff_table(jep_huff_table* table);
+
+/**
+ * Creates an empty Huffman arena.
+ * No scratch space is allocated until it is needed.
+ *
+ * Returns:
+ *   jep_huff_arena - a new Huffman arena or NULL on failure
+ */
+JEP_UTILS_API jep_huff_arena* JEP_UTILS_CALL
+jep_create_huff_arena();
+
+/**
+ * Encodes a series of bytes like jep_huff_encode into the output of
+ * an arena.
+ * The encoded bytes belong to the arena. They are replaced by the next
+ * call with the same arena, and must not be destroyed by the caller.
+ * Returns NULL on failure.
+ *
+ * Params:
+ *   jep_huff_arena - a Huffman arena
+ *   jep_byte_buffer - a collection of raw, unencoded bytes
+ *
+ * Returns:
+ *   jep_byte_buffer - the output of the arena
+ */
+JEP_UTILS_API jep_byte_buffer* JEP_UTILS_CALL
+jep_huff_arena_encode(jep_huff_arena* arena, jep_byte_buffer* raw);
+
+/**
+ * Encodes a series of bytes like jep_huff_encode_context into the
+ * output of an arena.
+ * The context model is kept by the arena, so it is only allocated by
+ * the first call.
+ * Returns NULL on failure.
+ *
+ * Params:
+ *   jep_huff_arena - a Huffman arena
+ *   jep_byte_buffer - a collection of raw, unencoded bytes
+ *
+ * Returns:
+ *   jep_byte_buffer - the output of the arena
+ */
+JEP_UTILS_API jep_byte_buffer* JEP_UTILS_CALL
+jep_huff_arena_encode_context(jep_huff_arena* arena, jep_byte_buffer* raw);
+
+/**
+ * Decodes a series of bytes like jep_huff_decode into the output of
+ * an arena.
+ * Indexed containers are decoded one block at a time.
+ * Returns NULL on failure.
+ *
+ * Params:
+ *   jep_huff_arena - a Huffman arena
+ *   jep_byte_buffer - a collection of encoded bytes
+ *
+ * Returns:
+ *   jep_byte_buffer - the output of the arena
+ */
+JEP_UTILS_API jep_byte_buffer* JEP_UTILS_CALL
+jep_huff_arena_decode(jep_huff_arena* arena, jep_byte_buffer* encoded);
+
+/**
+ * Empties the output of an arena without freeing any memory.
+ * Only the size of the output is reset, so the next message is written
+ * into the memory that the output already has. Emptying the output
+ * with jep_clear_byte_buffer instead would free that memory.
+ *
+ * Params:
+ *   jep_huff_arena - a Huffman arena
+ */
+JEP_UTILS_API void JEP_UTILS_CALL
+jep_huff_reset_arena(jep_huff_arena* arena);
+
+/**
+ * Frees the resources allocated for a Huffman arena, including
+ * its output.
+ *
+ * Params:
+ *   jep_huff_arena - a Huffman arena
+ */
+JEP_UTILS_API void JEP_UTILS_CALL
+jep_destroy_huff_arena(jep_huff_arena* arena);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif
@@ -0,0 +1,418 @@
+#ifndef JEP_HUFFMAN_HPP
+#define JEP_HUFFMAN_HPP
+
+#include "huffman.h"
+
+
+
+
+namespace jep
+{
+
+/* the length of the longest code in a static Huffman table */
+constexpr uint32_t huff_static_bits = JEP_HUFF_DEFAULT_CODE_LENGTH;
+
+/* the number of entries in the decoding table of a static table */
+constexpr uint32_t huff_static_size = 1U << huff_static_bits;
+
+/**
+ * A static Huffman table is built by the compiler from a fixed
+ * frequency table, so that messages whose distribution is known in
+ * advance are encoded and decoded without building any codes at run
+ * time. It is normally declared constexpr:
+ *
+ *   constexpr uint32_t counts[256] = { ... };
+ *   constexpr jep::huff_static_table table = jep::make_huff_table(counts);
+ *   static_assert(table.valid, "no byte has a count");
+ *
+ * Bytes with a count of 0 have no code and cannot be encoded.
+ * No code is longer than huff_static_bits, so every code is resolved
+ * with a single lookup in the decoding table.
+ *
+ * The blocks that it encodes are ordinary coded blocks, so they can be
+ * decoded by jep_huff_decode and every other decoder of the library.
+ */
+struct huff_static_table
+{
+    jep_byte lengths[UCHAR_MAX + 1] = {};          /* the length of each code       */
+    uint32_t codes[UCHAR_MAX + 1] = {};            /* each code, first bit in LSB   */
+    uint16_t entries[huff_static_size] = {};       /* the length and byte per index */
+    jep_byte header[6 + (UCHAR_MAX + 2) / 2] = {}; /* the header of every block     */
+    size_t header_size = 0;                        /* the size of the header        */
+    bool valid = false;                            /* whether any byte has a code   */
+};
+
+namespace detail
+{
+
+/**
+ * Reverses the order of the bits of a code so that its first bit
+ * is in the least significant position.
+ */
+constexpr uint32_t huff_reverse(uint32_t code, uint32_t len)
+{
+	uint32_t bits = 0; // The reversed bits
+
+	for (uint32_t i = 0; i < len; i++)
+		bits |= ((code >> (len - 1 - i)) & 1) << i;
+
+	return bits;
+}
+
+/**
+ * Gives each byte with a count a code length of at most
+ * huff_static_bits. The lengths are those of a Huffman tree, with any
+ * that are too long shortened and the rest lengthened to make room.
+ * Returns the number of bytes with a code.
+ */
+constexpr uint32_t huff_lengths(const uint32_t (&counts)[UCHAR_MAX + 1],
+	jep_byte (&lengths)[UCHAR_MAX + 1])
+{
+	uint32_t order[UCHAR_MAX + 1] = {};        // The bytes by increasing count
+	uint64_t weight[2 * (UCHAR_MAX + 1)] = {}; // The weight of each node
+	uint32_t parent[2 * (UCHAR_MAX + 1)] = {}; // The parent of each node
+	uint32_t depth[2 * (UCHAR_MAX + 1)] = {};  // The depth of each node
+	uint32_t m = 0;                            // The number of leaves
+
+	// List the bytes with a count from the least common up.
+	for (uint32_t c = 0; c <= UCHAR_MAX; c++)
+	{
+		if (counts[c] == 0)
+			continue;
+
+		uint32_t k = m++;
+		while (k > 0 && counts[order[k - 1]] > counts[c])
+		{
+			order[k] = order[k - 1];
+			k--;
+		}
+
+		order[k] = c;
+	}
+
+	if (m == 0)
+		return 0;
+
+	if (m == 1)
+	{
+		lengths[order[0]] = 1;
+		return 1;
+	}
+
+	// Leaves and new nodes are both taken in order of weight,
+	// so the lightest two are always at the front of one or the other.
+	for (uint32_t i = 0; i < m; i++)
+		weight[i] = counts[order[i]];
+
+	uint32_t leaf = 0;
+	uint32_t node = m;
+	for (uint32_t k = m; k < 2 * m - 1; k++)
+	{
+		uint32_t pair[2] = {};
+
+		for (uint32_t p = 0; p < 2; p++)
+		{
+			if (leaf < m && (node >= k || weight[leaf] <= weight[node]))
+				pair[p] = leaf++;
+			else
+				pair[p] = node++;
+		}
+
+		weight[k] = weight[pair[0]] + weight[pair[1]];
+		parent[pair[0]] = k;
+		parent[pair[1]] = k;
+	}
+
+	for (uint32_t k = 2 * m - 2; k-- > 0;)
+		depth[k] = depth[parent[k]] + 1;
+
+	// Shorten the longest codes, then lengthen the least common
+	// of the others until the codes fit (Kraft's inequality).
+	uint32_t room = huff_static_size;
+	uint32_t used = 0;
+	for (uint32_t i = 0; i < m; i++)
+	{
+		if (depth[i] > huff_static_bits)
+			depth[i] = huff_static_bits;
+
+		used += 1U << (huff_static_bits - depth[i]);
+	}
+
+	while (used > room)
+	{
+		uint32_t best = m;
+		for (uint32_t i = 0; i < m; i++)
+		{
+			if (depth[i] < huff_static_bits
+				&& (best == m || depth[i] > depth[best]))
+			{
+				best = i;
+			}
+		}
+
+		depth[best]++;
+		used -= 1U << (huff_static_bits - depth[best]);
+	}
+
+	// Give any room that is left to the most common bytes.
+	for (uint32_t i = m; i-- > 0;)
+	{
+		while (depth[i] > 1
+			&& used + (1U << (huff_static_bits - depth[i])) <= room)
+		{
+			used += 1U << (huff_static_bits - depth[i]);
+			depth[i]--;
+		}
+	}
+
+	for (uint32_t i = 0; i < m; i++)
+		lengths[order[i]] = (jep_byte)depth[i];
+
+	return m;
+}
+
+} // namespace detail
+
+/**
+ * Builds a static Huffman table from the number of times each byte
+ * value is expected to occur. Only the ratios of the counts matter.
+ * The table is not valid if every count is 0.
+ *
+ * Params:
+ *   uint32_t - an array of JEP_HISTOGRAM_SIZE counts
+ *
+ * Returns:
+ *   huff_static_table - the static table
+ */
+constexpr huff_static_table make_huff_table(
+	const uint32_t (&counts)[UCHAR_MAX + 1])
+{
+	huff_static_table t;                         // The table
+	uint32_t per_len[huff_static_bits + 1] = {}; // The codes of each length
+	uint32_t next[huff_static_bits + 1] = {};    // The next code of each length
+	uint32_t first = UCHAR_MAX;                  // The lowest byte with a code
+	uint32_t last = 0;                           // The highest byte with a code
+
+	if (detail::huff_lengths(counts, t.lengths) == 0)
+		return t;
+
+	// Canonical codes are assigned in order of length,
+	// and then in order of byte value, as in the C library.
+	for (uint32_t c = 0; c <= UCHAR_MAX; c++)
+		per_len[t.lengths[c]]++;
+
+	per_len[0] = 0;
+	uint32_t code = 0;
+	for (uint32_t len = 1; len <= huff_static_bits; len++)
+	{
+		code = (code + per_len[len - 1]) << 1;
+		next[len] = code;
+	}
+
+	for (uint32_t c = 0; c <= UCHAR_MAX; c++)
+	{
+		uint32_t len = t.lengths[c];
+
+		if (len == 0)
+			continue;
+
+		t.codes[c] = detail::huff_reverse(next[len]++, len);
+
+		for (uint32_t j = t.codes[c]; j < huff_static_size; j += 1U << len)
+			t.entries[j] = (uint16_t)((len << 8) | c);
+
+		if (c < first)
+			first = c;
+
+		last = c;
+	}
+
+	// The header of every block is the same, with four bits
+	// per length and the first length in the low bits.
+	t.header[0] = 0x4A;
+	t.header[1] = 0x03;
+	t.header[2] = 0x00;
+	t.header[3] = 4;
+	t.header[4] = (jep_byte)first;
+	t.header[5] = (jep_byte)last;
+	t.header_size = 6;
+
+	for (uint32_t c = first; c <= last; c++)
+	{
+		if ((c - first) & 1)
+			t.header[t.header_size - 1] |= (jep_byte)(t.lengths[c] << 4);
+		else
+			t.header[t.header_size++] = t.lengths[c];
+	}
+
+	t.valid = true;
+
+	return t;
+}
+
+/**
+ * Encodes an array of bytes as a coded block using a static table.
+ * No memory is allocated, and no codes are built.
+ * A coded block cannot be empty, so empty input is written as the same
+ * empty stored block that jep_huff_encode_to writes.
+ * Fails if the table is not valid, if a byte has no code, or if the
+ * block does not fit within the capacity.
+ *
+ * Params:
+ *   huff_static_table - a static table
+ *   jep_byte - an array of raw bytes
+ *   size_t - the number of raw bytes
+ *   jep_byte - an array to receive the block
+ *   size_t - the capacity of the array
+ *   size_t - a pointer to receive the size of the block
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+inline int huff_encode_static(const huff_static_table& t, const jep_byte* src,
+	size_t n, jep_byte* dest, size_t cap, size_t* size)
+{
+	uint64_t total; // The number of bits of data
+	uint64_t bits;  // Bits waiting to be written
+	uint32_t count; // The number of waiting bits
+	size_t pos;     // Position in the output
+
+	if (!t.valid || (src == NULL && n > 0) || dest == NULL || size == NULL
+		|| n > UINT32_MAX)
+	{
+		return 0;
+	}
+
+	total = 0;
+	for (size_t i = 0; i < n; i++)
+	{
+		if (t.lengths[src[i]] == 0)
+			return 0;
+
+		total += t.lengths[src[i]];
+	}
+
+	if (n == 0)
+		return jep_huff_encode_to(src, n, dest, cap, size);
+
+	if (total > UINT32_MAX
+		|| cap < t.header_size + 8 + (total + CHAR_BIT - 1) / CHAR_BIT)
+	{
+		return 0;
+	}
+
+	for (pos = 0; pos < t.header_size; pos++)
+		dest[pos] = t.header[pos];
+
+	jep_split_u32((uint32_t)n, (dest + pos));
+	jep_split_u32((uint32_t)total, (dest + pos + 4));
+	pos += 8;
+
+	// Codes are packed from the least significant bit up,
+	// and written a byte at a time once they are complete.
+	bits = 0;
+	count = 0;
+	for (size_t i = 0; i < n; i++)
+	{
+		bits |= (uint64_t)t.codes[src[i]] << count;
+		count += t.lengths[src[i]];
+
+		while (count >= CHAR_BIT)
+		{
+			dest[pos++] = (jep_byte)bits;
+			bits >>= CHAR_BIT;
+			count -= CHAR_BIT;
+		}
+	}
+
+	if (count > 0)
+		dest[pos++] = (jep_byte)bits;
+
+	*size = pos;
+
+	return 1;
+}
+
+/**
+ * Decodes a block into memory provided by the caller.
+ * A block that was encoded with the same static table is decoded with
+ * its decoding table. Any other block is decoded by jep_huff_decode_to.
+ * No memory is allocated.
+ * Fails if the block is damaged or the decoded bytes do not fit
+ * within the capacity.
+ *
+ * Params:
+ *   huff_static_table - a static table
+ *   jep_byte - an array holding a block
+ *   size_t - the number of bytes in the array
+ *   jep_byte - an array to receive the decoded bytes
+ *   size_t - the capacity of the array
+ *   size_t - a pointer to receive the number of decoded bytes
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+inline int huff_decode_static(const huff_static_table& t, const jep_byte* src,
+	size_t n, jep_byte* dest, size_t cap, size_t* size)
+{
+	uint32_t count;     // The number of decoded bytes
+	uint32_t total;     // The number of bits of data
+	uint64_t bits;      // Bits read but not yet decoded
+	uint32_t have;      // The number of bits read
+	uint64_t remaining; // The number of bits left to decode
+	size_t pos;         // Position in the block
+	size_t end;         // The end of the data
+
+	if (src == NULL || dest == NULL || size == NULL)
+		return 0;
+
+	bool same = t.valid && n >= t.header_size + 8;
+	for (pos = 0; same && pos < t.header_size; pos++)
+		same = src[pos] == t.header[pos];
+
+	if (!same)
+		return jep_huff_decode_to(src, n, dest, cap, size);
+
+	jep_build_u32(count, (src + pos));
+	jep_build_u32(total, (src + pos + 4));
+	pos += 8;
+
+	end = pos + (total / CHAR_BIT) + (total % CHAR_BIT ? 1 : 0);
+
+	if (count > cap || count > total || end > n)
+		return 0;
+
+	bits = 0;
+	have = 0;
+	remaining = total;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		while (have <= 56 && pos < end)
+		{
+			bits |= (uint64_t)src[pos++] << have;
+			have += CHAR_BIT;
+		}
+
+		uint16_t e = t.entries[bits & (huff_static_size - 1)];
+		uint32_t len = e >> 8;
+
+		if (len == 0 || len > remaining)
+			return 0;
+
+		dest[i] = (jep_byte)(e & 0xFF);
+		bits >>= len;
+		have = have > len ? have - len : 0;
+		remaining -= len;
+	}
+
+	if (remaining != 0)
+		return 0;
+
+	*size = count;
+
+	return 1;
+}
+
+} // namespace jep
+
+#endif
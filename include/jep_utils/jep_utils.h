@@ -166,7 +166,48 @@ typedef uint8_t jep_byte;
  *   b - an array of four unsigned 8-bit integers
  */
 #define jep_build_u32(n, b) \
-    n = (b[3] << 24) | (b[2] << 16) | (b[1] << 8) | b[0];
+    n = ((uint32_t)b[3] << 24) | ((uint32_t)b[2] << 16) | ((uint32_t)b[1] << 8) | b[0];
+
+/**
+ * Reads an unsigned 32-bit integer from four bytes, least significant
+ * byte first. Most compilers reduce this to a single load on little
+ * endian machines.
+ *
+ * Params:
+ *   p - a pointer to four unsigned 8-bit integers
+ *
+ * Returns:
+ *   uint32_t - the integer value of the bytes
+ */
+static inline uint32_t jep_load_le32(const jep_byte* p)
+{
+	return (uint32_t)p[0]
+		| ((uint32_t)p[1] << 8)
+		| ((uint32_t)p[2] << 16)
+		| ((uint32_t)p[3] << 24);
+}
+
+/**
+ * Reads an unsigned 64-bit integer from eight bytes, least significant
+ * byte first.
+ *
+ * Params:
+ *   p - a pointer to eight unsigned 8-bit integers
+ *
+ * Returns:
+ *   uint64_t - the integer value of the bytes
+ */
+static inline uint64_t jep_load_le64(const jep_byte* p)
+{
+	return (uint64_t)p[0]
+		| ((uint64_t)p[1] << 8)
+		| ((uint64_t)p[2] << 16)
+		| ((uint64_t)p[3] << 24)
+		| ((uint64_t)p[4] << 32)
+		| ((uint64_t)p[5] << 40)
+		| ((uint64_t)p[6] << 48)
+		| ((uint64_t)p[7] << 56);
+}
 
 #else
 #error CHAR_BIT is not 8
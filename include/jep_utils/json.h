@@ -4,6 +4,10 @@
 #include "jep_utils.h"
 #include "string.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 
 
 
@@ -133,4 +137,8 @@ jep_destroy_json_object(jep_json_object* obj);
 JEP_UTILS_API jep_json_field* JEP_UTILS_CALL
 jep_get_json_field(jep_json_object* obj, jep_string* name);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif
@@ -0,0 +1,72 @@
+#ifndef JEP_LZ_H
+#define JEP_LZ_H
+
+#include "jep_utils.h"
+#include "byte_buffer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+
+
+/* the fastest compression level */
+#define JEP_LZ_MIN_LEVEL 1
+
+/* the compression level that finds the longest matches */
+#define JEP_LZ_MAX_LEVEL 9
+
+/* a compression level that balances speed and size */
+#define JEP_LZ_DEFAULT_LEVEL 6
+
+/* the greatest distance between a match and its earlier copy */
+#define JEP_LZ_WINDOW_SIZE 65535
+
+
+
+
+/**
+ * Compresses a series of bytes by replacing repeated strings with
+ * references to their earlier copies (LZ77) and then encoding what
+ * remains with Huffman Coding.
+ * Higher levels search further for longer matches, trading speed for
+ * size. Every level can be decompressed by jep_lz_decompress.
+ * Returns NULL on failure, or if the level is not between
+ * JEP_LZ_MIN_LEVEL and JEP_LZ_MAX_LEVEL.
+ *
+ * An LZ frame begins with the bytes 0x4A 0x4C and the number of raw
+ * bytes as a 32-bit little endian integer. It is followed by five
+ * sections: the literal bytes, a token for each match, the extra bytes
+ * of long lengths, and the low and high bytes of each match distance.
+ * Each section holds its decoded size and the size of its Huffman
+ * block as 32-bit little endian integers, followed by the block.
+ *
+ * Params:
+ *   jep_byte_buffer - a collection of raw, uncompressed bytes
+ *   uint32_t - the compression level
+ *
+ * Returns:
+ *   jep_byte_buffer - a collection of compressed bytes
+ */
+JEP_UTILS_API jep_byte_buffer* JEP_UTILS_CALL
+jep_lz_compress(jep_byte_buffer* raw, uint32_t level);
+
+/**
+ * Decompresses an LZ frame.
+ * Returns NULL on failure, or if the frame is damaged.
+ *
+ * Params:
+ *   jep_byte_buffer - a collection of bytes holding an LZ frame
+ *
+ * Returns:
+ *   jep_byte_buffer - the decompressed bytes
+ */
+JEP_UTILS_API jep_byte_buffer* JEP_UTILS_CALL
+jep_lz_decompress(jep_byte_buffer* encoded);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
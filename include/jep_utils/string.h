@@ -4,6 +4,10 @@
 #include "jep_utils.h"
 #include "character.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 
 
 
@@ -194,4 +198,8 @@ jep_string_to_uint(jep_string* str, int radix);
 JEP_UTILS_API double JEP_UTILS_CALL
 jep_string_to_double(jep_string* str);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif
@@ -3,6 +3,10 @@
 
 #include "jep_utils.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 
 
 
@@ -155,4 +159,8 @@ jep_utf16be_decode(const jep_byte* bytes, size_t n, size_t* res);
 JEP_UTILS_API jep_code_point* JEP_UTILS_CALL
 jep_utf16le_decode(const jep_byte* bytes, size_t n, size_t* res);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif
@@ -0,0 +1,1047 @@
+#include "jep_utils/jep_utils.h"
+#include "jep_utils/ans.h"
+#include "jep_utils/histogram.h"
+
+
+
+
+/**
+ * The number of interleaved states. Bytes take turns between the
+ * states, and each state writes its bits to its own bitstream, so the
+ * decoder can work on every state at once rather than one after another.
+ * The states are encoded in pairs, so there is an even number of them.
+ */
+#define ANS_STATES 4
+
+/**
+ * The size of the fixed part of a frame: the number of raw bytes,
+ * the range of byte values, and the final state and the number of bits
+ * of each bitstream.
+ */
+#define ANS_FRAME_HEADER (6 + 6 * ANS_STATES)
+
+/**
+ * The largest number of bytes used to write the frequency of a byte.
+ * Seven bits of the frequency are written in each byte.
+ */
+#define ANS_FREQ_MAX 2
+
+/**
+ * The distance between the states that are given to the same byte.
+ * It is odd, so stepping through the table visits every state once,
+ * and large enough to scatter each byte across the whole table.
+ */
+#define ANS_SPREAD_STEP ((JEP_ANS_TABLE_SIZE >> 1) + (JEP_ANS_TABLE_SIZE >> 3) + 3)
+
+
+
+
+/**
+ * Decodes one byte from a state and reads the bits of its next state
+ * from the end of its bitstream. Four bytes must be readable at the
+ * bits, and there must be at least as many bits left as the state has.
+ *
+ * Params:
+ *   x - the state, which is advanced
+ *   p - the bits left in the bitstream, which is reduced
+ *   b - the bitstream
+ *   d - the byte to receive the decoded byte
+ */
+#define ans_step(x, p, b, d) \
+	do { \
+		const ans_entry* s_ = &(table[x]); \
+		d = s_->sym; \
+		p -= s_->bits; \
+		x = s_->base + ((jep_load_le32((b) + (p) / CHAR_BIT) \
+			>> ((p) % CHAR_BIT)) \
+			& ((1U << s_->bits) - 1)); \
+	} while (0)
+
+
+
+
+/**
+ * The encoding parameters of a single byte value.
+ * A state is reduced into the range of the byte by writing its low bits,
+ * and the reduced state then selects the next state of the encoder.
+ */
+typedef struct ans_symbol {
+	uint32_t bits;   // The most bits written for the byte
+	uint32_t limit;  // States below this write one bit fewer
+	int32_t offset;  // The position of the byte's next states, less its frequency
+}ans_symbol;
+
+/**
+ * An entry of the decoding table holds the byte decoded from a state
+ * and how to find the next state from the bits that follow.
+ */
+typedef struct ans_entry {
+	uint16_t base;  // The next state before the bits are added
+	jep_byte sym;   // The decoded byte
+	jep_byte bits;  // The number of bits to read
+}ans_entry;
+
+/**
+ * A bit writer packs the bits of two bitstreams into the free space of
+ * an array, starting from the least significant bit of each byte.
+ * The first bitstream grows from the front of the space and the second
+ * from the back, a byte at a time in reverse, so neither needs to know
+ * how long the other will be. Writing stops when the two meet.
+ */
+typedef struct ans_writer {
+	jep_byte* front;     // The next byte of the first bitstream
+	jep_byte* back;      // One past the next byte of the second
+	uint64_t bits[2];    // Pending bits with the first bit in the LSB
+	uint32_t count[2];   // The number of pending bits
+	int full;            // 1 if the bits did not fit
+}ans_writer;
+
+
+
+
+/**
+ * Scales the frequency of each byte so that the frequencies add up to
+ * JEP_ANS_TABLE_SIZE. Every byte that occurs keeps a frequency of at
+ * least 1. The difference left by rounding is made up by the most
+ * frequent bytes, where it costs the least.
+ *
+ * Params:
+ *   uint32_t - an array of JEP_HISTOGRAM_SIZE counts
+ *   size_t - the total of the counts, which must be greater than 0
+ *   uint32_t - an array of JEP_HISTOGRAM_SIZE frequencies to be set
+ */
+static void normalize_counts(const uint32_t* counts, size_t n,
+	uint32_t* freqs);
+
+/**
+ * Spreads the states of the coder among the bytes, giving each byte
+ * as many states as its frequency.
+ *
+ * Params:
+ *   uint32_t - an array of JEP_HISTOGRAM_SIZE frequencies
+ *   jep_byte - an array of JEP_ANS_TABLE_SIZE bytes to be set
+ */
+static void spread_symbols(const uint32_t* freqs, jep_byte* spread);
+
+/**
+ * Builds the encoding parameters of each byte and the table of the
+ * next state of each byte.
+ *
+ * Params:
+ *   uint32_t - an array of JEP_HISTOGRAM_SIZE frequencies
+ *   ans_symbol - an array of JEP_HISTOGRAM_SIZE parameters to be set
+ *   uint16_t - an array of JEP_ANS_TABLE_SIZE states to be set
+ */
+static void build_encoder(const uint32_t* freqs, ans_symbol* syms,
+	uint16_t* states);
+
+/**
+ * Builds the decoding table from the frequency of each byte.
+ *
+ * Params:
+ *   uint32_t - an array of JEP_HISTOGRAM_SIZE frequencies
+ *   ans_entry - an array of JEP_ANS_TABLE_SIZE entries to be set
+ */
+static void build_decoder(const uint32_t* freqs, ans_entry* table);
+
+/**
+ * Writes the frequencies of a range of byte values.
+ *
+ * Params:
+ *   uint32_t - an array of JEP_HISTOGRAM_SIZE frequencies
+ *   uint32_t - the first byte value that occurs
+ *   uint32_t - the last byte value that occurs
+ *   jep_byte - an array to receive the frequencies
+ *
+ * Returns:
+ *   size_t - the number of bytes written
+ */
+static size_t write_freqs(const uint32_t* freqs, uint32_t first,
+	uint32_t last, jep_byte* dest);
+
+/**
+ * Reads the frequencies of a range of byte values.
+ * Returns 0 if the frequencies are incomplete or do not add up to
+ * JEP_ANS_TABLE_SIZE.
+ *
+ * Params:
+ *   jep_byte - an array of bytes beginning with the range
+ *   size_t - the number of bytes in the array
+ *   uint32_t - an array of JEP_HISTOGRAM_SIZE frequencies to be set
+ *
+ * Returns:
+ *   size_t - the number of bytes read or 0 on failure
+ */
+static size_t read_freqs(const jep_byte* src, size_t n, uint32_t* freqs);
+
+/**
+ * Reads the fixed part of a frame and the frequencies that follow it.
+ * Returns 0 if the frequencies do not add up to JEP_ANS_TABLE_SIZE,
+ * if a state is out of range, if the bitstreams run past the end of
+ * the frame, or if the frame cannot hold as many bytes as it claims.
+ * A frame of no bytes has nothing after its byte count.
+ *
+ * Params:
+ *   jep_byte - an array holding a frame
+ *   size_t - the number of bytes in the array
+ *   uint32_t - a pointer to receive the number of raw bytes
+ *   uint32_t - an array of JEP_HISTOGRAM_SIZE frequencies to be set
+ *   uint32_t - an array of ANS_STATES states to be set
+ *   uint32_t - an array of ANS_STATES bit counts to be set
+ *   size_t - a pointer to receive the size of the header
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+static int read_header(const jep_byte* src, size_t n, uint32_t* count,
+	uint32_t* freqs, uint32_t* x, uint32_t* totals, size_t* head);
+
+/**
+ * Adds bits to one of the bitstreams of a bit writer.
+ * Fewer than 32 bits may be added at once.
+ *
+ * Params:
+ *   ans_writer - a bit writer
+ *   uint32_t - 0 for the first bitstream or 1 for the second
+ *   uint64_t - the bits to be written, with the first bit in the LSB
+ *   uint32_t - the number of bits
+ */
+static void put_bits(ans_writer* w, uint32_t s, uint64_t bits, uint32_t len);
+
+/**
+ * Writes any pending bits of both bitstreams of a bit writer,
+ * padding the last byte of each with zeros.
+ *
+ * Params:
+ *   ans_writer - a bit writer
+ */
+static void flush_writer(ans_writer* w);
+
+/**
+ * Encodes the bytes of a pair of states, each into its own bitstream,
+ * and writes the two bitstreams one after the other.
+ *
+ * Params:
+ *   jep_byte - an array of raw bytes
+ *   size_t - the number of raw bytes
+ *   ans_symbol - the parameters of each byte
+ *   uint16_t - the next states of each byte
+ *   uint32_t - the first state of the pair
+ *   jep_byte - the first byte of free space
+ *   jep_byte - one past the last byte of free space
+ *   uint32_t - an array of ANS_STATES final states to be set
+ *   uint64_t - an array of ANS_STATES bit counts to be set
+ *
+ * Returns:
+ *   size_t - the number of bytes written, or 0 if they did not fit
+ */
+static size_t encode_pair(const jep_byte* src, size_t n,
+	const ans_symbol* syms, const uint16_t* states, uint32_t first,
+	jep_byte* dest, jep_byte* end, uint32_t* x, uint64_t* total);
+
+/**
+ * Reads a number of bits that end at a bit position.
+ * The bits were written last to first, so the decoder reads them
+ * backwards from the end.
+ *
+ * Params:
+ *   jep_byte - the bytes holding the bits
+ *   size_t - the number of bytes
+ *   uint64_t - the position of the first bit to be read
+ *   uint32_t - the number of bits to read
+ *
+ * Returns:
+ *   uint32_t - the bits
+ */
+static uint32_t read_bits(const jep_byte* src, size_t n, uint64_t pos,
+	uint32_t len);
+
+/**
+ * Finds the position of the highest bit that is set in an integer.
+ *
+ * Params:
+ *   uint32_t - an integer greater than 0
+ *
+ * Returns:
+ *   uint32_t - the position of the highest set bit
+ */
+static uint32_t highest_bit(uint32_t x);
+
+
+
+
+JEP_UTILS_API size_t JEP_UTILS_CALL
+jep_ans_bound(size_t n)
+{
+	// No byte costs more bits than the state has, and each bitstream
+	// may end with a partial byte.
+	if (n > UINT32_MAX)
+		return 0;
+
+	return ANS_FRAME_HEADER + (UCHAR_MAX + 1) * ANS_FREQ_MAX
+		+ (size_t)(((uint64_t)n * JEP_ANS_TABLE_BITS + 7) / 8) + ANS_STATES;
+}
+
+JEP_UTILS_API int JEP_UTILS_CALL
+jep_ans_encode_to(const jep_byte* src, size_t n, jep_byte* dest, size_t cap,
+	size_t* size)
+{
+	uint32_t counts[JEP_HISTOGRAM_SIZE];   // The frequency of each byte
+	uint32_t freqs[JEP_HISTOGRAM_SIZE];    // The scaled frequencies
+	ans_symbol syms[JEP_HISTOGRAM_SIZE];   // The parameters of each byte
+	uint16_t states[JEP_ANS_TABLE_SIZE];   // The next states of each byte
+	uint64_t total[ANS_STATES];            // The bits of each state
+	uint32_t x[ANS_STATES];                // The final states
+	uint32_t first;                        // The first byte that occurs
+	uint32_t last;                         // The last byte that occurs
+	size_t head;                           // The size of the header
+	size_t pos;                            // Position in the output
+	size_t used;                           // The bytes of a pair
+	size_t i;                              // Index
+
+	if (dest == NULL || size == NULL || cap < 4
+		|| !jep_byte_histogram(src, n, counts))
+	{
+		return 0;
+	}
+
+	jep_split_u32((uint32_t)n, dest);
+
+	if (n == 0)
+	{
+		*size = 4;
+		return 1;
+	}
+
+	first = UCHAR_MAX;
+	last = 0;
+	for (i = 0; i <= UCHAR_MAX; i++)
+	{
+		if (counts[i] == 0)
+			continue;
+
+		if (i < first)
+			first = (uint32_t)i;
+
+		last = (uint32_t)i;
+	}
+
+	normalize_counts(counts, n, freqs);
+	build_encoder(freqs, syms, states);
+
+	// The frequencies are written after the byte count, but the final
+	// states and the bit counts are only known once the bytes are encoded.
+	if (cap - 4 < 2 + (last - first + 1) * ANS_FREQ_MAX + 6 * ANS_STATES)
+		return 0;
+
+	head = 4 + write_freqs(freqs, first, last, dest + 4);
+	pos = head + 6 * ANS_STATES;
+
+	for (i = 0; i < ANS_STATES; i += 2)
+	{
+		used = encode_pair(src, n, syms, states, (uint32_t)i, dest + pos,
+			dest + cap, x, total);
+
+		if (used == 0 && (total[i] > 0 || total[i + 1] > 0))
+			return 0;
+
+		if (total[i] > UINT32_MAX || total[i + 1] > UINT32_MAX)
+			return 0;
+
+		pos += used;
+	}
+
+	// The decoder begins where the encoder finished.
+	for (i = 0; i < ANS_STATES; i++)
+	{
+		dest[head + i * 2] = (jep_byte)(x[i] - JEP_ANS_TABLE_SIZE);
+		dest[head + i * 2 + 1] = (jep_byte)((x[i] - JEP_ANS_TABLE_SIZE) >> 8);
+		jep_split_u32((uint32_t)total[i],
+			(dest + head + 2 * ANS_STATES + 4 * i));
+	}
+
+	*size = pos;
+
+	return 1;
+}
+
+JEP_UTILS_API int JEP_UTILS_CALL
+jep_ans_decode_to(const jep_byte* src, size_t n, jep_byte* dest, size_t cap,
+	size_t* size)
+{
+	ans_entry table[JEP_ANS_TABLE_SIZE];   // The decoding table
+	uint32_t freqs[JEP_HISTOGRAM_SIZE];    // The scaled frequencies
+	const jep_byte* bits[ANS_STATES];      // The bitstream of each state
+	size_t bytes[ANS_STATES];              // The bytes of each bitstream
+	uint64_t pos[ANS_STATES];              // The bits left in each one
+	uint64_t safe[ANS_STATES];             // The last position with 4 bytes
+	uint32_t totals[ANS_STATES];           // The bits of each bitstream
+	uint32_t x[ANS_STATES];                // The states of the decoder
+	uint32_t x0, x1, x2, x3;               // The states, in registers
+	uint64_t p0, p1, p2, p3;               // The positions, in registers
+	const ans_entry* e;                    // The entry of the current state
+	uint32_t count;                        // The number of raw bytes
+	uint32_t k;                            // The state of a byte
+	size_t head;                           // The size of the header
+	size_t i;                              // Index
+
+	if (src == NULL || size == NULL
+		|| !read_header(src, n, &count, freqs, x, totals, &head))
+	{
+		return 0;
+	}
+
+	if (count > cap || (dest == NULL && count > 0))
+		return 0;
+
+	if (count == 0)
+	{
+		*size = 0;
+		return 1;
+	}
+
+	build_decoder(freqs, table);
+
+	// The bitstreams follow one another, and each is read from its end.
+	for (k = 0; k < ANS_STATES; k++)
+	{
+		bits[k] = src + head;
+		bytes[k] = totals[k] / CHAR_BIT + (totals[k] % CHAR_BIT ? 1 : 0);
+		pos[k] = totals[k];
+		safe[k] = bytes[k] >= 4 ? (uint64_t)(bytes[k] - 4) * CHAR_BIT : 0;
+		head += bytes[k];
+	}
+
+	i = 0;
+
+	// The last bits written are read first, and there may be fewer
+	// than four bytes after them. The loop below also needs the
+	// first state to be next.
+	while (i < count && ((i % ANS_STATES) != 0
+		|| pos[0] > safe[0] || pos[1] > safe[1]
+		|| pos[2] > safe[2] || pos[3] > safe[3]))
+	{
+		k = (uint32_t)(i % ANS_STATES);
+		e = &(table[x[k]]);
+		dest[i] = e->sym;
+
+		if (e->bits > pos[k])
+			return 0;
+
+		pos[k] -= e->bits;
+		x[k] = e->base + read_bits(bits[k], bytes[k], pos[k], e->bits);
+		i++;
+	}
+
+	// From here on every read has four bytes to load, and no read can
+	// run past the first bit of its bitstream, so neither needs to be
+	// checked. The states do not wait on one another, so the steps of
+	// all four overlap.
+	x0 = x[0]; x1 = x[1]; x2 = x[2]; x3 = x[3];
+	p0 = pos[0]; p1 = pos[1]; p2 = pos[2]; p3 = pos[3];
+
+	while (i + ANS_STATES <= count && p0 >= JEP_ANS_TABLE_BITS
+		&& p1 >= JEP_ANS_TABLE_BITS && p2 >= JEP_ANS_TABLE_BITS
+		&& p3 >= JEP_ANS_TABLE_BITS)
+	{
+		ans_step(x0, p0, bits[0], dest[i]);
+		ans_step(x1, p1, bits[1], dest[i + 1]);
+		ans_step(x2, p2, bits[2], dest[i + 2]);
+		ans_step(x3, p3, bits[3], dest[i + 3]);
+		i += ANS_STATES;
+	}
+
+	x[0] = x0; x[1] = x1; x[2] = x2; x[3] = x3;
+	pos[0] = p0; pos[1] = p1; pos[2] = p2; pos[3] = p3;
+
+	while (i < count)
+	{
+		k = (uint32_t)(i % ANS_STATES);
+		e = &(table[x[k]]);
+		dest[i] = e->sym;
+
+		// The bits cannot run out before the last byte.
+		if (e->bits > pos[k])
+			return 0;
+
+		pos[k] -= e->bits;
+		x[k] = e->base + read_bits(bits[k], bytes[k], pos[k], e->bits);
+		i++;
+	}
+
+	// The encoder began each state in the first state, and every bit
+	// belongs to a byte.
+	for (k = 0; k < ANS_STATES; k++)
+	{
+		if (x[k] != 0 || pos[k] != 0)
+			return 0;
+	}
+
+	*size = count;
+
+	return 1;
+}
+
+JEP_UTILS_API int JEP_UTILS_CALL
+jep_ans_measure(const jep_byte* src, size_t n, size_t* count)
+{
+	uint32_t freqs[JEP_HISTOGRAM_SIZE];    // The scaled frequencies
+	uint32_t x[ANS_STATES];                // The states of the decoder
+	uint32_t totals[ANS_STATES];           // The bits of each bitstream
+	uint32_t raw;                          // The number of raw bytes
+	size_t head;                           // The size of the header
+
+	if (src == NULL || count == NULL
+		|| !read_header(src, n, &raw, freqs, x, totals, &head))
+	{
+		return 0;
+	}
+
+	*count = raw;
+
+	return 1;
+}
+
+JEP_UTILS_API jep_byte_buffer* JEP_UTILS_CALL
+jep_ans_encode(jep_byte_buffer* raw)
+{
+	jep_byte_buffer* encoded;
+	jep_byte* buffer;
+	size_t bound;
+	size_t size;
+
+	if (raw == NULL)
+		return NULL;
+
+	bound = jep_ans_bound(raw->size);
+
+	if (bound == 0)
+		return NULL;
+
+	encoded = jep_create_byte_buffer();
+	buffer = jep_alloc(jep_byte, bound);
+
+	if (encoded == NULL || buffer == NULL)
+	{
+		jep_destroy_byte_buffer(encoded);
+		free(buffer);
+		return NULL;
+	}
+
+	free(encoded->buffer);
+	encoded->buffer = buffer;
+	encoded->cap = bound;
+
+	if (!jep_ans_encode_to(raw->buffer, raw->size, buffer, bound, &size))
+	{
+		jep_destroy_byte_buffer(encoded);
+		return NULL;
+	}
+
+	encoded->size = size;
+
+	return encoded;
+}
+
+JEP_UTILS_API jep_byte_buffer* JEP_UTILS_CALL
+jep_ans_decode(jep_byte_buffer* encoded)
+{
+	jep_byte_buffer* raw;
+	jep_byte* buffer;
+	size_t count;
+	size_t size;
+
+	// The header is checked before any room is made for the bytes
+	// that it claims, so a damaged count is not allocated.
+	if (encoded == NULL
+		|| !jep_ans_measure(encoded->buffer, encoded->size, &count))
+	{
+		return NULL;
+	}
+
+	raw = jep_create_byte_buffer();
+
+	if (raw == NULL)
+		return NULL;
+
+	// Make room for every decoded byte before any are decoded.
+	if (count > raw->cap)
+	{
+		buffer = jep_realloc(raw->buffer, jep_byte, count);
+
+		if (buffer == NULL)
+		{
+			jep_destroy_byte_buffer(raw);
+			return NULL;
+		}
+
+		raw->buffer = buffer;
+		raw->cap = count;
+	}
+
+	if (!jep_ans_decode_to(encoded->buffer, encoded->size, raw->buffer,
+		raw->cap, &size))
+	{
+		jep_destroy_byte_buffer(raw);
+		return NULL;
+	}
+
+	raw->size = size;
+
+	return raw;
+}
+
+
+
+
+static void normalize_counts(const uint32_t* counts, size_t n,
+	uint32_t* freqs)
+{
+	uint32_t total;  // The total of the scaled frequencies
+	uint32_t most;   // The byte with the highest frequency
+	uint32_t take;   // The amount taken from the highest frequency
+	uint32_t i;      // Index
+
+	total = 0;
+	most = 0;
+
+	for (i = 0; i <= UCHAR_MAX; i++)
+	{
+		freqs[i] = 0;
+
+		if (counts[i] == 0)
+			continue;
+
+		freqs[i] = (uint32_t)(((uint64_t)counts[i] * JEP_ANS_TABLE_SIZE) / n);
+
+		if (freqs[i] == 0)
+			freqs[i] = 1;
+
+		total += freqs[i];
+
+		if (freqs[i] > freqs[most])
+			most = i;
+	}
+
+	// Rounding down leaves states to spare, which go to the most
+	// frequent byte.
+	if (total <= JEP_ANS_TABLE_SIZE)
+	{
+		freqs[most] += JEP_ANS_TABLE_SIZE - total;
+		return;
+	}
+
+	// Raising rare bytes to 1 can take too many states. They are
+	// taken back from the most frequent bytes, none of which falls
+	// below 1. There are far more states than byte values, so this
+	// always succeeds.
+	while (total > JEP_ANS_TABLE_SIZE)
+	{
+		most = 0;
+		for (i = 1; i <= UCHAR_MAX; i++)
+		{
+			if (freqs[i] > freqs[most])
+				most = i;
+		}
+
+		take = total - JEP_ANS_TABLE_SIZE;
+
+		if (take > freqs[most] / 2)
+			take = freqs[most] / 2;
+
+		freqs[most] -= take;
+		total -= take;
+	}
+}
+
+
+static void spread_symbols(const uint32_t* freqs, jep_byte* spread)
+{
+	uint32_t pos; // The next state to be given out
+	uint32_t i;   // Index
+	uint32_t j;   // Index
+
+	pos = 0;
+	for (i = 0; i <= UCHAR_MAX; i++)
+	{
+		for (j = 0; j < freqs[i]; j++)
+		{
+			spread[pos] = (jep_byte)i;
+			pos = (pos + ANS_SPREAD_STEP) & (JEP_ANS_TABLE_SIZE - 1);
+		}
+	}
+}
+
+
+static void build_encoder(const uint32_t* freqs, ans_symbol* syms,
+	uint16_t* states)
+{
+	jep_byte spread[JEP_ANS_TABLE_SIZE]; // The byte of each state
+	uint32_t next[JEP_HISTOGRAM_SIZE];   // The next position of each byte
+	uint32_t start;                      // The first position of a byte
+	uint32_t bits;                       // The most bits of a byte
+	uint32_t i;                          // Index
+
+	start = 0;
+	for (i = 0; i <= UCHAR_MAX; i++)
+	{
+		next[i] = start;
+
+		if (freqs[i] == 0)
+		{
+			syms[i].bits = 0;
+			syms[i].limit = 0;
+			syms[i].offset = 0;
+			continue;
+		}
+
+		// A state is reduced by as many bits as it takes to bring it
+		// into the range [f, 2f), which is one bit fewer for the states
+		// below f shifted by the most bits.
+		bits = JEP_ANS_TABLE_BITS - highest_bit(freqs[i]);
+		syms[i].bits = bits;
+		syms[i].limit = freqs[i] << bits;
+		syms[i].offset = (int32_t)start - (int32_t)freqs[i];
+
+		start += freqs[i];
+	}
+
+	spread_symbols(freqs, spread);
+
+	// The states of each byte are listed in order, so the reduced
+	// state f + k selects the kth state of the byte.
+	for (i = 0; i < JEP_ANS_TABLE_SIZE; i++)
+		states[next[spread[i]]++] = (uint16_t)(JEP_ANS_TABLE_SIZE + i);
+}
+
+
+static void build_decoder(const uint32_t* freqs, ans_entry* table)
+{
+	jep_byte spread[JEP_ANS_TABLE_SIZE]; // The byte of each state
+	uint32_t next[JEP_HISTOGRAM_SIZE];   // The next reduced state of each byte
+	uint32_t bits;                       // The bits read after a state
+	uint32_t x;                          // A reduced state
+	uint32_t i;                          // Index
+
+	for (i = 0; i <= UCHAR_MAX; i++)
+		next[i] = freqs[i];
+
+	spread_symbols(freqs, spread);
+
+	// This undoes a step of the encoder. The reduced state is shifted
+	// back up into the range of the table, and the bits that the
+	// encoder removed are read to restore the state before it.
+	for (i = 0; i < JEP_ANS_TABLE_SIZE; i++)
+	{
+		x = next[spread[i]]++;
+		bits = JEP_ANS_TABLE_BITS - highest_bit(x);
+
+		table[i].sym = spread[i];
+		table[i].bits = (jep_byte)bits;
+		table[i].base = (uint16_t)((x << bits) - JEP_ANS_TABLE_SIZE);
+	}
+}
+
+
+static size_t write_freqs(const uint32_t* freqs, uint32_t first,
+	uint32_t last, jep_byte* dest)
+{
+	size_t pos;  // Position in the output
+	uint32_t i;  // Index
+
+	dest[0] = (jep_byte)first;
+	dest[1] = (jep_byte)last;
+	pos = 2;
+
+	for (i = first; i <= last; i++)
+	{
+		if (freqs[i] < 0x80)
+		{
+			dest[pos++] = (jep_byte)freqs[i];
+		}
+		else
+		{
+			dest[pos++] = (jep_byte)(0x80 | (freqs[i] & 0x7F));
+			dest[pos++] = (jep_byte)(freqs[i] >> 7);
+		}
+	}
+
+	return pos;
+}
+
+
+static size_t read_freqs(const jep_byte* src, size_t n, uint32_t* freqs)
+{
+	uint32_t total;  // The total of the frequencies
+	uint32_t first;  // The first byte value
+	uint32_t last;   // The last byte value
+	size_t pos;      // Position in the input
+	uint32_t i;      // Index
+
+	if (n < 2 || src[0] > src[1])
+		return 0;
+
+	first = src[0];
+	last = src[1];
+	pos = 2;
+
+	for (i = 0; i <= UCHAR_MAX; i++)
+		freqs[i] = 0;
+
+	total = 0;
+	for (i = first; i <= last; i++)
+	{
+		if (pos >= n)
+			return 0;
+
+		freqs[i] = src[pos] & 0x7F;
+
+		if (src[pos++] & 0x80)
+		{
+			if (pos >= n)
+				return 0;
+
+			freqs[i] |= (uint32_t)src[pos++] << 7;
+		}
+
+		total += freqs[i];
+
+		if (total > JEP_ANS_TABLE_SIZE)
+			return 0;
+	}
+
+	if (total != JEP_ANS_TABLE_SIZE)
+		return 0;
+
+	return pos;
+}
+
+
+static int read_header(const jep_byte* src, size_t n, uint32_t* count,
+	uint32_t* freqs, uint32_t* x, uint32_t* totals, size_t* head)
+{
+	uint64_t bits;   // The bits of every bitstream
+	uint64_t bytes;  // The bytes of every bitstream
+	uint32_t most;   // The highest frequency
+	size_t used;     // The bytes of frequencies
+	size_t i;        // Index
+
+	if (n < 4)
+		return 0;
+
+	jep_build_u32(*count, src);
+
+	if (*count == 0)
+	{
+		*head = 4;
+		return 1;
+	}
+
+	used = read_freqs(src + 4, n - 4, freqs);
+
+	if (used == 0)
+		return 0;
+
+	*head = 4 + used;
+
+	if (n - *head < 6 * ANS_STATES)
+		return 0;
+
+	bits = 0;
+	bytes = 0;
+	for (i = 0; i < ANS_STATES; i++)
+	{
+		x[i] = (uint32_t)src[*head + i * 2]
+			| ((uint32_t)src[*head + i * 2 + 1] << 8);
+
+		if (x[i] >= JEP_ANS_TABLE_SIZE)
+			return 0;
+
+		jep_build_u32(totals[i], (src + *head + 2 * ANS_STATES + 4 * i));
+		bits += totals[i];
+		bytes += totals[i] / CHAR_BIT + (totals[i] % CHAR_BIT ? 1 : 0);
+	}
+
+	*head += 6 * ANS_STATES;
+
+	if (n - *head < bytes)
+		return 0;
+
+	// Only a byte with more than half of the states can be decoded
+	// without reading a bit. Without one, every byte reads at least
+	// one bit, so there cannot be more bytes than bits.
+	most = 0;
+	for (i = 0; i <= UCHAR_MAX; i++)
+	{
+		if (freqs[i] > most)
+			most = freqs[i];
+	}
+
+	if (most <= JEP_ANS_TABLE_SIZE / 2 && *count > bits)
+		return 0;
+
+	return 1;
+}
+
+
+static size_t encode_pair(const jep_byte* src, size_t n,
+	const ans_symbol* syms, const uint16_t* states, uint32_t first,
+	jep_byte* dest, jep_byte* end, uint32_t* x, uint64_t* total)
+{
+	const ans_symbol* sym;  // The current byte's parameters
+	ans_writer w;           // The bit writer
+	jep_byte t;             // A byte being moved
+	size_t front;           // The bytes of the first bitstream
+	size_t back;            // The bytes of the second bitstream
+	uint32_t len;           // The bits written for a byte
+	uint32_t s;             // The bitstream of a byte
+	uint32_t k;             // The state of a byte
+	size_t i;               // Index
+
+	w.front = dest;
+	w.back = end;
+	w.bits[0] = w.bits[1] = 0;
+	w.count[0] = w.count[1] = 0;
+	w.full = 0;
+
+	x[first] = JEP_ANS_TABLE_SIZE;
+	x[first + 1] = JEP_ANS_TABLE_SIZE;
+	total[first] = 0;
+	total[first + 1] = 0;
+
+	// Bytes are encoded from last to first, so that the decoder,
+	// which reads the bits backwards, produces them in order.
+	for (i = n; i-- > 0;)
+	{
+		k = (uint32_t)(i % ANS_STATES);
+
+		if (k != first && k != first + 1)
+			continue;
+
+		s = k - first;
+		sym = &(syms[src[i]]);
+		len = sym->bits - (x[k] < sym->limit);
+
+		put_bits(&w, s, x[k] & ((1U << len) - 1), len);
+		total[k] += len;
+
+		x[k] = states[sym->offset + (int32_t)(x[k] >> len)];
+	}
+
+	flush_writer(&w);
+
+	if (w.full)
+		return 0;
+
+	// The second bitstream was written backwards from the end, so it is
+	// turned around and moved down to follow the first.
+	front = (size_t)(w.front - dest);
+	back = (size_t)(end - w.back);
+
+	for (i = 0; i < back / 2; i++)
+	{
+		t = w.back[i];
+		w.back[i] = w.back[back - 1 - i];
+		w.back[back - 1 - i] = t;
+	}
+
+	memmove(dest + front, w.back, back);
+
+	return front + back;
+}
+
+
+static void put_bits(ans_writer* w, uint32_t s, uint64_t bits, uint32_t len)
+{
+	w->bits[s] |= bits << w->count[s];
+	w->count[s] += len;
+
+	if (w->count[s] < 32)
+		return;
+
+	if (w->back - w->front < 4)
+	{
+		w->full = 1;
+	}
+	else if (s == 0)
+	{
+		w->front[0] = (jep_byte)(w->bits[0]);
+		w->front[1] = (jep_byte)(w->bits[0] >> 8);
+		w->front[2] = (jep_byte)(w->bits[0] >> 16);
+		w->front[3] = (jep_byte)(w->bits[0] >> 24);
+		w->front += 4;
+	}
+	else
+	{
+		w->back[-1] = (jep_byte)(w->bits[1]);
+		w->back[-2] = (jep_byte)(w->bits[1] >> 8);
+		w->back[-3] = (jep_byte)(w->bits[1] >> 16);
+		w->back[-4] = (jep_byte)(w->bits[1] >> 24);
+		w->back -= 4;
+	}
+
+	w->bits[s] >>= 32;
+	w->count[s] -= 32;
+}
+
+
+static void flush_writer(ans_writer* w)
+{
+	uint32_t s; // A bitstream
+
+	for (s = 0; s < 2; s++)
+	{
+		while (w->count[s] > 0)
+		{
+			if (w->front == w->back)
+			{
+				w->full = 1;
+				return;
+			}
+
+			if (s == 0)
+				*(w->front++) = (jep_byte)(w->bits[0]);
+			else
+				*(--w->back) = (jep_byte)(w->bits[1]);
+
+			w->bits[s] >>= CHAR_BIT;
+			w->count[s] = w->count[s] > CHAR_BIT ? w->count[s] - CHAR_BIT : 0;
+		}
+	}
+}
+
+static uint32_t read_bits(const jep_byte* src, size_t n, uint64_t pos,
+	uint32_t len)
+{
+	uint64_t word;   // The bytes holding the bits
+	size_t byte;     // The byte holding the first bit
+	size_t i;        // Index
+
+	byte = (size_t)(pos / CHAR_BIT);
+
+	if (n - byte >= 8)
+	{
+		word = jep_load_le64(src + byte);
+	}
+	else
+	{
+		// Near the end of the bits, only the remaining bytes are loaded.
+		word = 0;
+		for (i = 0; byte + i < n; i++)
+			word |= (uint64_t)src[byte + i] << (i * CHAR_BIT);
+	}
+
+	return (uint32_t)(word >> (pos % CHAR_BIT)) & ((1U << len) - 1);
+}
+
+
+static uint32_t highest_bit(uint32_t x)
+{
+	uint32_t bit; // The position of the highest bit
+
+	bit = 0;
+	while (x >>= 1)
+		bit++;
+
+	return bit;
+}
@@ -50,7 +50,7 @@ jep_append_byte(jep_byte_buffer* bb, jep_byte b)
 
 	if (bb->size >= bb->cap)
 	{
-		size_t new_cap = bb->size + bb->size / 2;
+		size_t new_cap = bb->cap + bb->cap / 2 + 1;
 		jep_byte* buffer = (jep_byte*)realloc(bb->buffer, new_cap);
 
 		if (buffer == NULL)
@@ -142,6 +142,7 @@ jep_clear_byte_buffer(jep_byte_buffer* bb)
 		return 0;
 
 	bb->buffer = buffer;
+	bb->cap = 1;
 
 	return 1;
 }
@@ -0,0 +1,85 @@
+#include "jep_utils/jep_utils.h"
+#include "jep_utils/histogram.h"
+
+
+
+
+/**
+ * The number of separate tables used to count large inputs.
+ */
+#define HIST_TABLES 4
+
+/**
+ * The smallest number of bytes that is counted with separate tables.
+ * Below this, clearing and combining the tables costs more than
+ * the increments that they save.
+ */
+#define HIST_SPLIT_MIN 1500
+
+
+
+
+JEP_UTILS_API int JEP_UTILS_CALL
+jep_byte_histogram(const jep_byte* src, size_t n, uint32_t* counts)
+{
+	uint32_t tables[HIST_TABLES][JEP_HISTOGRAM_SIZE]; // Separate counters
+	uint32_t a, b, c, d;                              // Four bytes each
+	size_t i;                                         // Index
+	int k;                                            // Index
+
+	if (counts == NULL || (src == NULL && n > 0) || n > UINT32_MAX)
+		return 0;
+
+	memset(counts, 0, sizeof(uint32_t) * JEP_HISTOGRAM_SIZE);
+
+	if (n < HIST_SPLIT_MIN)
+	{
+		for (i = 0; i < n; i++)
+			counts[src[i]]++;
+
+		return 1;
+	}
+
+	memset(tables, 0, sizeof(tables));
+
+	// Each byte of a word goes to a different table, so consecutive
+	// increments of the same byte value touch different counters.
+	for (i = 0; i + 16 <= n; i += 16)
+	{
+		a = jep_load_le32(src + i);
+		b = jep_load_le32(src + i + 4);
+		c = jep_load_le32(src + i + 8);
+		d = jep_load_le32(src + i + 12);
+
+		tables[0][a & 0xFF]++;
+		tables[1][(a >> 8) & 0xFF]++;
+		tables[2][(a >> 16) & 0xFF]++;
+		tables[3][a >> 24]++;
+
+		tables[0][b & 0xFF]++;
+		tables[1][(b >> 8) & 0xFF]++;
+		tables[2][(b >> 16) & 0xFF]++;
+		tables[3][b >> 24]++;
+
+		tables[0][c & 0xFF]++;
+		tables[1][(c >> 8) & 0xFF]++;
+		tables[2][(c >> 16) & 0xFF]++;
+		tables[3][c >> 24]++;
+
+		tables[0][d & 0xFF]++;
+		tables[1][(d >> 8) & 0xFF]++;
+		tables[2][(d >> 16) & 0xFF]++;
+		tables[3][d >> 24]++;
+	}
+
+	for (; i < n; i++)
+		tables[0][src[i]]++;
+
+	for (i = 0; i < JEP_HISTOGRAM_SIZE; i++)
+	{
+		for (k = 0; k < HIST_TABLES; k++)
+			counts[i] += tables[k][i];
+	}
+
+	return 1;
+}
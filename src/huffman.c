@@ -1,5 +1,25 @@
 #include "jep_utils/jep_utils.h"
 #include "jep_utils/huffman.h"
+#include "jep_utils/histogram.h"
+#include "jep_utils/ans.h"
+#include "jep_utils/crc.h"
+
+#include <math.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#if defined(JEP_HUFF_STATS) && !defined(_WIN32)
+#include <time.h>
+#endif
 
 
 
@@ -14,6 +34,37 @@ static const jep_byte dict_end = 0x04;
 static const jep_byte data_begin = 0x05;
 static const jep_byte data_end = 0x06;
 
+/* canonical format metadata */
+static const jep_byte huff_magic = 0x4A;
+static const jep_byte huff_version = 0x03;
+static const jep_byte huff_type_code = 0x00;
+static const jep_byte huff_type_index = 0x01;
+static const jep_byte huff_type_split = 0x02;
+static const jep_byte huff_type_table = 0x03;
+static const jep_byte huff_type_stored = 0x04;
+static const jep_byte huff_type_run = 0x05;
+static const jep_byte huff_type_context = 0x06;
+static const jep_byte huff_type_ans = 0x07;
+static const jep_byte huff_type_checked = 0x08;
+
+/* the previous version, whose coded blocks do not record
+   the number of bytes that they decode to */
+static const jep_byte huff_version_unsized = 0x02;
+
+/* the size of the fixed part of an indexed container header */
+static const size_t huff_index_header = 19;
+
+/* the size of the header of a stored block and of a run block */
+static const size_t huff_stored_header = 7;
+static const size_t huff_run_header = 8;
+
+/* the size of the header of an ANS block, which is followed by a frame */
+static const size_t huff_ans_header = 7;
+
+/* the size of the header of a checked block, which holds the size and
+   the checksum of the block that follows it */
+static const size_t huff_checked_header = 11;
+
 
 
 
@@ -30,28 +81,389 @@ static const jep_byte data_end = 0x06;
  */
 #define resym(a, n) jep_realloc(a, jep_huff_sym, n)
 
+/**
+ * The maximum length of a canonical code.
+ * Canonical codes are computed as integers, so they cannot be
+ * any longer than the integer type used to hold them.
+ */
+#define HUFF_MAX_CODE_BITS 63
 
+/**
+ * The number of bits used to index a decoding table.
+ * Any code that is no longer than this can be resolved with
+ * a single table lookup.
+ */
+#define HUFF_TABLE_BITS 11
 
+/**
+ * The number of entries in a decoding table.
+ */
+#define HUFF_TABLE_SIZE (1 << HUFF_TABLE_BITS)
 
-/*-----------------------------------------------------------------*/
-/*                        Memory Management                        */
-/*-----------------------------------------------------------------*/
+/**
+ * The number of interleaved bitstreams in a split block.
+ */
+#define HUFF_STREAMS 4
+
+/**
+ * The smallest number of bytes that is encoded as a split block.
+ * Smaller blocks do not decode long enough for interleaving to make up
+ * for the cost of the extra bit counts and the partial final bytes.
+ */
+#define HUFF_SPLIT_MIN 1024
+
+/**
+ * The number of bits used to index a multi-symbol decoding table.
+ * Each entry holds every whole code that fits in these bits,
+ * up to HUFF_MULTI_SYMS of them.
+ */
+#define HUFF_MULTI_BITS 12
+
+/**
+ * The number of entries in a multi-symbol decoding table.
+ */
+#define HUFF_MULTI_SIZE (1 << HUFF_MULTI_BITS)
+
+/**
+ * The most symbols held by an entry of a multi-symbol decoding table.
+ */
+#define HUFF_MULTI_SYMS 3
 
 /**
- * Creates a Huffman leaf node.
+ * The longest average code, in bits, that is decoded with a
+ * multi-symbol table. Longer codes leave too little room in an entry
+ * for a second symbol to be worth the larger table.
+ */
+#define HUFF_MULTI_AVG 5
+
+/**
+ * The fewest symbols that are decoded with a multi-symbol table.
+ * Smaller blocks do not decode long enough to make up for the time
+ * spent building it.
+ */
+#define HUFF_MULTI_MIN 16384
+
+/**
+ * The number of bytes that are collected before they are written
+ * to a file, so that files are written in a few large pieces.
+ */
+#define HUFF_FILE_CHUNK (1 << 20)
+
+/**
+ * The largest number of encoded bytes that a stream decodes at once
+ * when a block is decoded as it arrives.
+ */
+#define HUFF_WINDOW 4096
+
+/**
+ * The largest number of bytes used to write the length of a message
+ * encoded with a shared table. Seven bits of the length are written
+ * in each byte.
+ */
+#define HUFF_VARINT_MAX 10
+
+/**
+ * The largest number of code tables in a context block.
+ * Each table needs its own decoder, so the decoders of every table
+ * must fit on the stack together.
+ */
+#define HUFF_CONTEXTS 8
+
+/**
+ * The number of times that the previous bytes are reassigned to the
+ * code tables that suit them best before the tables are written.
+ */
+#define HUFF_CONTEXT_ROUNDS 6
+
+/**
+ * The smallest number of bytes that is encoded with a context model.
+ * Smaller inputs rarely save enough to pay for the extra tables.
+ */
+#define HUFF_CONTEXT_MIN 4096
+
+/**
+ * Determines whether a block was written in a version of the format
+ * that can be read.
  *
- * Returns:
- *   huff_node - a new leaf node
+ * Params:
+ *   v - the version byte of a block
+ */
+#define known_version(v) ((v) == huff_version || (v) == huff_version_unsized)
+
+/**
+ * Extracts the code length from a decoding table entry.
+ * A length of 0 means that the code is longer than HUFF_TABLE_BITS
+ * (or does not exist), and the tree must be walked to resolve it.
+ *
+ * Params:
+ *   e - a decoding table entry
+ */
+#define entry_len(e) ((e) >> 8)
+
+/**
+ * Extracts the symbol byte from a decoding table entry.
+ *
+ * Params:
+ *   e - a decoding table entry
+ */
+#define entry_sym(e) ((jep_byte)((e) & 0xFF))
+
+/**
+ * Extracts the number of bits used by a multi-symbol table entry.
+ *
+ * Params:
+ *   e - a multi-symbol table entry
+ */
+#define multi_len(e) (((e) >> 24) & 0xF)
+
+/**
+ * Extracts the number of symbols in a multi-symbol table entry.
+ * A count of 0 means that the first code is longer than HUFF_TABLE_BITS.
+ *
+ * Params:
+ *   e - a multi-symbol table entry
+ */
+#define multi_count(e) ((e) >> 28)
+
+/**
+ * Determines whether a number of symbols encoded in a number of bits
+ * is decoded with a multi-symbol table.
+ *
+ * Params:
+ *   n - the number of symbols
+ *   bits - the number of bits
  */
-static jep_huff_node* create_leaf_node();
+#define use_multi(n, bits) \
+	((n) >= HUFF_MULTI_MIN && (uint64_t)(bits) <= (uint64_t)(n) * HUFF_MULTI_AVG)
 
 /**
- * Frees the resources allocated for a Huffman leaf node.
+ * Phase timers for Huffman statistics.
+ * A timer is declared after the other variables of a function, started,
+ * and then lapped at the end of each phase, which adds the time since
+ * the previous lap to a field of the statistics. Without JEP_HUFF_STATS,
+ * the timers are removed entirely, though the statistics are still
+ * referenced so that a function which only times them uses them.
  *
  * Params:
- *   huff_node - a Huffman leaf node
+ *   t - the name of a timer
+ *   s - the statistics, which may be NULL
+ *   f - the field of the statistics that receives the time
+ */
+#ifdef JEP_HUFF_STATS
+#define huff_timer(t) uint64_t t = 0
+#define huff_timer_start(s, t) \
+	do { if ((s) != NULL) { t = huff_clock(); } } while (0)
+#define huff_timer_lap(s, f, t) \
+	do { \
+		if ((s) != NULL) \
+		{ \
+			uint64_t l_ = huff_clock(); \
+			(s)->f += l_ - t; \
+			t = l_; \
+		} \
+	} while (0)
+#else
+#define huff_timer(t)
+#define huff_timer_start(s, t) (void)(s)
+#define huff_timer_lap(s, f, t) (void)(s)
+#endif
+
+
+
+
+/*-----------------------------------------------------------------*/
+/*                          Internal Types                         */
+/*-----------------------------------------------------------------*/
+
+/**
+ * A bit reader consumes a stream of bytes as a sequence of bits.
+ * Bits are read starting from the least significant bit of each byte,
+ * which is the order in which jep_add_bit stores them.
+ * Up to 64 bits are buffered at a time so that several symbols can be
+ * decoded between each read from memory.
+ */
+typedef struct huff_reader {
+	const jep_byte* pos; // The next byte to be loaded
+	const jep_byte* end; // One past the last byte of input
+	uint64_t bits;       // Buffered bits with the next bit in the LSB
+	uint32_t count;      // The number of valid bits in the buffer
+}huff_reader;
+
+/**
+ * A bit writer packs a sequence of bits into an array of bytes.
+ * Bits are written starting from the least significant bit of each byte.
+ * Bits are collected in a 64-bit accumulator and written to memory
+ * 32 bits at a time.
+ */
+typedef struct huff_writer {
+	jep_byte* pos;  // The next byte to be written
+	uint64_t bits;  // Pending bits with the first bit in the LSB
+	uint32_t count; // The number of pending bits
+}huff_writer;
+
+/**
+ * An entry in an encoding table holds the code for a single byte value
+ * with the bits in the order in which they are written.
+ */
+typedef struct huff_code_entry {
+	uint64_t bits; // The code with its first bit in the LSB
+	uint32_t len;  // The number of bits in the code
+}huff_code_entry;
+
+/**
+ * A decoder resolves codes of up to HUFF_TABLE_BITS bits with a single
+ * table lookup. Longer canonical codes are resolved one bit at a time
+ * from the number of codes of each length. Codes that are not canonical
+ * are resolved by walking a Huffman tree instead.
+ */
+typedef struct huff_decoder {
+	uint16_t entries[HUFF_TABLE_SIZE];       // The decoding table
+	uint32_t counts[HUFF_MAX_CODE_BITS + 1]; // The number of codes of each length
+	jep_byte symbols[UCHAR_MAX + 1];         // The bytes in order of their codes
+	uint32_t longest;                        // The length of the longest code
+	jep_huff_node* root;                     // The tree of non-canonical codes
+}huff_decoder;
+
+/**
+ * A multi-symbol table decodes several short codes with a single
+ * lookup. Each entry is indexed by the next HUFF_MULTI_BITS bits of the
+ * input and holds the bytes of the codes that begin there, the first in
+ * the low byte, followed by the number of bits that they use and the
+ * number of bytes.
+ */
+typedef struct huff_multi_table {
+	uint32_t entries[HUFF_MULTI_SIZE]; // The decoding table
+}huff_multi_table;
+
+/**
+ * The lookup tables of a shared Huffman table are built once when the
+ * table is created, so that messages can be encoded and decoded
+ * without any setup.
+ */
+typedef struct huff_lookup {
+	huff_code_entry codes[UCHAR_MAX + 1]; // The code of each byte value
+	huff_decoder decoder;                 // The decoder of every code
+}huff_lookup;
+
+/**
+ * A partial block is a coded, split, or stored block that a stream is
+ * decoding as its bytes arrive. The bitstreams of a split block follow
+ * one another and decode to consecutive bytes, so each is decoded in
+ * turn. Bits that do not yet hold a whole code are carried over to the
+ * next bytes.
+ */
+typedef struct huff_partial {
+	huff_decoder dec;                      // The decoder of every code
+	uint32_t symbols[HUFF_STREAMS];        // The bytes of each bitstream
+	uint32_t bits[HUFF_STREAMS];           // The bits of each bitstream
+	uint32_t streams;                      // The number of bitstreams
+	uint32_t current;                      // The bitstream being decoded
+	uint64_t left;                         // The bytes still to be decoded
+	uint64_t remaining;                    // The bits still to be decoded
+	uint64_t bytes;                        // The bytes still to arrive
+	jep_byte window[HUFF_WINDOW + 16];     // Carried and arriving bytes
+	size_t carried;                        // The number of carried bytes
+	uint32_t skip;                         // Decoded bits of the first one
+	int stored;                            // 1 for a stored block
+	int active;                            // 1 while a block is partial
+}huff_partial;
+
+/**
+ * A context model encodes each byte with one of several code tables,
+ * chosen by the byte before it. Previous bytes that are followed by
+ * similar bytes share a table, so the map from previous bytes to
+ * tables is small enough to be written with the tables.
+ */
+typedef struct huff_context_model {
+	uint32_t counts[(UCHAR_MAX + 1) * (UCHAR_MAX + 1)];    // The frequency of each pair of bytes
+	uint32_t totals[HUFF_CONTEXTS][UCHAR_MAX + 1];         // The frequency of each byte in each table
+	jep_byte lengths[HUFF_CONTEXTS][UCHAR_MAX + 1];        // The code lengths of each table
+	huff_code_entry codes[HUFF_CONTEXTS][UCHAR_MAX + 1];   // The codes of each table
+	jep_byte map[UCHAR_MAX + 1];                           // The table of each previous byte
+	uint32_t count;                                        // The number of tables
+	uint64_t bits;                                         // The number of bits of data
+}huff_context_model;
+
+#ifdef _WIN32
+typedef HANDLE huff_thread;
+typedef HANDLE huff_file;
+#else
+typedef pthread_t huff_thread;
+typedef int huff_file;
+#endif
+
+/**
+ * A mapped file is read straight from memory that the operating system
+ * fills from the file as it is used, so its bytes are never copied
+ * into a buffer. An empty file has no memory.
+ */
+typedef struct huff_mapped_file {
+	const jep_byte* data; // The bytes of the file
+	size_t size;          // The number of bytes
+	huff_file file;       // The open file
+#ifdef _WIN32
+	HANDLE mapping;       // The mapping of the file
+#endif
+}huff_mapped_file;
+
+/**
+ * A worker performs a task for some of the indices in a range.
+ * It begins with its own position among the workers and advances by
+ * the number of workers, so that each index is handled exactly once.
+ */
+typedef struct huff_worker {
+	int (*task)(void*, uint32_t); // The task to perform for each index
+	void* ctx;                    // The data shared by every task
+	uint32_t first;               // The first index to be handled
+	uint32_t step;                // The distance between indices
+	uint32_t count;               // The number of indices in the range
+	int result;                   // 1 if every task succeeded
+	int started;                  // 1 if the worker has its own thread
+	huff_thread thread;           // The thread running the worker
+}huff_worker;
+
+/**
+ * A block job describes how an array of bytes is divided into blocks
+ * and where the encoded blocks are kept until they are written.
+ */
+typedef struct huff_block_job {
+	const jep_byte* src;      // The raw bytes
+	size_t size;              // The number of raw bytes
+	size_t block_size;        // The number of raw bytes per block
+	uint32_t limit;           // The longest code in a block
+	uint32_t coder;           // The entropy coder of every block
+	jep_byte_buffer** blocks; // The encoded blocks
+}huff_block_job;
+
+/**
+ * An index locates the blocks of an indexed container.
+ * The offsets are left as they were written, so reading an index
+ * does not require any memory to be allocated.
+ */
+typedef struct huff_index {
+	uint32_t block_size;     // The number of raw bytes per block
+	uint32_t count;          // The number of blocks
+	uint64_t raw_size;       // The total number of raw bytes
+	const jep_byte* offsets; // The offset of each block and of the end
+	const jep_byte* blocks;  // The first byte of the first block
+	uint64_t blocks_size;    // The number of bytes after the index
+}huff_index;
+
+/**
+ * An index job describes where each block of an indexed container
+ * is decoded to.
  */
-static void destroy_leaf_node(jep_huff_node* node);
+typedef struct huff_index_job {
+	huff_index* index; // The index of the container
+	jep_byte* dest;    // The decoded bytes of every block
+}huff_index_job;
+
+
+
+
+/*-----------------------------------------------------------------*/
+/*                        Memory Management                        */
+/*-----------------------------------------------------------------*/
 
 /**
  * Creates a dictionary of bitcodes.
@@ -73,12 +485,17 @@ static jep_huff_dict* create_dict(size_t count);
 static void destroy_dict(jep_huff_dict* dict);
 
 /**
- * Creates an empty, unsorted Huffman tree.
+ * Creates an empty Huffman tree.
+ * All of the nodes of the tree are allocated at once,
+ * so the capacity must be known ahead of time.
+ *
+ * Params:
+ *   uint32_t - the maximum number of nodes in the tree
  *
  * Returns:
- *   huff_node - a new, unorganized Huffman tree
+ *   huff_tree - a new, empty Huffman tree
  */
-static jep_huff_tree* create_tree();
+static jep_huff_tree* create_tree(uint32_t cap);
 
 /**
  * Frees the resources allocated for a Huffman tree.
@@ -104,34 +521,50 @@ static jep_huff_code* create_huff_code();
 /*-----------------------------------------------------------------*/
 
 /**
- * Adds a leaf node to a Huffman tree.
+ * Takes the next unused node from the node array of a Huffman tree.
+ * The node begins as a branch with no leaves.
  *
  * Params:
  *   huff_tree - a Huffman tree
- *   huff_node - a Huffman leaf node
+ *
+ * Returns:
+ *   huff_node - a new node or NULL if the tree is full
  */
-static void add_leaf_node(jep_huff_tree* tree, jep_huff_node* node);
+static jep_huff_node* add_node(jep_huff_tree* tree);
 
 /**
- * Sorts the leaf nodes of a Huffman tree in order of increasing frequency.
+ * Compares two Huffman nodes by the frequency of their symbols.
+ * Nodes of equal frequency are ordered by byte value so that
+ * the result does not depend on the sorting algorithm.
  *
  * Params:
- *   huff_tree - an unsorted Huffman tree
+ *   void - a Huffman node
+ *   void - another Huffman node
+ *
+ * Returns:
+ *   int - a negative, zero, or positive value
  */
-static void sort_leaf_nodes(jep_huff_tree* tree);
+static int compare_nodes(const void* a, const void* b);
 
 /**
- * Assembles a list of Huffman leaf nodes into a Huffman tree.
- * The leaf nodes should already be sorted by frequency.
+ * Assembles the symbols of a dictionary into a Huffman tree.
+ * The tree must have room for 2n - 1 nodes, where n is the number
+ * of symbols. The leaves are sorted by frequency and placed at the
+ * end of the node array. Parent nodes are then created from the two
+ * least frequent nodes that have not yet been joined, which are always
+ * at the front of either the sorted leaves or the parent nodes created
+ * so far. Each parent node is placed before the ones created before it,
+ * so the root node ends up at the beginning of the array.
  * Returns 1 on success or 0 on failure.
  *
  * Params:
- *   huff_tree - an unconstructed Huffman tree
+ *   huff_tree - an empty Huffman tree
+ *   huff_dict - a dictionary of symbols with their frequencies
  *
  * Returns:
  *   int - 1 on success or 0 on failure.
  */
-static int construct_tree(jep_huff_tree* tree);
+static int construct_tree(jep_huff_tree* tree, jep_huff_dict* dict);
 
 /**
  * Builds a Huffman tree based on a dictionary of bitcodes.
@@ -145,59 +578,140 @@ static int construct_tree(jep_huff_tree* tree);
 static jep_huff_tree* reconstruct_tree(jep_huff_dict* dict);
 
 /**
- * Assigns bitcodes to the leaves of a Huffman tree.
- * Returns 1 on success or 0 on failure.
+ * Determines the code length of each symbol from its depth in a
+ * Huffman tree and stores it in the corresponding dictionary symbol.
+ * A tree with a single leaf still gives that leaf a length of 1.
  *
  * Params:
- *   huff_tree - a Huffman tree
+ *   huff_tree - a Huffman tree made by construct_tree
+ *   huff_dict - the dictionary from which the tree was made
+ */
+static void assign_code_lengths(jep_huff_tree* tree, jep_huff_dict* dict);
+
+/**
+ * Determines the optimal code lengths for the symbols of a dictionary
+ * such that no code is longer than a given limit, using the
+ * package-merge algorithm.
+ * Each list of items corresponds to a code length, starting with the
+ * longest. A list is made by merging the symbols with packages formed
+ * from pairs of items in the previous list. The 2n - 2 least frequent
+ * items of the final list determine how many times each symbol is
+ * chosen, which is the length of its code.
+ * The limit must allow at least one code for every symbol.
+ *
+ * Params:
+ *   huff_dict - a dictionary of symbols with their frequencies
+ *   uint32_t - the maximum code length
+ */
+static void limit_code_lengths(jep_huff_dict* dict, uint32_t limit);
+
+/**
+ * Determines the length of the code of every byte value from the number
+ * of times each one occurs, such that no code is longer than the limit.
+ * Bytes that do not occur have a length of 0. No memory is allocated.
+ * Returns 0 if no byte occurs or the limit is too short to give every
+ * byte its own code.
+ *
+ * Params:
+ *   uint32_t - an array of JEP_HISTOGRAM_SIZE counts
+ *   uint32_t - the maximum length of a code in bits
+ *   jep_byte - an array of UCHAR_MAX + 1 bytes to receive the lengths
  *
  * Returns:
  *   int - 1 on success or 0 on failure
  */
-static int assign_bitcodes(jep_huff_tree* tree);
+static int build_code_lengths(const uint32_t* counts,
+	uint32_t limit,
+	jep_byte* lengths);
+
+
+
+
+/*-----------------------------------------------------------------*/
+/*                         Canonical Codes                         */
+/*-----------------------------------------------------------------*/
 
 /**
- * Recursively assigns a bitcode to a Huffman leaf node and all of its
- * leaf nodes.
- * Returns 1 on success or 0 on failure.
+ * Computes the canonical code of each symbol in a dictionary from
+ * the code lengths stored in the tree depth of each symbol.
+ * Shorter codes precede longer codes, and codes of the same length
+ * are ordered by byte value. The first bit of a code is its most
+ * significant bit.
+ * Returns 1 on success or 0 if the lengths cannot form a prefix code.
  *
  * Params:
- *   huff_node - the root node of a Huffman tree
- *   unsigned long - the current level within the tree
- *   jep_bitstring - a bitstring populated based on the current branch and level
+ *   huff_dict - a bitcode dictionary
+ *   uint64_t - an array to receive the code of each symbol
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+static int canonical_code_values(jep_huff_dict* dict, uint64_t* codes);
+
+/**
+ * Computes the canonical code of every byte value from the length
+ * of its code. Bytes with a length of 0 do not receive a code.
+ * Returns 1 on success or 0 if the lengths cannot form a prefix code.
+ *
+ * Params:
+ *   jep_byte - an array of UCHAR_MAX + 1 code lengths
+ *   uint64_t - an array of UCHAR_MAX + 1 codes to be computed
  *
  * Returns:
  *   int - 1 on success or 0 on failure
  */
-static int assign_bitcode(
-	jep_huff_node* node,
-	uint32_t level,
-	jep_bitstring* bs
-);
+static int lengths_to_codes(const jep_byte* lengths, uint64_t* codes);
 
 /**
- * Constructs a branch of a Huffman tree.
+ * Replaces the bitcode of each symbol in a dictionary with its
+ * canonical code.
  * Returns 1 on success or 0 on failure.
  *
  * Params:
- *   huff_node - a Huffman node
- *   jep_bitstring - a bitstring containing the bitcode for the current branch
- *   huff_sym - the raw data to be stored at the current node
- *   jep_byte - which byte in the bitstring is currently being used
- *   unsigned long - which bit in the current byte is currently being used
- *   unsigned long - the number of branches traversed
+ *   huff_dict - a bitcode dictionary whose symbols have code lengths
  *
  * Returns:
  *   int - 1 on success or 0 on failure
  */
-static int build_branch(
-	jep_huff_node** node,
-	jep_bitstring* bs,
-	jep_huff_sym data,
-	jep_byte byte,
-	uint32_t bit,
-	uint32_t bit_count
-);
+static int assign_canonical_codes(jep_huff_dict* dict);
+
+/**
+ * Determines whether the bitcodes of a dictionary are the canonical
+ * codes for their lengths. Only such a dictionary can be written
+ * using code lengths alone.
+ *
+ * Params:
+ *   huff_dict - a bitcode dictionary
+ *
+ * Returns:
+ *   int - 1 if the codes are canonical or 0 otherwise
+ */
+static int is_canonical(jep_huff_dict* dict);
+
+/**
+ * Creates a dictionary of canonical codes from the number of times each
+ * byte value occurs. Every byte with a count of at least 1 is given
+ * a code, and no code is longer than the limit.
+ * Returns NULL on failure, or if no byte occurs or the limit is too
+ * short to give every byte its own code.
+ *
+ * Params:
+ *   uint32_t - an array of JEP_HISTOGRAM_SIZE counts
+ *   uint32_t - the maximum length of a code in bits
+ *
+ * Returns:
+ *   huff_dict - a dictionary of canonical codes or NULL on failure
+ */
+static jep_huff_dict* build_canonical_dict(const uint32_t* counts,
+	uint32_t limit);
+
+/**
+ * Empties a bitstring without releasing its memory.
+ *
+ * Params:
+ *   jep_bitstring - a bitstring
+ */
+static void reset_bitstring(jep_bitstring* bs);
 
 
 
@@ -248,6 +762,92 @@ static void write_huff_dict(jep_huff_dict* dict, jep_byte_buffer* bb);
  */
 static void write_huff_data(jep_bitstring* data, jep_byte_buffer* bb);
 
+/**
+ * Reads a dictionary of code lengths from a byte buffer and
+ * assigns the canonical code for each length.
+ *
+ * Params:
+ *   jep_byte_buffer - a collection of bytes encoded with Huffman Coding
+ *   size_t - the position in the byte buffer to start reading
+ *
+ * Returns:
+ *   huff_dict - a bitcode dictionary or NULL on failure
+ */
+static jep_huff_dict* read_canonical_dict(jep_byte_buffer* data, size_t* pos);
+
+/**
+ * Reads a bitstring that follows a dictionary of code lengths.
+ *
+ * Params:
+ *   jep_byte_buffer - a collection of bytes encoded with Huffman Coding
+ *   size_t - the position in the byte buffer to start reading
+ *
+ * Returns:
+ *   jep_bitstring - a bitstring containing encoded data or NULL on failure
+ */
+static jep_bitstring* read_canonical_data(jep_byte_buffer* data, size_t* pos);
+
+/**
+ * Writes a dictionary of canonical codes to a byte buffer.
+ * Only the length of each code is written. The lengths are written
+ * for every byte value from the lowest symbol to the highest symbol,
+ * using four bits per length if possible or eight bits otherwise.
+ *
+ * Params:
+ *   huff_dict - a dictionary of canonical codes
+ *   jep_byte_buffer - a byte buffer to receive the data
+ */
+static void write_canonical_dict(jep_huff_dict* dict, jep_byte_buffer* bb);
+
+/**
+ * Writes a bitstring that follows a dictionary of code lengths.
+ *
+ * Params:
+ *   jep_bitstring - a bitstring to write
+ *   jep_byte_buffer - a byte buffer to receive the data
+ */
+static void write_canonical_data(jep_bitstring* data, jep_byte_buffer* bb);
+
+/**
+ * Reads the code lengths of a canonical dictionary from an array
+ * of bytes. Bytes that are not in the dictionary have a length of 0.
+ * Returns 0 if the lengths are incomplete or invalid, or if every
+ * length is 0.
+ *
+ * Params:
+ *   jep_byte - an array of bytes beginning with the length width
+ *   size_t - the number of bytes in the array
+ *   jep_byte - an array of UCHAR_MAX + 1 bytes to receive the lengths
+ *
+ * Returns:
+ *   size_t - the number of bytes read or 0 on failure
+ */
+static size_t read_lengths(const jep_byte* src, size_t n, jep_byte* lengths);
+
+/**
+ * Writes the code lengths of a canonical dictionary to an array of
+ * bytes. See write_canonical_dict. At least one length must not be 0.
+ *
+ * Params:
+ *   jep_byte - an array of UCHAR_MAX + 1 code lengths
+ *   jep_byte - an array with room for lengths_size bytes
+ *
+ * Returns:
+ *   size_t - the number of bytes written
+ */
+static size_t write_lengths(const jep_byte* lengths, jep_byte* dest);
+
+/**
+ * Determines the number of bytes written by write_lengths.
+ *
+ * Params:
+ *   jep_byte - an array of UCHAR_MAX + 1 code lengths
+ *
+ * Returns:
+ *   size_t - the number of bytes needed for the lengths
+ */
+static size_t lengths_size(const jep_byte* lengths);
+
 /**
  * Reads bytes from a buffer.
  * Returns the number of bytes successfully read.
@@ -288,1280 +888,7275 @@ static int write_to_buffer(const jep_byte* src,
 
 
 /*-----------------------------------------------------------------*/
-/*                   Public API Implementation                     */
+/*                          Table Encoding                         */
 /*-----------------------------------------------------------------*/
 
-JEP_UTILS_API jep_byte_buffer* JEP_UTILS_CALL
-jep_huff_encode(jep_byte_buffer* raw)
-{
-	jep_byte_buffer* encoded;
-	jep_huff_code* huff;
-	jep_huff_tree* tree;
-	jep_huff_dict* dict;
-	jep_bitstring* data;
+/**
+ * Builds an encoding table from the lengths of canonical codes.
+ * The table has an entry for every possible byte value, so the code
+ * for a byte can be found without searching. Bytes with a length
+ * of 0 have no code.
+ * Returns 1 on success or 0 if the lengths cannot form a prefix code.
+ *
+ * Params:
+ *   jep_byte - an array of UCHAR_MAX + 1 code lengths
+ *   huff_code_entry - an array of UCHAR_MAX + 1 table entries
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+static int build_code_table(const jep_byte* lengths, huff_code_entry* table);
 
-	jep_huff_sym bytes[UCHAR_MAX + 1];
-	uint32_t unique;
-	uint32_t i;
+/**
+ * Reverses the order of the low bits of an integer, so that a canonical
+ * code, whose first bit is the most significant, can be written with
+ * its first bit in the least significant position.
+ *
+ * Params:
+ *   uint64_t - the bits of a code
+ *   uint32_t - the number of bits in the code
+ *
+ * Returns:
+ *   uint64_t - the reversed bits
+ */
+static uint64_t reverse_bits(uint64_t code, uint32_t len);
+
+/**
+ * Encodes an array of bytes using an encoding table.
+ * The destination must have room for every bit of every code,
+ * rounded up to a whole byte.
+ *
+ * Params:
+ *   huff_code_entry - an encoding table
+ *   jep_byte - the bytes to encode
+ *   size_t - the number of bytes to encode
+ *   jep_byte - an array to receive the encoded bits
+ *
+ * Returns:
+ *   size_t - the number of bytes written to the destination
+ */
+static size_t encode_with_table(const huff_code_entry* table,
+	const jep_byte* src,
+	size_t n,
+	jep_byte* dest);
+
+/**
+ * Gathers the bits of a bitstring into an integer with the first bit
+ * in the least significant position.
+ *
+ * Params:
+ *   jep_bitstring - a bitstring of no more than 64 bits
+ *
+ * Returns:
+ *   uint64_t - the bits of the bitstring
+ */
+static uint64_t stream_bits(jep_bitstring* bs);
+
+/**
+ * Adds bits to a bit writer, writing a 32-bit word to memory if
+ * enough bits have been collected.
+ *
+ * Params:
+ *   huff_writer - a bit writer
+ *   uint64_t - the bits to write with the first bit in the LSB
+ *   uint32_t - the number of bits to write, which must not exceed 32
+ */
+static void put_bits(huff_writer* w, uint64_t bits, uint32_t len);
+
+/**
+ * Writes any pending bits of a bit writer to memory.
+ * The last byte is padded with zeros.
+ *
+ * Params:
+ *   huff_writer - a bit writer
+ */
+static void flush_writer(huff_writer* w);
+
+
+
+
+/*-----------------------------------------------------------------*/
+/*                          Table Decoding                         */
+/*-----------------------------------------------------------------*/
+
+/**
+ * Builds a decoding table from a bitcode dictionary.
+ * Each entry of the table is indexed by the next HUFF_TABLE_BITS bits
+ * of the input and holds the symbol and length of the code that
+ * begins with those bits.
+ *
+ * Params:
+ *   huff_dict - a bitcode dictionary
+ *   uint16_t - an array of HUFF_TABLE_SIZE table entries
+ */
+static void build_decode_table(jep_huff_dict* dict, uint16_t* table);
+
+/**
+ * Builds a decoder from the lengths of canonical codes.
+ * No memory is allocated.
+ * Returns 1 on success or 0 if the lengths cannot form a prefix code.
+ *
+ * Params:
+ *   jep_byte - an array of UCHAR_MAX + 1 code lengths
+ *   huff_decoder - a decoder to be built
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+static int build_decoder(const jep_byte* lengths, huff_decoder* dec);
+
+/**
+ * Decodes a series of bits using a decoder.
+ * If the output is fixed, its buffer is never reallocated, and decoding
+ * fails if the decoded bytes do not fit within its capacity. This allows
+ * the output to refer to part of a larger array.
+ * Returns 1 on success or 0 on failure.
+ *
+ * Params:
+ *   huff_decoder - a decoder
+ *   jep_byte - the bytes holding the bits
+ *   size_t - the number of bytes
+ *   uint64_t - the number of bits, which must fit in the bytes
+ *   jep_byte_buffer - a byte buffer to receive the decoded bytes
+ *   int - 1 if the output cannot grow or 0 otherwise
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+static int decode_with_table(const huff_decoder* dec,
+	const jep_byte* src,
+	size_t n,
+	uint64_t bits,
+	jep_byte_buffer* raw,
+	int fixed);
+
+/**
+ * Decodes a number of symbols one at a time.
+ * Codes that are too long to be resolved by the table are decoded
+ * one bit at a time.
+ * Returns 1 on success or 0 if the bits run out or do not form a code.
+ *
+ * Params:
+ *   huff_decoder - a decoder
+ *   huff_reader - a bit reader
+ *   uint64_t - the number of bits left in the data
+ *   jep_byte - an array to receive the decoded bytes
+ *   size_t - the number of symbols to decode
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+static int decode_symbols(const huff_decoder* dec,
+	huff_reader* r,
+	uint64_t* remaining,
+	jep_byte* out,
+	size_t n);
+
+/**
+ * Decodes a series of bits that is known to hold a number of symbols
+ * into an array with room for all of them.
+ * Since the output cannot run out of room, only the input is checked
+ * while decoding.
+ * Returns 1 on success, or 0 if the bits do not hold exactly that
+ * many symbols.
+ *
+ * Params:
+ *   huff_decoder - a decoder
+ *   jep_byte - the bytes holding the bits
+ *   size_t - the number of bytes
+ *   uint64_t - the number of bits, which must fit in the bytes
+ *   jep_byte - an array to receive the decoded bytes
+ *   size_t - the number of symbols
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+static int decode_counted(const huff_decoder* dec,
+	const jep_byte* src,
+	size_t n,
+	uint64_t bits,
+	jep_byte* out,
+	size_t count);
+
+/**
+ * Builds a multi-symbol table from a decoder of canonical codes.
+ * Each entry holds as many codes as fit in its bits, so short codes
+ * are decoded several at a time.
+ *
+ * Params:
+ *   huff_decoder - a decoder
+ *   huff_multi_table - a multi-symbol table to be built
+ */
+static void build_multi_table(const huff_decoder* dec, huff_multi_table* multi);
+
+/**
+ * Fills the entries of a multi-symbol table that begin with a series
+ * of codes, and then those that begin with each longer series.
+ *
+ * Params:
+ *   huff_multi_table - a multi-symbol table
+ *   uint32_t - the codes of up to HUFF_MULTI_BITS bits in order of length,
+ *     each with its bits in the low 16 bits, its length above them,
+ *     and its byte in the high 8 bits
+ *   uint32_t - the number of codes
+ *   uint32_t - the bits of the series
+ *   uint32_t - the number of bits in the series
+ *   uint32_t - the number of codes in the series
+ *   uint32_t - the bytes of the series, the first in the low byte
+ */
+static void fill_multi_entries(huff_multi_table* multi,
+	const uint32_t* codes,
+	uint32_t n,
+	uint32_t prefix,
+	uint32_t used,
+	uint32_t count,
+	uint32_t syms);
+
+/**
+ * Decodes a series of bits that is known to hold a number of symbols,
+ * as decode_counted does, but decodes several symbols with each lookup
+ * of a multi-symbol table.
+ * Returns 1 on success, or 0 if the bits do not hold exactly that
+ * many symbols.
+ *
+ * Params:
+ *   huff_decoder - a decoder
+ *   huff_multi_table - a multi-symbol table built from the decoder
+ *   jep_byte - the bytes holding the bits
+ *   size_t - the number of bytes
+ *   uint64_t - the number of bits, which must fit in the bytes
+ *   jep_byte - an array to receive the decoded bytes
+ *   size_t - the number of symbols
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+static int decode_multi(const huff_decoder* dec,
+	const huff_multi_table* multi,
+	const jep_byte* src,
+	size_t n,
+	uint64_t bits,
+	jep_byte* out,
+	size_t count);
+
+/**
+ * Counts the symbols in data encoded with a dictionary of
+ * canonical codes.
+ * Returns 1 on success or 0 if the data cannot be decoded.
+ *
+ * Params:
+ *   huff_dict - a dictionary of canonical codes
+ *   jep_bitstring - the encoded data
+ *   uint32_t - a pointer to receive the number of symbols
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+static int count_codes(jep_huff_dict* dict, jep_bitstring* data,
+	uint32_t* count);
+
+/**
+ * Fills a bit reader with as many bits as it can hold.
+ * If at least eight bytes of input remain, they are loaded as a
+ * single word. Otherwise, the remaining bytes are loaded one at a time.
+ *
+ * Params:
+ *   huff_reader - a bit reader
+ */
+static void refill_reader(huff_reader* r);
+
+/**
+ * Ensures that a byte buffer can hold at least n more bytes.
+ * Returns 1 on success or 0 on failure.
+ *
+ * Params:
+ *   jep_byte_buffer - a byte buffer
+ *   size_t - the number of additional bytes required
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+static int reserve_bytes(jep_byte_buffer* bb, size_t n);
+
+
+
+
+/*-----------------------------------------------------------------*/
+/*                        Interleaved Streams                      */
+/*-----------------------------------------------------------------*/
+
+/**
+ * Writes a split block to an array of bytes.
+ * The bytes are divided into HUFF_STREAMS consecutive segments, and each
+ * segment is encoded as its own bitstream. The bitstreams are preceded
+ * by the number of bytes and the bit count of each bitstream, which
+ * tells the decoder where every bitstream begins.
+ * The destination must have room for coded_size bytes.
+ * Returns 0 on failure.
+ *
+ * Params:
+ *   jep_byte - an array of UCHAR_MAX + 1 canonical code lengths
+ *   huff_code_entry - an encoding table built from the lengths
+ *   jep_byte - an array of raw bytes
+ *   size_t - the number of raw bytes
+ *   jep_byte - an array to receive the block
+ *
+ * Returns:
+ *   size_t - the number of bytes written or 0 on failure
+ */
+static size_t write_split(const jep_byte* lengths,
+	const huff_code_entry* table,
+	const jep_byte* src,
+	size_t n,
+	jep_byte* dest);
+
+/**
+ * Reads the bitstreams of a split block as a single bitstring.
+ * Since the segments are consecutive, joining their bitstreams
+ * produces the same bits as encoding the whole block at once.
+ *
+ * Params:
+ *   jep_byte_buffer - a collection of encoded bytes
+ *   size_t - the position of the byte count in the buffer
+ *
+ * Returns:
+ *   jep_bitstring - the joined bitstreams or NULL on failure
+ */
+static jep_bitstring* read_split_data(jep_byte_buffer* data, size_t* pos);
+
+/**
+ * Decodes a split block and appends the decoded bytes to a byte buffer.
+ * When every code can be resolved by the decoding table, the
+ * bitstreams are decoded together so that the symbols of one do not
+ * have to wait for the symbols of another.
+ * Returns 1 on success or 0 on failure.
+ *
+ * Params:
+ *   jep_byte_buffer - a byte buffer containing one split block
+ *   jep_byte_buffer - a byte buffer to receive the decoded bytes
+ *   int - 1 if the output cannot grow or 0 otherwise
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+static int decode_split(jep_byte_buffer* encoded,
+	jep_byte_buffer* raw,
+	int fixed);
+
+
+
+
+/*-----------------------------------------------------------------*/
+/*                            Raw Blocks                           */
+/*-----------------------------------------------------------------*/
+
+/**
+ * Writes a stored block to an array of bytes.
+ * A stored block holds the raw bytes as they are, and is written when
+ * Huffman Coding would not make the bytes any smaller.
+ * Returns 0 if the block does not fit.
+ *
+ * Params:
+ *   jep_byte - an array of raw bytes
+ *   size_t - the number of raw bytes, which must fit in 32 bits
+ *   jep_byte - an array to receive the block
+ *   size_t - the capacity of the array
+ *
+ * Returns:
+ *   size_t - the number of bytes written or 0 on failure
+ */
+static size_t write_stored(const jep_byte* src,
+	size_t n,
+	jep_byte* dest,
+	size_t cap);
+
+/**
+ * Writes a run block to an array of bytes.
+ * A run block holds a single byte value and the number of times
+ * it is repeated.
+ * Returns 0 if the block does not fit.
+ *
+ * Params:
+ *   jep_byte - the repeated byte
+ *   size_t - the number of repetitions, which must fit in 32 bits
+ *   jep_byte - an array to receive the block
+ *   size_t - the capacity of the array
+ *
+ * Returns:
+ *   size_t - the number of bytes written or 0 on failure
+ */
+static size_t write_run(jep_byte b, size_t n, jep_byte* dest, size_t cap);
+
+/**
+ * Decodes a stored block or a run block and appends the raw bytes to
+ * a byte buffer.
+ * If the output is fixed, it is never reallocated. See decode_with_table.
+ * Returns 1 on success or 0 on failure.
+ *
+ * Params:
+ *   jep_byte_buffer - a byte buffer containing one stored or run block
+ *   jep_byte_buffer - a byte buffer to receive the decoded bytes
+ *   int - 1 if the output cannot grow or 0 otherwise
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+static int decode_raw(jep_byte_buffer* encoded,
+	jep_byte_buffer* raw,
+	int fixed);
+
+/**
+ * Determines the greatest number of bytes that a block encoded with
+ * canonical codes can occupy, without encoding it.
+ *
+ * Params:
+ *   jep_byte - an array of UCHAR_MAX + 1 code lengths
+ *   uint64_t - the total number of bits of encoded data
+ *   size_t - the number of raw bytes
+ *
+ * Returns:
+ *   uint64_t - the largest possible size of the encoded block
+ */
+static uint64_t coded_size(const jep_byte* lengths, uint64_t bits, size_t n);
+
+
+
+
+/*-----------------------------------------------------------------*/
+/*                            Streaming                            */
+/*-----------------------------------------------------------------*/
+
+/**
+ * Encodes an array of bytes as a single block and appends it to
+ * a byte buffer.
+ * Returns 1 on success or 0 on failure.
+ *
+ * Params:
+ *   jep_byte - an array of raw bytes
+ *   size_t - the number of raw bytes
+ *   uint32_t - the maximum length of a code in bits
+ *   uint32_t - the entropy coder, one of the JEP_HUFF_CODER values
+ *   jep_byte_buffer - a byte buffer to receive the encoded block
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+static int encode_block(const jep_byte* src,
+	size_t n,
+	uint32_t limit,
+	uint32_t coder,
+	jep_byte_buffer* out);
+
+/**
+ * Encodes an array of bytes as a single block in an array of bytes.
+ * Depending on the histogram of the bytes, the block holds canonical
+ * codes, the bytes as they are, or a single repeated byte.
+ * If there are statistics, the histogram is counted into them.
+ * No memory is allocated.
+ * Returns 0 on failure, or if the block may not fit in the destination.
+ * A capacity of jep_huff_compress_bound bytes is always enough.
+ *
+ * Params:
+ *   jep_byte - an array of raw bytes
+ *   size_t - the number of raw bytes
+ *   uint32_t - the maximum length of a code in bits
+ *   jep_byte - an array to receive the block
+ *   size_t - the capacity of the array
+ *   jep_huff_stats - statistics to be counted and timed, or NULL
+ *
+ * Returns:
+ *   size_t - the number of bytes written or 0 on failure
+ */
+static size_t encode_frame(const jep_byte* src,
+	size_t n,
+	uint32_t limit,
+	jep_byte* dest,
+	size_t cap,
+	jep_huff_stats* stats);
+
+/**
+ * Decodes a single block and appends the decoded bytes to
+ * a byte buffer.
+ * If the output is fixed, it is never reallocated. See decode_with_table.
+ * Returns 1 on success or 0 on failure.
+ *
+ * Params:
+ *   jep_byte_buffer - a byte buffer containing one encoded block
+ *   jep_byte_buffer - a byte buffer to receive the decoded bytes
+ *   int - 1 if the output cannot grow or 0 otherwise
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+static int decode_block(jep_byte_buffer* encoded,
+	jep_byte_buffer* raw,
+	int fixed);
+
+/**
+ * Determines the size of an encoded block from as many of its bytes
+ * as are available.
+ * If the available bytes are enough to determine the size of the block,
+ * the size is the total number of bytes in the block. Otherwise, it is
+ * the number of bytes needed to learn more about the block, which is
+ * always greater than the number of bytes available.
+ * Returns 0 if the bytes cannot begin a canonical block.
+ *
+ * Params:
+ *   jep_byte - the available bytes of an encoded block
+ *   size_t - the number of available bytes
+ *   size_t - a pointer to receive the size
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+static int measure_block(const jep_byte* src, size_t n, size_t* size);
+
+/**
+ * Creates a Huffman stream with an empty pending buffer.
+ *
+ * Params:
+ *   size_t - the number of raw bytes per block
+ *
+ * Returns:
+ *   jep_huff_stream - a new Huffman stream or NULL on failure
+ */
+static jep_huff_stream* create_stream(size_t block_size);
+
+
+
+
+/*-----------------------------------------------------------------*/
+/*                              Threads                            */
+/*-----------------------------------------------------------------*/
+
+/**
+ * Performs a task for every index in a range using several threads.
+ * The calling thread acts as one of the workers. If a thread cannot
+ * be started, its work is done by the calling thread instead.
+ * Returns 1 if every task succeeded or 0 otherwise.
+ *
+ * Params:
+ *   int - a task that returns 1 on success or 0 on failure
+ *   void - the data shared by every task
+ *   uint32_t - the number of indices in the range
+ *   uint32_t - the number of threads, or 0 for one per processor
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+static int run_parallel(int (*task)(void*, uint32_t),
+	void* ctx,
+	uint32_t count,
+	uint32_t threads);
+
+/**
+ * Performs the task of a worker for each of its indices.
+ *
+ * Params:
+ *   huff_worker - a worker
+ */
+static void run_worker(huff_worker* w);
+
+/**
+ * Starts a thread for a worker.
+ * Returns 1 on success or 0 on failure.
+ *
+ * Params:
+ *   huff_worker - a worker
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+static int start_worker(huff_worker* w);
+
+/**
+ * Waits for the thread of a worker to finish.
+ *
+ * Params:
+ *   huff_worker - a worker that was started
+ */
+static void join_worker(huff_worker* w);
+
+/**
+ * Determines the number of processors available to run threads.
+ *
+ * Returns:
+ *   uint32_t - the number of processors, which is at least 1
+ */
+static uint32_t count_processors();
+
+
+
+
+/*-----------------------------------------------------------------*/
+/*                            Block Index                          */
+/*-----------------------------------------------------------------*/
+
+/**
+ * Encodes a single block of a block job.
+ * Returns 1 on success or 0 on failure.
+ *
+ * Params:
+ *   void - a block job
+ *   uint32_t - the index of the block
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+static int encode_block_task(void* ctx, uint32_t i);
+
+/**
+ * Writes the header, the index, and the blocks of a block job
+ * to a byte buffer.
+ * Returns 1 on success or 0 on failure.
+ *
+ * Params:
+ *   huff_block_job - a block job whose blocks have been encoded
+ *   uint32_t - the number of blocks
+ *   jep_byte_buffer - a byte buffer to receive the container
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+static int write_index(huff_block_job* job,
+	uint32_t count,
+	jep_byte_buffer* out);
+
+/**
+ * Reads and validates the header of an indexed container.
+ * The offsets of the blocks are validated as they are used.
+ * Returns 1 on success or 0 on failure.
+ *
+ * Params:
+ *   jep_byte_buffer - an indexed container
+ *   huff_index - an index to be populated
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+static int read_index(jep_byte_buffer* encoded, huff_index* index);
+
+/**
+ * Decodes a single block of an index job into its place in the output.
+ * Returns 1 on success or 0 on failure.
+ *
+ * Params:
+ *   void - an index job
+ *   uint32_t - the index of the block
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+static int decode_block_task(void* ctx, uint32_t i);
+
+/**
+ * Prepares a byte buffer that refers to a block of an indexed container
+ * without copying it.
+ * Only the offsets of the requested block are validated, so that a block
+ * can be found without reading the rest of the index.
+ * Returns 1 on success or 0 if the offsets are invalid.
+ *
+ * Params:
+ *   huff_index - the index of a container
+ *   uint32_t - the index of the block
+ *   jep_byte_buffer - a byte buffer to refer to the block
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+static int index_block(huff_index* index, uint32_t i, jep_byte_buffer* block);
+
+/**
+ * Determines the number of raw bytes in a block of an indexed container.
+ *
+ * Params:
+ *   huff_index - the index of a container
+ *   uint32_t - the index of the block
+ *
+ * Returns:
+ *   size_t - the number of raw bytes in the block
+ */
+static size_t index_block_size(huff_index* index, uint32_t i);
+
+/**
+ * Determines whether a byte buffer begins with the header of
+ * an indexed container.
+ *
+ * Params:
+ *   jep_byte_buffer - a byte buffer
+ *
+ * Returns:
+ *   int - 1 if the buffer is an indexed container or 0 otherwise
+ */
+static int is_indexed(jep_byte_buffer* encoded);
+
+/**
+ * Writes an unsigned 64-bit integer as eight bytes with the least
+ * significant byte first.
+ *
+ * Params:
+ *   uint64_t - an unsigned 64-bit integer
+ *   jep_byte - an array of eight bytes
+ */
+static void split_u64(uint64_t n, jep_byte* b);
+
+/**
+ * Reads an unsigned 64-bit integer from eight bytes with the least
+ * significant byte first.
+ *
+ * Params:
+ *   jep_byte - an array of eight bytes
+ *
+ * Returns:
+ *   uint64_t - an unsigned 64-bit integer
+ */
+static uint64_t build_u64(const jep_byte* b);
+
+
+
+
+/*-----------------------------------------------------------------*/
+/*                          Shared Tables                          */
+/*-----------------------------------------------------------------*/
+
+/**
+ * Creates a shared Huffman table from a dictionary of canonical codes.
+ * The dictionary must have a code for every byte value, and no code
+ * may be longer than JEP_HUFF_MAX_CODE_LENGTH.
+ * On success, the table takes ownership of the dictionary.
+ * Returns NULL on failure.
+ *
+ * Params:
+ *   huff_dict - a dictionary of canonical codes
+ *
+ * Returns:
+ *   jep_huff_table - a new Huffman table
+ */
+static jep_huff_table* create_table(jep_huff_dict* dict);
+
+/**
+ * Writes an unsigned integer using seven bits per byte, starting with
+ * the least significant bits. The high bit of each byte is set if
+ * another byte follows.
+ *
+ * Params:
+ *   uint64_t - an unsigned integer
+ *   jep_byte - an array of at least HUFF_VARINT_MAX bytes
+ *
+ * Returns:
+ *   size_t - the number of bytes written
+ */
+static size_t write_varint(uint64_t n, jep_byte* dest);
+
+/**
+ * Reads an unsigned integer that was written by write_varint.
+ * Returns 0 if the integer is incomplete or does not fit
+ * in 64 bits.
+ *
+ * Params:
+ *   jep_byte - an array of bytes
+ *   size_t - the number of bytes in the array
+ *   uint64_t - a reference to receive the integer
+ *
+ * Returns:
+ *   size_t - the number of bytes read or 0 on failure
+ */
+static size_t read_varint(const jep_byte* src, size_t n, uint64_t* value);
+
+
+
+
+/*-----------------------------------------------------------------*/
+/*                         Context Modeling                        */
+/*-----------------------------------------------------------------*/
+
+/**
+ * Encodes an array of bytes as a single block, using a context model
+ * if it makes the block smaller than encode_frame would.
+ * Returns 0 on failure, or if the block may not fit in the destination.
+ * A capacity of jep_huff_compress_bound bytes is always enough.
+ *
+ * Params:
+ *   jep_byte - an array of raw bytes
+ *   size_t - the number of raw bytes
+ *   huff_context_model - a context model to be built
+ *   jep_byte - an array to receive the block
+ *   size_t - the capacity of the array
+ *
+ * Returns:
+ *   size_t - the number of bytes written or 0 on failure
+ */
+static size_t encode_context(const jep_byte* src,
+	size_t n,
+	huff_context_model* model,
+	jep_byte* dest,
+	size_t cap);
+
+/**
+ * Builds a context model from the pairs of bytes in an array.
+ * The previous bytes that occur most often each begin a table, and
+ * every previous byte is then repeatedly assigned to the table that
+ * encodes the bytes after it in the fewest bits. The first byte
+ * is preceded by 0.
+ * Returns 0 on failure.
+ *
+ * Params:
+ *   jep_byte - an array of raw bytes
+ *   size_t - the number of raw bytes, which must fit in 32 bits
+ *   huff_context_model - a context model to be built
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+static int build_context_model(const jep_byte* src,
+	size_t n,
+	huff_context_model* model);
+
+/**
+ * Determines the number of bits used to write the table of a previous
+ * byte in the map of a context block.
+ *
+ * Params:
+ *   uint32_t - the number of tables
+ *
+ * Returns:
+ *   uint32_t - the number of bits per map entry
+ */
+static uint32_t context_map_bits(uint32_t count);
+
+/**
+ * Determines the size of a context block without encoding it.
+ *
+ * Params:
+ *   huff_context_model - a context model
+ *
+ * Returns:
+ *   uint64_t - the size of the block
+ */
+static uint64_t context_size(const huff_context_model* model);
+
+/**
+ * Writes a context block to an array of bytes.
+ * The block holds the number of tables, the map of previous bytes to
+ * tables, the code lengths of each table, the byte and bit counts,
+ * and then the bits.
+ * The destination must have room for context_size bytes.
+ *
+ * Params:
+ *   huff_context_model - a context model built from the bytes
+ *   jep_byte - an array of raw bytes
+ *   size_t - the number of raw bytes
+ *   jep_byte - an array to receive the block
+ *
+ * Returns:
+ *   size_t - the number of bytes written
+ */
+static size_t write_context(const huff_context_model* model,
+	const jep_byte* src,
+	size_t n,
+	jep_byte* dest);
+
+/**
+ * Decodes a context block and appends the decoded bytes to
+ * a byte buffer.
+ * The decoder of each table is built on the stack, and the table
+ * for each byte is found from the byte before it.
+ * If the output is fixed, it is never reallocated. See decode_with_table.
+ * Returns 1 on success or 0 on failure.
+ *
+ * Params:
+ *   jep_byte_buffer - a byte buffer containing one context block
+ *   jep_byte_buffer - a byte buffer to receive the decoded bytes
+ *   int - 1 if the output cannot grow or 0 otherwise
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+static int decode_context(jep_byte_buffer* encoded,
+	jep_byte_buffer* raw,
+	int fixed);
+
+/**
+ * Determines the size of a context block from as many of its bytes
+ * as are available. See measure_block.
+ *
+ * Params:
+ *   jep_byte - the available bytes of a context block
+ *   size_t - the number of available bytes
+ *   size_t - a pointer to receive the size
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+static int measure_context(const jep_byte* src, size_t n, size_t* size);
+
+
+
+
+/*-----------------------------------------------------------------*/
+/*                            ANS Blocks                           */
+/*-----------------------------------------------------------------*/
+
+/**
+ * Encodes an array of bytes as an ANS block in an array of bytes.
+ * An ANS block holds the size of an ANS frame followed by the frame.
+ * Like encode_frame, empty input is written as a stored block,
+ * a single repeated byte as a run block, and bytes that the frame
+ * would not shrink as a stored block.
+ * Returns 0 on failure, or if the block may not fit in the destination.
+ * A capacity of jep_huff_compress_bound bytes is always enough.
+ *
+ * Params:
+ *   jep_byte - an array of raw bytes
+ *   size_t - the number of raw bytes
+ *   jep_byte - an array to receive the block
+ *   size_t - the capacity of the array
+ *
+ * Returns:
+ *   size_t - the number of bytes written or 0 on failure
+ */
+static size_t write_ans(const jep_byte* src,
+	size_t n,
+	jep_byte* dest,
+	size_t cap);
+
+/**
+ * Decodes an ANS block and appends the raw bytes to a byte buffer.
+ * If the output is fixed, it is never reallocated. See decode_with_table.
+ * Returns 1 on success or 0 on failure.
+ *
+ * Params:
+ *   jep_byte_buffer - a byte buffer containing one ANS block
+ *   jep_byte_buffer - a byte buffer to receive the decoded bytes
+ *   int - 1 if the output cannot grow or 0 otherwise
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+static int decode_ans(jep_byte_buffer* encoded,
+	jep_byte_buffer* raw,
+	int fixed);
+
+
+
+
+/*-----------------------------------------------------------------*/
+/*                            Checksums                            */
+/*-----------------------------------------------------------------*/
+
+/**
+ * Encodes an array of bytes as a block wrapped in a checked block and
+ * appends it to a byte buffer.
+ * A checked block holds the size of the block inside it and the
+ * CRC-32C of that block's bytes, so that damage is found before
+ * anything is decoded.
+ * Returns 1 on success or 0 on failure.
+ *
+ * Params:
+ *   jep_byte - an array of raw bytes
+ *   size_t - the number of raw bytes
+ *   uint32_t - the maximum length of a code in bits
+ *   uint32_t - the entropy coder of the block
+ *   jep_byte_buffer - a byte buffer to receive the block
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+static int write_checked(const jep_byte* src,
+	size_t n,
+	uint32_t limit,
+	uint32_t coder,
+	jep_byte_buffer* out);
+
+/**
+ * Verifies the checksum of a checked block and then decodes the block
+ * inside it, appending the decoded bytes to a byte buffer.
+ * Checked blocks cannot be nested.
+ * If the output is fixed, it is never reallocated. See decode_with_table.
+ * Returns 1 on success or 0 on failure.
+ *
+ * Params:
+ *   jep_byte_buffer - a byte buffer containing one checked block
+ *   jep_byte_buffer - a byte buffer to receive the decoded bytes
+ *   int - 1 if the output cannot grow or 0 otherwise
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+static int decode_checked(jep_byte_buffer* encoded,
+	jep_byte_buffer* raw,
+	int fixed);
+
+/**
+ * Encodes one block of a Huffman stream and appends it to a byte
+ * buffer, with a checksum if the stream asks for one.
+ * Returns 1 on success or 0 on failure.
+ *
+ * Params:
+ *   jep_huff_stream - a Huffman stream created for encoding
+ *   jep_byte - an array of raw bytes
+ *   size_t - the number of raw bytes
+ *   jep_byte_buffer - a byte buffer to receive the block
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+static int encode_stream_block(jep_huff_stream* stream,
+	const jep_byte* src,
+	size_t n,
+	jep_byte_buffer* out);
+
+
+
+
+/*-----------------------------------------------------------------*/
+/*                        Incremental Decoding                     */
+/*-----------------------------------------------------------------*/
+
+/**
+ * Determines the size of the header of a block that can be decoded
+ * as it arrives: a coded block with a byte count, a split block,
+ * or a stored block.
+ * Returns 0 if the block is of any other kind, or if its header is
+ * not yet available.
+ *
+ * Params:
+ *   jep_byte - the available bytes of a block
+ *   size_t - the number of available bytes
+ *
+ * Returns:
+ *   size_t - the size of the header or 0
+ */
+static size_t partial_header(const jep_byte* src, size_t n);
+
+/**
+ * Begins decoding a block as it arrives from its complete header.
+ * Returns 0 if the header is damaged.
+ *
+ * Params:
+ *   huff_partial - a partial block that is not active
+ *   jep_byte - the header of a block
+ *   size_t - the size of the header
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+static int begin_partial(huff_partial* p, const jep_byte* src, size_t n);
+
+/**
+ * Decodes the bytes of a partial block as they arrive, appending
+ * every byte that can be decoded to a byte buffer.
+ * Bytes after the end of the block are not used.
+ * Returns 0 if the block is damaged.
+ *
+ * Params:
+ *   huff_partial - an active partial block
+ *   jep_byte - an array of encoded bytes
+ *   size_t - the number of encoded bytes
+ *   jep_byte_buffer - a byte buffer to receive the decoded bytes
+ *   size_t - a pointer to receive the number of bytes used
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+static int continue_partial(huff_partial* p,
+	const jep_byte* src,
+	size_t n,
+	jep_byte_buffer* out,
+	size_t* used);
+
+/**
+ * Moves a partial block on to its next bitstream, or finishes the
+ * block after its last one.
+ *
+ * Params:
+ *   huff_partial - an active partial block
+ */
+static void next_partial_stream(huff_partial* p);
+
+
+
+
+/*-----------------------------------------------------------------*/
+/*                               Files                             */
+/*-----------------------------------------------------------------*/
+
+/**
+ * Maps a file into memory to be read once from start to end.
+ * Returns 1 on success or 0 if the file cannot be opened or mapped.
+ *
+ * Params:
+ *   char - the path of the file
+ *   huff_mapped_file - a mapped file to be filled
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+static int map_file(const char* path, huff_mapped_file* map);
+
+/**
+ * Unmaps and closes a mapped file.
+ *
+ * Params:
+ *   huff_mapped_file - a mapped file
+ */
+static void unmap_file(huff_mapped_file* map);
+
+/**
+ * Creates a file to be written, or empties it if it already exists.
+ * Fails if it is the same file as a mapped file, since emptying it
+ * would remove the bytes that are being read.
+ *
+ * Params:
+ *   char - the path of the file
+ *   huff_mapped_file - the mapped input
+ *   huff_file - a pointer to receive the open file
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+static int create_file(const char* path,
+	const huff_mapped_file* input,
+	huff_file* file);
+
+/**
+ * Writes every byte of an array to a file.
+ *
+ * Params:
+ *   huff_file - an open file
+ *   jep_byte - an array of bytes
+ *   size_t - the number of bytes
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+static int write_file(huff_file file, const jep_byte* src, size_t n);
+
+/**
+ * Closes a file that was created, and removes it unless it is kept.
+ * Bytes that are still being written can fail when the file is closed,
+ * so a file that does not close cleanly is removed as well.
+ *
+ * Params:
+ *   huff_file - an open file
+ *   char - the path of the file
+ *   int - 1 to keep the file or 0 to remove it
+ *
+ * Returns:
+ *   int - 1 if the file is kept or 0 if it is removed
+ */
+static int close_file(huff_file file, const char* path, int keep);
+
+/**
+ * Decodes a complete block into a file. Decoded bytes are collected in
+ * a byte buffer and written whenever it holds HUFF_FILE_CHUNK bytes.
+ * Run, stored, and coded blocks that decode to more than that are
+ * decoded a piece at a time, so the buffer never holds much more than
+ * one batch no matter how many bytes a block claims to hold.
+ * Returns 0 if the block is damaged or cannot be written.
+ *
+ * Params:
+ *   jep_byte_buffer - a complete block
+ *   huff_partial - a partial block that is not active
+ *   jep_byte_buffer - a byte buffer of bytes that are not yet written
+ *   huff_file - the file to receive the decoded bytes
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+static int decode_file_block(jep_byte_buffer* block,
+	huff_partial* partial,
+	jep_byte_buffer* out,
+	huff_file file);
+
+
+
+
+/*-----------------------------------------------------------------*/
+/*                            Statistics                           */
+/*-----------------------------------------------------------------*/
+
+/**
+ * Fills the histogram and the entropy of statistics from the raw bytes.
+ * Returns 1 on success or 0 on failure.
+ *
+ * Params:
+ *   jep_byte - an array of raw bytes
+ *   size_t - the number of raw bytes
+ *   jep_huff_stats - the statistics to be filled
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+static int count_stats(const jep_byte* src, size_t n, jep_huff_stats* stats);
+
+/**
+ * Fills the number of raw bytes and the entropy of statistics
+ * whose histogram is already filled.
+ *
+ * Params:
+ *   size_t - the number of raw bytes
+ *   jep_huff_stats - the statistics to be filled
+ */
+static void entropy_stats(size_t n, jep_huff_stats* stats);
+
+/**
+ * Fills the code lengths and the header and payload sizes of
+ * statistics from an encoded block.
+ * The number of raw bytes must already be filled.
+ *
+ * Params:
+ *   jep_byte - an encoded block
+ *   size_t - the size of the block
+ *   jep_huff_stats - the statistics to be filled
+ */
+static void block_stats(const jep_byte* src, size_t n, jep_huff_stats* stats);
+
+#ifdef JEP_HUFF_STATS
+/**
+ * Reads a monotonic clock.
+ *
+ * Returns:
+ *   uint64_t - the time in nanoseconds since an arbitrary point
+ */
+static uint64_t huff_clock();
+#endif
+
+
+
+
+/*-----------------------------------------------------------------*/
+/*                   Public API Implementation                     */
+/*-----------------------------------------------------------------*/
+
+JEP_UTILS_API jep_byte_buffer* JEP_UTILS_CALL
+jep_huff_encode(jep_byte_buffer* raw)
+{
+	return jep_huff_encode_limited(raw, JEP_HUFF_DEFAULT_CODE_LENGTH);
+}
+
+JEP_UTILS_API jep_byte_buffer* JEP_UTILS_CALL
+jep_huff_encode_limited(jep_byte_buffer* raw, uint32_t limit)
+{
+	jep_byte_buffer* encoded;
+
+	if (raw == NULL)
+		return NULL;
+
+	encoded = jep_create_byte_buffer();
+
+	if (encoded == NULL)
+		return NULL;
+
+	if (!encode_block(raw->buffer, raw->size, limit,
+		JEP_HUFF_CODER_HUFFMAN, encoded))
+	{
+		jep_destroy_byte_buffer(encoded);
+		return NULL;
+	}
+
+	return encoded;
+}
+
+JEP_UTILS_API jep_byte_buffer* JEP_UTILS_CALL
+jep_huff_decode(jep_byte_buffer* encoded)
+{
+	jep_byte_buffer* raw;
+
+	if (encoded == NULL)
+		return NULL;
+
+	// Indexed containers are decoded one block at a time.
+	if (is_indexed(encoded))
+		return jep_huff_decode_blocks(encoded, 1);
+
+	raw = jep_create_byte_buffer();
+
+	if (raw == NULL)
+		return NULL;
+
+	if (!decode_block(encoded, raw, 0))
+	{
+		jep_destroy_byte_buffer(raw);
+		return NULL;
+	}
+
+	return raw;
+}
+
+JEP_UTILS_API size_t JEP_UTILS_CALL
+jep_huff_compress_bound(size_t n)
+{
+	// A block is never larger than the bytes it would store.
+	if (n > UINT32_MAX || n > SIZE_MAX - huff_stored_header)
+		return 0;
+
+	return huff_stored_header + n;
+}
+
+JEP_UTILS_API int JEP_UTILS_CALL
+jep_huff_encode_to(const jep_byte* src, size_t n, jep_byte* dest, size_t cap,
+	size_t* size)
+{
+	size_t written;
+
+	if (dest == NULL || size == NULL)
+		return 0;
+
+	written = encode_frame(src, n, JEP_HUFF_DEFAULT_CODE_LENGTH, dest, cap,
+		NULL);
+
+	if (written == 0)
+		return 0;
+
+	*size = written;
+
+	return 1;
+}
+
+JEP_UTILS_API int JEP_UTILS_CALL
+jep_huff_decode_to(const jep_byte* src, size_t n, jep_byte* dest, size_t cap,
+	size_t* size)
+{
+	jep_byte_buffer encoded; // A view of the encoded bytes
+	jep_byte_buffer raw;     // A view of the destination
+	huff_index index;        // The index of a container
+	huff_index_job job;      // The blocks of a container
+	uint32_t i;              // Index
+
+	if (src == NULL || size == NULL || (dest == NULL && cap > 0))
+		return 0;
+
+	encoded.buffer = (jep_byte*)src;
+	encoded.size = n;
+	encoded.cap = n;
+
+	raw.buffer = dest;
+	raw.size = 0;
+	raw.cap = cap;
+
+	// The blocks of a container are decoded one after another
+	// directly into their places.
+	if (is_indexed(&encoded))
+	{
+		if (!read_index(&encoded, &index) || index.raw_size > cap)
+			return 0;
+
+		job.index = &index;
+		job.dest = dest;
+
+		for (i = 0; i < index.count; i++)
+		{
+			if (!decode_block_task(&job, i))
+				return 0;
+		}
+
+		*size = (size_t)index.raw_size;
+		return 1;
+	}
+
+	if (!decode_block(&encoded, &raw, 1))
+		return 0;
+
+	*size = raw.size;
+
+	return 1;
+}
+
+JEP_UTILS_API jep_byte_buffer* JEP_UTILS_CALL
+jep_huff_encode_context(jep_byte_buffer* raw)
+{
+	huff_context_model* model;
+	jep_byte_buffer* encoded;
+	size_t bound;
+	size_t size;
+
+	if (raw == NULL)
+		return NULL;
+
+	bound = jep_huff_compress_bound(raw->size);
+
+	if (bound == 0)
+		return NULL;
+
+	model = jep_alloc(huff_context_model, 1);
+	encoded = jep_create_byte_buffer();
+
+	if (model == NULL || encoded == NULL || !reserve_bytes(encoded, bound))
+	{
+		free(model);
+		jep_destroy_byte_buffer(encoded);
+		return NULL;
+	}
+
+	size = encode_context(raw->buffer, raw->size, model, encoded->buffer,
+		encoded->cap);
+
+	free(model);
+
+	if (size == 0)
+	{
+		jep_destroy_byte_buffer(encoded);
+		return NULL;
+	}
+
+	encoded->size = size;
+
+	return encoded;
+}
+
+JEP_UTILS_API jep_byte_buffer* JEP_UTILS_CALL
+jep_huff_encode_ans(jep_byte_buffer* raw)
+{
+	jep_byte_buffer* encoded;
+
+	if (raw == NULL)
+		return NULL;
+
+	encoded = jep_create_byte_buffer();
+
+	if (encoded == NULL)
+		return NULL;
+
+	if (!encode_block(raw->buffer, raw->size, JEP_HUFF_DEFAULT_CODE_LENGTH,
+		JEP_HUFF_CODER_ANS, encoded))
+	{
+		jep_destroy_byte_buffer(encoded);
+		return NULL;
+	}
+
+	return encoded;
+}
+
+JEP_UTILS_API jep_byte_buffer* JEP_UTILS_CALL
+jep_huff_encode_checked(jep_byte_buffer* raw)
+{
+	jep_byte_buffer* encoded;
+
+	if (raw == NULL)
+		return NULL;
+
+	encoded = jep_create_byte_buffer();
+
+	if (encoded == NULL)
+		return NULL;
+
+	if (!write_checked(raw->buffer, raw->size, JEP_HUFF_DEFAULT_CODE_LENGTH,
+		JEP_HUFF_CODER_HUFFMAN, encoded))
+	{
+		jep_destroy_byte_buffer(encoded);
+		return NULL;
+	}
+
+	return encoded;
+}
+
+JEP_UTILS_API jep_byte_buffer* JEP_UTILS_CALL
+jep_huff_encode_blocks(jep_byte_buffer* raw,
+	size_t block_size,
+	uint32_t threads)
+{
+	jep_byte_buffer* encoded; // The indexed container
+	huff_block_job job;       // The blocks to be encoded
+	size_t count;             // The number of blocks
+	size_t i;                 // Index
+	int res;                  // The result of encoding the blocks
+
+	if (raw == NULL)
+		return NULL;
+
+	if (block_size == 0)
+		block_size = JEP_HUFF_DEFAULT_BLOCK_SIZE;
+
+	count = raw->size / block_size + (raw->size % block_size ? 1 : 0);
+
+	if (block_size > UINT32_MAX || count > UINT32_MAX)
+		return NULL;
+
+	job.src = raw->buffer;
+	job.size = raw->size;
+	job.block_size = block_size;
+	job.limit = JEP_HUFF_DEFAULT_CODE_LENGTH;
+	job.coder = JEP_HUFF_CODER_HUFFMAN;
+	job.blocks = jep_alloc(jep_byte_buffer*, count + 1);
+
+	if (job.blocks == NULL)
+		return NULL;
+
+	for (i = 0; i < count; i++)
+		job.blocks[i] = NULL;
+
+	// Every block has its own dictionary,
+	// so the blocks can be encoded in any order.
+	res = run_parallel(encode_block_task, &job, (uint32_t)count, threads);
+
+	encoded = res ? jep_create_byte_buffer() : NULL;
+
+	if (encoded != NULL && !write_index(&job, (uint32_t)count, encoded))
+	{
+		jep_destroy_byte_buffer(encoded);
+		encoded = NULL;
+	}
+
+	for (i = 0; i < count; i++)
+		jep_destroy_byte_buffer(job.blocks[i]);
+
+	free(job.blocks);
+
+	return encoded;
+}
+
+JEP_UTILS_API jep_byte_buffer* JEP_UTILS_CALL
+jep_huff_decode_blocks(jep_byte_buffer* encoded, uint32_t threads)
+{
+	jep_byte_buffer* raw; // The decoded data
+	huff_index index;     // The index of the container
+	huff_index_job job;   // The blocks to be decoded
+
+	if (encoded == NULL || !read_index(encoded, &index))
+		return NULL;
+
+	if (index.raw_size > SIZE_MAX)
+		return NULL;
+
+	raw = jep_create_byte_buffer();
+
+	if (raw == NULL)
+		return NULL;
+
+	if (!reserve_bytes(raw, (size_t)index.raw_size))
+	{
+		jep_destroy_byte_buffer(raw);
+		return NULL;
+	}
+
+	// The size of every block is known in advance,
+	// so each one is decoded directly into its place.
+	job.index = &index;
+	job.dest = raw->buffer;
+
+	if (!run_parallel(decode_block_task, &job, index.count, threads))
+	{
+		jep_destroy_byte_buffer(raw);
+		return NULL;
+	}
+
+	raw->size = (size_t)index.raw_size;
+
+	return raw;
+}
+
+JEP_UTILS_API jep_byte_buffer* JEP_UTILS_CALL
+jep_huff_decode_at(jep_byte_buffer* encoded, size_t offset, size_t* start)
+{
+	jep_byte_buffer* raw;  // The decoded block
+	jep_byte_buffer block; // A view of the encoded block
+	huff_index index;      // The index of the container
+	uint32_t i;            // The index of the block
+
+	if (encoded == NULL || !read_index(encoded, &index))
+		return NULL;
+
+	if (offset >= index.raw_size)
+		return NULL;
+
+	i = (uint32_t)(offset / index.block_size);
+
+	if (!index_block(&index, i, &block))
+		return NULL;
+
+	raw = jep_create_byte_buffer();
+
+	if (raw == NULL)
+		return NULL;
+
+	if (!decode_block(&block, raw, 0)
+		|| raw->size != index_block_size(&index, i))
+	{
+		jep_destroy_byte_buffer(raw);
+		return NULL;
+	}
+
+	if (start != NULL)
+		*start = (size_t)i * index.block_size;
+
+	return raw;
+}
+
+JEP_UTILS_API jep_byte_buffer* JEP_UTILS_CALL
+jep_huff_encode_stats(jep_byte_buffer* raw, jep_huff_stats* stats)
+{
+	jep_byte_buffer* encoded;
+	size_t bound;
+	size_t size;
+
+	if (raw == NULL || stats == NULL)
+		return NULL;
+
+	memset(stats, 0, sizeof(jep_huff_stats));
+	bound = jep_huff_compress_bound(raw->size);
+	encoded = jep_create_byte_buffer();
+
+	if (bound == 0 || encoded == NULL || !reserve_bytes(encoded, bound))
+	{
+		jep_destroy_byte_buffer(encoded);
+		return NULL;
+	}
+
+	// The histogram is counted and timed while the block is encoded.
+	size = encode_frame(raw->buffer, raw->size, JEP_HUFF_DEFAULT_CODE_LENGTH,
+		encoded->buffer, encoded->cap, stats);
+
+	if (size == 0)
+	{
+		jep_destroy_byte_buffer(encoded);
+		return NULL;
+	}
+
+	encoded->size = size;
+	entropy_stats(raw->size, stats);
+	block_stats(encoded->buffer, encoded->size, stats);
+
+	return encoded;
+}
+
+JEP_UTILS_API jep_byte_buffer* JEP_UTILS_CALL
+jep_huff_decode_stats(jep_byte_buffer* encoded, jep_huff_stats* stats)
+{
+	jep_byte_buffer* raw;
+	huff_timer(timer);
+
+	if (encoded == NULL || stats == NULL)
+		return NULL;
+
+	memset(stats, 0, sizeof(jep_huff_stats));
+	huff_timer_start(stats, timer);
+
+	raw = jep_huff_decode(encoded);
+
+	huff_timer_lap(stats, decode_ns, timer);
+
+	if (raw == NULL || !count_stats(raw->buffer, raw->size, stats))
+	{
+		jep_destroy_byte_buffer(raw);
+		return NULL;
+	}
+
+	block_stats(encoded->buffer, encoded->size, stats);
+
+	return raw;
+}
+
+JEP_UTILS_API jep_huff_code* JEP_UTILS_CALL
+jep_huff_read(jep_byte_buffer* raw)
+{
+	jep_huff_tree* tree;
+	jep_huff_dict* dict;
+	jep_bitstring* bs;
+	jep_huff_code* hc;
+
+	jep_byte header[3];
+	jep_byte u32buff[4];
+
+	size_t pos = 0;
+
+	if (raw == NULL)
+		return NULL;
+
+	// Data written with canonical codes begins with a header.
+	// Anything else is expected to be the original format,
+	// which begins with the dict_begin metadata.
+	if (raw->size > 0 && raw->buffer[0] == huff_magic)
+	{
+		if (read_from_buffer(header, raw, 3, &pos) != 3
+			|| !known_version(header[1])
+			|| (header[2] != huff_type_code && header[2] != huff_type_split))
+		{
+			return NULL;
+		}
+
+		dict = read_canonical_dict(raw, &pos);
+
+		if (dict == NULL)
+			return NULL;
+
+		// The byte count of a coded block is implied by the data.
+		if (header[2] == huff_type_split)
+			bs = read_split_data(raw, &pos);
+		else if (header[1] == huff_version_unsized
+			|| read_from_buffer(u32buff, raw, 4, &pos) == 4)
+			bs = read_canonical_data(raw, &pos);
+		else
+			bs = NULL;
+	}
+	else
+	{
+		// Read the dictionary.
+		dict = read_huff_dict(raw, &pos);
+
+		if (dict == NULL)
+			return NULL;
+
+		// Read the data
+		bs = read_huff_data(raw, &pos);
+	}
+
+	if (bs == NULL)
+	{
+		destroy_dict(dict);
+		return NULL;
+	}
+
+	// Reconstruct a Huffman tree
+	tree = reconstruct_tree(dict);
+
+	if (tree == NULL)
+	{
+		destroy_dict(dict);
+		jep_destroy_bitstring(bs);
+		return NULL;
+	}
+
+	// Create and populate the Huffman Coding context
+	hc = create_huff_code();
+
+	if (hc == NULL)
+	{
+		destroy_dict(dict);
+		jep_destroy_bitstring(bs);
+		destroy_tree(tree);
+		return NULL;
+	}
+
+	hc->tree = tree;
+	hc->dict = dict;
+	hc->data = bs;
+
+	return hc;
+}
+
+JEP_UTILS_API int JEP_UTILS_CALL
+jep_huff_write(jep_huff_code* hc, jep_byte_buffer* buffer)
+{
+	jep_byte u32buff[4];
+	uint32_t count;
+
+	if (hc == NULL || buffer == NULL)
+		return 0;
+
+	if (hc->dict == NULL || hc->data == NULL)
+		return 0;
+
+	// Codes that were not assigned canonically can only be
+	// described by writing out every bit of every code.
+	if (!is_canonical(hc->dict))
+	{
+		write_huff_dict(hc->dict, buffer);
+		write_huff_data(hc->data, buffer);
+		return 1;
+	}
+
+	// The number of bytes that the data decodes to
+	// is written ahead of the data.
+	if (!count_codes(hc->dict, hc->data, &count))
+		return 0;
+
+	jep_split_u32(count, u32buff);
+
+	if (!jep_append_byte(buffer, huff_magic)
+		|| !jep_append_byte(buffer, huff_version)
+		|| !jep_append_byte(buffer, huff_type_code))
+	{
+		return 0;
+	}
+
+	write_canonical_dict(hc->dict, buffer);
+
+	if (!jep_append_bytes(buffer, u32buff, 4))
+		return 0;
+
+	write_canonical_data(hc->data, buffer);
+
+	return 1;
+}
+
+JEP_UTILS_API void JEP_UTILS_CALL
+jep_destroy_huff_code(jep_huff_code* hc)
+{
+	if (hc == NULL)
+		return;
+
+	destroy_dict(hc->dict);
+	destroy_tree(hc->tree);
+	jep_destroy_bitstring(hc->data);
+
+	free(hc);
+}
+
+JEP_UTILS_API jep_huff_stream* JEP_UTILS_CALL
+jep_huff_encode_init(size_t block_size)
+{
+	return create_stream(block_size > 0 ? block_size
+		: JEP_HUFF_DEFAULT_BLOCK_SIZE);
+}
+
+JEP_UTILS_API int JEP_UTILS_CALL
+jep_huff_encode_update(jep_huff_stream* stream, const jep_byte* src, size_t n,
+	jep_byte_buffer* out)
+{
+	jep_byte_buffer* pending; // Raw bytes that do not yet fill a block
+	size_t take;              // The number of bytes to add to the block
+
+	if (stream == NULL || out == NULL || (src == NULL && n > 0))
+		return 0;
+
+	pending = stream->pending;
+
+	while (n > 0)
+	{
+		// Whole blocks are encoded directly from the input
+		// rather than being copied first.
+		if (pending->size == 0 && n >= stream->block_size)
+		{
+			if (!encode_stream_block(stream, src, stream->block_size, out))
+				return 0;
+
+			src += stream->block_size;
+			n -= stream->block_size;
+			continue;
+		}
+
+		take = stream->block_size - pending->size;
+
+		if (take > n)
+			take = n;
+
+		if (!reserve_bytes(pending, take))
+			return 0;
+
+		memcpy(pending->buffer + pending->size, src, take);
+		pending->size += take;
+		src += take;
+		n -= take;
+
+		if (pending->size == stream->block_size)
+		{
+			if (!encode_stream_block(stream, pending->buffer,
+				pending->size, out))
+			{
+				return 0;
+			}
+
+			pending->size = 0;
+		}
+	}
+
+	return 1;
+}
+
+JEP_UTILS_API int JEP_UTILS_CALL
+jep_huff_encode_finish(jep_huff_stream* stream, jep_byte_buffer* out)
+{
+	jep_byte_buffer* pending; // Raw bytes that do not yet fill a block
+
+	if (stream == NULL || out == NULL)
+		return 0;
+
+	pending = stream->pending;
+
+	if (pending->size > 0)
+	{
+		if (!encode_stream_block(stream, pending->buffer, pending->size,
+			out))
+		{
+			return 0;
+		}
+
+		pending->size = 0;
+	}
+
+	return 1;
+}
+
+JEP_UTILS_API int JEP_UTILS_CALL
+jep_huff_encode_select(jep_huff_stream* stream, uint32_t coder)
+{
+	if (stream == NULL || (coder != JEP_HUFF_CODER_HUFFMAN
+		&& coder != JEP_HUFF_CODER_ANS))
+	{
+		return 0;
+	}
+
+	stream->coder = coder;
+
+	return 1;
+}
+
+JEP_UTILS_API int JEP_UTILS_CALL
+jep_huff_encode_checksum(jep_huff_stream* stream, int checked)
+{
+	if (stream == NULL)
+		return 0;
+
+	stream->checked = checked ? 1 : 0;
+
+	return 1;
+}
+
+JEP_UTILS_API jep_huff_stream* JEP_UTILS_CALL
+jep_huff_decode_init()
+{
+	return create_stream(0);
+}
+
+JEP_UTILS_API int JEP_UTILS_CALL
+jep_huff_decode_update(jep_huff_stream* stream, const jep_byte* src, size_t n,
+	jep_byte_buffer* out)
+{
+	jep_byte_buffer* pending; // Encoded bytes of an incomplete block
+	jep_byte_buffer block;    // A view of one complete block
+	huff_partial* partial;    // A block decoded as it arrives
+	size_t size;              // The size of the current block
+	size_t take;              // The number of bytes to add to the block
+
+	if (stream == NULL || out == NULL || (src == NULL && n > 0))
+		return 0;
+
+	pending = stream->pending;
+	partial = (huff_partial*)stream->partial;
+
+	while (n > 0)
+	{
+		if (partial != NULL && partial->active)
+		{
+			if (!continue_partial(partial, src, n, out, &take))
+				return 0;
+
+			src += take;
+			n -= take;
+			continue;
+		}
+
+		// Blocks that arrive whole are decoded directly from
+		// the input rather than being copied first.
+		if (pending->size == 0)
+		{
+			if (!measure_block(src, n, &size))
+				return 0;
+
+			if (size <= n)
+			{
+				block.buffer = (jep_byte*)src;
+				block.size = block.cap = size;
+
+				if (!decode_block(&block, out, 0))
+					return 0;
+
+				src += size;
+				n -= size;
+				continue;
+			}
+		}
+
+		// Otherwise, collect the block a piece at a time.
+		// Its size is only known once enough of it has been seen.
+		if (!measure_block(pending->buffer, pending->size, &size))
+			return 0;
+
+		take = size - pending->size;
+
+		if (take > n)
+			take = n;
+
+		if (!reserve_bytes(pending, take))
+			return 0;
+
+		memcpy(pending->buffer + pending->size, src, take);
+		pending->size += take;
+		src += take;
+		n -= take;
+
+		if (!measure_block(pending->buffer, pending->size, &size))
+			return 0;
+
+		if (size <= pending->size)
+		{
+			if (!decode_block(pending, out, 0))
+				return 0;
+
+			pending->size = 0;
+			continue;
+		}
+
+		// Once the header of a block that can be decoded as it
+		// arrives is complete, the rest of it is not collected.
+		if (partial_header(pending->buffer, pending->size) != pending->size)
+			continue;
+
+		if (partial == NULL)
+		{
+			partial = jep_alloc(huff_partial, 1);
+
+			if (partial == NULL)
+				return 0;
+
+			stream->partial = partial;
+		}
+
+		if (!begin_partial(partial, pending->buffer, pending->size))
+			return 0;
+
+		pending->size = 0;
+	}
+
+	return 1;
+}
+
+JEP_UTILS_API int JEP_UTILS_CALL
+jep_huff_decode_finish(jep_huff_stream* stream)
+{
+	int complete; // Whether the last block was complete
+
+	if (stream == NULL)
+		return 0;
+
+	complete = stream->pending->size == 0;
+	stream->pending->size = 0;
+
+	if (stream->partial != NULL)
+	{
+		if (((huff_partial*)stream->partial)->active)
+			complete = 0;
+
+		((huff_partial*)stream->partial)->active = 0;
+	}
+
+	return complete;
+}
+
+JEP_UTILS_API void JEP_UTILS_CALL
+jep_destroy_huff_stream(jep_huff_stream* stream)
+{
+	if (stream == NULL)
+		return;
+
+	jep_destroy_byte_buffer(stream->pending);
+	free(stream->partial);
+
+	free(stream);
+}
+
+JEP_UTILS_API int JEP_UTILS_CALL
+jep_huff_compress_file(const char* src_path, const char* dest_path)
+{
+	huff_mapped_file input; // The file to compress
+	huff_file output;       // The file to receive the blocks
+	jep_byte_buffer* out;   // Blocks that are not yet written
+	size_t pos;             // Position in the input
+	size_t n;               // The number of bytes in a block
+	int res;                // The result of compressing
+
+	if (src_path == NULL || dest_path == NULL || !map_file(src_path, &input))
+		return 0;
+
+	if (!create_file(dest_path, &input, &output))
+	{
+		unmap_file(&input);
+		return 0;
+	}
+
+	out = jep_create_byte_buffer();
+	res = out != NULL;
+
+	// Each block is encoded straight from the mapped input,
+	// and the blocks are written once enough of them are collected.
+	for (pos = 0; res && pos < input.size; pos += n)
+	{
+		n = input.size - pos < JEP_HUFF_DEFAULT_BLOCK_SIZE
+			? input.size - pos : JEP_HUFF_DEFAULT_BLOCK_SIZE;
+
+		res = encode_block(input.data + pos, n, JEP_HUFF_DEFAULT_CODE_LENGTH,
+			JEP_HUFF_CODER_HUFFMAN, out);
+
+		if (res && out->size >= HUFF_FILE_CHUNK)
+		{
+			res = write_file(output, out->buffer, out->size);
+			out->size = 0;
+		}
+	}
+
+	if (res && out->size > 0)
+		res = write_file(output, out->buffer, out->size);
+
+	jep_destroy_byte_buffer(out);
+	res = close_file(output, dest_path, res);
+	unmap_file(&input);
+
+	return res;
+}
+
+JEP_UTILS_API int JEP_UTILS_CALL
+jep_huff_decompress_file(const char* src_path, const char* dest_path)
+{
+	huff_mapped_file input; // The file to decompress
+	huff_file output;       // The file to receive the decoded bytes
+	jep_byte_buffer block;  // A view of a block in the input
+	jep_byte_buffer* out;   // Decoded bytes that are not yet written
+	huff_partial* partial;  // A block decoded a piece at a time
+	size_t pos;             // Position in the input
+	size_t size;            // The size of a block
+	int res;                // The result of decompressing
+
+	if (src_path == NULL || dest_path == NULL || !map_file(src_path, &input))
+		return 0;
+
+	if (!create_file(dest_path, &input, &output))
+	{
+		unmap_file(&input);
+		return 0;
+	}
+
+	out = jep_create_byte_buffer();
+	partial = jep_alloc(huff_partial, 1);
+	res = out != NULL && partial != NULL;
+
+	if (partial != NULL)
+		partial->active = 0;
+
+	// Every block is decoded straight from the mapped input.
+	// A block that runs past the end of the file is incomplete.
+	for (pos = 0; res && pos < input.size; pos += size)
+	{
+		res = measure_block(input.data + pos, input.size - pos, &size)
+			&& size <= input.size - pos;
+
+		if (!res)
+			break;
+
+		block.buffer = (jep_byte*)(input.data + pos);
+		block.size = block.cap = size;
+
+		res = decode_file_block(&block, partial, out, output);
+
+		if (res && out->size >= HUFF_FILE_CHUNK)
+		{
+			res = write_file(output, out->buffer, out->size);
+			out->size = 0;
+		}
+	}
+
+	if (res && out->size > 0)
+		res = write_file(output, out->buffer, out->size);
+
+	jep_destroy_byte_buffer(out);
+	free(partial);
+	res = close_file(output, dest_path, res);
+	unmap_file(&input);
+
+	return res;
+}
+
+JEP_UTILS_API jep_huff_table* JEP_UTILS_CALL
+jep_huff_train(jep_byte_buffer** samples, size_t count)
+{
+	jep_huff_table* table;
+	jep_huff_dict* dict;
+	uint64_t totals[JEP_HISTOGRAM_SIZE];
+	uint32_t counts[JEP_HISTOGRAM_SIZE];
+	uint64_t sum;
+	uint32_t shift;
+	size_t chunk;
+	size_t pos;
+	size_t i;
 	uint32_t j;
 
-	if (raw == NULL)
+	if (samples == NULL && count > 0)
+		return NULL;
+
+	for (j = 0; j < JEP_HISTOGRAM_SIZE; j++)
+		totals[j] = 0;
+
+	for (i = 0; i < count; i++)
+	{
+		if (samples[i] == NULL)
+			return NULL;
+
+		// A histogram can count at most UINT32_MAX bytes at once.
+		for (pos = 0; pos < samples[i]->size; pos += chunk)
+		{
+			chunk = samples[i]->size - pos;
+			if (chunk > UINT32_MAX)
+				chunk = UINT32_MAX;
+
+			if (!jep_byte_histogram(samples[i]->buffer + pos, chunk, counts))
+				return NULL;
+
+			for (j = 0; j < JEP_HISTOGRAM_SIZE; j++)
+				totals[j] += counts[j];
+		}
+	}
+
+	// The weights of the tree must fit in 32 bits, so the totals
+	// of a very large corpus are scaled down.
+	shift = 0;
+	do
+	{
+		sum = 0;
+		for (j = 0; j < JEP_HISTOGRAM_SIZE; j++)
+			sum += (totals[j] >> shift) + 1;
+	} while (sum > UINT32_MAX && ++shift < 64);
+
+	// Every byte is counted at least once so that messages
+	// containing bytes that were not in the samples can
+	// still be encoded.
+	for (j = 0; j < JEP_HISTOGRAM_SIZE; j++)
+		counts[j] = (uint32_t)(totals[j] >> shift) + 1;
+
+	dict = build_canonical_dict(counts, JEP_HUFF_DEFAULT_CODE_LENGTH);
+
+	if (dict == NULL)
+		return NULL;
+
+	table = create_table(dict);
+
+	if (table == NULL)
+		destroy_dict(dict);
+
+	return table;
+}
+
+JEP_UTILS_API int JEP_UTILS_CALL
+jep_huff_write_table(jep_huff_table* table, jep_byte_buffer* out)
+{
+	if (table == NULL || out == NULL)
+		return 0;
+
+	if (!jep_append_byte(out, huff_magic)
+		|| !jep_append_byte(out, huff_version)
+		|| !jep_append_byte(out, huff_type_table))
+	{
+		return 0;
+	}
+
+	write_canonical_dict(table->dict, out);
+
+	return 1;
+}
+
+JEP_UTILS_API jep_huff_table* JEP_UTILS_CALL
+jep_huff_read_table(jep_byte_buffer* encoded)
+{
+	jep_huff_table* table;
+	jep_huff_dict* dict;
+	size_t pos;
+
+	if (encoded == NULL || encoded->size < 3
+		|| encoded->buffer[0] != huff_magic
+		|| !known_version(encoded->buffer[1])
+		|| encoded->buffer[2] != huff_type_table)
+	{
+		return NULL;
+	}
+
+	pos = 3;
+	dict = read_canonical_dict(encoded, &pos);
+
+	if (dict == NULL)
+		return NULL;
+
+	table = pos == encoded->size ? create_table(dict) : NULL;
+
+	if (table == NULL)
+		destroy_dict(dict);
+
+	return table;
+}
+
+JEP_UTILS_API int JEP_UTILS_CALL
+jep_huff_encode_shared(jep_huff_table* table, const jep_byte* src, size_t n,
+	jep_byte_buffer* out)
+{
+	huff_lookup* lookup;
+	jep_byte* dest;
+	size_t size;
+
+	if (table == NULL || out == NULL || (src == NULL && n > 0))
+		return 0;
+
+	lookup = (huff_lookup*)table->lookup;
+
+	if (n > (SIZE_MAX - HUFF_VARINT_MAX) / JEP_HUFF_MAX_CODE_LENGTH)
+		return 0;
+
+	// Reserve enough room for the longest possible encoding
+	// so that the bits can be written without checking.
+	size = ((uint64_t)n * lookup->decoder.longest + CHAR_BIT - 1) / CHAR_BIT;
+
+	if (!reserve_bytes(out, HUFF_VARINT_MAX + size))
+		return 0;
+
+	dest = out->buffer + out->size;
+	size = write_varint(n, dest);
+	size += encode_with_table(lookup->codes, src, n, dest + size);
+	out->size += size;
+
+	return 1;
+}
+
+JEP_UTILS_API int JEP_UTILS_CALL
+jep_huff_decode_shared(jep_huff_table* table, const jep_byte* src, size_t n,
+	jep_byte_buffer* out)
+{
+	huff_lookup* lookup;
+	huff_reader r;
+	jep_byte* dest;
+	uint64_t count;
+	uint64_t remaining;
+	uint32_t len;
+	uint16_t e;
+	size_t left;
+	size_t pos;
+	int k;
+
+	if (table == NULL || src == NULL || out == NULL)
+		return 0;
+
+	lookup = (huff_lookup*)table->lookup;
+	pos = read_varint(src, n, &count);
+
+	if (pos == 0)
+		return 0;
+
+	// Every code has at least one bit, so a valid count
+	// can never require an unreasonable allocation.
+	remaining = (uint64_t)(n - pos) * CHAR_BIT;
+
+	if (count > remaining || count > (uint64_t)(SIZE_MAX - out->size)
+		|| !reserve_bytes(out, (size_t)count))
+	{
+		return 0;
+	}
+
+	r.pos = src + pos;
+	r.end = src + n;
+	r.bits = 0;
+	r.count = 0;
+
+	dest = out->buffer + out->size;
+	left = (size_t)count;
+
+	while (left > 0)
+	{
+		// Decode four symbols for every refill of the bit reader,
+		// as in decode_with_table.
+		while (left >= 4 && remaining >= 4 * HUFF_TABLE_BITS
+			&& r.end - r.pos >= 8)
+		{
+			refill_reader(&r);
+
+			for (k = 0; k < 4; k++)
+			{
+				e = lookup->decoder.entries[r.bits & (HUFF_TABLE_SIZE - 1)];
+				len = entry_len(e);
+
+				if (len == 0)
+					break;
+
+				dest[k] = entry_sym(e);
+				r.bits >>= len;
+				r.count -= len;
+				remaining -= len;
+			}
+
+			dest += k;
+			left -= k;
+
+			if (k < 4)
+				break;
+		}
+
+		if (left == 0)
+			break;
+
+		if (!decode_symbols(&lookup->decoder, &r, &remaining, dest, 1))
+			return 0;
+
+		dest++;
+		left--;
+	}
+
+	// Only the padding of the last byte may be left over.
+	if (remaining >= CHAR_BIT)
+		return 0;
+
+	out->size += (size_t)count;
+
+	return 1;
+}
+
+JEP_UTILS_API void JEP_UTILS_CALL
+jep_destroy_huff_table(jep_huff_table* table)
+{
+	if (table == NULL)
+		return;
+
+	destroy_dict(table->dict);
+	free(table->lookup);
+
+	free(table);
+}
+
+JEP_UTILS_API jep_huff_arena* JEP_UTILS_CALL
+jep_create_huff_arena()
+{
+	jep_huff_arena* arena;
+
+	arena = jep_alloc(jep_huff_arena, 1);
+
+	if (arena == NULL)
+		return NULL;
+
+	arena->output = jep_create_byte_buffer();
+	arena->model = NULL;
+
+	if (arena->output == NULL)
+	{
+		free(arena);
+		return NULL;
+	}
+
+	return arena;
+}
+
+JEP_UTILS_API jep_byte_buffer* JEP_UTILS_CALL
+jep_huff_arena_encode(jep_huff_arena* arena, jep_byte_buffer* raw)
+{
+	if (arena == NULL || raw == NULL)
+		return NULL;
+
+	arena->output->size = 0;
+
+	if (!encode_block(raw->buffer, raw->size, JEP_HUFF_DEFAULT_CODE_LENGTH,
+		JEP_HUFF_CODER_HUFFMAN, arena->output))
+	{
+		return NULL;
+	}
+
+	return arena->output;
+}
+
+JEP_UTILS_API jep_byte_buffer* JEP_UTILS_CALL
+jep_huff_arena_encode_context(jep_huff_arena* arena, jep_byte_buffer* raw)
+{
+	jep_byte_buffer* out; // The output of the arena
+	size_t bound;         // The largest possible size of the output
+	size_t size;          // The size of the output
+
+	if (arena == NULL || raw == NULL)
+		return NULL;
+
+	out = arena->output;
+	out->size = 0;
+
+	bound = jep_huff_compress_bound(raw->size);
+
+	if (bound == 0 || !reserve_bytes(out, bound))
+		return NULL;
+
+	// The model is large, so it is kept for the next call.
+	if (arena->model == NULL)
+	{
+		arena->model = jep_alloc(huff_context_model, 1);
+
+		if (arena->model == NULL)
+			return NULL;
+	}
+
+	size = encode_context(raw->buffer, raw->size,
+		(huff_context_model*)arena->model, out->buffer, out->cap);
+
+	if (size == 0)
+		return NULL;
+
+	out->size = size;
+
+	return out;
+}
+
+JEP_UTILS_API jep_byte_buffer* JEP_UTILS_CALL
+jep_huff_arena_decode(jep_huff_arena* arena, jep_byte_buffer* encoded)
+{
+	jep_byte_buffer* out; // The output of the arena
+	huff_index index;     // The index of an indexed container
+	huff_index_job job;   // The blocks of an indexed container
+
+	if (arena == NULL || encoded == NULL)
+		return NULL;
+
+	out = arena->output;
+	out->size = 0;
+
+	if (!is_indexed(encoded))
+		return decode_block(encoded, out, 0) ? out : NULL;
+
+	if (!read_index(encoded, &index) || index.raw_size > SIZE_MAX
+		|| !reserve_bytes(out, (size_t)index.raw_size))
+	{
+		return NULL;
+	}
+
+	job.index = &index;
+	job.dest = out->buffer;
+
+	if (!run_parallel(decode_block_task, &job, index.count, 1))
+		return NULL;
+
+	out->size = (size_t)index.raw_size;
+
+	return out;
+}
+
+JEP_UTILS_API void JEP_UTILS_CALL
+jep_huff_reset_arena(jep_huff_arena* arena)
+{
+	if (arena == NULL)
+		return;
+
+	arena->output->size = 0;
+}
+
+JEP_UTILS_API void JEP_UTILS_CALL
+jep_destroy_huff_arena(jep_huff_arena* arena)
+{
+	if (arena == NULL)
+		return;
+
+	jep_destroy_byte_buffer(arena->output);
+	free(arena->model);
+
+	free(arena);
+}
+
+
+
+
+/*-----------------------------------------------------------------*/
+/*                 Memory Management Implementation                */
+/*-----------------------------------------------------------------*/
+
+static jep_huff_dict* create_dict(size_t count)
+{
+	jep_huff_dict* dict;
+	jep_huff_sym* symbols;
+	size_t i;
+
+	dict = jep_alloc(jep_huff_dict, 1);
+
+	if (dict == NULL)
+		return NULL;
+
+	dict->count = count;
+
+	symbols = jep_alloc(jep_huff_sym, count);
+
+	if (symbols == NULL)
+	{
+		free(dict);
+		return NULL;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		symbols[i].code = NULL;
+	}
+
+	dict->symbols = symbols;
+
+	return dict;
+}
+
+static void destroy_dict(jep_huff_dict* dict)
+{
+	if (dict == NULL)
+		return;
+
+	uint32_t i;
+
+	for (i = 0; i < dict->count; i++)
+		jep_destroy_bitstring(dict->symbols[i].code);
+
+	if (dict->symbols != NULL)
+		free(dict->symbols);
+
+	free(dict);
+}
+
+static jep_huff_tree* create_tree(uint32_t cap)
+{
+	jep_huff_tree* tree;
+
+	tree = jep_alloc(jep_huff_tree, 1);
+
+	if (tree == NULL)
+		return NULL;
+
+	tree->nodes = jep_alloc(jep_huff_node, cap);
+
+	if (tree->nodes == NULL)
+	{
+		free(tree);
+		return NULL;
+	}
+
+	tree->count = 0;
+	tree->cap = cap;
+
+	return tree;
+}
+
+static void destroy_tree(jep_huff_tree* tree)
+{
+	if (tree == NULL)
+		return;
+
+	// Every node lives in the same array, and disposal
+	// of bitstrings is handled in destroy_dict.
+	if (tree->nodes != NULL)
+		free(tree->nodes);
+
+	free(tree);
+}
+
+static jep_huff_code* create_huff_code()
+{
+	jep_huff_code* hc;
+
+	hc = jep_alloc(jep_huff_code, 1);
+
+	if (hc == NULL)
+		return NULL;
+
+	// The components are supplied by whoever
+	// populates the context.
+	hc->tree = NULL;
+	hc->dict = NULL;
+	hc->data = NULL;
+
+	return hc;
+}
+
+
+
+
+/*-----------------------------------------------------------------*/
+/*                  Tree Construction Implementation               */
+/*-----------------------------------------------------------------*/
+
+static jep_huff_node* add_node(jep_huff_tree* tree)
+{
+	jep_huff_node* node;
+
+	if (tree->count >= tree->cap)
+		return NULL;
+
+	node = &(tree->nodes[tree->count++]);
+
+	node->leaf_1 = NULL;
+	node->leaf_2 = NULL;
+	node->sym.code = NULL;
+	node->sym.b = 0;
+	node->sym.f = 0;
+	node->sym.w = 1;
+	node->sym.n = 0;
+
+	return node;
+}
+
+
+static int compare_nodes(const void* a, const void* b)
+{
+	const jep_huff_node* x = (const jep_huff_node*)a;
+	const jep_huff_node* y = (const jep_huff_node*)b;
+
+	if (x->sym.f != y->sym.f)
+		return x->sym.f < y->sym.f ? -1 : 1;
+
+	return (int)x->sym.b - (int)y->sym.b;
+}
+
+
+static int construct_tree(jep_huff_tree* tree, jep_huff_dict* dict)
+{
+	jep_huff_node* nodes; // The node array
+	jep_huff_node* par;   // A parent node for two nodes
+	jep_huff_node* pick;  // The least frequent node not yet joined
+	uint32_t n;           // The number of leaves
+	uint32_t leaf;        // The next leaf to be joined
+	uint32_t head;        // The next parent node to be joined
+	uint32_t next;        // The position of the next parent node
+	uint32_t i, k;        // Indices
+
+	// Ensure that we have a tree and that there are leaves.
+	if (tree == NULL || dict == NULL || dict->count == 0)
+		return 0;
+
+	n = dict->count;
+
+	if (tree->cap < 2 * n - 1)
+		return 0;
+
+	nodes = tree->nodes;
+	tree->count = 2 * n - 1;
+
+	// The leaves occupy the end of the array
+	// in order of increasing frequency.
+	for (i = 0; i < n; i++)
+	{
+		nodes[n - 1 + i].sym = dict->symbols[i];
+		nodes[n - 1 + i].sym.w = 0;
+		nodes[n - 1 + i].sym.n = 0;
+		nodes[n - 1 + i].leaf_1 = NULL;
+		nodes[n - 1 + i].leaf_2 = NULL;
+	}
+
+	qsort(nodes + n - 1, n, sizeof(jep_huff_node), compare_nodes);
+
+	// Parent nodes are created in order of increasing frequency,
+	// so the parent nodes that have not been joined form a sorted
+	// queue from head - 1 down to next + 1.
+	leaf = n - 1;
+	head = n - 1;
+	next = n - 1;
+
+	while (next > 0)
+	{
+		par = &(nodes[--next]);
+
+		// Take the two least frequent nodes from the front of
+		// the two queues. A leaf wins a tie so that the tree
+		// is no deeper than it needs to be.
+		for (k = 0; k < 2; k++)
+		{
+			if (leaf < 2 * n - 1
+				&& (head <= next + 1
+					|| nodes[leaf].sym.f <= nodes[head - 1].sym.f))
+			{
+				pick = &(nodes[leaf++]);
+			}
+			else
+			{
+				pick = &(nodes[--head]);
+			}
+
+			if (k == 0)
+				par->leaf_1 = pick;
+			else
+				par->leaf_2 = pick;
+		}
+
+		par->sym.b = 0;
+		par->sym.f = par->leaf_1->sym.f + par->leaf_2->sym.f;
+		par->sym.w = 1;
+		par->sym.n = 0;
+		par->sym.code = NULL;
+	}
+
+	return 1;
+}
+
+
+static void assign_code_lengths(jep_huff_tree* tree, jep_huff_dict* dict)
+{
+	jep_byte lengths[UCHAR_MAX + 1]; // The code length of each byte
+	jep_huff_node* node;             // The current node
+	uint32_t i;                      // Index
+
+	// A lone leaf still needs one bit to be encoded.
+	if (tree->count == 1)
+	{
+		dict->symbols[0].n = 1;
+		return;
+	}
+
+	tree->nodes[0].sym.n = 0;
+
+	// Every parent node comes before its leaves in the array,
+	// so the depth of a parent is always known before the
+	// depths of its leaves are needed.
+	for (i = 0; i < tree->count; i++)
+	{
+		node = &(tree->nodes[i]);
+
+		if (node->sym.w == 0)
+		{
+			lengths[node->sym.b] = (jep_byte)node->sym.n;
+			continue;
+		}
+
+		node->leaf_1->sym.n = node->sym.n + 1;
+		node->leaf_2->sym.n = node->sym.n + 1;
+	}
+
+	for (i = 0; i < dict->count; i++)
+		dict->symbols[i].n = lengths[dict->symbols[i].b];
+}
+
+
+static void limit_code_lengths(jep_huff_dict* dict, uint32_t limit)
+{
+	// The type of each item in each list.
+	// A value of -1 is a package and anything else is a symbol index.
+	int16_t kinds[JEP_HUFF_MAX_CODE_LENGTH][2 * (UCHAR_MAX + 1)];
+	uint32_t sizes[JEP_HUFF_MAX_CODE_LENGTH];    // The size of each list
+	uint64_t weights[2][2 * (UCHAR_MAX + 1)];    // The weights of two lists
+	jep_huff_node leaves[UCHAR_MAX + 1];         // The symbols in order
+	uint64_t* prev;                              // The previous list
+	uint64_t* cur;                               // The current list
+	uint32_t n;                                  // The number of symbols
+	uint32_t level;                              // The current list
+	uint32_t s, p, k;                            // Indices
+	uint32_t packages;                           // Number of packages
+	uint32_t chosen;                             // Number of items chosen
+
+	n = dict->count;
+
+	// Two symbols or less always fit within any limit.
+	if (n <= 2)
+	{
+		for (s = 0; s < n; s++)
+			dict->symbols[s].n = 1;
+		return;
+	}
+
+	// Sort the symbols by frequency.
+	for (s = 0; s < n; s++)
+	{
+		leaves[s].sym = dict->symbols[s];
+		leaves[s].sym.n = s;
+	}
+
+	qsort(leaves, n, sizeof(jep_huff_node), compare_nodes);
+
+	// The list for the longest codes contains only the symbols.
+	cur = weights[0];
+	for (s = 0; s < n; s++)
+	{
+		cur[s] = leaves[s].sym.f;
+		kinds[0][s] = (int16_t)s;
+	}
+	sizes[0] = n;
+
+	// Each following list merges the symbols with packages made
+	// from pairs of items in the previous list.
+	for (level = 1; level < limit; level++)
+	{
+		prev = cur;
+		cur = weights[level & 1];
+		packages = sizes[level - 1] / 2;
+
+		s = p = k = 0;
+		while (s < n || p < packages)
+		{
+			if (p >= packages
+				|| (s < n && leaves[s].sym.f <= prev[2 * p] + prev[2 * p + 1]))
+			{
+				cur[k] = leaves[s].sym.f;
+				kinds[level][k++] = (int16_t)s++;
+			}
+			else
+			{
+				cur[k] = prev[2 * p] + prev[2 * p + 1];
+				kinds[level][k++] = -1;
+				p++;
+			}
+		}
+
+		sizes[level] = k;
+	}
+
+	for (s = 0; s < n; s++)
+		dict->symbols[leaves[s].sym.n].n = 0;
+
+	// Choose 2n - 2 items from the final list. Every package that
+	// is chosen causes the two items that it was made from to be
+	// chosen from the list before it.
+	chosen = 2 * n - 2;
+	for (level = limit; level > 0 && chosen > 0; level--)
+	{
+		packages = 0;
+
+		for (k = 0; k < chosen; k++)
+		{
+			if (kinds[level - 1][k] == -1)
+				packages++;
+			else
+				dict->symbols[leaves[kinds[level - 1][k]].sym.n].n++;
+		}
+
+		chosen = 2 * packages;
+	}
+}
+
+
+static int build_code_lengths(const uint32_t* counts,
+	uint32_t limit,
+	jep_byte* lengths)
+{
+	jep_huff_node nodes[2 * (UCHAR_MAX + 1) - 1]; // Every node of the tree
+	jep_huff_sym symbols[UCHAR_MAX + 1];          // The bytes that occur
+	jep_huff_tree tree;                           // A tree of the nodes
+	jep_huff_dict dict;                           // A dictionary of the symbols
+	uint32_t i, j;                                // Indices
+
+	for (i = 0, j = 0; i <= UCHAR_MAX; i++)
+	{
+		lengths[i] = 0;
+
+		if (counts[i] == 0)
+			continue;
+
+		symbols[j].b = (jep_byte)i;
+		symbols[j].f = counts[i];
+		symbols[j].w = 0;
+		symbols[j].n = 0;
+		symbols[j].code = NULL;
+		j++;
+	}
+
+	// There must be enough codes of the maximum length
+	// for every unique byte.
+	if (j == 0 || (limit < 32 && j > (1U << limit)))
+		return 0;
+
+	dict.symbols = symbols;
+	dict.count = j;
+	tree.nodes = nodes;
+	tree.count = 0;
+	tree.cap = 2 * j - 1;
+
+	// Construct the tree and determine the length of each code.
+	if (!construct_tree(&tree, &dict))
+		return 0;
+
+	assign_code_lengths(&tree, &dict);
+
+	// If any code is too long, find the best code lengths
+	// that do not exceed the limit.
+	for (i = 0; i < dict.count; i++)
+	{
+		if (dict.symbols[i].n > limit)
+		{
+			limit_code_lengths(&dict, limit);
+			break;
+		}
+	}
+
+	for (i = 0; i < dict.count; i++)
+		lengths[dict.symbols[i].b] = (jep_byte)dict.symbols[i].n;
+
+	return 1;
+}
+
+
+static jep_huff_tree* reconstruct_tree(jep_huff_dict* dict)
+{
+	uint32_t i, j;        // Indices
+	uint32_t cap;         // The maximum number of nodes
+	jep_huff_tree* tree;  // A Huffman tree
+	jep_huff_node* node;  // The current node of a branch
+	jep_huff_node** leaf; // The next node of a branch
+	jep_bitstring* bs;    // The bitstring for a Huffman symbol
+
+	// A branch adds at most one node for every bit of its code.
+	cap = 1;
+	for (i = 0; i < dict->count; i++)
+	{
+		if (dict->symbols[i].code == NULL || dict->symbols[i].code->bit_count == 0)
+			return NULL;
+
+		cap += dict->symbols[i].code->bit_count;
+	}
+
+	// Create the tree and its root node.
+	tree = create_tree(cap);
+
+	if (tree == NULL)
+		return NULL;
+
+	add_node(tree);
+
+	// Loop through the symbols in the dictionary
+	// and build each branch of the tree based on
+	// the bit code. If the current bit is a 1, then
+	// the next node in the branch will be leaf_1,
+	// otherwise it will be leaf_2.
+	for (i = 0; i < dict->count; i++)
+	{
+		bs = dict->symbols[i].code;
+		node = tree->nodes;
+
+		for (j = 0; j < bs->bit_count; j++)
+		{
+			// A code cannot pass through the leaf of another code.
+			if (node->sym.w == 0)
+			{
+				destroy_tree(tree);
+				return NULL;
+			}
+
+			if (bs->bytes[j / CHAR_BIT] & (1 << (j % CHAR_BIT)))
+				leaf = &(node->leaf_1);
+			else
+				leaf = &(node->leaf_2);
+
+			// Create the next node if it doesn't already exist.
+			// The last node of a code must not already exist,
+			// otherwise the code would be the prefix of another.
+			if (*leaf == NULL)
+			{
+				*leaf = add_node(tree);
+			}
+			else if (j == bs->bit_count - 1)
+			{
+				destroy_tree(tree);
+				return NULL;
+			}
+
+			node = *leaf;
+		}
+
+		// Populate the symbol data of the leaf node.
+		node->sym = dict->symbols[i];
+		node->sym.w = 0;
+	}
+
+	return tree;
+}
+
+
+
+
+/*-----------------------------------------------------------------*/
+/*                   Canonical Codes Implementation                */
+/*-----------------------------------------------------------------*/
+
+static int canonical_code_values(jep_huff_dict* dict, uint64_t* codes)
+{
+	jep_byte lengths[UCHAR_MAX + 1]; // The code length of each byte
+	uint64_t values[UCHAR_MAX + 1];  // The code of each byte
+	uint32_t len;                    // The current code length
+	uint32_t i;                      // Index
+
+	for (i = 0; i <= UCHAR_MAX; i++)
+		lengths[i] = 0;
+
+	// Make sure that no byte appears more than once.
+	for (i = 0; i < dict->count; i++)
+	{
+		len = dict->symbols[i].n;
+
+		if (len == 0 || len > HUFF_MAX_CODE_BITS
+			|| lengths[dict->symbols[i].b] != 0)
+		{
+			return 0;
+		}
+
+		lengths[dict->symbols[i].b] = (jep_byte)len;
+	}
+
+	if (!lengths_to_codes(lengths, values))
+		return 0;
+
+	for (i = 0; i < dict->count; i++)
+		codes[i] = values[dict->symbols[i].b];
+
+	return 1;
+}
+
+
+static int lengths_to_codes(const jep_byte* lengths, uint64_t* codes)
+{
+	uint32_t counts[HUFF_MAX_CODE_BITS + 1]; // Number of codes of each length
+	uint64_t next[HUFF_MAX_CODE_BITS + 1];   // Next code of each length
+	uint64_t code;                           // The current code
+	uint32_t len;                            // The current code length
+	uint32_t i;                              // Index
+
+	for (i = 0; i <= HUFF_MAX_CODE_BITS; i++)
+		counts[i] = 0;
+
+	// Count the codes of each length.
+	for (i = 0; i <= UCHAR_MAX; i++)
+	{
+		if (lengths[i] > HUFF_MAX_CODE_BITS)
+			return 0;
+
+		counts[lengths[i]]++;
+	}
+
+	counts[0] = 0;
+
+	// Determine the first code of each length.
+	// Each length begins where the previous length left off,
+	// extended by one bit. If the codes of any length run out
+	// of room, the lengths do not describe a prefix code.
+	code = 0;
+	for (len = 1; len <= HUFF_MAX_CODE_BITS; len++)
+	{
+		code = (code + counts[len - 1]) << 1;
+		next[len] = code;
+
+		if (counts[len] > 0 && (code + counts[len] - 1) >> len)
+			return 0;
+	}
+
+	// Assign codes in order of byte value within each length.
+	for (i = 0; i <= UCHAR_MAX; i++)
+	{
+		if (lengths[i] > 0)
+			codes[i] = next[lengths[i]]++;
+	}
+
+	return 1;
+}
+
+
+static int assign_canonical_codes(jep_huff_dict* dict)
+{
+	uint64_t codes[UCHAR_MAX + 1]; // The code of each symbol
+	jep_bitstring* bs;             // The bitstring of the current symbol
+	uint32_t len;                  // The length of the current code
+	uint32_t i, j;                 // Indices
+
+	if (dict == NULL || dict->count > UCHAR_MAX + 1)
+		return 0;
+
+	if (!canonical_code_values(dict, codes))
+		return 0;
+
+	for (i = 0; i < dict->count; i++)
+	{
+		bs = dict->symbols[i].code;
+		len = dict->symbols[i].n;
+
+		if (bs == NULL)
+		{
+			bs = jep_create_bitstring();
+
+			if (bs == NULL)
+				return 0;
+
+			dict->symbols[i].code = bs;
+		}
+
+		reset_bitstring(bs);
+
+		// The most significant bit of the code comes first.
+		for (j = len; j > 0; j--)
+		{
+			if (!jep_add_bit(bs, (unsigned int)((codes[i] >> (j - 1)) & 1)))
+				return 0;
+		}
+	}
+
+	return 1;
+}
+
+
+static int is_canonical(jep_huff_dict* dict)
+{
+	uint64_t codes[UCHAR_MAX + 1]; // The canonical code of each symbol
+	jep_huff_dict lengths;         // The symbols with their code lengths
+	jep_huff_sym syms[UCHAR_MAX + 1];
+	jep_bitstring* bs;             // The bitstring of the current symbol
+	uint32_t i, j;                 // Indices
+
+	if (dict == NULL || dict->count == 0 || dict->count > UCHAR_MAX + 1)
+		return 0;
+
+	// The length of each code is the length of its bitstring,
+	// which is not necessarily the tree depth of the symbol.
+	for (i = 0; i < dict->count; i++)
+	{
+		if (dict->symbols[i].code == NULL)
+			return 0;
+
+		syms[i] = dict->symbols[i];
+		syms[i].n = dict->symbols[i].code->bit_count;
+	}
+
+	lengths.symbols = syms;
+	lengths.count = dict->count;
+
+	if (!canonical_code_values(&lengths, codes))
+		return 0;
+
+	for (i = 0; i < dict->count; i++)
+	{
+		bs = dict->symbols[i].code;
+
+		for (j = 0; j < bs->bit_count; j++)
+		{
+			if ((unsigned int)jep_get_bit(bs, j)
+				!= ((codes[i] >> (bs->bit_count - 1 - j)) & 1))
+			{
+				return 0;
+			}
+		}
+	}
+
+	return 1;
+}
+
+
+static jep_huff_dict* build_canonical_dict(const uint32_t* counts,
+	uint32_t limit)
+{
+	jep_byte lengths[UCHAR_MAX + 1]; // The code length of each byte
+	jep_huff_dict* dict;             // The dictionary to be built
+	uint32_t count;                  // The number of bytes that occur
+	uint32_t i;                      // Index
+
+	if (!build_code_lengths(counts, limit, lengths))
+		return NULL;
+
+	count = 0;
+	for (i = 0; i <= UCHAR_MAX; i++)
+	{
+		if (lengths[i] > 0)
+			count++;
+	}
+
+	dict = create_dict(count);
+
+	if (dict == NULL)
+		return NULL;
+
+	for (i = 0, count = 0; i <= UCHAR_MAX; i++)
+	{
+		if (lengths[i] == 0)
+			continue;
+
+		dict->symbols[count].b = (jep_byte)i;
+		dict->symbols[count].f = counts[i];
+		dict->symbols[count].w = 0;
+		dict->symbols[count].n = lengths[i];
+		count++;
+	}
+
+	// Assign canonical codes based on the code lengths
+	// so that only the lengths need to be written.
+	if (!assign_canonical_codes(dict))
+	{
+		destroy_dict(dict);
+		return NULL;
+	}
+
+	return dict;
+}
+
+
+static void reset_bitstring(jep_bitstring* bs)
+{
+	// The existing allocation is kept. jep_add_bit will resize
+	// the byte array according to the byte count as bits are added.
+	bs->bit_count = 0;
+	bs->byte_count = 1;
+	bs->current_bits = 0;
+	bs->bytes[0] = 0;
+}
+
+
+
+
+/*-----------------------------------------------------------------*/
+/*                     Buffer I/O Implementation                   */
+/*-----------------------------------------------------------------*/
+
+static void write_huff_dict(jep_huff_dict* dict, jep_byte_buffer* bb)
+{
+	uint32_t i, j;      // Indices
+	uint8_t u32buff[4]; // Buffer to hold the bytes of a uint32_t
+	size_t pos;         // Position in the output stream
+	size_t s;           // The size of 1 byte. This should always be 1.
+
+	jep_byte b;            // Byte value of the current symbol
+	uint32_t bit_count;    // Number of bits in the bitstring
+	uint32_t byte_count;   // Number of bytes in the bitstring
+	jep_byte current_bits; // Number of occupied bits in the last byte
+	jep_byte* bytes;       // Bytes in the bitstring
+
+
+	pos = 0;
+	s = sizeof(jep_byte);
+
+	// Write the dict_begin metadata to signify the beginning
+	// of a dictionary.
+	write_to_buffer(&dict_begin, bb, s, &pos);
+
+	// Loop through the symbols in the dictionary and write
+	// their data to the output buffer.
+	// Since the bit count and byte count are unsigned 32-bit integers,
+	// we split them into four 8-bit bytes before writing.
+	for (i = 0; i < dict->count; i++)
+	{
+		// Gather the information about the current symbol.
+		b = dict->symbols[i].b;
+		bit_count = dict->symbols[i].code->bit_count;
+		byte_count = dict->symbols[i].code->byte_count;
+		current_bits = dict->symbols[i].code->current_bits;
+		bytes = dict->symbols[i].code->bytes;
+
+
+		// Write the dict_byte metadata to signify that
+		// we're about to write the byte value of the
+		// current symbol.
+		// Then, write the symbol's byte value.
+		write_to_buffer(&dict_byte, bb, s, &pos);
+		write_to_buffer(&b, bb, 1, &pos);
+
+		// Write the dict_code metadata to signify that
+		// we're about to write bitstring information.
+		write_to_buffer(&dict_code, bb, s, &pos);
+
+		// Write the bit count of the bitstring.
+		jep_split_u32(bit_count, u32buff);
+		write_to_buffer(u32buff, bb, s * 4, &pos);
+
+		// Write the byte count of the bitstring.
+		jep_split_u32(byte_count, u32buff);
+		write_to_buffer(u32buff, bb, s * 4, &pos);
+
+		// Write the number of currently occupied bits in
+		// the last byte.
+		write_to_buffer(&current_bits, bb, s, &pos);
+
+		// Write the bytes of the bitstring data.
+		for (j = 0; j < byte_count; j++)
+		{
+			write_to_buffer(&(bytes[j]), bb, s, &pos);
+		}
+	}
+
+	// Write the dict_end metadata to signify that we've finished
+	// writing the dictionary.
+	write_to_buffer(&dict_end, bb, sizeof(jep_byte), &pos);
+}
+
+
+static void write_huff_data(jep_bitstring* data, jep_byte_buffer* bb)
+{
+	uint32_t i;         // Index
+	uint8_t u32buff[4]; // Buffer to hold the bytes of a uint32_t
+	size_t pos;         // Position in the output stream
+	size_t s;           // The size of 1 byte. This should always be 1.
+
+	uint32_t bit_count;    // Number of bits in the bitstring
+	uint32_t byte_count;   // Number of bytes in the bitstring
+	jep_byte current_bits; // Number of occupied bits in the last byte
+
+
+	pos = 0;
+	s = sizeof(jep_byte);
+
+	bit_count = data->bit_count;
+	byte_count = data->byte_count;
+	current_bits = data->current_bits;
+
+	// Write the data_begin metadata to signify that we're
+	// about to write the encoded bitstring data.
+	write_to_buffer(&data_begin, bb, sizeof(jep_byte), &pos);
+
+	// Write the bit count.
+	jep_split_u32(bit_count, u32buff);
+	write_to_buffer(u32buff, bb, s * 4, &pos);
+
+	// Write the byte count.
+	jep_split_u32(byte_count, u32buff);
+	write_to_buffer(u32buff, bb, s * 4, &pos);
+
+	// Write the number of bits occupied in the last byte.
+	write_to_buffer(&current_bits, bb, s, &pos);
+
+	// Write the bitstring data.
+	for (i = 0; i < data->byte_count; i++)
+	{
+		write_to_buffer(&(data->bytes[i]), bb, s, &pos);
+	}
+
+	// Write the data_end metadata to signify that we've finished
+	// writing the data.
+	write_to_buffer(&data_end, bb, s, &pos);
+}
+
+
+static jep_huff_dict* read_huff_dict(jep_byte_buffer* data, size_t* pos)
+{
+	jep_huff_dict* dict; // The dictionary to be read from the buffer
+	size_t cap;          // Capacity of the dictionary
+	size_t new_cap;      // New capacity for resizing the dictionary
+	size_t count;        // Number of symbols in the dictionary
+	int res;             // Result of read operations
+	jep_huff_sym sym;    // An individual symbol
+	jep_huff_sym* syms;  // Pointer used for reallocation
+	jep_byte u32buff[4]; // Buffer for holding an unsigned 32-bit integer
+	uint32_t u32;        // An unsigned 32-bit integer
+	jep_byte b;          // An unsigned 8-bit integer
+	size_t s;            // The size of 1 byte. This should always be 1.
+
+	uint32_t bit_count;  // Number of bits in the bitstring
+	uint32_t byte_count; // Number of bytes in the bitstring
+	jep_byte* bytes;     // Bytes in the bitstring
+
+
+	cap = 10;
+	dict = create_dict(sizeof(jep_huff_sym) * cap);
+	count = 0;
+	res = 1;
+	u32 = 0;
+	b = 0;
+	s = sizeof(jep_byte);
+
+	// Ensure that we successfully created the dictionary.
+	if (dict == NULL)
+		return NULL;
+
+	// Read the first byte from the buffer.
+	res = read_from_buffer(&b, data, s, pos);
+
+	// Verify that the first byte is the dict_begin metadata.
+	if (!res || b != dict_begin)
+	{
+		destroy_dict(dict);
+		return NULL;
+	}
+
+	// As long as there are bytes remaining to be read,
+	// read them from the buffer and insert them into the dictionary.
+	while (res)
+	{
+		// Read the next byte.
+		res = read_from_buffer(&b, data, s, pos);
+
+		if (res && b == dict_byte)
+		{
+			// If the previous byte was the dict_byte metadata,
+			// then the next byte will be the value of a symbol.
+			if ((res = read_from_buffer(&b, data, s, pos)))
+				sym.b = b;
+		}
+		else if (res && b == dict_code)
+		{
+			// If the previous byte was the dict_code metadata,
+			// then the following bytes will be a bistring.
+			// The bit count and byte count are 32-bit
+			// unsigned integers, so they will need to be
+			// reconstructed from a sequence of four bytes.
+
+			// Create the bitstring for the current symbol.
+			sym.code = jep_create_bitstring();
+
+			// Ensure that the bitstring was created.
+			if (sym.code == NULL)
+			{
+				destroy_dict(dict);
+				return NULL;
+			}
+
+			// Destroy the bytes since we'll recreate them later.
+			free(sym.code->bytes);
+
+			// Read the bit count.
+			res = read_from_buffer(u32buff, data, s * 4, pos);
+			jep_build_u32(u32, u32buff);
+			bit_count = u32;
+
+			// Read the byte count.
+			res = read_from_buffer(u32buff, data, s * 4, pos);
+			jep_build_u32(u32, u32buff);
+			byte_count = u32;
+
+			// Read the number of bits occupied in the last byte.
+			res = read_from_buffer(&b, data, s, pos);
+
+			// Allocate a new array of bytes.
+			bytes = jep_alloc(jep_byte, byte_count);
+
+			// Read the bytes of the bitstring.
+			res = read_from_buffer(bytes, data, byte_count, pos);
+
+			// Resize the dictionary if necessary.
+			if (count >= cap)
+			{
+				new_cap = cap + cap / 2;
+
+				syms = resym(dict->symbols, new_cap);
+
+				if (syms == NULL)
+				{
+					dict->symbols = NULL;
+					destroy_dict(dict);
+					return NULL;
+				}
+
+				dict->symbols = syms;
+				cap = new_cap;
+			}
+
+			// Populate members of the symbol structure.
+			sym.code->bit_count = bit_count;
+			sym.code->byte_count = byte_count;
+			sym.code->bytes = bytes;
+
+			// Add the symbol to the dictionary.
+			dict->symbols[count++] = sym;
+		}
+		else if (b == dict_end)
+		{
+			// If the previous byte was the dict_end metadata,
+			// break out of the loop.
+			res = 0;
+		}
+	}
+
+	// If we allocated more memory than necessary,
+	// resize the dictionary's symbol array to have
+	// an appropriate length.
+	if (count < cap)
+	{
+		syms = resym(dict->symbols, count);
+
+		if (syms == NULL)
+		{
+			dict->symbols = NULL;
+			destroy_dict(dict);
+			return NULL;
+		}
+
+		dict->symbols = syms;
+	}
+
+	dict->count = count;
+
+	return dict;
+}
+
+
+static jep_bitstring* read_huff_data(jep_byte_buffer* data, size_t* pos)
+{
+	jep_bitstring* bs;   // A bitstring to hold the data
+	jep_byte u32buff[4]; // Buffer for holding an unsigned 32-bit integer
+	uint32_t u32;        // An unsigned 32-bit integer
+	jep_byte b;          // An unsigned 8-bit integer
+	size_t s;            // The size of 1 byte. This should always be 1.
+
+
+	// Create the bitstring.
+	bs = jep_create_bitstring();
+
+	if (bs == NULL)
+		return NULL;
+
+	// Dispose of the byte array since it will be created later.
+	free(bs->bytes);
+	bs->bytes = NULL;
+
+	u32 = 0;
+	b = 0;
+	//res = 1;
+	s = sizeof(jep_byte);
+
+	// Read the first byte from the buffer.
+	read_from_buffer(&b, data, s, pos);
+
+	// Verify that the first byte was the data_begin metadata.
+	if (b == data_begin)
+	{
+		// Read the bit count.
+		read_from_buffer(u32buff, data, s * 4, pos);
+		jep_build_u32(u32, u32buff);
+		bs->bit_count = u32;
+
+		// Read the byte count.
+		read_from_buffer(u32buff, data, s * 4, pos);
+		jep_build_u32(u32, u32buff);
+		bs->byte_count = u32;
+
+		// Read the number of bits occupied in the last byte.
+		read_from_buffer(&b, data, s, pos);
+		bs->current_bits = b;
+
+		// Allocate an array of bytes.
+		bs->bytes = jep_alloc(jep_byte, bs->byte_count);
+
+		// Read the bitstring data.
+		read_from_buffer(bs->bytes, data, bs->byte_count, pos);
+	}
+
+	// Without data, there is nothing to decode.
+	if (bs->bytes == NULL)
+	{
+		jep_destroy_bitstring(bs);
+		return NULL;
+	}
+
+	return bs;
+}
+
+
+static jep_huff_dict* read_canonical_dict(jep_byte_buffer* data, size_t* pos)
+{
+	jep_huff_dict* dict;             // The dictionary to be read
+	jep_byte lengths[UCHAR_MAX + 1]; // The length of each code
+	uint32_t count;                  // The number of symbols
+	size_t size;                     // The number of bytes read
+	uint32_t i;                      // Index
+
+	if (*pos > data->size)
+		return NULL;
+
+	size = read_lengths(data->buffer + *pos, data->size - *pos, lengths);
+
+	if (size == 0)
+		return NULL;
+
+	count = 0;
+	for (i = 0; i <= UCHAR_MAX; i++)
+	{
+		if (lengths[i] > 0)
+			count++;
+	}
+
+	dict = create_dict(count);
+
+	if (dict == NULL)
+		return NULL;
+
+	// Any byte with a length of 0 does not appear in the data.
+	for (i = 0, count = 0; i <= UCHAR_MAX; i++)
+	{
+		if (lengths[i] == 0)
+			continue;
+
+		dict->symbols[count].b = (jep_byte)i;
+		dict->symbols[count].f = 0;
+		dict->symbols[count].w = 0;
+		dict->symbols[count].n = lengths[i];
+		count++;
+	}
+
+	// Rebuild the codes from their lengths.
+	if (!assign_canonical_codes(dict))
+	{
+		destroy_dict(dict);
+		return NULL;
+	}
+
+	*pos += size;
+
+	return dict;
+}
+
+
+static jep_bitstring* read_canonical_data(jep_byte_buffer* data, size_t* pos)
+{
+	jep_bitstring* bs;   // A bitstring to hold the data
+	jep_byte u32buff[4]; // Buffer for holding an unsigned 32-bit integer
+	uint32_t bit_count;  // The number of bits of data
+	uint32_t byte_count; // The number of bytes of data
+	jep_byte* bytes;     // The bytes of data
+
+	if (read_from_buffer(u32buff, data, 4, pos) != 4)
+		return NULL;
+
+	jep_build_u32(bit_count, u32buff);
+
+	// The bytes are implied by the bit count.
+	byte_count = bit_count / CHAR_BIT + (bit_count % CHAR_BIT ? 1 : 0);
+
+	if (byte_count == 0 || data->size - *pos < byte_count)
+		return NULL;
+
+	bs = jep_create_bitstring();
+
+	if (bs == NULL)
+		return NULL;
+
+	bytes = jep_alloc(jep_byte, byte_count);
+
+	if (bytes == NULL)
+	{
+		jep_destroy_bitstring(bs);
+		return NULL;
+	}
+
+	memcpy(bytes, data->buffer + *pos, byte_count);
+	*pos += byte_count;
+
+	free(bs->bytes);
+	bs->bytes = bytes;
+	bs->bit_count = bit_count;
+	bs->byte_count = byte_count;
+	bs->current_bits = (jep_byte)(bit_count - (byte_count - 1) * CHAR_BIT);
+
+	return bs;
+}
+
+
+static void write_canonical_dict(jep_huff_dict* dict, jep_byte_buffer* bb)
+{
+	jep_byte lengths[UCHAR_MAX + 1]; // The length of each code
+	uint32_t i;                      // Index
+
+	for (i = 0; i <= UCHAR_MAX; i++)
+		lengths[i] = 0;
+
+	for (i = 0; i < dict->count; i++)
+		lengths[dict->symbols[i].b] = (jep_byte)dict->symbols[i].code->bit_count;
+
+	if (!reserve_bytes(bb, lengths_size(lengths)))
+		return;
+
+	bb->size += write_lengths(lengths, bb->buffer + bb->size);
+}
+
+
+static void write_canonical_data(jep_bitstring* data, jep_byte_buffer* bb)
+{
+	uint8_t u32buff[4]; // Buffer to hold the bytes of a uint32_t
+	uint32_t n;         // The number of bytes of data
+	size_t pos;         // Position in the output stream
+
+	pos = bb->size;
+
+	// Only the bit count is written. The number of bytes
+	// can be determined from it.
+	jep_split_u32(data->bit_count, u32buff);
+	write_to_buffer(u32buff, bb, 4, &pos);
+
+	n = data->bit_count / CHAR_BIT + (data->bit_count % CHAR_BIT ? 1 : 0);
+	write_to_buffer(data->bytes, bb, n, &pos);
+}
+
+
+static size_t read_lengths(const jep_byte* src, size_t n, jep_byte* lengths)
+{
+	uint32_t width;  // The number of bits per length
+	uint32_t first;  // The lowest byte in the dictionary
+	uint32_t range;  // The number of lengths written
+	uint32_t size;   // The number of bytes of lengths
+	uint32_t count;  // The number of lengths that are not 0
+	uint32_t i;      // Index
+
+	if (n < 3)
+		return 0;
+
+	width = src[0];
+	first = src[1];
+
+	if ((width != 4 && width != 8) || src[1] > src[2])
+		return 0;
+
+	range = (uint32_t)src[2] - first + 1;
+	size = width == 4 ? (range + 1) / 2 : range;
+
+	if (n - 3 < size)
+		return 0;
+
+	for (i = 0; i <= UCHAR_MAX; i++)
+		lengths[i] = 0;
+
+	// Unpack the lengths. When four bits are used for each
+	// length, the low bits of a byte hold the first length.
+	count = 0;
+	for (i = 0; i < range; i++)
+	{
+		if (width == 4)
+			lengths[first + i] = (i & 1) ? jep_hi_4(src[3 + i / 2])
+				: jep_lo_4(src[3 + i / 2]);
+		else
+			lengths[first + i] = src[3 + i];
+
+		if (lengths[first + i] > 0)
+			count++;
+	}
+
+	if (count == 0)
+		return 0;
+
+	return 3 + size;
+}
+
+
+static size_t write_lengths(const jep_byte* lengths, jep_byte* dest)
+{
+	uint32_t first; // The lowest byte in the dictionary
+	uint32_t last;  // The highest byte in the dictionary
+	uint32_t width; // The number of bits per length
+	size_t pos;     // Position in the output
+	uint32_t i;     // Index
+
+	first = UCHAR_MAX;
+	last = 0;
+	width = 4;
+
+	for (i = 0; i <= UCHAR_MAX; i++)
+	{
+		if (lengths[i] == 0)
+			continue;
+
+		if (i < first)
+			first = i;
+
+		last = i;
+
+		if (lengths[i] > 15)
+			width = 8;
+	}
+
+	dest[0] = (jep_byte)width;
+	dest[1] = (jep_byte)first;
+	dest[2] = (jep_byte)last;
+	pos = 3;
+
+	// Pack two lengths into each byte if they fit.
+	for (i = first; i <= last; i++)
+	{
+		if (width == 8)
+			dest[pos++] = lengths[i];
+		else if ((i - first) & 1)
+			dest[pos - 1] |= (jep_byte)(lengths[i] << 4);
+		else
+			dest[pos++] = lengths[i];
+	}
+
+	return pos;
+}
+
+
+static size_t lengths_size(const jep_byte* lengths)
+{
+	uint32_t first; // The lowest byte in the dictionary
+	uint32_t last;  // The highest byte in the dictionary
+	uint32_t width; // The number of bits per length
+	uint32_t i;     // Index
+
+	first = UCHAR_MAX;
+	last = 0;
+	width = 4;
+
+	for (i = 0; i <= UCHAR_MAX; i++)
+	{
+		if (lengths[i] == 0)
+			continue;
+
+		if (i < first)
+			first = i;
+
+		last = i;
+
+		if (lengths[i] > 15)
+			width = 8;
+	}
+
+	if (first > last)
+		return 3;
+
+	return 3 + (width == 4 ? (last - first + 2) / 2 : last - first + 1);
+}
+
+
+static int read_from_buffer(jep_byte* dest,
+	jep_byte_buffer* src,
+	size_t n,
+	size_t* pos)
+{
+	size_t i, j;  // Indices
+	size_t start; // Position in output stream
+	int result;   // Number of bytes written to output buffer
+
+
+	// Ensure that the source and destination are not NULL.
+	if (src == NULL || src->buffer == NULL || dest == NULL)
+		return 0;
+
+	start = *pos;
+	result = 0;
+
+	// Ensure that the current position is less than
+	// the source size.
+	if (*pos >= src->size)
+		return 0;
+
+	// Copy each byte from the source buffer into the destination array.
+	for (i = start, j = 0; i < start + n && i < src->size; i++)
+	{
+		dest[j++] = src->buffer[i];
+		(*pos)++;
+		result++;
+	}
+
+	return result;
+}
+
+
+static int write_to_buffer(const jep_byte* src,
+	jep_byte_buffer* dest,
+	size_t n,
+	size_t* pos)
+{
+	int result; // Number of bytes written to output buffer
+
+
+	// Ensure that the source and destination are not NULL.
+	if (dest == NULL || dest->buffer == NULL || src == NULL)
+		return 0;
+
+	result = 0;
+
+	// Ensure that the current position is not greater
+	// than the size of the destination buffer.
+	if (*pos > dest->size)
+		return 0;
+
+	// Make room for all of the bytes at once,
+	// then copy them into the destination buffer.
+	if (!reserve_bytes(dest, n))
+		return 0;
+
+	memcpy(dest->buffer + dest->size, src, n);
+	dest->size += n;
+	*pos += n;
+	result = (int)n;
+
+	return result;
+}
+
+
+
+
+/*-----------------------------------------------------------------*/
+/*                   Table Encoding Implementation                 */
+/*-----------------------------------------------------------------*/
+
+static size_t encode_with_table(const huff_code_entry* table,
+	const jep_byte* src,
+	size_t n,
+	jep_byte* dest)
+{
+	huff_writer w;             // The bit writer
+	const huff_code_entry* e;  // The code of the current byte
+	size_t i;                  // Index
+
+	w.pos = dest;
+	w.bits = 0;
+	w.count = 0;
+
+	for (i = 0; i < n; i++)
+	{
+		// The encoder never produces codes longer than
+		// JEP_HUFF_MAX_CODE_LENGTH, which fits in a single write.
+		e = &(table[src[i]]);
+		put_bits(&w, e->bits, e->len);
+	}
+
+	flush_writer(&w);
+
+	return (size_t)(w.pos - dest);
+}
+
+
+static int build_code_table(const jep_byte* lengths, huff_code_entry* table)
+{
+	uint64_t codes[UCHAR_MAX + 1]; // The canonical code of each byte
+	uint32_t i;                    // Index
+
+	if (!lengths_to_codes(lengths, codes))
+		return 0;
+
+	for (i = 0; i <= UCHAR_MAX; i++)
+	{
+		table[i].len = lengths[i];
+		table[i].bits = lengths[i] > 0 ? reverse_bits(codes[i], lengths[i]) : 0;
+	}
+
+	return 1;
+}
+
+
+static uint64_t reverse_bits(uint64_t code, uint32_t len)
+{
+	uint64_t bits; // The reversed bits
+	uint32_t i;    // Index
+
+	bits = 0;
+	for (i = 0; i < len; i++)
+		bits |= ((code >> (len - 1 - i)) & 1) << i;
+
+	return bits;
+}
+
+
+static uint64_t stream_bits(jep_bitstring* bs)
+{
+	uint64_t bits; // The gathered bits
+	uint32_t i;    // Index
+
+	bits = 0;
+	for (i = 0; i < bs->bit_count && i < 64; i++)
+	{
+		if (bs->bytes[i / CHAR_BIT] & (1 << (i % CHAR_BIT)))
+			bits |= ((uint64_t)1 << i);
+	}
+
+	return bits;
+}
+
+
+static void put_bits(huff_writer* w, uint64_t bits, uint32_t len)
+{
+	// There are always fewer than 32 pending bits before
+	// the new bits are added, so the accumulator cannot overflow.
+	w->bits |= bits << w->count;
+	w->count += len;
+
+	if (w->count >= 32)
+	{
+		w->pos[0] = (jep_byte)(w->bits);
+		w->pos[1] = (jep_byte)(w->bits >> 8);
+		w->pos[2] = (jep_byte)(w->bits >> 16);
+		w->pos[3] = (jep_byte)(w->bits >> 24);
+		w->pos += 4;
+		w->bits >>= 32;
+		w->count -= 32;
+	}
+}
+
+
+static void flush_writer(huff_writer* w)
+{
+	while (w->count > 0)
+	{
+		*(w->pos++) = (jep_byte)(w->bits);
+		w->bits >>= CHAR_BIT;
+		w->count = w->count > CHAR_BIT ? w->count - CHAR_BIT : 0;
+	}
+}
+
+
+
+
+/*-----------------------------------------------------------------*/
+/*                   Table Decoding Implementation                 */
+/*-----------------------------------------------------------------*/
+
+static void build_decode_table(jep_huff_dict* dict, uint16_t* table)
+{
+	uint32_t i, j;     // Indices
+	uint32_t len;      // The length of the current code
+	uint32_t code;     // The bits of the current code in stream order
+	jep_bitstring* bs; // The bitstring of the current code
+
+	// An entry of 0 means that the code must be resolved
+	// by walking the tree.
+	for (i = 0; i < HUFF_TABLE_SIZE; i++)
+		table[i] = 0;
+
+	for (i = 0; i < dict->count; i++)
+	{
+		bs = dict->symbols[i].code;
+
+		if (bs == NULL)
+			continue;
+
+		len = bs->bit_count;
+
+		// Long codes are left to the tree.
+		if (len == 0 || len > HUFF_TABLE_BITS)
+			continue;
+
+		// The first bit of the code is the least
+		// significant bit of the index.
+		code = (uint32_t)stream_bits(bs);
+
+		// Every index whose low bits match the code refers
+		// to the same symbol, regardless of the bits that follow.
+		for (j = code; j < HUFF_TABLE_SIZE; j += (1U << len))
+			table[j] = (uint16_t)((len << 8) | dict->symbols[i].b);
+	}
+}
+
+
+static int build_decoder(const jep_byte* lengths, huff_decoder* dec)
+{
+	uint64_t codes[UCHAR_MAX + 1];          // The canonical code of each byte
+	uint32_t next[HUFF_MAX_CODE_BITS + 2];  // The next position of each length
+	uint32_t len;                           // The length of the current code
+	uint32_t code;                          // The current code in stream order
+	uint32_t i, j;                          // Indices
+
+	if (!lengths_to_codes(lengths, codes))
+		return 0;
+
+	for (i = 0; i <= HUFF_MAX_CODE_BITS; i++)
+		dec->counts[i] = 0;
+
+	for (i = 0; i < HUFF_TABLE_SIZE; i++)
+		dec->entries[i] = 0;
+
+	dec->longest = 0;
+	dec->root = NULL;
+
+	for (i = 0; i <= UCHAR_MAX; i++)
+	{
+		len = lengths[i];
+		dec->counts[len]++;
+
+		if (len > dec->longest)
+			dec->longest = len;
+
+		if (len == 0 || len > HUFF_TABLE_BITS)
+			continue;
+
+		// Every index whose low bits match the code refers
+		// to the same symbol, regardless of the bits that follow.
+		code = (uint32_t)reverse_bits(codes[i], len);
+		for (j = code; j < HUFF_TABLE_SIZE; j += (1U << len))
+			dec->entries[j] = (uint16_t)((len << 8) | i);
+	}
+
+	dec->counts[0] = 0;
+
+	// Canonical codes of the same length are in order of byte value,
+	// so listing the bytes by length puts them in order of their codes.
+	next[1] = 0;
+	for (len = 1; len <= HUFF_MAX_CODE_BITS; len++)
+		next[len + 1] = next[len] + dec->counts[len];
+
+	for (i = 0; i <= UCHAR_MAX; i++)
+	{
+		if (lengths[i] > 0)
+			dec->symbols[next[lengths[i]]++] = (jep_byte)i;
+	}
+
+	return dec->longest > 0;
+}
+
+
+static int decode_with_table(const huff_decoder* dec,
+	const jep_byte* src,
+	size_t n,
+	uint64_t bits,
+	jep_byte_buffer* raw,
+	int fixed)
+{
+	huff_reader r;       // The bit reader
+	jep_byte* out;       // The output array
+	uint64_t remaining;  // The number of bits left to decode
+	uint32_t len;        // The length of the current code
+	uint16_t e;          // The current table entry
+	size_t size;         // The number of bytes decoded
+	int k;               // Index
+
+	if (bits > (uint64_t)n * CHAR_BIT)
+		return 0;
+
+	r.pos = src;
+	r.end = src + n;
+	r.bits = 0;
+	r.count = 0;
+
+	remaining = bits;
+	size = raw->size;
+
+	while (remaining > 0)
+	{
+		// Decode four symbols for every refill of the bit reader.
+		// A refill provides at least 56 bits, so four codes that are
+		// resolved by the table can always be consumed without checking
+		// the bit count in between.
+		while (remaining >= 4 * HUFF_TABLE_BITS && r.end - r.pos >= 8)
+		{
+			// Fixed output is finished one symbol at a time
+			// once there is no room for four more.
+			if (raw->cap - size < 4)
+			{
+				if (fixed)
+					break;
+
+				raw->size = size;
+				if (!reserve_bytes(raw, 4))
+					return 0;
+			}
+
+			out = raw->buffer + size;
+			refill_reader(&r);
+
+			for (k = 0; k < 4; k++)
+			{
+				e = dec->entries[r.bits & (HUFF_TABLE_SIZE - 1)];
+				len = entry_len(e);
+
+				// Long codes are handled one at a time below.
+				if (len == 0)
+					break;
+
+				out[k] = entry_sym(e);
+				r.bits >>= len;
+				r.count -= len;
+				remaining -= len;
+			}
+
+			size += k;
+
+			if (k < 4)
+				break;
+		}
+
+		if (remaining == 0)
+			break;
+
+		// Decode a single symbol. This handles long codes
+		// as well as the last few symbols of the data.
+		if (size >= raw->cap)
+		{
+			if (fixed)
+				return 0;
+
+			raw->size = size;
+			if (!reserve_bytes(raw, 1))
+				return 0;
+		}
+
+		if (!decode_symbols(dec, &r, &remaining, raw->buffer + size, 1))
+			return 0;
+
+		size++;
+	}
+
+	raw->size = size;
+
+	return 1;
+}
+
+
+static int decode_symbols(const huff_decoder* dec,
+	huff_reader* r,
+	uint64_t* remaining,
+	jep_byte* out,
+	size_t n)
+{
+	jep_huff_node* leaf; // The current node when walking the tree
+	uint64_t code;       // The bits of a long code read so far
+	uint64_t first;      // The first code of the current length
+	uint32_t index;      // The position of the first code of the length
+	uint32_t len;        // The length of the current code
+	uint16_t e;          // The current table entry
+	size_t i;            // Index
+
+	for (i = 0; i < n; i++)
+	{
+		if (r->count < HUFF_TABLE_BITS)
+			refill_reader(r);
+
+		e = dec->entries[r->bits & (HUFF_TABLE_SIZE - 1)];
+		len = entry_len(e);
+
+		if (len != 0)
+		{
+			// A code cannot extend past the end of the data.
+			if (len > *remaining || len > r->count)
+				return 0;
+
+			r->bits >>= len;
+			r->count -= len;
+			*remaining -= len;
+			out[i] = entry_sym(e);
+			continue;
+		}
+
+		if (dec->root != NULL)
+		{
+			// Traverse the Huffman tree.
+			// Starting from the root node,
+			// if the current bit is 1, we move on to leaf 1 of the
+			// current node, otherwise we move to leaf 2.
+			leaf = dec->root;
+			while (leaf != NULL && leaf->sym.w != 0)
+			{
+				if (*remaining == 0)
+					return 0;
+
+				if (r->count == 0)
+				{
+					refill_reader(r);
+					if (r->count == 0)
+						return 0;
+				}
+
+				leaf = (r->bits & 1) ? leaf->leaf_1 : leaf->leaf_2;
+				r->bits >>= 1;
+				r->count--;
+				(*remaining)--;
+			}
+
+			if (leaf == NULL)
+				return 0;
+
+			out[i] = leaf->sym.b;
+			continue;
+		}
+
+		// Extend the code one bit at a time until it falls within
+		// the range of the canonical codes of its length.
+		code = first = 0;
+		index = 0;
+		for (len = 1; len <= dec->longest; len++)
+		{
+			if (*remaining == 0)
+				return 0;
+
+			if (r->count == 0)
+			{
+				refill_reader(r);
+				if (r->count == 0)
+					return 0;
+			}
+
+			code |= r->bits & 1;
+			r->bits >>= 1;
+			r->count--;
+			(*remaining)--;
+
+			if (code - first < dec->counts[len])
+				break;
+
+			index += dec->counts[len];
+			first = (first + dec->counts[len]) << 1;
+			code <<= 1;
+		}
+
+		if (len > dec->longest)
+			return 0;
+
+		out[i] = dec->symbols[index + (code - first)];
+	}
+
+	return 1;
+}
+
+
+static int decode_counted(const huff_decoder* dec,
+	const jep_byte* src,
+	size_t n,
+	uint64_t bits,
+	jep_byte* out,
+	size_t count)
+{
+	huff_reader r;       // The bit reader
+	jep_byte* end;       // The end of the output
+	uint64_t remaining;  // The number of bits left to decode
+	uint32_t len;        // The length of the current code
+	uint16_t e;          // The current table entry
+	int k;               // Index
+
+	// Every code has at least one bit and no more bits
+	// than the longest code.
+	if (bits > (uint64_t)n * CHAR_BIT || count > bits
+		|| (uint64_t)count * dec->longest < bits)
+	{
+		return 0;
+	}
+
+	r.pos = src;
+	r.end = src + n;
+	r.bits = 0;
+	r.count = 0;
+
+	remaining = bits;
+	end = out + count;
+
+	// Decode four symbols for every refill of the bit reader.
+	// See decode_with_table.
+	while (end - out >= 4 && remaining >= 4 * HUFF_TABLE_BITS
+		&& r.end - r.pos >= 8)
+	{
+		refill_reader(&r);
+
+		for (k = 0; k < 4; k++)
+		{
+			e = dec->entries[r.bits & (HUFF_TABLE_SIZE - 1)];
+			len = entry_len(e);
+
+			if (len == 0)
+				break;
+
+			*out++ = entry_sym(e);
+			r.bits >>= len;
+			r.count -= len;
+			remaining -= len;
+		}
+
+		// Long codes are handled one at a time.
+		if (k < 4 && !decode_symbols(dec, &r, &remaining, out++, 1))
+			return 0;
+	}
+
+	// Every bit must belong to a symbol.
+	return decode_symbols(dec, &r, &remaining, out, (size_t)(end - out))
+		&& remaining == 0;
+}
+
+
+static void build_multi_table(const huff_decoder* dec, huff_multi_table* multi)
+{
+	uint32_t codes[UCHAR_MAX + 1]; // The short codes in order of length
+	uint32_t n;                    // The number of short codes
+	uint64_t code;                 // The current canonical code
+	uint32_t index;                // The position of the current code
+	uint32_t len;                  // The length of the current code
+	uint32_t i;                    // Index
+
+	// Canonical codes of each length follow one another,
+	// so they are listed without searching the table.
+	n = 0;
+	code = 0;
+	index = 0;
+	for (len = 1; len <= HUFF_MULTI_BITS && len <= dec->longest; len++)
+	{
+		for (i = 0; i < dec->counts[len]; i++)
+		{
+			codes[n++] = (uint32_t)reverse_bits(code++, len)
+				| (len << 16) | ((uint32_t)dec->symbols[index++] << 24);
+		}
+
+		code <<= 1;
+	}
+
+	fill_multi_entries(multi, codes, n, 0, 0, 0, 0);
+}
+
+
+static void fill_multi_entries(huff_multi_table* multi,
+	const uint32_t* codes,
+	uint32_t n,
+	uint32_t prefix,
+	uint32_t used,
+	uint32_t count,
+	uint32_t syms)
+{
+	uint32_t len; // The length of the next code
+	uint32_t e;   // The entry for the prefix
+	uint32_t i;   // Index
+
+	// Every index that begins with the prefix holds its codes,
+	// unless a longer prefix below holds more of them.
+	e = syms | (used << 24) | (count << 28);
+	for (i = prefix; i < HUFF_MULTI_SIZE; i += 1U << used)
+		multi->entries[i] = e;
+
+	if (count == HUFF_MULTI_SYMS)
+		return;
+
+	for (i = 0; i < n; i++)
+	{
+		len = (codes[i] >> 16) & 0xFF;
+
+		if (used + len > HUFF_MULTI_BITS)
+			break;
+
+		fill_multi_entries(multi, codes, n,
+			prefix | ((codes[i] & 0xFFFF) << used), used + len, count + 1,
+			syms | ((codes[i] >> 24) << (count * CHAR_BIT)));
+	}
+}
+
+
+static int decode_multi(const huff_decoder* dec,
+	const huff_multi_table* multi,
+	const jep_byte* src,
+	size_t n,
+	uint64_t bits,
+	jep_byte* out,
+	size_t count)
+{
+	huff_reader r;       // The bit reader
+	jep_byte* end;       // The end of the output
+	uint64_t remaining;  // The number of bits left to decode
+	uint32_t len;        // The bits used by the current entry
+	uint32_t e;          // The current table entry
+	int k;               // Index
+
+	if (bits > (uint64_t)n * CHAR_BIT || count > bits
+		|| (uint64_t)count * dec->longest < bits)
+	{
+		return 0;
+	}
+
+	r.pos = src;
+	r.end = src + n;
+	r.bits = 0;
+	r.count = 0;
+
+	remaining = bits;
+	end = out + count;
+
+	// Make four lookups for every refill of the bit reader, as in
+	// decode_counted. Every entry writes all of its bytes, so there
+	// must be room for four full entries, and the bytes past the count
+	// of each entry are overwritten by the next.
+	while (end - out >= 4 * HUFF_MULTI_SYMS
+		&& remaining >= 4 * HUFF_MULTI_BITS && r.end - r.pos >= 8)
+	{
+		refill_reader(&r);
+
+		for (k = 0; k < 4; k++)
+		{
+			e = multi->entries[r.bits & (HUFF_MULTI_SIZE - 1)];
+			len = multi_len(e);
+
+			if (len == 0)
+				break;
+
+			out[0] = (jep_byte)e;
+			out[1] = (jep_byte)(e >> 8);
+			out[2] = (jep_byte)(e >> 16);
+			out += multi_count(e);
+			r.bits >>= len;
+			r.count -= len;
+			remaining -= len;
+		}
+
+		// Long codes are handled one at a time.
+		if (k < 4 && !decode_symbols(dec, &r, &remaining, out++, 1))
+			return 0;
+	}
+
+	// Every bit must belong to a symbol.
+	return decode_symbols(dec, &r, &remaining, out, (size_t)(end - out))
+		&& remaining == 0;
+}
+
+
+static int count_codes(jep_huff_dict* dict, jep_bitstring* data,
+	uint32_t* count)
+{
+	huff_decoder dec;                // The decoder of every code
+	jep_byte lengths[UCHAR_MAX + 1]; // The length of each code
+	huff_reader r;                   // The bit reader
+	uint64_t remaining;              // The number of bits left to decode
+	uint32_t n;                      // The number of symbols
+	jep_byte b;                      // A decoded symbol
+	uint32_t i;                      // Index
+
+	for (i = 0; i <= UCHAR_MAX; i++)
+		lengths[i] = 0;
+
+	for (i = 0; i < dict->count; i++)
+	{
+		if (dict->symbols[i].code->bit_count > HUFF_MAX_CODE_BITS)
+			return 0;
+
+		lengths[dict->symbols[i].b] = (jep_byte)dict->symbols[i].code->bit_count;
+	}
+
+	if (!build_decoder(lengths, &dec))
+		return 0;
+
+	r.pos = data->bytes;
+	r.end = data->bytes + data->byte_count;
+	r.bits = 0;
+	r.count = 0;
+
+	remaining = data->bit_count;
+
+	for (n = 0; remaining > 0; n++)
+	{
+		if (!decode_symbols(&dec, &r, &remaining, &b, 1))
+			return 0;
+	}
+
+	*count = n;
+
+	return 1;
+}
+
+
+static void refill_reader(huff_reader* r)
+{
+	if (r->end - r->pos >= 8)
+	{
+		// Load a whole word, but only advance past the bytes that
+		// fit entirely into the buffer. The bits of a partially
+		// loaded byte will be loaded again in the same position
+		// by the next refill.
+		r->bits |= jep_load_le64(r->pos) << r->count;
+		r->pos += (63 - r->count) >> 3;
+		r->count |= 56;
+	}
+	else
+	{
+		while (r->count <= 56 && r->pos < r->end)
+		{
+			r->bits |= (uint64_t)*r->pos++ << r->count;
+			r->count += CHAR_BIT;
+		}
+	}
+}
+
+
+static int reserve_bytes(jep_byte_buffer* bb, size_t n)
+{
+	size_t new_cap;   // The new capacity of the buffer
+	jep_byte* buffer; // The reallocated buffer
+
+	if (bb->cap - bb->size >= n)
+		return 1;
+
+	new_cap = bb->cap + bb->cap / 2;
+
+	if (new_cap < bb->size + n)
+		new_cap = bb->size + n;
+
+	buffer = jep_realloc(bb->buffer, jep_byte, new_cap);
+
+	if (buffer == NULL)
+		return 0;
+
+	bb->buffer = buffer;
+	bb->cap = new_cap;
+
+	return 1;
+}
+
+
+
+
+/*-----------------------------------------------------------------*/
+/*                      Streaming Implementation                   */
+/*-----------------------------------------------------------------*/
+
+static int encode_block(const jep_byte* src,
+	size_t n,
+	uint32_t limit,
+	uint32_t coder,
+	jep_byte_buffer* out)
+{
+	size_t bound; // The largest possible size of the block
+	size_t size;  // The size of the block
+
+	bound = jep_huff_compress_bound(n);
+
+	if (bound == 0 || !reserve_bytes(out, bound))
+		return 0;
+
+	if (coder == JEP_HUFF_CODER_ANS)
+	{
+		size = write_ans(src, n, out->buffer + out->size,
+			out->cap - out->size);
+	}
+	else
+	{
+		size = encode_frame(src, n, limit, out->buffer + out->size,
+			out->cap - out->size, NULL);
+	}
+
+	if (size == 0)
+		return 0;
+
+	out->size += size;
+
+	return 1;
+}
+
+
+static size_t encode_frame(const jep_byte* src,
+	size_t n,
+	uint32_t limit,
+	jep_byte* dest,
+	size_t cap,
+	jep_huff_stats* stats)
+{
+	huff_code_entry table[UCHAR_MAX + 1]; // The code of each byte
+	uint32_t own[JEP_HISTOGRAM_SIZE];     // The frequency of each byte
+	uint32_t* counts;                     // The histogram that is filled
+	jep_byte lengths[UCHAR_MAX + 1];      // The length of each code
+	uint64_t total;                       // The number of bits of data
+	uint64_t size;                        // The largest size of the block
+	size_t pos;                           // Position in the output
+	uint32_t i;                           // Index
+	huff_timer(timer);                    // The time of the last phase
+
+	if ((src == NULL && n > 0) || limit < 1
+		|| limit > JEP_HUFF_MAX_CODE_LENGTH)
+	{
+		return 0;
+	}
+
+	// Statistics keep the histogram itself, so it is only counted once.
+	counts = stats != NULL ? stats->counts : own;
+
+	huff_timer_start(stats, timer);
+
+	// Determine the frequency of each byte.
+	if (!jep_byte_histogram(src, n, counts))
+		return 0;
+
+	huff_timer_lap(stats, count_ns, timer);
+
+	// There are no codes without any bytes.
+	if (n == 0)
+		return write_stored(src, n, dest, cap);
+
+	// A single repeated byte only needs to be written once.
+	if (counts[src[0]] == n)
+		return write_run(src[0], n, dest, cap);
+
+	if (!build_code_lengths(counts, limit, lengths))
+		return 0;
+
+	huff_timer_lap(stats, tree_ns, timer);
+
+	if (!build_code_table(lengths, table))
+		return 0;
+
+	huff_timer_lap(stats, code_ns, timer);
+
+	total = 0;
+	for (i = 0; i <= UCHAR_MAX; i++)
+		total += (uint64_t)counts[i] * table[i].len;
+
+	// Bytes that Huffman Coding cannot shrink are stored as they are.
+	size = coded_size(lengths, total, n);
+
+	if (size >= huff_stored_header + (uint64_t)n)
+		return write_stored(src, n, dest, cap);
+
+	if (size > cap)
+		return 0;
+
+	// Large blocks are divided among interleaved bitstreams.
+	if (n >= HUFF_SPLIT_MIN)
+	{
+		pos = write_split(lengths, table, src, n, dest);
+		huff_timer_lap(stats, pack_ns, timer);
+		return pos;
+	}
+
+	if (total > UINT32_MAX)
+		return 0;
+
+	dest[0] = huff_magic;
+	dest[1] = huff_version;
+	dest[2] = huff_type_code;
+	pos = 3 + write_lengths(lengths, dest + 3);
+
+	// The byte count lets the decoder make room for every byte at once.
+	// Every code has at least one bit, so it fits if the bit count fits.
+	jep_split_u32((uint32_t)n, (dest + pos));
+	jep_split_u32((uint32_t)total, (dest + pos + 4));
+	pos += 8;
+
+	pos += encode_with_table(table, src, n, dest + pos);
+	huff_timer_lap(stats, pack_ns, timer);
+
+	return pos;
+}
+
+
+static int decode_block(jep_byte_buffer* encoded,
+	jep_byte_buffer* raw,
+	int fixed)
+{
+	jep_huff_code* hc;               // Huffman Coding data
+	huff_decoder dec;                // The decoder of every code
+	huff_multi_table multi;          // The decoder of short codes
+	jep_byte lengths[UCHAR_MAX + 1]; // The length of each code
+	const jep_byte* src;             // The bytes of the block
+	uint32_t count;                  // The number of decoded bytes
+	uint32_t bits;                   // The number of bits of data
+	size_t bytes;                    // The number of bytes of data
+	size_t pos;                      // Position in the block
+	int sized;                       // 1 if the block has a byte count
+	int res;                         // The result of decoding
+
+	src = encoded->buffer;
+
+	if (encoded->size >= 3 && src[0] == huff_magic)
+	{
+		if (!known_version(src[1]))
+			return 0;
+
+		if (src[2] == huff_type_split)
+			return decode_split(encoded, raw, fixed);
+
+		if (src[2] == huff_type_stored || src[2] == huff_type_run)
+			return decode_raw(encoded, raw, fixed);
+
+		if (src[2] == huff_type_context)
+			return decode_context(encoded, raw, fixed);
+
+		if (src[2] == huff_type_ans)
+			return decode_ans(encoded, raw, fixed);
+
+		if (src[2] == huff_type_checked)
+			return decode_checked(encoded, raw, fixed);
+
+		if (src[2] != huff_type_code)
+			return 0;
+
+		// Canonical codes are decoded straight from the block
+		// without building a dictionary or a tree.
+		pos = read_lengths(src + 3, encoded->size - 3, lengths);
+
+		if (pos == 0 || !build_decoder(lengths, &dec))
+			return 0;
+
+		pos += 3;
+		sized = src[1] != huff_version_unsized;
+
+		if (encoded->size - pos < (sized ? 8 : 4))
+			return 0;
+
+		count = 0;
+		if (sized)
+		{
+			jep_build_u32(count, (src + pos));
+			pos += 4;
+		}
+
+		jep_build_u32(bits, (src + pos));
+		pos += 4;
+		bytes = bits / CHAR_BIT + (bits % CHAR_BIT ? 1 : 0);
+
+		if (bytes == 0 || encoded->size - pos < bytes)
+			return 0;
+
+		if (!sized)
+			return decode_with_table(&dec, src + pos, bytes, bits, raw, fixed);
+
+		// Make room for every decoded byte before any are decoded.
+		// Every code has at least one bit, so a byte count that the
+		// bits cannot hold is rejected before anything is allocated.
+		if (count > bits
+			|| (fixed ? raw->cap - raw->size < count : !reserve_bytes(raw, count)))
+		{
+			return 0;
+		}
+
+		// Short codes are decoded several at a time.
+		if (use_multi(count, bits))
+		{
+			build_multi_table(&dec, &multi);
+			res = decode_multi(&dec, &multi, src + pos, bytes, bits,
+				raw->buffer + raw->size, count);
+		}
+		else
+		{
+			res = decode_counted(&dec, src + pos, bytes, bits,
+				raw->buffer + raw->size, count);
+		}
+
+		if (!res)
+			return 0;
+
+		raw->size += count;
+
+		return 1;
+	}
+
+	hc = jep_huff_read(encoded);
+
+	if (hc == NULL)
+		return 0;
+
+	// Resolve as many codes as possible with table lookups
+	// and fall back to the tree for any that are too long.
+	build_decode_table(hc->dict, dec.entries);
+	dec.longest = 0;
+	dec.root = hc->tree->nodes;
+
+	res = decode_with_table(&dec, hc->data->bytes, hc->data->byte_count,
+		hc->data->bit_count, raw, fixed);
+
+	jep_destroy_huff_code(hc);
+
+	return res;
+}
+
+
+static int measure_block(const jep_byte* src, size_t n, size_t* size)
+{
+	size_t head;       // The size of the header and the code lengths
+	uint32_t range;    // The number of code lengths
+	uint32_t bits;     // The number of bits of data
+	uint32_t count;    // The number of raw bytes of a stored block
+	uint32_t streams;  // The number of bitstreams
+	uint32_t k;        // Index
+
+	if ((n > 0 && src[0] != huff_magic)
+		|| (n > 1 && !known_version(src[1]))
+		|| (n > 2 && src[2] != huff_type_code && src[2] != huff_type_split
+			&& src[2] != huff_type_stored && src[2] != huff_type_run
+			&& src[2] != huff_type_context && src[2] != huff_type_ans
+			&& src[2] != huff_type_checked))
+	{
+		return 0;
+	}
+
+	// The header determines how the rest of the block is measured.
+	if (n < 3)
+	{
+		*size = 3;
+		return 1;
+	}
+
+	if (src[2] == huff_type_run)
+	{
+		*size = huff_run_header;
+		return 1;
+	}
+
+	if (src[2] == huff_type_context)
+		return measure_context(src, n, size);
+
+	// An ANS block gives the size of its frame.
+	if (src[2] == huff_type_ans)
+	{
+		if (n < huff_ans_header)
+		{
+			*size = huff_ans_header;
+			return 1;
+		}
+
+		jep_build_u32(count, (src + 3));
+		*size = huff_ans_header + (size_t)count;
+		return 1;
+	}
+
+	// So does a checked block, for the block inside it.
+	if (src[2] == huff_type_checked)
+	{
+		if (n < huff_checked_header)
+		{
+			*size = huff_checked_header;
+			return 1;
+		}
+
+		jep_build_u32(count, (src + 3));
+		*size = huff_checked_header + (size_t)count;
+		return 1;
+	}
+
+	if (src[2] == huff_type_stored)
+	{
+		if (n < huff_stored_header)
+		{
+			*size = huff_stored_header;
+			return 1;
+		}
+
+		jep_build_u32(count, (src + 3));
+		*size = huff_stored_header + (size_t)count;
+		return 1;
+	}
+
+	// The length width and the byte range are needed
+	// to find the bit count.
+	if (n < 6)
+	{
+		*size = 6;
+		return 1;
+	}
+
+	if ((src[3] != 4 && src[3] != 8) || src[4] > src[5])
+		return 0;
+
+	range = (uint32_t)src[5] - src[4] + 1;
+	head = 6 + (src[3] == 4 ? (range + 1) / 2 : range);
+
+	// A split block has a byte count and then a bit count
+	// for each of its bitstreams. Coded blocks have a byte count
+	// unless they were written by the previous version.
+	streams = src[2] == huff_type_split ? HUFF_STREAMS : 1;
+
+	if (src[2] == huff_type_split || src[1] != huff_version_unsized)
+		head += 4;
+
+	if (n < head + 4 * streams)
+	{
+		*size = head + 4 * streams;
+		return 1;
+	}
+
+	*size = head + 4 * streams;
+
+	for (k = 0; k < streams; k++)
+	{
+		jep_build_u32(bits, (src + head + 4 * k));
+		*size += bits / CHAR_BIT + (bits % CHAR_BIT ? 1 : 0);
+	}
+
+	return 1;
+}
+
+
+static jep_huff_stream* create_stream(size_t block_size)
+{
+	jep_huff_stream* stream;
+
+	stream = jep_alloc(jep_huff_stream, 1);
+
+	if (stream == NULL)
+		return NULL;
+
+	stream->pending = jep_create_byte_buffer();
+
+	if (stream->pending == NULL)
+	{
+		free(stream);
+		return NULL;
+	}
+
+	stream->block_size = block_size;
+	stream->limit = JEP_HUFF_DEFAULT_CODE_LENGTH;
+	stream->coder = JEP_HUFF_CODER_HUFFMAN;
+	stream->checked = 0;
+	stream->partial = NULL;
+
+	return stream;
+}
+
+
+
+
+/*-----------------------------------------------------------------*/
+/*                        Threads Implementation                   */
+/*-----------------------------------------------------------------*/
+
+static int run_parallel(int (*task)(void*, uint32_t),
+	void* ctx,
+	uint32_t count,
+	uint32_t threads)
+{
+	huff_worker* workers; // The workers
+	uint32_t i;           // Index
+	int res;              // The combined result of the workers
+
+	if (threads == 0)
+		threads = count_processors();
+
+	if (threads > count)
+		threads = count;
+
+	if (threads == 0)
+		return 1;
+
+	workers = jep_alloc(huff_worker, threads);
+
+	if (workers == NULL)
+		return 0;
+
+	for (i = 0; i < threads; i++)
+	{
+		workers[i].task = task;
+		workers[i].ctx = ctx;
+		workers[i].first = i;
+		workers[i].step = threads;
+		workers[i].count = count;
+		workers[i].result = 1;
+		workers[i].started = 0;
+	}
+
+	// The calling thread does the work of the first worker
+	// while the others run on their own threads.
+	for (i = 1; i < threads; i++)
+		workers[i].started = start_worker(&workers[i]);
+
+	run_worker(&workers[0]);
+
+	res = workers[0].result;
+
+	for (i = 1; i < threads; i++)
+	{
+		if (workers[i].started)
+			join_worker(&workers[i]);
+		else
+			run_worker(&workers[i]);
+
+		res &= workers[i].result;
+	}
+
+	free(workers);
+
+	return res;
+}
+
+
+static void run_worker(huff_worker* w)
+{
+	uint32_t i;
+
+	for (i = w->first; i < w->count && w->result; i += w->step)
+		w->result = w->task(w->ctx, i);
+}
+
+
+#ifdef _WIN32
+
+static DWORD WINAPI worker_main(LPVOID arg)
+{
+	run_worker((huff_worker*)arg);
+	return 0;
+}
+
+
+static int start_worker(huff_worker* w)
+{
+	w->thread = CreateThread(NULL, 0, worker_main, w, 0, NULL);
+
+	return w->thread != NULL;
+}
+
+
+static void join_worker(huff_worker* w)
+{
+	WaitForSingleObject(w->thread, INFINITE);
+	CloseHandle(w->thread);
+}
+
+
+static uint32_t count_processors()
+{
+	SYSTEM_INFO info;
+
+	GetSystemInfo(&info);
+
+	return info.dwNumberOfProcessors > 0
+		? (uint32_t)info.dwNumberOfProcessors : 1;
+}
+
+#else
+
+static void* worker_main(void* arg)
+{
+	run_worker((huff_worker*)arg);
+	return NULL;
+}
+
+
+static int start_worker(huff_worker* w)
+{
+	return pthread_create(&w->thread, NULL, worker_main, w) == 0;
+}
+
+
+static void join_worker(huff_worker* w)
+{
+	pthread_join(w->thread, NULL);
+}
+
+
+static uint32_t count_processors()
+{
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return n > 0 ? (uint32_t)n : 1;
+}
+
+#endif
+
+
+
+
+/*-----------------------------------------------------------------*/
+/*                      Block Index Implementation                 */
+/*-----------------------------------------------------------------*/
+
+static int encode_block_task(void* ctx, uint32_t i)
+{
+	huff_block_job* job = (huff_block_job*)ctx;
+	size_t start;
+	size_t n;
+
+	start = (size_t)i * job->block_size;
+	n = job->size - start < job->block_size
+		? job->size - start : job->block_size;
+
+	job->blocks[i] = jep_create_byte_buffer();
+
+	if (job->blocks[i] == NULL)
+		return 0;
+
+	return encode_block(job->src + start, n, job->limit, job->coder,
+		job->blocks[i]);
+}
+
+
+static int write_index(huff_block_job* job,
+	uint32_t count,
+	jep_byte_buffer* out)
+{
+	jep_byte* dest;   // The next byte to be written
+	uint64_t offset;  // The offset of the current block
+	size_t total;     // The size of the container
+	uint32_t i;       // Index
+
+	total = huff_index_header + ((size_t)count + 1) * 8;
+	for (i = 0; i < count; i++)
+		total += job->blocks[i]->size;
+
+	if (!reserve_bytes(out, total))
+		return 0;
+
+	dest = out->buffer + out->size;
+
+	dest[0] = huff_magic;
+	dest[1] = huff_version;
+	dest[2] = huff_type_index;
+	jep_split_u32((uint32_t)job->block_size, (dest + 3));
+	jep_split_u32(count, (dest + 7));
+	split_u64(job->size, dest + 11);
+	dest += huff_index_header;
+
+	// The offset of each block is measured from the end of the index.
+	// A final offset marks the end of the last block.
+	offset = 0;
+	for (i = 0; i <= count; i++)
+	{
+		split_u64(offset, dest);
+		dest += 8;
+
+		if (i < count)
+			offset += job->blocks[i]->size;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		memcpy(dest, job->blocks[i]->buffer, job->blocks[i]->size);
+		dest += job->blocks[i]->size;
+	}
+
+	out->size += total;
+
+	return 1;
+}
+
+
+static int read_index(jep_byte_buffer* encoded, huff_index* index)
+{
+	const jep_byte* src; // The container
+	uint64_t head;       // The size of the header and the index
+	uint64_t expected;   // The number of blocks implied by the sizes
+
+	if (!is_indexed(encoded) || encoded->size < huff_index_header)
+		return 0;
+
+	src = encoded->buffer;
+
+	jep_build_u32(index->block_size, (src + 3));
+	jep_build_u32(index->count, (src + 7));
+	index->raw_size = build_u64(src + 11);
+
+	if (index->block_size == 0)
+		return 0;
+
+	expected = index->raw_size / index->block_size
+		+ (index->raw_size % index->block_size ? 1 : 0);
+
+	head = huff_index_header + ((uint64_t)index->count + 1) * 8;
+
+	if (expected != index->count || head > encoded->size)
+		return 0;
+
+	index->offsets = src + huff_index_header;
+	index->blocks = src + head;
+	index->blocks_size = encoded->size - head;
+
+	return 1;
+}
+
+
+static int decode_block_task(void* ctx, uint32_t i)
+{
+	huff_index_job* job = (huff_index_job*)ctx;
+	jep_byte_buffer block; // A view of the encoded block
+	jep_byte_buffer raw;   // A view of the place for the decoded block
+
+	if (!index_block(job->index, i, &block))
+		return 0;
+
+	raw.buffer = job->dest + (size_t)i * job->index->block_size;
+	raw.size = 0;
+	raw.cap = index_block_size(job->index, i);
+
+	if (!decode_block(&block, &raw, 1))
+		return 0;
+
+	return raw.size == raw.cap;
+}
+
+
+static int index_block(huff_index* index, uint32_t i, jep_byte_buffer* block)
+{
+	uint64_t start;
+	uint64_t end;
+
+	if (i >= index->count)
+		return 0;
+
+	start = build_u64(index->offsets + (size_t)i * 8);
+	end = build_u64(index->offsets + ((size_t)i + 1) * 8);
+
+	if (start >= end || end > index->blocks_size)
+		return 0;
+
+	block->buffer = (jep_byte*)index->blocks + start;
+	block->size = block->cap = (size_t)(end - start);
+
+	return 1;
+}
+
+
+static size_t index_block_size(huff_index* index, uint32_t i)
+{
+	uint64_t start = (uint64_t)i * index->block_size;
+
+	if (index->raw_size - start < index->block_size)
+		return (size_t)(index->raw_size - start);
+
+	return index->block_size;
+}
+
+
+static int is_indexed(jep_byte_buffer* encoded)
+{
+	return encoded->size >= 3
+		&& encoded->buffer[0] == huff_magic
+		&& known_version(encoded->buffer[1])
+		&& encoded->buffer[2] == huff_type_index;
+}
+
+
+static void split_u64(uint64_t n, jep_byte* b)
+{
+	jep_split_u32((uint32_t)n, b);
+	jep_split_u32((uint32_t)(n >> 32), (b + 4));
+}
+
+
+static uint64_t build_u64(const jep_byte* b)
+{
+	uint32_t lo;
+	uint32_t hi;
+
+	jep_build_u32(lo, b);
+	jep_build_u32(hi, (b + 4));
+
+	return ((uint64_t)hi << 32) | lo;
+}
+
+
+
+
+/*-----------------------------------------------------------------*/
+/*                  Interleaved Streams Implementation             */
+/*-----------------------------------------------------------------*/
+
+static size_t write_split(const jep_byte* lengths,
+	const huff_code_entry* table,
+	const jep_byte* src,
+	size_t n,
+	jep_byte* dest)
+{
+	jep_byte* meta;           // The byte and bit counts
+	uint64_t bits;            // The bits in a bitstream
+	size_t seg;               // The bytes in each segment
+	size_t start;             // The start of a segment
+	size_t end;               // The end of a segment
+	size_t pos;               // Position in the output
+	size_t i;                 // Index
+	int k;                    // Index
+
+	if (n > UINT32_MAX)
+		return 0;
+
+	seg = (n + HUFF_STREAMS - 1) / HUFF_STREAMS;
+
+	dest[0] = huff_magic;
+	dest[1] = huff_version;
+	dest[2] = huff_type_split;
+	pos = 3 + write_lengths(lengths, dest + 3);
+
+	meta = dest + pos;
+	jep_split_u32((uint32_t)n, meta);
+	pos += 4 + 4 * HUFF_STREAMS;
+
+	// Measure each bitstream so that the bit counts can be written
+	// ahead of the bitstreams.
+	for (k = 0; k < HUFF_STREAMS; k++)
+	{
+		start = (size_t)k * seg < n ? (size_t)k * seg : n;
+		end = start + seg < n ? start + seg : n;
+
+		bits = 0;
+		for (i = start; i < end; i++)
+			bits += table[src[i]].len;
+
+		if (bits > UINT32_MAX)
+			return 0;
+
+		jep_split_u32((uint32_t)bits, (meta + 4 + 4 * k));
+	}
+
+	for (k = 0; k < HUFF_STREAMS; k++)
+	{
+		start = (size_t)k * seg < n ? (size_t)k * seg : n;
+		end = start + seg < n ? start + seg : n;
+
+		pos += encode_with_table(table, src + start, end - start, dest + pos);
+	}
+
+	return pos;
+}
+
+
+static jep_bitstring* read_split_data(jep_byte_buffer* data, size_t* pos)
+{
+	jep_bitstring* bs;             // A bitstring to hold the data
+	jep_byte meta[4 + 4 * HUFF_STREAMS]; // The byte and bit counts
+	uint32_t bits[HUFF_STREAMS];   // The bits in each bitstream
+	uint64_t total;                // The bits in every bitstream
+	uint32_t left;                 // The bits left in a bitstream
+	uint32_t take;                 // The bits to be copied at once
+	size_t bytes;                  // The bytes in a bitstream
+	jep_byte* joined;              // The bytes of the joined bitstreams
+	huff_reader r;                 // Reads each bitstream
+	huff_writer w;                 // Writes the joined bitstreams
+	int k;                         // Index
+
+	if (read_from_buffer(meta, data, sizeof(meta), pos) != (int)sizeof(meta))
+		return NULL;
+
+	// Ensure that every bitstream is present before
+	// making room for all of them.
+	total = 0;
+	bytes = 0;
+	for (k = 0; k < HUFF_STREAMS; k++)
+	{
+		jep_build_u32(bits[k], (meta + 4 + 4 * k));
+		total += bits[k];
+		bytes += bits[k] / CHAR_BIT + (bits[k] % CHAR_BIT ? 1 : 0);
+	}
+
+	if (total == 0 || total > UINT32_MAX || data->size - *pos < bytes)
 		return NULL;
 
-	huff = create_huff_code();
-	data = jep_create_bitstring();
-	tree = create_tree();
+	bs = jep_create_bitstring();
+	joined = jep_alloc(jep_byte, total / CHAR_BIT + (total % CHAR_BIT ? 1 : 0));
 
-	// Check for failure to create any of the components
-	if (huff == NULL || data == NULL || tree == NULL)
+	if (bs == NULL || joined == NULL)
 	{
-		jep_destroy_huff_code(huff);
-		jep_destroy_bitstring(data);
-		destroy_tree(tree);
+		jep_destroy_bitstring(bs);
+		free(joined);
 		return NULL;
 	}
 
-	// Prepare the dictionary.
-	for (i = 0; i < UCHAR_MAX + 1; i++)
+	w.pos = joined;
+	w.bits = 0;
+	w.count = 0;
+
+	for (k = 0; k < HUFF_STREAMS; k++)
+	{
+		bytes = bits[k] / CHAR_BIT + (bits[k] % CHAR_BIT ? 1 : 0);
+
+		r.pos = data->buffer + *pos;
+		r.end = r.pos + bytes;
+		r.bits = 0;
+		r.count = 0;
+
+		// The bitstreams are not aligned to bytes,
+		// so they are copied up to 32 bits at a time.
+		for (left = bits[k]; left > 0; left -= take)
+		{
+			take = left < 32 ? left : 32;
+
+			if (r.count < take)
+				refill_reader(&r);
+
+			put_bits(&w, r.bits & (((uint64_t)1 << take) - 1), take);
+			r.bits >>= take;
+			r.count -= take;
+		}
+
+		*pos += bytes;
+	}
+
+	flush_writer(&w);
+
+	free(bs->bytes);
+	bs->bytes = joined;
+	bs->bit_count = (uint32_t)total;
+	bs->byte_count = (uint32_t)(total / CHAR_BIT + (total % CHAR_BIT ? 1 : 0));
+	bs->current_bits = (jep_byte)(total - (bs->byte_count - 1) * CHAR_BIT);
+
+	return bs;
+}
+
+
+static int decode_split(jep_byte_buffer* encoded,
+	jep_byte_buffer* raw,
+	int fixed)
+{
+	huff_decoder dec;                    // The decoder of every code
+	huff_multi_table multi;              // The decoder of short codes
+	jep_byte lengths[UCHAR_MAX + 1];     // The length of each code
+	const jep_byte* meta;                // The byte and bit counts
+	huff_reader r[HUFF_STREAMS];         // A reader for each bitstream
+	uint64_t remaining[HUFF_STREAMS];    // The bits left in each bitstream
+	size_t left[HUFF_STREAMS];           // The symbols left in each one
+	jep_byte* out[HUFF_STREAMS];         // The output of each bitstream
+	uint32_t n;                          // The number of bytes
+	uint32_t bits;                       // The bits in a bitstream
+	size_t seg;                          // The bytes in each segment
+	size_t start;                        // The start of a segment
+	size_t bytes;                        // The bytes in a bitstream
+	size_t pos;                          // Position in the input
+	uint64_t total;                      // The bits in every bitstream
+	uint32_t len;                        // The length of a code
+	uint16_t e;                          // A table entry
+	uint32_t m;                          // A multi-symbol table entry
+	int short_codes;                     // 1 if multi is used
+	int j, k;                            // Indices
+	int res;                             // The result of decoding
+
+	if (encoded->size < 3 || !known_version(encoded->buffer[1])
+		|| encoded->buffer[2] != huff_type_split)
+	{
+		return 0;
+	}
+
+	pos = read_lengths(encoded->buffer + 3, encoded->size - 3, lengths);
+
+	if (pos == 0 || !build_decoder(lengths, &dec))
+		return 0;
+
+	pos += 3;
+
+	if (encoded->size - pos < 4 + 4 * HUFF_STREAMS)
+		return 0;
+
+	meta = encoded->buffer + pos;
+	pos += 4 + 4 * HUFF_STREAMS;
+
+	jep_build_u32(n, meta);
+
+	seg = ((size_t)n + HUFF_STREAMS - 1) / HUFF_STREAMS;
+
+	// Every code has at least one bit, so a bitstream cannot
+	// hold more symbols than bits.
+	total = 0;
+	for (k = 0; k < HUFF_STREAMS; k++)
+	{
+		jep_build_u32(bits, (meta + 4 + 4 * k));
+		total += bits;
+		bytes = bits / CHAR_BIT + (bits % CHAR_BIT ? 1 : 0);
+
+		start = (size_t)k * seg < n ? (size_t)k * seg : n;
+		left[k] = n - start < seg ? n - start : seg;
+
+		if (encoded->size - pos < bytes || left[k] > bits)
+			return 0;
+
+		r[k].pos = encoded->buffer + pos;
+		r[k].end = r[k].pos + bytes;
+		r[k].bits = 0;
+		r[k].count = 0;
+		remaining[k] = bits;
+
+		pos += bytes;
+	}
+
+	// Make room for every decoded byte before any are decoded.
+	if (fixed ? raw->cap - raw->size < n : !reserve_bytes(raw, n))
+		return 0;
+
+	for (k = 0; k < HUFF_STREAMS; k++)
 	{
-		bytes[i].b = (jep_byte)i;
-		bytes[i].f = 0;
-		bytes[i].w = 0;
-		bytes[i].n = 1;
-		bytes[i].code = NULL;
+		start = (size_t)k * seg < n ? (size_t)k * seg : n;
+		out[k] = raw->buffer + raw->size + start;
 	}
 
-	// Determine the unique bytes.
-	// Any bitstrings created here will be destroyed
-	// when the dictionary is destroyed.
-	unique = 0;
-	for (i = 0; i < raw->size; i++)
+	// Short codes are decoded several at a time, with four lookups
+	// in each bitstream for every refill, as in decode_multi.
+	short_codes = use_multi(n, total) && dec.longest <= HUFF_TABLE_BITS;
+
+	if (short_codes)
+		build_multi_table(&dec, &multi);
+
+	while (short_codes)
 	{
-		if (bytes[raw->buffer[i]].f == 0)
+		for (k = 0; k < HUFF_STREAMS; k++)
 		{
-			unique++;
-			bytes[raw->buffer[i]].code = jep_create_bitstring();
+			if (left[k] < 4 * HUFF_MULTI_SYMS
+				|| remaining[k] < 4 * HUFF_MULTI_BITS
+				|| r[k].end - r[k].pos < 8)
+			{
+				break;
+			}
+		}
 
-			// Check for failure to create bitstring
-			if (bytes[raw->buffer[i]].code == NULL)
+		if (k < HUFF_STREAMS)
+			break;
+
+		for (k = 0; k < HUFF_STREAMS; k++)
+			refill_reader(&r[k]);
+
+		for (j = 0; j < 4; j++)
+		{
+			for (k = 0; k < HUFF_STREAMS; k++)
 			{
-				jep_destroy_huff_code(huff);
-				jep_destroy_bitstring(data);
-				destroy_tree(tree);
-				return NULL;
+				m = multi.entries[r[k].bits & (HUFF_MULTI_SIZE - 1)];
+				len = multi_len(m);
+
+				out[k][0] = (jep_byte)m;
+				out[k][1] = (jep_byte)(m >> 8);
+				out[k][2] = (jep_byte)(m >> 16);
+				out[k] += multi_count(m);
+				left[k] -= multi_count(m);
+				r[k].bits >>= len;
+				r[k].count -= len;
+				remaining[k] -= len;
 			}
 		}
-		bytes[raw->buffer[i]].f++;
 	}
 
-	// Create Huffman leaf nodes.
-	// Any nodes created here will be destroyed
-	// when the tree is destroyed.
-	for (i = 0; i < UCHAR_MAX + 1; i++)
+	// Decode four symbols from each bitstream for every refill.
+	// The bitstreams do not depend on each other, so their table
+	// lookups can all be in flight at once.
+	while (dec.longest <= HUFF_TABLE_BITS)
 	{
-		if (bytes[i].f > 0)
+		for (k = 0; k < HUFF_STREAMS; k++)
 		{
-			jep_huff_node* node = create_leaf_node();
-
-			// Check for failure to create leaf node
-			if (node == NULL)
+			if (left[k] < 4 || remaining[k] < 4 * HUFF_TABLE_BITS
+				|| r[k].end - r[k].pos < 8)
 			{
-				jep_destroy_huff_code(huff);
-				jep_destroy_bitstring(data);
-				destroy_tree(tree);
-				return NULL;
+				break;
 			}
+		}
+
+		if (k < HUFF_STREAMS)
+			break;
+
+		for (k = 0; k < HUFF_STREAMS; k++)
+			refill_reader(&r[k]);
+
+		for (j = 0; j < 4; j++)
+		{
+			for (k = 0; k < HUFF_STREAMS; k++)
+			{
+				e = dec.entries[r[k].bits & (HUFF_TABLE_SIZE - 1)];
+				len = entry_len(e);
 
-			node->next = NULL;
-			node->leaf_1 = NULL;
-			node->leaf_2 = NULL;
-			node->sym = bytes[i];
-			add_leaf_node(tree, node);
+				*(out[k]++) = entry_sym(e);
+				r[k].bits >>= len;
+				r[k].count -= len;
+				remaining[k] -= len;
+			}
 		}
-	}
 
-	// Sort the list of leaf nodes.
-	sort_leaf_nodes(tree);
+		for (k = 0; k < HUFF_STREAMS; k++)
+			left[k] -= 4;
+	}
 
-	// Construct the tree and check for failure.
-	if (!construct_tree(tree))
+	// Finish each bitstream on its own. Every bit must belong
+	// to a symbol.
+	res = 1;
+	for (k = 0; k < HUFF_STREAMS && res; k++)
 	{
-		jep_destroy_huff_code(huff);
-		jep_destroy_bitstring(data);
-		destroy_tree(tree);
+		res = decode_symbols(&dec, &r[k], &remaining[k], out[k], left[k])
+			&& remaining[k] == 0;
+	}
+
+	if (res)
+		raw->size += n;
+
+	return res;
+}
+
+
+
+
+/*-----------------------------------------------------------------*/
+/*                    Shared Tables Implementation                 */
+/*-----------------------------------------------------------------*/
+
+static jep_huff_table* create_table(jep_huff_dict* dict)
+{
+	jep_huff_table* table;           // The table to be created
+	huff_lookup* lookup;             // The encoding and decoding tables
+	jep_byte lengths[UCHAR_MAX + 1]; // The length of each code
+	uint32_t i;                      // Index
+
+	if (dict == NULL || dict->count != UCHAR_MAX + 1)
 		return NULL;
+
+	for (i = 0; i < dict->count; i++)
+	{
+		if (dict->symbols[i].code == NULL
+			|| dict->symbols[i].code->bit_count > JEP_HUFF_MAX_CODE_LENGTH)
+		{
+			return NULL;
+		}
+
+		lengths[dict->symbols[i].b] = (jep_byte)dict->symbols[i].code->bit_count;
 	}
 
-	// Assign bitcodes and check for failure.
-	if (!assign_bitcodes(tree))
+	table = jep_alloc(jep_huff_table, 1);
+	lookup = jep_alloc(huff_lookup, 1);
+
+	if (table == NULL || lookup == NULL
+		|| !build_code_table(lengths, lookup->codes)
+		|| !build_decoder(lengths, &lookup->decoder))
 	{
-		jep_destroy_huff_code(huff);
-		jep_destroy_bitstring(data);
-		destroy_tree(tree);
+		free(table);
+		free(lookup);
 		return NULL;
 	}
 
-	// Create the bitcode dictionary.
-	dict = create_dict(unique);
+	table->dict = dict;
+	table->lookup = lookup;
 
-	// Check for failure to create the dictionary.
-	if (dict == NULL)
+	return table;
+}
+
+
+static size_t write_varint(uint64_t n, jep_byte* dest)
+{
+	size_t i; // Index
+
+	for (i = 0; n >= 0x80; i++)
 	{
-		jep_destroy_huff_code(huff);
-		jep_destroy_bitstring(data);
-		destroy_tree(tree);
-		return NULL;
+		dest[i] = (jep_byte)(n | 0x80);
+		n >>= 7;
 	}
 
-	// Populate the bitcode dictionary.
-	for (i = 0, j = 0; i < UCHAR_MAX + 1; i++)
+	dest[i] = (jep_byte)n;
+
+	return i + 1;
+}
+
+
+static size_t read_varint(const jep_byte* src, size_t n, uint64_t* value)
+{
+	uint64_t v;     // The integer read so far
+	uint32_t shift; // The position of the next seven bits
+	size_t i;       // Index
+
+	v = 0;
+	shift = 0;
+
+	for (i = 0; i < n && i < HUFF_VARINT_MAX; i++)
 	{
-		if (bytes[i].f > 0)
+		// The tenth byte only has room for the highest bit.
+		if (shift == 63 && src[i] > 1)
+			return 0;
+
+		v |= (uint64_t)(src[i] & 0x7F) << shift;
+
+		if ((src[i] & 0x80) == 0)
 		{
-			dict->symbols[j].b = bytes[i].b;
-			dict->symbols[j].f = bytes[i].f;
-			dict->symbols[j].n = bytes[i].n;
-			dict->symbols[j++].code = bytes[i].code;
+			*value = v;
+			return i + 1;
 		}
+
+		shift += 7;
 	}
-	dict->count = j;
 
-	// Encode the data
-	for (i = 0; i < raw->size; i++)
+	return 0;
+}
+
+
+
+
+/*-----------------------------------------------------------------*/
+/*                      Raw Blocks Implementation                  */
+/*-----------------------------------------------------------------*/
+
+static size_t write_stored(const jep_byte* src,
+	size_t n,
+	jep_byte* dest,
+	size_t cap)
+{
+	if (n > UINT32_MAX || cap < huff_stored_header
+		|| cap - huff_stored_header < n)
 	{
-		for (j = 0; j < unique; j++)
-		{
-			if (dict->symbols[j].b == raw->buffer[i])
-			{
-				// Add bits and check for failure
-				if (!jep_add_bits(data, dict->symbols[j].code))
-				{
-					jep_destroy_huff_code(huff);
-					jep_destroy_bitstring(data);
-					destroy_tree(tree);
-					return NULL;
-				}
-			}
-		}
+		return 0;
 	}
 
-	huff->tree = tree;
-	huff->dict = dict;
-	huff->data = data;
+	dest[0] = huff_magic;
+	dest[1] = huff_version;
+	dest[2] = huff_type_stored;
+	jep_split_u32((uint32_t)n, (dest + 3));
 
-	encoded = jep_create_byte_buffer();
+	if (n > 0)
+		memcpy(dest + huff_stored_header, src, n);
 
-	if (encoded == NULL)
+	return huff_stored_header + n;
+}
+
+
+static size_t write_run(jep_byte b, size_t n, jep_byte* dest, size_t cap)
+{
+	if (n > UINT32_MAX || cap < huff_run_header)
+		return 0;
+
+	dest[0] = huff_magic;
+	dest[1] = huff_version;
+	dest[2] = huff_type_run;
+	dest[3] = b;
+	jep_split_u32((uint32_t)n, (dest + 4));
+
+	return huff_run_header;
+}
+
+
+static int decode_raw(jep_byte_buffer* encoded,
+	jep_byte_buffer* raw,
+	int fixed)
+{
+	const jep_byte* src; // The bytes of the block
+	uint32_t count;      // The number of raw bytes
+	int run;             // 1 if the block is a run block
+
+	src = encoded->buffer;
+	run = src[2] == huff_type_run;
+
+	if (encoded->size < (run ? huff_run_header : huff_stored_header)
+		|| !known_version(src[1]))
 	{
-		jep_destroy_huff_code(huff);
-		return NULL;
+		return 0;
 	}
 
-	// Write the Huffman Coding data to the output buffer.
-	jep_huff_write(huff, encoded);
+	jep_build_u32(count, (src + (run ? 4 : 3)));
 
-	return encoded;
+	if (!run && encoded->size - huff_stored_header < count)
+		return 0;
+
+	if (raw->cap - raw->size < count)
+	{
+		if (fixed || !reserve_bytes(raw, count))
+			return 0;
+	}
+
+	if (run)
+		memset(raw->buffer + raw->size, src[3], count);
+	else if (count > 0)
+		memcpy(raw->buffer + raw->size, src + huff_stored_header, count);
+
+	raw->size += count;
+
+	return 1;
 }
 
-JEP_UTILS_API jep_byte_buffer* JEP_UTILS_CALL
-jep_huff_decode(jep_byte_buffer* encoded)
+
+static uint64_t coded_size(const jep_byte* lengths, uint64_t bits, size_t n)
 {
-	jep_byte_buffer* raw; // The decoded data
-	jep_huff_code* hc;    // Huffman Coding data
-	jep_huff_node* root;  // The root node of the Huffman tree
-	jep_huff_node* leaf;  // The current leaf node
-	uint32_t byte;        // Current byte of a bitstring
-	uint32_t bit;         // Current bit of a byte in a bitstring
-	uint32_t i;           // Index
+	uint64_t size;    // The size of the block
+	uint32_t streams; // The number of bitstreams
 
-	if (encoded == NULL)
-		return NULL;
+	// The header, the code lengths, the byte count, and the bit count
+	// of each bitstream, each of which may end with a partial byte.
+	streams = n >= HUFF_SPLIT_MIN ? HUFF_STREAMS : 1;
+	size = 3 + lengths_size(lengths) + 4;
+	size += (uint64_t)streams * 5 + bits / CHAR_BIT;
 
-	hc = jep_huff_read(encoded);
+	return size;
+}
 
-	if (hc == NULL)
-		return NULL;
 
-	raw = jep_create_byte_buffer();
 
-	if (raw == NULL)
+
+/*-----------------------------------------------------------------*/
+/*                   Context Modeling Implementation               */
+/*-----------------------------------------------------------------*/
+
+static size_t encode_context(const jep_byte* src,
+	size_t n,
+	huff_context_model* model,
+	jep_byte* dest,
+	size_t cap)
+{
+	uint32_t counts[JEP_HISTOGRAM_SIZE]; // The frequency of each byte
+	jep_byte lengths[UCHAR_MAX + 1];     // The order-0 code lengths
+	uint64_t plain;                      // The size of an order-0 block
+	uint64_t size;                       // The size of the context block
+	uint64_t bits;                       // The bits of an order-0 block
+	uint32_t i;                          // Index
+
+	if (n < HUFF_CONTEXT_MIN || n > UINT32_MAX
+		|| !build_context_model(src, n, model) || model->count < 2)
+	{
+		return encode_frame(src, n, JEP_HUFF_DEFAULT_CODE_LENGTH, dest, cap,
+			NULL);
+	}
+
+	// Estimate the block that encode_frame would write,
+	// which never holds more than the raw bytes.
+	if (!jep_byte_histogram(src, n, counts)
+		|| !build_code_lengths(counts, JEP_HUFF_DEFAULT_CODE_LENGTH, lengths))
+	{
+		return 0;
+	}
+
+	bits = 0;
+	for (i = 0; i <= UCHAR_MAX; i++)
+		bits += (uint64_t)counts[i] * lengths[i];
+
+	plain = coded_size(lengths, bits, n);
+
+	if (plain > huff_stored_header + (uint64_t)n)
+		plain = huff_stored_header + (uint64_t)n;
+
+	size = context_size(model);
+
+	if (size >= plain || model->bits > UINT32_MAX)
+		return encode_frame(src, n, JEP_HUFF_DEFAULT_CODE_LENGTH, dest, cap,
+			NULL);
+
+	if (size > cap)
+		return 0;
+
+	return write_context(model, src, n, dest);
+}
+
+
+static int build_context_model(const jep_byte* src,
+	size_t n,
+	huff_context_model* model)
+{
+	uint64_t weight[UCHAR_MAX + 1]; // The number of bytes after each byte
+	uint32_t table[HUFF_CONTEXTS];  // The new position of each table
+	const uint32_t* row;            // The counts after a previous byte
+	uint64_t cost;                  // The bits of a previous byte's row
+	uint64_t best_cost;             // The fewest bits of the row so far
+	uint32_t best;                  // The table with the fewest bits
+	uint32_t count;                 // The number of tables
+	uint32_t prev;                  // The previous byte
+	uint32_t round;                 // The current round of assignment
+	uint32_t c, k, i;               // Indices
+	int changed;                    // 1 if any previous byte moved
+
+	memset(model->counts, 0, sizeof(model->counts));
+
+	// Count every pair of bytes.
+	prev = 0;
+	for (i = 0; i < n; i++)
 	{
-		jep_destroy_huff_code(hc);
-		return NULL;
+		model->counts[(prev << 8) | src[i]]++;
+		prev = src[i];
 	}
 
+	for (c = 0; c <= UCHAR_MAX; c++)
+	{
+		weight[c] = 0;
+		for (i = 0; i <= UCHAR_MAX; i++)
+			weight[c] += model->counts[(c << 8) | i];
 
-	root = hc->tree->nodes;
-	leaf = root;
-	bit = byte = 0;
+		model->map[c] = HUFF_CONTEXTS;
+	}
 
-	// Traverse the Huffman tree.
-	// Starting from the root node,
-	// if the current bit in the bitstring is 1, we move on
-	// to leaf 1 of the current node, otherwise we move to leaf 2.
-	// Upon reaching the last node of a branch, we add the byte value
-	// stored in that node to the output buffer.
-	for (i = 0; i <= hc->data->bit_count; i++)
+	// Each of the most common previous bytes begins its own table.
+	for (count = 0; count < HUFF_CONTEXTS; count++)
 	{
-		// Update the bitstring position variables
-		// checking the current bit advances the bit counter.
-		// Once that has reached CHAR_BIT, we reset it and
-		// advance the byte counter.
-		if (bit == CHAR_BIT)
+		best = UCHAR_MAX + 1;
+		for (c = 0; c <= UCHAR_MAX; c++)
 		{
-			byte++;
-			bit = 0;
+			if (model->map[c] == HUFF_CONTEXTS && weight[c] > 0
+				&& (best > UCHAR_MAX || weight[c] > weight[best]))
+			{
+				best = c;
+			}
 		}
 
-		if (leaf->sym.w == 0)
+		if (best > UCHAR_MAX)
+			break;
+
+		model->map[best] = (jep_byte)count;
+	}
+
+	for (round = 0; round < HUFF_CONTEXT_ROUNDS; round++)
+	{
+		// Every byte is given a code in every table while the tables
+		// are being chosen, so that any previous byte can be tried
+		// with any table.
+		for (k = 0; k < count; k++)
 		{
-			// Attempt to add the byte to the output
-			// buffer and check for failure.
-			if (!jep_append_byte(raw, leaf->sym.b))
-			{
-				jep_destroy_byte_buffer(raw);
-				return NULL;
-			}
+			for (i = 0; i <= UCHAR_MAX; i++)
+				model->totals[k][i] = 1;
+		}
+
+		for (c = 0; c <= UCHAR_MAX; c++)
+		{
+			if (model->map[c] >= count)
+				continue;
 
-			leaf = root;
-			i--;
+			row = model->counts + (c << 8);
+			for (i = 0; i <= UCHAR_MAX; i++)
+				model->totals[model->map[c]][i] += row[i];
 		}
-		else
+
+		for (k = 0; k < count; k++)
 		{
-			// Determine which leaf node to visit next
-			// and advance the bit counter
-			if (hc->data->bytes[byte] & (1 << bit++))
-			{
-				leaf = leaf->leaf_1;
-			}
-			else
+			if (!build_code_lengths(model->totals[k],
+				JEP_HUFF_DEFAULT_CODE_LENGTH, model->lengths[k]))
 			{
-				leaf = leaf->leaf_2;
+				return 0;
 			}
 		}
-	}
 
-	return raw;
-}
+		changed = 0;
+		for (c = 0; c <= UCHAR_MAX; c++)
+		{
+			if (weight[c] == 0)
+				continue;
 
-JEP_UTILS_API jep_huff_code* JEP_UTILS_CALL
-jep_huff_read(jep_byte_buffer* raw)
-{
-	jep_huff_tree* tree;
-	jep_huff_dict* dict;
-	jep_bitstring* bs;
-	jep_huff_code* hc;
+			row = model->counts + (c << 8);
+			best = 0;
+			best_cost = 0;
 
-	size_t pos = 0;
+			for (k = 0; k < count; k++)
+			{
+				cost = 0;
+				for (i = 0; i <= UCHAR_MAX; i++)
+					cost += (uint64_t)row[i] * model->lengths[k][i];
+
+				if (k == 0 || cost < best_cost)
+				{
+					best = k;
+					best_cost = cost;
+				}
+			}
 
-	// Read the dictionary.
-	dict = read_huff_dict(raw, &pos);
+			if (model->map[c] != best)
+			{
+				model->map[c] = (jep_byte)best;
+				changed = 1;
+			}
+		}
 
-	if (dict == NULL)
-		return NULL;
+		if (!changed)
+			break;
+	}
 
-	// Read the data
-	bs = read_huff_data(raw, &pos);
+	// Drop any table that no previous byte chose, and give the
+	// previous bytes that never occur the first table.
+	for (k = 0; k < count; k++)
+		table[k] = HUFF_CONTEXTS;
 
-	if (bs == NULL)
+	model->count = 0;
+	for (c = 0; c <= UCHAR_MAX; c++)
 	{
-		destroy_dict(dict);
-		return NULL;
+		if (weight[c] > 0 && table[model->map[c]] == HUFF_CONTEXTS)
+			table[model->map[c]] = model->count++;
 	}
 
-	// Reconstruct a Huffman tree
-	tree = reconstruct_tree(dict);
+	for (c = 0; c <= UCHAR_MAX; c++)
+		model->map[c] = weight[c] > 0 ? (jep_byte)table[model->map[c]] : 0;
 
-	if (tree == NULL)
+	// Build the final tables from the bytes that actually follow
+	// their previous bytes.
+	for (k = 0; k < model->count; k++)
 	{
-		destroy_dict(dict);
-		jep_destroy_bitstring(bs);
-		return NULL;
+		for (i = 0; i <= UCHAR_MAX; i++)
+			model->totals[k][i] = 0;
 	}
 
-	// Create and populate the Huffman Coding context
-	hc = create_huff_code();
+	for (c = 0; c <= UCHAR_MAX; c++)
+	{
+		row = model->counts + (c << 8);
+		for (i = 0; i <= UCHAR_MAX; i++)
+			model->totals[model->map[c]][i] += row[i];
+	}
 
-	if (hc == NULL)
+	model->bits = 0;
+	for (k = 0; k < model->count; k++)
 	{
-		destroy_dict(dict);
-		jep_destroy_bitstring(bs);
-		destroy_tree(tree);
-		return NULL;
+		if (!build_code_lengths(model->totals[k],
+			JEP_HUFF_DEFAULT_CODE_LENGTH, model->lengths[k])
+			|| !build_code_table(model->lengths[k], model->codes[k]))
+		{
+			return 0;
+		}
+
+		for (i = 0; i <= UCHAR_MAX; i++)
+			model->bits += (uint64_t)model->totals[k][i] * model->codes[k][i].len;
 	}
 
-	hc->tree = tree;
-	hc->dict = dict;
-	hc->data = bs;
+	return 1;
+}
 
-	return hc;
+
+static uint32_t context_map_bits(uint32_t count)
+{
+	uint32_t bits; // The number of bits per entry
+
+	bits = 0;
+	while ((1U << bits) < count)
+		bits++;
+
+	return bits;
 }
 
-JEP_UTILS_API int JEP_UTILS_CALL
-jep_huff_write(jep_huff_code* hc, jep_byte_buffer* buffer)
+
+static uint64_t context_size(const huff_context_model* model)
 {
-	if (hc == NULL || buffer == NULL)
-		return 0;
+	uint64_t size; // The size of the block
+	uint32_t k;    // Index
 
-	if (hc->dict == NULL || hc->data == NULL)
-		return 0;
+	// The header, the number of tables, and the map.
+	size = 4 + ((UCHAR_MAX + 1) * context_map_bits(model->count) + 7) / 8;
 
-	write_huff_dict(hc->dict, buffer);
-	write_huff_data(hc->data, buffer);
+	for (k = 0; k < model->count; k++)
+		size += lengths_size(model->lengths[k]);
 
-	return 1;
+	// The byte and bit counts, and the bits.
+	size += 8 + model->bits / CHAR_BIT + (model->bits % CHAR_BIT ? 1 : 0);
+
+	return size;
 }
 
-JEP_UTILS_API void JEP_UTILS_CALL
-jep_destroy_huff_code(jep_huff_code* hc)
+
+static size_t write_context(const huff_context_model* model,
+	const jep_byte* src,
+	size_t n,
+	jep_byte* dest)
 {
-	if (hc == NULL)
-		return;
+	const huff_code_entry* e; // The code of the current byte
+	huff_writer w;            // The bit writer
+	uint32_t width;           // The bits per map entry
+	jep_byte prev;            // The previous byte
+	size_t pos;               // Position in the output
+	size_t i;                 // Index
+	uint32_t k;               // Index
 
-	destroy_dict(hc->dict);
-	destroy_tree(hc->tree);
-	jep_destroy_bitstring(hc->data);
+	dest[0] = huff_magic;
+	dest[1] = huff_version;
+	dest[2] = huff_type_context;
+	dest[3] = (jep_byte)model->count;
 
-	free(hc);
-}
+	// The map is packed with the first entry in the lowest bits.
+	width = context_map_bits(model->count);
 
+	w.pos = dest + 4;
+	w.bits = 0;
+	w.count = 0;
 
+	for (i = 0; i <= UCHAR_MAX && width > 0; i++)
+		put_bits(&w, model->map[i], width);
 
+	flush_writer(&w);
+	pos = (size_t)(w.pos - dest);
 
-/*-----------------------------------------------------------------*/
-/*                 Memory Management Implementation                */
-/*-----------------------------------------------------------------*/
+	for (k = 0; k < model->count; k++)
+		pos += write_lengths(model->lengths[k], dest + pos);
 
-static jep_huff_node* create_leaf_node()
-{
-	jep_huff_node* node;
+	jep_split_u32((uint32_t)n, (dest + pos));
+	jep_split_u32((uint32_t)model->bits, (dest + pos + 4));
+	pos += 8;
 
-	node = jep_alloc(jep_huff_node, 1);
+	w.pos = dest + pos;
+	w.bits = 0;
+	w.count = 0;
 
-	if (node == NULL)
-		return NULL;
+	prev = 0;
+	for (i = 0; i < n; i++)
+	{
+		e = &(model->codes[model->map[prev]][src[i]]);
+		put_bits(&w, e->bits, e->len);
+		prev = src[i];
+	}
 
-	node->leaf_1 = NULL;
-	node->leaf_2 = NULL;
-	node->next = NULL;
-	node->prev = NULL;
-	node->sym.code = NULL;
-	node->sym.b = 0;
-	node->sym.f = 0;
-	node->sym.w = 0;
-	node->sym.n = 0;
+	flush_writer(&w);
 
-	return node;
+	return (size_t)(w.pos - dest);
 }
 
-static void destroy_leaf_node(jep_huff_node* node)
+
+static int decode_context(jep_byte_buffer* encoded,
+	jep_byte_buffer* raw,
+	int fixed)
 {
-	if (node == NULL)
-		return;
+	huff_decoder dec[HUFF_CONTEXTS];        // The decoder of each table
+	const huff_decoder* select[UCHAR_MAX + 1]; // The decoder after each byte
+	jep_byte lengths[UCHAR_MAX + 1];        // The code lengths of a table
+	const jep_byte* src;                    // The bytes of the block
+	huff_reader r;                          // The bit reader
+	jep_byte* out;                          // The next decoded byte
+	jep_byte* end;                          // The end of the output
+	uint64_t remaining;                     // The bits left to decode
+	uint32_t longest;                       // The longest code of any table
+	uint32_t count;                         // The number of tables
+	uint32_t width;                         // The bits per map entry
+	uint32_t n;                             // The number of decoded bytes
+	uint32_t bits;                          // The number of bits of data
+	uint32_t len;                           // The length of a code
+	uint32_t t;                             // The table of a previous byte
+	size_t bytes;                           // The bytes of data
+	size_t pos;                             // Position in the block
+	size_t used;                            // The bytes read by a step
+	jep_byte prev;                          // The previous byte
+	uint16_t e;                             // A table entry
+	uint32_t i, k;                          // Indices
+
+	src = encoded->buffer;
+
+	if (encoded->size < 4 || !known_version(src[1])
+		|| src[2] != huff_type_context)
+	{
+		return 0;
+	}
 
-	if (node->leaf_1 != NULL)
-		destroy_leaf_node(node->leaf_1);
+	count = src[3];
 
-	if (node->leaf_2 != NULL)
-		destroy_leaf_node(node->leaf_2);
+	if (count < 1 || count > HUFF_CONTEXTS)
+		return 0;
 
-	// Disposal of bitstrings is handled in destroy_dict.
+	width = context_map_bits(count);
+	pos = 4 + ((UCHAR_MAX + 1) * width + 7) / 8;
 
-	free(node);
-}
+	if (encoded->size < pos)
+		return 0;
 
-static jep_huff_dict* create_dict(size_t count)
-{
-	jep_huff_dict* dict;
-	jep_huff_sym* symbols;
-	size_t i;
+	for (i = 0; i <= UCHAR_MAX; i++)
+	{
+		t = 0;
+		for (k = 0; k < width; k++)
+		{
+			if (src[4 + (i * width + k) / CHAR_BIT] & (1 << ((i * width + k) % CHAR_BIT)))
+				t |= 1U << k;
+		}
 
-	dict = jep_alloc(jep_huff_dict, 1);
+		if (t >= count)
+			return 0;
 
-	if (dict == NULL)
-		return NULL;
+		select[i] = &dec[t];
+	}
 
-	dict->count = count;
+	longest = 0;
+	for (k = 0; k < count; k++)
+	{
+		used = read_lengths(src + pos, encoded->size - pos, lengths);
 
-	symbols = jep_alloc(jep_huff_sym, count);
+		if (used == 0 || !build_decoder(lengths, &dec[k]))
+			return 0;
 
-	if (symbols == NULL)
-	{
-		free(dict);
-		return NULL;
+		if (dec[k].longest > longest)
+			longest = dec[k].longest;
+
+		pos += used;
 	}
 
-	for (i = 0; i < count; i++)
+	if (encoded->size - pos < 8)
+		return 0;
+
+	jep_build_u32(n, (src + pos));
+	jep_build_u32(bits, (src + pos + 4));
+	pos += 8;
+	bytes = bits / CHAR_BIT + (bits % CHAR_BIT ? 1 : 0);
+
+	// Every code has at least one bit and no more bits than the
+	// longest code, so a byte count that the bits cannot hold is
+	// rejected before anything is allocated.
+	if (encoded->size - pos < bytes || n > bits
+		|| (uint64_t)n * longest < bits)
 	{
-		symbols[i].code = NULL;
+		return 0;
 	}
 
-	dict->symbols = symbols;
+	if (fixed ? raw->cap - raw->size < n : !reserve_bytes(raw, n))
+		return 0;
 
-	return dict;
-}
+	r.pos = src + pos;
+	r.end = r.pos + bytes;
+	r.bits = 0;
+	r.count = 0;
+
+	remaining = bits;
+	out = raw->buffer + raw->size;
+	end = out + n;
+	prev = 0;
+
+	// Decode four symbols for every refill of the bit reader.
+	// See decode_with_table. Each lookup depends on the symbol before
+	// it, but the output never has to be checked.
+	while (end - out >= 4 && remaining >= 4 * HUFF_TABLE_BITS
+		&& r.end - r.pos >= 8)
+	{
+		refill_reader(&r);
 
-static void destroy_dict(jep_huff_dict* dict)
-{
-	if (dict == NULL)
-		return;
+		for (k = 0; k < 4; k++)
+		{
+			e = select[prev]->entries[r.bits & (HUFF_TABLE_SIZE - 1)];
+			len = entry_len(e);
 
-	uint32_t i;
+			if (len == 0)
+				break;
 
-	for (i = 0; i < dict->count; i++)
-		jep_destroy_bitstring(dict->symbols[i].code);
+			prev = *out++ = entry_sym(e);
+			r.bits >>= len;
+			r.count -= len;
+			remaining -= len;
+		}
 
-	if (dict->symbols != NULL)
-		free(dict->symbols);
+		// Long codes are handled one at a time.
+		if (k < 4)
+		{
+			if (!decode_symbols(select[prev], &r, &remaining, out, 1))
+				return 0;
 
-	free(dict);
-}
+			prev = *out++;
+		}
+	}
 
-static jep_huff_tree* create_tree()
-{
-	jep_huff_tree* tree;
+	while (out < end)
+	{
+		if (!decode_symbols(select[prev], &r, &remaining, out, 1))
+			return 0;
 
-	tree = jep_alloc(jep_huff_tree, 1);
+		prev = *out++;
+	}
 
-	if (tree == NULL)
-		return NULL;
+	// Every bit must belong to a symbol.
+	if (remaining != 0)
+		return 0;
 
-	tree->nodes = NULL;
+	raw->size += n;
 
-	return tree;
+	return 1;
 }
 
-static void destroy_tree(jep_huff_tree* tree)
-{
-	if (tree == NULL)
-		return;
 
-	jep_huff_node* node = tree->nodes;
-	jep_huff_node* next = NULL;
+static int measure_context(const jep_byte* src, size_t n, size_t* size)
+{
+	uint32_t count; // The number of tables
+	uint32_t range; // The number of code lengths of a table
+	uint32_t bits;  // The number of bits of data
+	size_t pos;     // Position in the block
+	uint32_t k;     // Index
 
-	while (node != NULL)
+	if (n < 4)
 	{
-		next = node->next;
-		destroy_leaf_node(node);
-		node = next;
+		*size = 4;
+		return 1;
 	}
 
-	free(tree);
-}
+	count = src[3];
 
-static jep_huff_code* create_huff_code()
-{
-	jep_huff_code* hc;
-	jep_bitstring* data;
+	if (count < 1 || count > HUFF_CONTEXTS)
+		return 0;
 
-	hc = jep_alloc(jep_huff_code, 1);
+	pos = 4 + ((UCHAR_MAX + 1) * context_map_bits(count) + 7) / 8;
 
-	if (hc == NULL)
-		return NULL;
+	// Each table begins with its length width and byte range.
+	for (k = 0; k < count; k++)
+	{
+		if (n < pos + 3)
+		{
+			*size = pos + 3;
+			return 1;
+		}
 
-	hc->tree = NULL;
-	hc->dict = NULL;
+		if ((src[pos] != 4 && src[pos] != 8) || src[pos + 1] > src[pos + 2])
+			return 0;
 
-	data = jep_create_bitstring();
+		range = (uint32_t)src[pos + 2] - src[pos + 1] + 1;
+		pos += 3 + (src[pos] == 4 ? (range + 1) / 2 : range);
+	}
 
-	if (data == NULL)
+	if (n < pos + 8)
 	{
-		free(hc);
-		return NULL;
+		*size = pos + 8;
+		return 1;
 	}
 
-	hc->data = data;
+	jep_build_u32(bits, (src + pos + 4));
+	*size = pos + 8 + bits / CHAR_BIT + (bits % CHAR_BIT ? 1 : 0);
 
-	return hc;
+	return 1;
 }
 
 
 
 
 /*-----------------------------------------------------------------*/
-/*                  Tree Construction Implementation               */
+/*                       ANS Blocks Implementation                 */
 /*-----------------------------------------------------------------*/
 
-static void add_leaf_node(jep_huff_tree* tree, jep_huff_node* node)
+static size_t write_ans(const jep_byte* src,
+	size_t n,
+	jep_byte* dest,
+	size_t cap)
 {
-	// This is your run-of-the-mill linked list insertion.
-	// If list is empty, the new node becomes the first node in the list.
-	// If the list is not empty, the new node gets added at the tail.
-	if (tree->nodes == NULL)
-	{
-		tree->nodes = node;
-		tree->nodes->next = NULL;
-		tree->nodes->prev = NULL;
-		tree->tail = node;
-	}
-	else if (tree->nodes != NULL)
+	uint32_t counts[JEP_HISTOGRAM_SIZE]; // The frequency of each byte
+	size_t frame;                        // The size of the frame
+
+	if ((src == NULL && n > 0) || n > UINT32_MAX
+		|| !jep_byte_histogram(src, n, counts))
 	{
-		tree->tail->next = node;
-		tree->tail->next->prev = tree->tail;
-		tree->tail = node;
+		return 0;
 	}
-}
 
+	if (n == 0)
+		return write_stored(src, n, dest, cap);
 
-static void sort_leaf_nodes(jep_huff_tree* tree)
-{
-	if (tree == NULL || tree->nodes == NULL)
-		return;
+	if (counts[src[0]] == n)
+		return write_run(src[0], n, dest, cap);
 
-	int sorted;           // Whether or not the list is sorted
-	jep_huff_node** node; // The head of the list
-	jep_huff_node* next;  // The next node in the list
+	if (cap < huff_stored_header + n)
+		return 0;
 
-	sorted = 0;
+	// Any frame that is not smaller than the bytes themselves
+	// is given up in favor of a stored block.
+	if (!jep_ans_encode_to(src, n, dest + huff_ans_header, n - 1, &frame))
+		return write_stored(src, n, dest, cap);
 
-	// Attempt to sort the list until it it sorted.
-	while (!sorted)
-	{
-		sorted = 1;
-		node = &(tree->nodes);
+	dest[0] = huff_magic;
+	dest[1] = huff_version;
+	dest[2] = huff_type_ans;
+	jep_split_u32((uint32_t)frame, (dest + 3));
+
+	return huff_ans_header + frame;
+}
 
-		// Use bubble sort to sort the list in order
-		// of increasing frequency.
-		// This may be a tremendous source of inefficiency.
-		while (*node != NULL)
-		{
-			if ((*node)->next != NULL && (*node)->next->sym.f < (*node)->sym.f)
-			{
-				sorted = 0;
 
-				next = (*node)->next;
+static int decode_ans(jep_byte_buffer* encoded,
+	jep_byte_buffer* raw,
+	int fixed)
+{
+	const jep_byte* src; // The bytes of the block
+	uint32_t frame;      // The size of the frame
+	size_t count;        // The number of raw bytes
+	size_t size;         // The number of decoded bytes
 
-				(*node)->next = next->next;
+	src = encoded->buffer;
 
-				next->prev = (*node)->prev;
+	if (encoded->size < huff_ans_header + 4)
+		return 0;
 
-				if (next->next != NULL)
-				{
-					next->next->prev = *node;
-				}
+	jep_build_u32(frame, (src + 3));
 
-				(*node)->prev = next;
+	if (frame > encoded->size - huff_ans_header)
+		return 0;
 
-				next->next = *node;
+	// Make room for every decoded byte before any are decoded,
+	// once the header of the frame is known to be sound.
+	if (!jep_ans_measure(src + huff_ans_header, frame, &count))
+		return 0;
 
-				*node = next;
-			}
-			else
-			{
-				node = &((*node)->next);
-			}
-		}
+	if (fixed ? raw->cap - raw->size < count : !reserve_bytes(raw, count))
+		return 0;
+
+	if (!jep_ans_decode_to(src + huff_ans_header, frame,
+		raw->buffer + raw->size, raw->cap - raw->size, &size))
+	{
+		return 0;
 	}
+
+	raw->size += size;
+
+	return 1;
 }
 
 
-static int construct_tree(jep_huff_tree* tree)
+
+
+/*-----------------------------------------------------------------*/
+/*                       Checksums Implementation                  */
+/*-----------------------------------------------------------------*/
+
+static int write_checked(const jep_byte* src,
+	size_t n,
+	uint32_t limit,
+	uint32_t coder,
+	jep_byte_buffer* out)
 {
-	jep_huff_node** node;     // The current node
-	jep_huff_node* par;       // A parent node for two leaf nodes
-	jep_huff_node* next;      // The next node in the list
-	jep_huff_node* last_next; // The old next node
-	jep_huff_node* new_head;  // The new head of the list
+	jep_byte* dest; // The header of the checked block
+	size_t start;   // The offset of the checked block
+	size_t size;    // The size of the block inside it
 
-	// Ensure that we have a tree and that it has leaves.
-	if (tree == NULL || tree->nodes == NULL)
+	if (!reserve_bytes(out, huff_checked_header))
+		return 0;
+
+	// The header is written last, once the block inside it is known.
+	start = out->size;
+	out->size += huff_checked_header;
+
+	if (!encode_block(src, n, limit, coder, out))
+	{
+		out->size = start;
 		return 0;
+	}
 
-	// Grab a reference to the first node in the list.
-	node = &(tree->nodes);
+	size = out->size - start - huff_checked_header;
 
-	// Loop through the list of nodes and 
-	while (*node != NULL && (*node)->next != NULL)
+	if (size > UINT32_MAX)
 	{
-		// Initialize the node pointers.
-		next = last_next = new_head = NULL;
+		out->size = start;
+		return 0;
+	}
 
-		// Create a new parent node to represent the sum
-		// of the next two nodes.
-		par = jep_alloc(jep_huff_node, 1);
+	dest = out->buffer + start;
 
-		if (par == NULL)
-			return 0;
+	dest[0] = huff_magic;
+	dest[1] = huff_version;
+	dest[2] = huff_type_checked;
+	jep_split_u32((uint32_t)size, (dest + 3));
+	jep_split_u32(jep_crc32c(0, dest + huff_checked_header, size),
+		(dest + 7));
 
-		// The current node and the next node become
-		// leaf 1 and leaf 2 of the new parent node respectively.
-		par->leaf_1 = *node;
-		par->leaf_2 = (*node)->next;
+	return 1;
+}
 
-		// Initialize the frequency of the parent node
-		// to be that of the current node.
-		par->sym.f = par->leaf_1->sym.f;
 
-		par->sym.b = 0;
-		par->sym.w = 1;
-		par->sym.n = 1;
-		par->sym.code = NULL;
-		par->next = NULL;
-		par->prev = NULL;
+static int decode_checked(jep_byte_buffer* encoded,
+	jep_byte_buffer* raw,
+	int fixed)
+{
+	jep_byte_buffer block; // A view of the block inside
+	const jep_byte* src;   // The bytes of the checked block
+	uint32_t size;         // The size of the block inside
+	uint32_t crc;          // The recorded checksum
 
-		// If the next node is not NULL,
-		// add its frequency to the parent node's frequency,
-		// and grab a reference to the 
-		if (par->leaf_2 != NULL)
-		{
-			par->sym.f += par->leaf_2->sym.f;
-			next = par->leaf_2->next;
-		}
+	src = encoded->buffer;
 
-		// The parent node should be placed right before the first
-		// node that has a higher frequency that it.
-		// So if the parent node has the highest frequency in the
-		// list, it will be placed at the tail, and if it has the
-		// lowest frequency, it will be placed at the head.
+	if (encoded->size < huff_checked_header)
+		return 0;
 
-		last_next = next;
-		new_head = next;
+	jep_build_u32(size, (src + 3));
+	jep_build_u32(crc, (src + 7));
 
-		// Determine the value of the parent node's "next" pointer.
-		while (next != NULL && next->sym.f < par->sym.f)
-		{
-			last_next = next;
-			next = next->next;
-		}
+	if (size > encoded->size - huff_checked_header)
+		return 0;
 
-		par->next = next;
+	block.buffer = encoded->buffer + huff_checked_header;
+	block.size = size;
+	block.cap = size;
 
-		// Determine the value of the parent node's "prev" pointer.
-		if (next != NULL)
-		{
-			// The parent node is not the last node.
-			par->prev = next->prev;
-			if (next->prev != NULL)
-			{
-				next->prev->next = par;
-			}
-			next->prev = par;
-		}
-		else if (next == NULL && last_next != NULL)
-		{
-			// The parent node is the last node.
-			last_next->next = par;
-			par->prev = last_next;
-		}
+	// A damaged block is rejected before any of it is decoded.
+	if (jep_crc32c(0, block.buffer, size) != crc)
+		return 0;
 
-		// Determine the new value of the current node pointer.
-		// If the parent node was inserted at the head of the list,
-		// then the new current node is the parent node. Otherwise,
-		// the next node in the list becomes the current one.
-		if (new_head == NULL || new_head == next)
-		{
-			*node = par;
-		}
-		else
-		{
-			new_head->prev = NULL;
-			*node = new_head;
-		}
-	}
+	if (size >= 3 && block.buffer[2] == huff_type_checked)
+		return 0;
 
-	return 1;
+	return decode_block(&block, raw, fixed);
 }
 
 
-static jep_huff_tree* reconstruct_tree(jep_huff_dict* dict)
+static int encode_stream_block(jep_huff_stream* stream,
+	const jep_byte* src,
+	size_t n,
+	jep_byte_buffer* out)
 {
-	uint32_t i;          // Index
-	jep_huff_tree* tree; // A Huffman tree
-	jep_huff_node* root; // The root node of a Huffman tree
-	jep_bitstring* bs;   // The bitstring for a Huffman symbol
-	int res;             // The result of building a branch
+	if (stream->checked)
+		return write_checked(src, n, stream->limit, stream->coder, out);
 
-	// Create the tree.
-	tree = create_tree();
+	return encode_block(src, n, stream->limit, stream->coder, out);
+}
 
-	if (tree == NULL)
-		return NULL;
 
-	// Create the root node.
-	root = create_leaf_node();
 
-	if (root == NULL)
-	{
-		destroy_tree(tree);
-		return NULL;
-	}
 
-	root->sym.w = 1;
+/*-----------------------------------------------------------------*/
+/*                   Incremental Decoding Implementation           */
+/*-----------------------------------------------------------------*/
 
-	// Add the root node to the tree.
-	add_leaf_node(tree, root);
+static size_t partial_header(const jep_byte* src, size_t n)
+{
+	uint32_t range; // The number of code lengths
+	size_t head;    // The size of the header
 
-	// Loop through the symbols in the dictionary
-	// and build each branch of the tree based on
-	// the bit code.
-	for (i = 0; i < dict->count; i++)
-	{
-		bs = dict->symbols[i].code;
+	if (n < 3 || src[0] != huff_magic || !known_version(src[1]))
+		return 0;
 
-		res = build_branch(&root, bs,
-			dict->symbols[i],
-			0, // current byte
-			0, // position in current byte
-			0  // current bit count
-		);
+	if (src[2] == huff_type_stored)
+		return n >= huff_stored_header ? huff_stored_header : 0;
 
-		// If we failed to build a branch,
-		// destroy what we've built so far and leave.
-		if (!res)
-		{
-			destroy_tree(tree);
-			return NULL;
-		}
+	// Coded blocks of the previous version do not say how many
+	// bytes they hold, so they are collected whole.
+	if (src[2] != huff_type_split
+		&& (src[2] != huff_type_code || src[1] == huff_version_unsized))
+	{
+		return 0;
 	}
 
-	return tree;
+	if (n < 6 || (src[3] != 4 && src[3] != 8) || src[4] > src[5])
+		return 0;
+
+	range = (uint32_t)src[5] - src[4] + 1;
+	head = 6 + (src[3] == 4 ? (range + 1) / 2 : range);
+	head += src[2] == huff_type_split ? 4 + 4 * HUFF_STREAMS : 8;
+
+	return n >= head ? head : 0;
 }
 
 
-static int assign_bitcodes(jep_huff_tree* tree)
+static int begin_partial(huff_partial* p, const jep_byte* src, size_t n)
 {
-	jep_huff_node* node; // The root node of the Huffman tree
-	jep_bitstring* bs;   // A bitstring to hold the bit codes
-	int res;             // The result of assigning the bit codes
+	jep_byte lengths[UCHAR_MAX + 1]; // The length of each code
+	uint32_t count;                  // The number of decoded bytes
+	size_t seg;                      // The bytes in each segment
+	size_t start;                    // The start of a segment
+	size_t pos;                      // Position in the header
+	uint32_t k;                      // Index
+
+	p->stored = src[2] == huff_type_stored;
+	p->carried = 0;
+	p->skip = 0;
+
+	if (p->stored)
+	{
+		jep_build_u32(count, (src + 3));
+		p->left = count;
+		p->active = 1;
+		return 1;
+	}
 
+	pos = read_lengths(src + 3, n - 3, lengths);
 
-	// Ensure that the tree exists.
-	if (tree == NULL)
+	if (pos == 0 || !build_decoder(lengths, &(p->dec)))
 		return 0;
 
-	node = tree->nodes;
-
-	node->sym.n = 0;
+	pos += 3;
+	jep_build_u32(count, (src + pos));
+	pos += 4;
 
-	// Create the bitstring.
-	bs = jep_create_bitstring();
+	p->streams = src[2] == huff_type_split ? HUFF_STREAMS : 1;
+	seg = ((size_t)count + p->streams - 1) / p->streams;
 
-	if (node->sym.w == 0)
+	// Every code has at least one bit, so a bitstream cannot
+	// hold more symbols than bits.
+	for (k = 0; k < p->streams; k++)
 	{
-		if (!jep_add_bit(bs, 0))
-		{
-			jep_destroy_bitstring(bs);
+		jep_build_u32(p->bits[k], (src + pos + 4 * k));
+
+		start = (size_t)k * seg < count ? (size_t)k * seg : count;
+		p->symbols[k] = (uint32_t)(count - start < seg ? count - start : seg);
+
+		if (p->symbols[k] > p->bits[k])
 			return 0;
-		}
 	}
 
-	// Assign the bitcodes to each node of the tree.
-	res = assign_bitcode(node, 0, bs);
-
-	// Destroy the bitstring.
-	jep_destroy_bitstring(bs);
+	p->current = 0;
+	p->left = p->symbols[0];
+	p->remaining = p->bits[0];
+	p->bytes = p->bits[0] / CHAR_BIT + (p->bits[0] % CHAR_BIT ? 1 : 0);
+	p->active = 1;
 
-	return res;
+	return 1;
 }
 
 
-static int assign_bitcode(
-	jep_huff_node* node,
-	uint32_t level,
-	jep_bitstring* bs
-)
+static int continue_partial(huff_partial* p,
+	const jep_byte* src,
+	size_t n,
+	jep_byte_buffer* out,
+	size_t* used)
 {
-	// Ensure that the node actually exists.
-	if (node == NULL)
-		return 0;
+	huff_reader r;   // A reader of the window
+	uint64_t avail;  // The bits in the window that are not decoded
+	size_t total;    // The bytes in the window
+	size_t take;     // The number of bytes to add to the window
+	size_t k;        // The number of bytes to decode at once
+	size_t start;    // The first byte that is not fully decoded
 
-	// If the weight of the current symbol is less than 1,
-	// add the bits to the symbol's bitstring.
-	if (node->sym.w < 1)
-	{
-		node->sym.n = level;
-		if (!jep_add_bits(node->sym.code, bs))
-			return 0;
-	}
+	*used = 0;
 
-	// If the first leaf exists,
-	// add a bit with the value of 1 to the current bitstring,
-	// make a recursive call to this function to progress to
-	// the next level, then remove the bit.
-	if (node->leaf_1 != NULL)
+	// Stored bytes are passed on as they are.
+	if (p->stored)
 	{
-		jep_add_bit(bs, 1);
+		take = p->left < n ? (size_t)p->left : n;
 
-		if (!assign_bitcode(node->leaf_1, level + 1, bs))
+		if (!reserve_bytes(out, take))
 			return 0;
 
-		if (!jep_pop_bit(bs))
-			return 0;
+		memcpy(out->buffer + out->size, src, take);
+		out->size += take;
+		p->left -= take;
+		p->active = p->left > 0;
+		*used = take;
+
+		return 1;
 	}
 
-	// If the first leaf exists,
-	// add a bit with the value of 0 to the current bitstring,
-	// make a recursive call to this function to progress to
-	// the next level, then remove the bit.
-	if (node->leaf_2 != NULL)
+	while (p->active)
 	{
-		jep_add_bit(bs, 0);
+		// A bitstream that is fully decoded must have used all of its bits.
+		if (p->left == 0)
+		{
+			if (p->remaining > 0)
+				return 0;
 
-		if (!assign_bitcode(node->leaf_2, level + 1, bs))
-			return 0;
+			next_partial_stream(p);
+			continue;
+		}
 
-		if (!jep_pop_bit(bs))
-			return 0;
-	}
+		if (n == 0)
+			break;
 
-	return 1;
-}
+		take = n < HUFF_WINDOW ? n : HUFF_WINDOW;
 
+		if (take > p->bytes)
+			take = (size_t)p->bytes;
 
-static int build_branch(
-	jep_huff_node** node,
-	jep_bitstring* bs,
-	jep_huff_sym data,
-	jep_byte byte,
-	uint32_t bit,
-	uint32_t bit_count
-)
-{
-	jep_huff_node** leaf; // The current leaf node
+		memcpy(p->window + p->carried, src, take);
+		src += take;
+		n -= take;
+		*used += take;
+		p->bytes -= take;
+		total = p->carried + take;
 
-	// If the current bit count matches the number of bits
-	// in the current bitstring, then we've reached the
-	// end of a branch.
-	if (bit_count == bs->bit_count)
-	{
-		// Create the leaf node if it doesn't already exist.
-		if (*node == NULL)
+		r.pos = p->window;
+		r.end = p->window + total;
+		r.bits = 0;
+		r.count = 0;
+
+		if (p->skip > 0)
 		{
-			*node = create_leaf_node();
-			if (*node == NULL)
-				return 0;
+			r.bits = p->window[0] >> p->skip;
+			r.count = CHAR_BIT - p->skip;
+			r.pos++;
 		}
 
-		// Populate the symbol data of the leaf node.
-		(*node)->sym = data;
-		(*node)->sym.w = 0;
+		// Until the last byte of the bitstream arrives, only as many
+		// codes are decoded as are certain to be complete.
+		for (;;)
+		{
+			avail = (uint64_t)(r.end - r.pos) * CHAR_BIT + r.count;
 
-		return 1;
-	}
+			if (p->bytes == 0)
+				k = (size_t)p->left;
+			else if (avail >= p->dec.longest)
+				k = (size_t)(avail / p->dec.longest);
+			else
+				break;
 
-	// If we've exceeded the number of bits in a byte,
-	// increment the byte counter and reset the bit counter.
-	if (bit == CHAR_BIT)
-	{
-		byte++;
-		bit = 0;
-	}
+			if (k > p->left)
+				k = (size_t)p->left;
 
-	// If the current bit is a 1, then the next
-	// node in the branch will be leaf_1,
-	// otherwise it will be leaf_2.
-	if (bs->bytes[byte] & (1 << bit++))
-	{
-		leaf = &((*node)->leaf_1);
-	}
-	else
-	{
-		leaf = &((*node)->leaf_2);
+			if (!reserve_bytes(out, k)
+				|| !decode_symbols(&(p->dec), &r, &(p->remaining),
+					out->buffer + out->size, k))
+			{
+				return 0;
+			}
+
+			out->size += k;
+			p->left -= k;
+
+			if (p->left == 0)
+				break;
+		}
+
+		// Keep the bytes that still hold undecoded bits.
+		avail = (uint64_t)(r.end - r.pos) * CHAR_BIT + r.count;
+		start = (size_t)(((uint64_t)total * CHAR_BIT - avail) / CHAR_BIT);
+		p->skip = (uint32_t)(((uint64_t)total * CHAR_BIT - avail) % CHAR_BIT);
+		p->carried = total - start;
+		memmove(p->window, p->window + start, p->carried);
 	}
 
-	// Create the next leaf node if it doesn't already exist.
-	if (*leaf == NULL)
-	{
-		*leaf = create_leaf_node();
+	return 1;
+}
 
-		if (*leaf == NULL)
-			return 0;
 
-		(*leaf)->sym.w = 1;
+static void next_partial_stream(huff_partial* p)
+{
+	uint32_t bits; // The bits of the next bitstream
+
+	p->carried = 0;
+	p->skip = 0;
+
+	if (++(p->current) >= p->streams)
+	{
+		p->active = 0;
+		return;
 	}
 
-	// Make a recursive call to this function to move to the next node.
-	return build_branch(leaf, bs, data, byte, bit, ++bit_count);
+	bits = p->bits[p->current];
+	p->left = p->symbols[p->current];
+	p->remaining = bits;
+	p->bytes = bits / CHAR_BIT + (bits % CHAR_BIT ? 1 : 0);
 }
 
 
 
 
 /*-----------------------------------------------------------------*/
-/*                     Buffer I/O Implementation                   */
+/*                       Statistics Implementation                 */
 /*-----------------------------------------------------------------*/
 
-static void write_huff_dict(jep_huff_dict* dict, jep_byte_buffer* bb)
+static int count_stats(const jep_byte* src, size_t n, jep_huff_stats* stats)
 {
-	uint32_t i, j;      // Indices
-	uint8_t u32buff[4]; // Buffer to hold the bytes of a uint32_t
-	size_t pos;         // Position in the output stream
-	size_t s;           // The size of 1 byte. This should always be 1.
+	if (!jep_byte_histogram(src, n, stats->counts))
+		return 0;
 
-	jep_byte b;            // Byte value of the current symbol
-	uint32_t bit_count;    // Number of bits in the bitstring
-	uint32_t byte_count;   // Number of bytes in the bitstring
-	jep_byte current_bits; // Number of occupied bits in the last byte
-	jep_byte* bytes;       // Bytes in the bitstring
+	entropy_stats(n, stats);
 
+	return 1;
+}
 
-	pos = 0;
-	s = sizeof(jep_byte);
 
-	// Write the dict_begin metadata to signify the beginning
-	// of a dictionary.
-	write_to_buffer(&dict_begin, bb, s, &pos);
+static void entropy_stats(size_t n, jep_huff_stats* stats)
+{
+	double p;   // The probability of a byte
+	uint32_t i; // Index
 
-	// Loop through the symbols in the dictionary and write
-	// their data to the output buffer.
-	// Since the bit count and byte count are unsigned 32-bit integers,
-	// we split them into four 8-bit bytes before writing.
-	for (i = 0; i < dict->count; i++)
+	stats->entropy = 0.0;
+	stats->raw_bytes = n;
+
+	for (i = 0; i <= UCHAR_MAX; i++)
 	{
-		// Gather the information about the current symbol.
-		b = dict->symbols[i].b;
-		bit_count = dict->symbols[i].code->bit_count;
-		byte_count = dict->symbols[i].code->byte_count;
-		current_bits = dict->symbols[i].code->current_bits;
-		bytes = dict->symbols[i].code->bytes;
+		if (stats->counts[i] == 0)
+			continue;
 
+		p = (double)stats->counts[i] / (double)n;
+		stats->entropy -= p * log2(p);
+	}
+}
 
-		// Write the dict_byte metadata to signify that
-		// we're about to write the byte value of the
-		// current symbol.
-		// Then, write the symbol's byte value.
-		write_to_buffer(&dict_byte, bb, s, &pos);
-		write_to_buffer(&b, bb, 1, &pos);
 
-		// Write the dict_code metadata to signify that
-		// we're about to write bitstring information.
-		write_to_buffer(&dict_code, bb, s, &pos);
+static void block_stats(const jep_byte* src, size_t n, jep_huff_stats* stats)
+{
+	jep_byte lengths[UCHAR_MAX + 1]; // The length of each code
+	uint64_t bits;                   // The number of bits of data
+	uint32_t count;                  // The bits of one bitstream
+	uint32_t streams;                // The number of bitstreams
+	size_t head;                     // The size of the header
+	size_t used;                     // The size of the code lengths
+	uint32_t i;                      // Index
+
+	// Anything else is counted as payload.
+	stats->header_bytes = 0;
+	stats->payload_bytes = n;
+	stats->max_length = 0;
+	bits = (uint64_t)n * CHAR_BIT;
+
+	if (n >= 3 && src[0] == huff_magic && known_version(src[1]))
+	{
+		if (src[2] == huff_type_stored && n >= huff_stored_header)
+		{
+			stats->header_bytes = huff_stored_header;
+			stats->payload_bytes = n - huff_stored_header;
+			bits = (uint64_t)stats->payload_bytes * CHAR_BIT;
+		}
+		else if (src[2] == huff_type_run)
+		{
+			stats->header_bytes = n;
+			stats->payload_bytes = 0;
+			bits = 0;
+		}
+		else if (src[2] == huff_type_code || src[2] == huff_type_split)
+		{
+			used = read_lengths(src + 3, n - 3, lengths);
+			streams = src[2] == huff_type_split ? HUFF_STREAMS : 1;
+			head = 3 + used + 4 * streams;
 
-		// Write the bit count of the bitstring.
-		jep_split_u32(bit_count, u32buff);
-		write_to_buffer(u32buff, bb, s * 4, &pos);
+			if (src[2] == huff_type_split || src[1] != huff_version_unsized)
+				head += 4;
 
-		// Write the byte count of the bitstring.
-		jep_split_u32(byte_count, u32buff);
-		write_to_buffer(u32buff, bb, s * 4, &pos);
+			if (used > 0 && n >= head)
+			{
+				bits = 0;
+				for (i = 0; i < streams; i++)
+				{
+					jep_build_u32(count, (src + head - 4 * (streams - i)));
+					bits += count;
+				}
 
-		// Write the number of currently occupied bits in
-		// the last byte.
-		write_to_buffer(&current_bits, bb, s, &pos);
+				for (i = 0; i <= UCHAR_MAX; i++)
+				{
+					if (lengths[i] > stats->max_length)
+						stats->max_length = lengths[i];
+				}
 
-		// Write the bytes of the bitstring data.
-		for (j = 0; j < byte_count; j++)
-		{
-			write_to_buffer(&(bytes[j]), bb, s, &pos);
+				stats->header_bytes = head;
+				stats->payload_bytes = n - head;
+			}
 		}
 	}
 
-	// Write the dict_end metadata to signify that we've finished
-	// writing the dictionary.
-	write_to_buffer(&dict_end, bb, sizeof(jep_byte), &pos);
+	stats->average_length = stats->raw_bytes > 0
+		? (double)bits / (double)stats->raw_bytes : 0.0;
 }
 
 
-static void write_huff_data(jep_bitstring* data, jep_byte_buffer* bb)
+#ifdef JEP_HUFF_STATS
+static uint64_t huff_clock()
 {
-	uint32_t i;         // Index
-	uint8_t u32buff[4]; // Buffer to hold the bytes of a uint32_t
-	size_t pos;         // Position in the output stream
-	size_t s;           // The size of 1 byte. This should always be 1.
-
-	uint32_t bit_count;    // Number of bits in the bitstring
-	uint32_t byte_count;   // Number of bytes in the bitstring
-	jep_byte current_bits; // Number of occupied bits in the last byte
-
+#ifdef _WIN32
+	LARGE_INTEGER count;
+	LARGE_INTEGER freq;
 
-	pos = 0;
-	s = sizeof(jep_byte);
+	QueryPerformanceCounter(&count);
+	QueryPerformanceFrequency(&freq);
 
-	bit_count = data->bit_count;
-	byte_count = data->byte_count;
-	current_bits = data->current_bits;
+	return (uint64_t)((double)count.QuadPart * 1e9 / (double)freq.QuadPart);
+#else
+	struct timespec ts;
 
-	// Write the data_begin metadata to signify that we're
-	// about to write the encoded bitstring data.
-	write_to_buffer(&data_begin, bb, sizeof(jep_byte), &pos);
+	clock_gettime(CLOCK_MONOTONIC, &ts);
 
-	// Write the bit count.
-	jep_split_u32(bit_count, u32buff);
-	write_to_buffer(u32buff, bb, s * 4, &pos);
+	return (uint64_t)ts.tv_sec * 1000000000U + (uint64_t)ts.tv_nsec;
+#endif
+}
+#endif
 
-	// Write the byte count.
-	jep_split_u32(byte_count, u32buff);
-	write_to_buffer(u32buff, bb, s * 4, &pos);
 
-	// Write the number of bits occupied in the last byte.
-	write_to_buffer(&current_bits, bb, s, &pos);
 
-	// Write the bitstring data.
-	for (i = 0; i < data->byte_count; i++)
-	{
-		write_to_buffer(&(data->bytes[i]), bb, s, &pos);
-	}
 
-	// Write the data_end metadata to signify that we've finished
-	// writing the data.
-	write_to_buffer(&data_end, bb, s, &pos);
-}
+/*-----------------------------------------------------------------*/
+/*                         Files Implementation                    */
+/*-----------------------------------------------------------------*/
 
+#ifdef _WIN32
 
-static jep_huff_dict* read_huff_dict(jep_byte_buffer* data, size_t* pos)
+static int map_file(const char* path, huff_mapped_file* map)
 {
-	jep_huff_dict* dict; // The dictionary to be read from the buffer
-	size_t cap;          // Capacity of the dictionary
-	size_t new_cap;      // New capacity for resizing the dictionary
-	size_t count;        // Number of symbols in the dictionary
-	int res;             // Result of read operations
-	jep_huff_sym sym;    // An individual symbol
-	jep_huff_sym* syms;  // Pointer used for reallocation
-	jep_byte u32buff[4]; // Buffer for holding an unsigned 32-bit integer
-	uint32_t u32;        // An unsigned 32-bit integer
-	jep_byte b;          // An unsigned 8-bit integer
-	size_t s;            // The size of 1 byte. This should always be 1.
+	LARGE_INTEGER size; // The size of the file
 
-	uint32_t bit_count;  // Number of bits in the bitstring
-	uint32_t byte_count; // Number of bytes in the bitstring
-	jep_byte* bytes;     // Bytes in the bitstring
+	map->data = NULL;
+	map->size = 0;
+	map->mapping = NULL;
 
+	// Sequential scanning lets the system read well ahead
+	// of the bytes that are in use.
+	map->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
 
-	cap = 10;
-	dict = create_dict(sizeof(jep_huff_sym) * cap);
-	count = 0;
-	res = 1;
-	u32 = 0;
-	b = 0;
-	s = sizeof(jep_byte);
+	if (map->file == INVALID_HANDLE_VALUE)
+		return 0;
+
+	if (!GetFileSizeEx(map->file, &size)
+		|| (uint64_t)size.QuadPart > (uint64_t)SIZE_MAX)
+	{
+		CloseHandle(map->file);
+		return 0;
+	}
 
-	// Ensure that we successfully created the dictionary.
-	if (dict == NULL)
-		return NULL;
+	map->size = (size_t)size.QuadPart;
 
-	// Read the first byte from the buffer.
-	res = read_from_buffer(&b, data, s, pos);
+	// An empty file cannot be mapped, but there is nothing to read.
+	if (map->size == 0)
+		return 1;
 
-	// Verify that the first byte is the dict_begin metadata.
-	if (!res || b != dict_begin)
+	map->mapping = CreateFileMappingA(map->file, NULL, PAGE_READONLY,
+		0, 0, NULL);
+
+	if (map->mapping != NULL)
 	{
-		destroy_dict(dict);
-		return NULL;
+		map->data = (const jep_byte*)MapViewOfFile(map->mapping,
+			FILE_MAP_READ, 0, 0, 0);
 	}
 
-	// As long as there are bytes remaining to be read,
-	// read them from the buffer and insert them into the dictionary.
-	while (res)
+	if (map->data == NULL)
 	{
-		// Read the next byte.
-		res = read_from_buffer(&b, data, s, pos);
+		if (map->mapping != NULL)
+			CloseHandle(map->mapping);
 
-		if (res && b == dict_byte)
-		{
-			// If the previous byte was the dict_byte metadata,
-			// then the next byte will be the value of a symbol.
-			if ((res = read_from_buffer(&b, data, s, pos)))
-				sym.b = b;
-		}
-		else if (res && b == dict_code)
-		{
-			// If the previous byte was the dict_code metadata,
-			// then the following bytes will be a bistring.
-			// The bit count and byte count are 32-bit
-			// unsigned integers, so they will need to be
-			// reconstructed from a sequence of four bytes.
+		CloseHandle(map->file);
+		return 0;
+	}
 
-			// Create the bitstring for the current symbol.
-			sym.code = jep_create_bitstring();
+	return 1;
+}
 
-			// Ensure that the bitstring was created.
-			if (sym.code == NULL)
-			{
-				destroy_dict(dict);
-				return NULL;
-			}
 
-			// Destroy the bytes since we'll recreate them later.
-			free(sym.code->bytes);
+static void unmap_file(huff_mapped_file* map)
+{
+	if (map->data != NULL)
+		UnmapViewOfFile(map->data);
 
-			// Read the bit count.
-			res = read_from_buffer(u32buff, data, s * 4, pos);
-			jep_build_u32(u32, u32buff);
-			bit_count = u32;
+	if (map->mapping != NULL)
+		CloseHandle(map->mapping);
 
-			// Read the byte count.
-			res = read_from_buffer(u32buff, data, s * 4, pos);
-			jep_build_u32(u32, u32buff);
-			byte_count = u32;
+	CloseHandle(map->file);
+}
 
-			// Read the number of bits occupied in the last byte.
-			res = read_from_buffer(&b, data, s, pos);
 
-			// Allocate a new array of bytes.
-			bytes = jep_alloc(jep_byte, byte_count);
+static int create_file(const char* path,
+	const huff_mapped_file* input,
+	huff_file* file)
+{
+	// The input is only shared for reading,
+	// so it cannot be opened again to be written.
+	(void)input;
 
-			// Read the bytes of the bitstring.
-			res = read_from_buffer(bytes, data, byte_count, pos);
+	*file = CreateFileA(path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
 
-			// Resize the dictionary if necessary.
-			if (count >= cap)
-			{
-				new_cap = cap + cap / 2;
+	return *file != INVALID_HANDLE_VALUE;
+}
 
-				syms = resym(dict->symbols, new_cap);
 
-				if (syms == NULL)
-				{
-					dict->symbols = NULL;
-					destroy_dict(dict);
-					return NULL;
-				}
+static int write_file(huff_file file, const jep_byte* src, size_t n)
+{
+	DWORD chunk;   // The number of bytes to write at once
+	DWORD written; // The number of bytes written
 
-				dict->symbols = syms;
-				cap = new_cap;
-			}
+	while (n > 0)
+	{
+		chunk = n < (1U << 30) ? (DWORD)n : (DWORD)(1U << 30);
 
-			// Populate members of the symbol structure.
-			sym.code->bit_count = bit_count;
-			sym.code->byte_count = byte_count;
-			sym.code->bytes = bytes;
+		if (!WriteFile(file, src, chunk, &written, NULL) || written == 0)
+			return 0;
 
-			// Add the symbol to the dictionary.
-			dict->symbols[count++] = sym;
-		}
-		else if (b == dict_end)
-		{
-			// If the previous byte was the dict_end metadata,
-			// break out of the loop.
-			res = 0;
-		}
+		src += written;
+		n -= written;
 	}
 
-	// If we allocated more memory than necessary,
-	// resize the dictionary's symbol array to have
-	// an appropriate length.
-	if (count < cap)
-	{
-		syms = resym(dict->symbols, count);
+	return 1;
+}
 
-		if (syms == NULL)
-		{
-			dict->symbols = NULL;
-			destroy_dict(dict);
-			return NULL;
-		}
 
-		dict->symbols = syms;
-	}
+static int close_file(huff_file file, const char* path, int keep)
+{
+	if (!CloseHandle(file))
+		keep = 0;
 
-	dict->count = count;
+	if (!keep)
+		DeleteFileA(path);
 
-	return dict;
+	return keep;
 }
 
+#else
 
-static jep_bitstring* read_huff_data(jep_byte_buffer* data, size_t* pos)
+static int map_file(const char* path, huff_mapped_file* map)
 {
-	jep_bitstring* bs;   // A bitstring to hold the data
-	jep_byte u32buff[4]; // Buffer for holding an unsigned 32-bit integer
-	uint32_t u32;        // An unsigned 32-bit integer
-	jep_byte b;          // An unsigned 8-bit integer
-	size_t s;            // The size of 1 byte. This should always be 1.
+	struct stat st; // The status of the file
+	void* data;     // The mapped bytes
 
+	map->data = NULL;
+	map->size = 0;
+	map->file = open(path, O_RDONLY);
 
-	// Create the bitstring.
-	bs = jep_create_bitstring();
+	if (map->file < 0)
+		return 0;
 
-	// Dispose of the byte array since it will be created later.
-	free(bs->bytes);
+	if (fstat(map->file, &st) != 0 || !S_ISREG(st.st_mode)
+		|| (uint64_t)st.st_size > (uint64_t)SIZE_MAX)
+	{
+		close(map->file);
+		return 0;
+	}
 
-	u32 = 0;
-	b = 0;
-	//res = 1;
-	s = sizeof(jep_byte);
+	map->size = (size_t)st.st_size;
 
-	// Read the first byte from the buffer.
-	read_from_buffer(&b, data, s, pos);
+	// An empty file cannot be mapped, but there is nothing to read.
+	if (map->size == 0)
+		return 1;
 
-	// Verify that the first byte was the data_begin metadata.
-	if (b == data_begin)
+	data = mmap(NULL, map->size, PROT_READ, MAP_PRIVATE, map->file, 0);
+
+	if (data == MAP_FAILED)
 	{
-		// Read the bit count.
-		read_from_buffer(u32buff, data, s * 4, pos);
-		jep_build_u32(u32, u32buff);
-		bs->bit_count = u32;
+		close(map->file);
+		return 0;
+	}
 
-		// Read the byte count.
-		read_from_buffer(u32buff, data, s * 4, pos);
-		jep_build_u32(u32, u32buff);
-		bs->byte_count = u32;
+	// The file is read once from start to end, so pages can be
+	// read well ahead of use and dropped soon after. The hint is
+	// only advice, so decoding goes on even if it is refused.
+	madvise(data, map->size, MADV_SEQUENTIAL);
 
-		// Read the number of bits occupied in the last byte.
-		read_from_buffer(&b, data, s, pos);
-		bs->current_bits = b;
+	map->data = (const jep_byte*)data;
 
-		// Allocate an array of bytes.
-		bs->bytes = jep_alloc(jep_byte, bs->byte_count);
+	return 1;
+}
 
-		// Read the bitstring data.
-		read_from_buffer(bs->bytes, data, bs->byte_count, pos);
-	}
 
-	return bs;
+static void unmap_file(huff_mapped_file* map)
+{
+	if (map->data != NULL)
+		munmap((void*)map->data, map->size);
+
+	close(map->file);
 }
 
 
-static int read_from_buffer(jep_byte* dest,
-	jep_byte_buffer* src,
-	size_t n,
-	size_t* pos)
+static int create_file(const char* path,
+	const huff_mapped_file* input,
+	huff_file* file)
 {
-	size_t i, j;  // Indices
-	size_t start; // Position in output stream
-	int result;   // Number of bytes written to output buffer
+	struct stat in;  // The status of the input
+	struct stat out; // The status of the output
 
+	*file = open(path, O_WRONLY | O_CREAT, 0666);
 
-	// Ensure that the source and destination are not NULL.
-	if (src == NULL || src->buffer == NULL || dest == NULL)
+	if (*file < 0)
 		return 0;
 
-	start = *pos;
-	result = 0;
-
-	// Ensure that the current position is less than
-	// the source size.
-	if (*pos >= src->size)
+	// The file is only emptied once it is known not to be the input.
+	if (fstat(input->file, &in) != 0 || fstat(*file, &out) != 0
+		|| (in.st_dev == out.st_dev && in.st_ino == out.st_ino)
+		|| ftruncate(*file, 0) != 0)
+	{
+		close(*file);
 		return 0;
+	}
 
-	// Copy each byte from the source buffer into the destination array.
-	for (i = start, j = 0; i < start + n && i < src->size; i++)
+	return 1;
+}
+
+
+static int write_file(huff_file file, const jep_byte* src, size_t n)
+{
+	ssize_t written; // The number of bytes written
+
+	while (n > 0)
 	{
-		dest[j++] = src->buffer[i];
-		(*pos)++;
-		result++;
+		written = write(file, src, n);
+
+		if (written < 0 && errno == EINTR)
+			continue;
+
+		if (written <= 0)
+			return 0;
+
+		src += written;
+		n -= (size_t)written;
 	}
 
-	return result;
+	return 1;
 }
 
 
-static int write_to_buffer(const jep_byte* src,
-	jep_byte_buffer* dest,
-	size_t n,
-	size_t* pos)
+static int close_file(huff_file file, const char* path, int keep)
 {
-	size_t i;   // Index
-	int result; // Number of bytes written to output buffer
+	// A failed close may mean that written bytes never reached the file,
+	// as on a full disk or a network file system. It is not retried,
+	// since the file may already be closed.
+	if (close(file) != 0)
+		keep = 0;
 
+	if (!keep)
+		unlink(path);
 
-	// Ensure that the source and destination are not NULL.
-	if (dest == NULL || dest->buffer == NULL || src == NULL)
-		return 0;
+	return keep;
+}
 
-	result = 0;
+#endif
 
-	// Ensure that the current position is not greater
-	// than the size of the destination buffer.
-	if (*pos > dest->size)
+
+static int decode_file_block(jep_byte_buffer* block,
+	huff_partial* partial,
+	jep_byte_buffer* out,
+	huff_file file)
+{
+	const jep_byte* src; // The bytes of the block
+	uint64_t count;      // The number of decoded bytes
+	size_t head;         // The size of the header
+	size_t pos;          // Position in the block
+	size_t take;         // The number of bytes to decode at once
+	size_t used;         // The number of bytes used
+	uint32_t run;        // The length of a run
+	uint32_t k;          // Index
+
+	src = block->buffer;
+
+	// A run is expanded one batch at a time.
+	if (block->size >= huff_run_header && src[0] == huff_magic
+		&& src[2] == huff_type_run)
+	{
+		if (!known_version(src[1]))
+			return 0;
+
+		jep_build_u32(run, (src + 4));
+
+		while (run > 0)
+		{
+			take = HUFF_FILE_CHUNK - out->size;
+
+			if (take > run)
+				take = run;
+
+			if (!reserve_bytes(out, take))
+				return 0;
+
+			memset(out->buffer + out->size, src[3], take);
+			out->size += take;
+			run -= (uint32_t)take;
+
+			if (out->size >= HUFF_FILE_CHUNK)
+			{
+				if (!write_file(file, out->buffer, out->size))
+					return 0;
+
+				out->size = 0;
+			}
+		}
+
+		return 1;
+	}
+
+	// Blocks that cannot be decoded as they arrive, and blocks that
+	// fit in a batch, are decoded whole.
+	head = partial_header(src, block->size);
+
+	if (head == 0)
+		return decode_block(block, out, 0);
+
+	if (!begin_partial(partial, src, head))
 		return 0;
 
-	// Copy each byte from the source array into the destination buffer.
-	for (i = 0; i < n; i++)
+	count = partial->left;
+
+	if (!partial->stored)
 	{
-		jep_append_byte(dest, src[i]);
-		(*pos)++;
-		result++;
+		for (k = 1; k < partial->streams; k++)
+			count += partial->symbols[k];
 	}
 
-	return result;
+	if (count <= HUFF_FILE_CHUNK)
+	{
+		partial->active = 0;
+		return decode_block(block, out, 0);
+	}
+
+	// Every code has at least one bit, so no more than a batch of
+	// bytes is decoded from each piece of the block.
+	for (pos = head; partial->active; pos += used)
+	{
+		take = block->size - pos < HUFF_FILE_CHUNK / CHAR_BIT
+			? block->size - pos : HUFF_FILE_CHUNK / CHAR_BIT;
+
+		if (!continue_partial(partial, src + pos, take, out, &used))
+		{
+			partial->active = 0;
+			return 0;
+		}
+
+		if (out->size >= HUFF_FILE_CHUNK)
+		{
+			if (!write_file(file, out->buffer, out->size))
+			{
+				partial->active = 0;
+				return 0;
+			}
+
+			out->size = 0;
+		}
+
+		// A block that ends before all of its bytes are decoded
+		// is damaged.
+		if (used == 0 && partial->active)
+		{
+			partial->active = 0;
+			return 0;
+		}
+	}
+
+	return pos == block->size;
 }
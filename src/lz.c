@@ -0,0 +1,796 @@
+#include "jep_utils/jep_utils.h"
+#include "jep_utils/lz.h"
+#include "jep_utils/huffman.h"
+
+
+
+
+/* frame metadata */
+static const jep_byte lz_magic = 0x4A;
+static const jep_byte lz_type = 0x4C;
+
+/* the size of the magic bytes and the raw byte count */
+static const size_t lz_frame_header = 6;
+
+/* the size of the decoded and encoded sizes of a section */
+static const size_t lz_section_header = 8;
+
+
+
+
+/**
+ * The shortest match that is replaced by a reference.
+ * Shorter matches would cost more than the literals they replace.
+ */
+#define LZ_MIN_MATCH 4
+
+/**
+ * The number of bits in the hash of the next four bytes.
+ */
+#define LZ_HASH_BITS 15
+
+/**
+ * The number of earlier positions kept in the hash chains, which is
+ * one more than the greatest distance.
+ */
+#define LZ_CHAIN_SIZE (JEP_LZ_WINDOW_SIZE + 1)
+
+/**
+ * The sections of a frame, each of which is encoded as its own
+ * Huffman block so that its bytes are coded by their own frequencies.
+ */
+#define LZ_LITERALS 0
+#define LZ_TOKENS 1
+#define LZ_EXTRA 2
+#define LZ_DIST_LOW 3
+#define LZ_DIST_HIGH 4
+#define LZ_SECTIONS 5
+
+/**
+ * The largest literal count or match length held by a token alone.
+ * Longer ones continue in the extra bytes.
+ */
+#define LZ_TOKEN_MAX 15
+
+
+
+
+/**
+ * The parameters of a compression level.
+ */
+typedef struct lz_level {
+	uint32_t depth;  // The most earlier positions tried for a match
+	uint32_t nice;   // A match length that ends the search
+	int lazy;        // 1 to prefer a longer match at the next position
+}lz_level;
+
+static const lz_level lz_levels[JEP_LZ_MAX_LEVEL] = {
+	{ 4, 16, 0 },
+	{ 8, 32, 0 },
+	{ 16, 32, 0 },
+	{ 32, 64, 0 },
+	{ 32, 64, 1 },
+	{ 64, 128, 1 },
+	{ 128, 256, 1 },
+	{ 512, 1024, 1 },
+	{ 4096, 65535, 1 }
+};
+
+/**
+ * A match finder keeps a hash chain of the earlier positions whose
+ * next four bytes share a hash, most recent first.
+ * Positions are stored plus one so that 0 ends a chain.
+ */
+typedef struct lz_matcher {
+	const jep_byte* src;                  // The raw bytes
+	size_t size;                          // The number of raw bytes
+	size_t next;                          // The next position to insert
+	const lz_level* level;                // The compression level
+	uint32_t head[1 << LZ_HASH_BITS];     // The latest position of each hash
+	uint32_t prev[LZ_CHAIN_SIZE];         // The position before each one
+}lz_matcher;
+
+/**
+ * The sections of a frame before they are encoded, or after they
+ * are decoded.
+ */
+typedef struct lz_sections {
+	jep_byte* data[LZ_SECTIONS];   // The bytes of each section
+	size_t size[LZ_SECTIONS];      // The number of bytes in each section
+}lz_sections;
+
+
+
+
+/**
+ * Allocates the sections of a frame.
+ * Returns 0 on failure, in which case nothing remains allocated.
+ *
+ * Params:
+ *   lz_sections - the sections to be allocated
+ *   size_t - an array of LZ_SECTIONS capacities
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+static int create_sections(lz_sections* s, const size_t* caps);
+
+/**
+ * Frees the sections of a frame.
+ *
+ * Params:
+ *   lz_sections - the sections to be freed
+ */
+static void destroy_sections(lz_sections* s);
+
+/**
+ * Hashes the four bytes at a position.
+ *
+ * Params:
+ *   jep_byte - a pointer to at least four bytes
+ *
+ * Returns:
+ *   uint32_t - a hash of LZ_HASH_BITS bits
+ */
+static uint32_t hash4(const jep_byte* p);
+
+/**
+ * Adds every position before a given one to the hash chains.
+ * Positions too close to the end to begin a match are skipped.
+ *
+ * Params:
+ *   lz_matcher - a match finder
+ *   size_t - the position to stop at
+ */
+static void insert_until(lz_matcher* m, size_t end);
+
+/**
+ * Finds the longest match for the bytes at a position among the
+ * earlier positions in its hash chain.
+ * Every earlier position must have been inserted.
+ *
+ * Params:
+ *   lz_matcher - a match finder
+ *   size_t - the position of the bytes to match
+ *   uint32_t - a pointer to receive the distance of the match
+ *
+ * Returns:
+ *   size_t - the length of the match, or 0 if none was found
+ */
+static size_t find_match(lz_matcher* m, size_t pos, uint32_t* dist);
+
+/**
+ * Divides an array of bytes into literals and matches and adds them
+ * to the sections of a frame.
+ *
+ * Params:
+ *   lz_matcher - a match finder holding the bytes
+ *   lz_sections - the sections to receive the literals and matches
+ */
+static void parse(lz_matcher* m, lz_sections* s);
+
+/**
+ * Adds a run of literals and the match that follows it to the
+ * sections of a frame.
+ *
+ * Params:
+ *   lz_sections - the sections of a frame
+ *   jep_byte - the literal bytes
+ *   size_t - the number of literal bytes
+ *   size_t - the length of the match
+ *   uint32_t - the distance of the match
+ */
+static void put_sequence(lz_sections* s, const jep_byte* lits, size_t count,
+	size_t len, uint32_t dist);
+
+/**
+ * Adds the part of a count that does not fit in a token to the
+ * extra bytes. Each byte of 255 is followed by another.
+ *
+ * Params:
+ *   lz_sections - the sections of a frame
+ *   size_t - the count less LZ_TOKEN_MAX
+ */
+static void put_extra(lz_sections* s, size_t n);
+
+/**
+ * Reads the part of a count that did not fit in a token.
+ * Returns 0 if the extra bytes run out.
+ *
+ * Params:
+ *   lz_sections - the decoded sections of a frame
+ *   size_t - a pointer to the position in the extra bytes
+ *   size_t - a pointer to the count, which is increased
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+static int read_extra(const lz_sections* s, size_t* pos, size_t* n);
+
+/**
+ * Encodes the sections of a frame and writes the frame.
+ * Returns NULL on failure.
+ *
+ * Params:
+ *   lz_sections - the sections of a frame
+ *   size_t - the number of raw bytes
+ *
+ * Returns:
+ *   jep_byte_buffer - the frame
+ */
+static jep_byte_buffer* write_frame(lz_sections* s, size_t n);
+
+/**
+ * Reads and decodes the sections of a frame.
+ * Returns 0 if the frame is damaged, or if its sections cannot
+ * rebuild as many raw bytes as it claims.
+ *
+ * Params:
+ *   jep_byte_buffer - a frame
+ *   uint32_t - the number of raw bytes in the frame
+ *   lz_sections - the sections to be allocated and decoded
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+static int read_sections(jep_byte_buffer* encoded, uint32_t n,
+	lz_sections* s);
+
+/**
+ * Rebuilds the raw bytes from the decoded sections of a frame.
+ * Returns 0 if any match reaches before the first byte or past the
+ * last one, or if the sections do not add up to the raw bytes.
+ *
+ * Params:
+ *   lz_sections - the decoded sections of a frame
+ *   jep_byte - an array to receive the raw bytes
+ *   size_t - the number of raw bytes
+ *
+ * Returns:
+ *   int - 1 on success or 0 on failure
+ */
+static int rebuild(const lz_sections* s, jep_byte* dest, size_t n);
+
+
+
+
+JEP_UTILS_API jep_byte_buffer* JEP_UTILS_CALL
+jep_lz_compress(jep_byte_buffer* raw, uint32_t level)
+{
+	jep_byte_buffer* encoded;  // The frame
+	lz_matcher* m;             // The match finder
+	lz_sections s;             // The sections of the frame
+	size_t caps[LZ_SECTIONS];  // The capacity of each section
+	size_t n;                  // The number of raw bytes
+	size_t seqs;               // The most matches there can be
+
+	if (raw == NULL || level < JEP_LZ_MIN_LEVEL || level > JEP_LZ_MAX_LEVEL
+		|| raw->size > UINT32_MAX)
+	{
+		return NULL;
+	}
+
+	n = raw->size;
+
+	// Every match covers at least LZ_MIN_MATCH bytes, and each count
+	// needs an extra byte for every 255 beyond LZ_TOKEN_MAX.
+	seqs = n / LZ_MIN_MATCH + 1;
+	caps[LZ_LITERALS] = n;
+	caps[LZ_TOKENS] = seqs;
+	caps[LZ_EXTRA] = 2 * seqs + 2 * (n / 255) + 2;
+	caps[LZ_DIST_LOW] = seqs;
+	caps[LZ_DIST_HIGH] = seqs;
+
+	m = jep_alloc(lz_matcher, 1);
+
+	if (m == NULL)
+		return NULL;
+
+	if (!create_sections(&s, caps))
+	{
+		free(m);
+		return NULL;
+	}
+
+	m->src = raw->buffer;
+	m->size = n;
+	m->next = 0;
+	m->level = &(lz_levels[level - 1]);
+	memset(m->head, 0, sizeof(m->head));
+
+	parse(m, &s);
+	free(m);
+
+	encoded = write_frame(&s, n);
+	destroy_sections(&s);
+
+	return encoded;
+}
+
+JEP_UTILS_API jep_byte_buffer* JEP_UTILS_CALL
+jep_lz_decompress(jep_byte_buffer* encoded)
+{
+	jep_byte_buffer* raw;  // The decompressed bytes
+	jep_byte* buffer;      // The array of decompressed bytes
+	lz_sections s;         // The decoded sections
+	uint32_t n;            // The number of raw bytes
+
+	if (encoded == NULL || encoded->size < lz_frame_header
+		|| encoded->buffer[0] != lz_magic || encoded->buffer[1] != lz_type)
+	{
+		return NULL;
+	}
+
+	jep_build_u32(n, (encoded->buffer + 2));
+
+	if (!read_sections(encoded, n, &s))
+		return NULL;
+
+	raw = jep_create_byte_buffer();
+
+	if (raw == NULL)
+	{
+		destroy_sections(&s);
+		return NULL;
+	}
+
+	// Make room for every byte before any are rebuilt.
+	if (n > raw->cap)
+	{
+		buffer = jep_realloc(raw->buffer, jep_byte, n);
+
+		if (buffer == NULL)
+		{
+			destroy_sections(&s);
+			jep_destroy_byte_buffer(raw);
+			return NULL;
+		}
+
+		raw->buffer = buffer;
+		raw->cap = n;
+	}
+
+	if (!rebuild(&s, raw->buffer, n))
+	{
+		destroy_sections(&s);
+		jep_destroy_byte_buffer(raw);
+		return NULL;
+	}
+
+	destroy_sections(&s);
+	raw->size = n;
+
+	return raw;
+}
+
+
+
+
+static int create_sections(lz_sections* s, const size_t* caps)
+{
+	uint32_t i; // Index
+
+	for (i = 0; i < LZ_SECTIONS; i++)
+	{
+		// Every section is allocated, even if it is empty,
+		// so that none of them is NULL.
+		s->data[i] = jep_alloc(jep_byte, caps[i] > 0 ? caps[i] : 1);
+		s->size[i] = 0;
+
+		if (s->data[i] == NULL)
+		{
+			while (i-- > 0)
+				free(s->data[i]);
+
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+
+static void destroy_sections(lz_sections* s)
+{
+	uint32_t i; // Index
+
+	for (i = 0; i < LZ_SECTIONS; i++)
+		free(s->data[i]);
+}
+
+
+static uint32_t hash4(const jep_byte* p)
+{
+	uint32_t x; // The four bytes
+
+	x = (uint32_t)p[0]
+		| ((uint32_t)p[1] << 8)
+		| ((uint32_t)p[2] << 16)
+		| ((uint32_t)p[3] << 24);
+
+	// Multiplying by a large odd constant mixes every byte
+	// into the high bits.
+	return (x * 2654435761U) >> (32 - LZ_HASH_BITS);
+}
+
+
+static void insert_until(lz_matcher* m, size_t end)
+{
+	uint32_t h; // The hash of the next four bytes
+
+	for (; m->next < end; m->next++)
+	{
+		if (m->size - m->next < LZ_MIN_MATCH)
+			continue;
+
+		h = hash4(m->src + m->next);
+		m->prev[m->next % LZ_CHAIN_SIZE] = m->head[h];
+		m->head[h] = (uint32_t)(m->next + 1);
+	}
+}
+
+
+static size_t find_match(lz_matcher* m, size_t pos, uint32_t* dist)
+{
+	const jep_byte* src;  // The raw bytes
+	const jep_byte* cur;  // The bytes to be matched
+	const jep_byte* prev; // The bytes of an earlier position
+	uint32_t cand;        // An earlier position plus one
+	uint32_t depth;       // The positions left to try
+	size_t limit;         // The longest possible match
+	size_t best;          // The length of the longest match
+	size_t len;           // The length of a match
+
+	src = m->src;
+	cur = src + pos;
+	limit = m->size - pos;
+	best = 0;
+
+	cand = m->head[hash4(cur)];
+
+	for (depth = m->level->depth; cand != 0 && depth > 0; depth--)
+	{
+		// Older positions are too far away to be referenced, and
+		// their place in the chain may have been taken.
+		if (pos - (cand - 1) > JEP_LZ_WINDOW_SIZE)
+			break;
+
+		prev = src + cand - 1;
+
+		// A match can only be longer than the best one if it
+		// agrees at the best one's last byte.
+		if (best < limit && prev[best] == cur[best])
+		{
+			len = 0;
+			while (len < limit && prev[len] == cur[len])
+				len++;
+
+			if (len > best)
+			{
+				best = len;
+				*dist = (uint32_t)(cur - prev);
+
+				if (best >= m->level->nice || best == limit)
+					break;
+			}
+		}
+
+		cand = m->prev[(cand - 1) % LZ_CHAIN_SIZE];
+	}
+
+	return best >= LZ_MIN_MATCH ? best : 0;
+}
+
+
+static void parse(lz_matcher* m, lz_sections* s)
+{
+	size_t anchor; // The first literal that has not been added
+	size_t pos;    // The position being matched
+	size_t len;    // The length of the match at the position
+	size_t next;   // The length of the match at the next position
+	uint32_t dist; // The distance of the match at the position
+	uint32_t d;    // The distance of the match at the next position
+
+	anchor = 0;
+	pos = 0;
+	dist = 0;
+	d = 0;
+
+	while (m->size - pos >= LZ_MIN_MATCH)
+	{
+		insert_until(m, pos);
+		len = find_match(m, pos, &dist);
+
+		if (len == 0)
+		{
+			pos++;
+			continue;
+		}
+
+		// A match is put off for as long as the next position
+		// has a longer one.
+		while (m->level->lazy && len < m->level->nice
+			&& m->size - pos > LZ_MIN_MATCH)
+		{
+			insert_until(m, pos + 1);
+			next = find_match(m, pos + 1, &d);
+
+			if (next <= len)
+				break;
+
+			pos++;
+			len = next;
+			dist = d;
+		}
+
+		put_sequence(s, m->src + anchor, pos - anchor, len, dist);
+
+		pos += len;
+		anchor = pos;
+	}
+
+	// The bytes after the last match are left in the literals,
+	// where the decoder finds them once every match is copied.
+	memcpy(s->data[LZ_LITERALS] + s->size[LZ_LITERALS], m->src + anchor,
+		m->size - anchor);
+	s->size[LZ_LITERALS] += m->size - anchor;
+}
+
+
+static void put_sequence(lz_sections* s, const jep_byte* lits, size_t count,
+	size_t len, uint32_t dist)
+{
+	jep_byte token; // The literal count and match length
+
+	memcpy(s->data[LZ_LITERALS] + s->size[LZ_LITERALS], lits, count);
+	s->size[LZ_LITERALS] += count;
+
+	len -= LZ_MIN_MATCH;
+
+	token = (jep_byte)(((count < LZ_TOKEN_MAX ? count : LZ_TOKEN_MAX) << 4)
+		| (len < LZ_TOKEN_MAX ? len : LZ_TOKEN_MAX));
+	s->data[LZ_TOKENS][s->size[LZ_TOKENS]++] = token;
+
+	if (count >= LZ_TOKEN_MAX)
+		put_extra(s, count - LZ_TOKEN_MAX);
+
+	if (len >= LZ_TOKEN_MAX)
+		put_extra(s, len - LZ_TOKEN_MAX);
+
+	s->data[LZ_DIST_LOW][s->size[LZ_DIST_LOW]++] = (jep_byte)dist;
+	s->data[LZ_DIST_HIGH][s->size[LZ_DIST_HIGH]++] = (jep_byte)(dist >> 8);
+}
+
+
+static void put_extra(lz_sections* s, size_t n)
+{
+	jep_byte* extra; // The extra bytes
+
+	extra = s->data[LZ_EXTRA];
+
+	while (n >= UCHAR_MAX)
+	{
+		extra[s->size[LZ_EXTRA]++] = UCHAR_MAX;
+		n -= UCHAR_MAX;
+	}
+
+	extra[s->size[LZ_EXTRA]++] = (jep_byte)n;
+}
+
+
+static int read_extra(const lz_sections* s, size_t* pos, size_t* n)
+{
+	jep_byte b; // An extra byte
+
+	do
+	{
+		if (*pos >= s->size[LZ_EXTRA])
+			return 0;
+
+		b = s->data[LZ_EXTRA][(*pos)++];
+		*n += b;
+	} while (b == UCHAR_MAX);
+
+	return 1;
+}
+
+
+static jep_byte_buffer* write_frame(lz_sections* s, size_t n)
+{
+	jep_byte_buffer* encoded; // The frame
+	jep_byte* buffer;         // The array of the frame
+	jep_byte* dest;           // The next section of the frame
+	size_t bound;             // The largest possible size of the frame
+	size_t size;              // The size of an encoded section
+	uint32_t i;               // Index
+
+	bound = lz_frame_header;
+	for (i = 0; i < LZ_SECTIONS; i++)
+		bound += lz_section_header + jep_huff_compress_bound(s->size[i]);
+
+	encoded = jep_create_byte_buffer();
+
+	if (encoded == NULL)
+		return NULL;
+
+	buffer = jep_realloc(encoded->buffer, jep_byte, bound);
+
+	if (buffer == NULL)
+	{
+		jep_destroy_byte_buffer(encoded);
+		return NULL;
+	}
+
+	encoded->buffer = buffer;
+	encoded->cap = bound;
+
+	buffer[0] = lz_magic;
+	buffer[1] = lz_type;
+	jep_split_u32((uint32_t)n, (buffer + 2));
+	encoded->size = lz_frame_header;
+
+	for (i = 0; i < LZ_SECTIONS; i++)
+	{
+		dest = buffer + encoded->size;
+
+		if (!jep_huff_encode_to(s->data[i], s->size[i],
+			dest + lz_section_header,
+			bound - encoded->size - lz_section_header, &size))
+		{
+			jep_destroy_byte_buffer(encoded);
+			return NULL;
+		}
+
+		jep_split_u32((uint32_t)s->size[i], dest);
+		jep_split_u32((uint32_t)size, (dest + 4));
+		encoded->size += lz_section_header + size;
+	}
+
+	return encoded;
+}
+
+
+static int read_sections(jep_byte_buffer* encoded, uint32_t n,
+	lz_sections* s)
+{
+	const jep_byte* src;       // The frame
+	size_t caps[LZ_SECTIONS];  // The decoded size of each section
+	size_t blocks[LZ_SECTIONS];// The encoded size of each section
+	uint32_t count;            // A size read from the frame
+	size_t pos;                // Position in the frame
+	size_t size;               // The number of decoded bytes
+	uint32_t i;                // Index
+
+	src = encoded->buffer;
+	pos = lz_frame_header;
+
+	// Every section is found before any is decoded, so a frame that
+	// is cut short does not allocate anything. No section can
+	// decode to more bytes than the frame holds.
+	for (i = 0; i < LZ_SECTIONS; i++)
+	{
+		if (encoded->size - pos < lz_section_header)
+			return 0;
+
+		jep_build_u32(count, (src + pos));
+		caps[i] = count;
+		jep_build_u32(count, (src + pos + 4));
+		blocks[i] = count;
+		pos += lz_section_header;
+
+		if (caps[i] > n || blocks[i] > encoded->size - pos)
+			return 0;
+
+		pos += blocks[i];
+	}
+
+	// Every match has a token and both halves of a distance. A match
+	// can cover no more bytes than its token and its extra bytes give
+	// it, so a frame that claims more raw bytes than its sections can
+	// rebuild is rejected before anything is allocated.
+	if (caps[LZ_DIST_LOW] != caps[LZ_TOKENS]
+		|| caps[LZ_DIST_HIGH] != caps[LZ_TOKENS]
+		|| n > (uint64_t)caps[LZ_LITERALS]
+			+ (uint64_t)caps[LZ_TOKENS] * (LZ_TOKEN_MAX + LZ_MIN_MATCH)
+			+ (uint64_t)caps[LZ_EXTRA] * UCHAR_MAX)
+	{
+		return 0;
+	}
+
+	if (!create_sections(s, caps))
+		return 0;
+
+	pos = lz_frame_header;
+
+	for (i = 0; i < LZ_SECTIONS; i++)
+	{
+		pos += lz_section_header;
+
+		if (!jep_huff_decode_to(src + pos, blocks[i], s->data[i], caps[i],
+			&size) || size != caps[i])
+		{
+			destroy_sections(s);
+			return 0;
+		}
+
+		s->size[i] = size;
+		pos += blocks[i];
+	}
+
+	return 1;
+}
+
+
+static int rebuild(const lz_sections* s, jep_byte* dest, size_t n)
+{
+	const jep_byte* lits;   // The next literal
+	size_t lits_left;       // The number of literals left
+	size_t extra;           // Position in the extra bytes
+	size_t out;             // The number of bytes rebuilt
+	size_t count;           // The number of literals before a match
+	size_t len;             // The length of a match
+	size_t dist;            // The distance of a match
+	size_t i;               // Index
+	size_t k;               // Index
+	jep_byte token;         // The literal count and match length
+
+	if (s->size[LZ_DIST_LOW] != s->size[LZ_TOKENS]
+		|| s->size[LZ_DIST_HIGH] != s->size[LZ_TOKENS])
+	{
+		return 0;
+	}
+
+	lits = s->data[LZ_LITERALS];
+	lits_left = s->size[LZ_LITERALS];
+	extra = 0;
+	out = 0;
+
+	for (i = 0; i < s->size[LZ_TOKENS]; i++)
+	{
+		token = s->data[LZ_TOKENS][i];
+
+		count = token >> 4;
+		if (count == LZ_TOKEN_MAX && !read_extra(s, &extra, &count))
+			return 0;
+
+		len = token & LZ_TOKEN_MAX;
+		if (len == LZ_TOKEN_MAX && !read_extra(s, &extra, &len))
+			return 0;
+
+		len += LZ_MIN_MATCH;
+		dist = s->data[LZ_DIST_LOW][i]
+			| ((size_t)s->data[LZ_DIST_HIGH][i] << 8);
+
+		if (count > lits_left || count > n - out)
+			return 0;
+
+		memcpy(dest + out, lits, count);
+		lits += count;
+		lits_left -= count;
+		out += count;
+
+		if (dist == 0 || dist > out || len > n - out)
+			return 0;
+
+		// A match may overlap the bytes it copies, which repeats them.
+		if (dist >= len)
+		{
+			memcpy(dest + out, dest + out - dist, len);
+		}
+		else
+		{
+			for (k = 0; k < len; k++)
+				dest[out + k] = dest[out + k - dist];
+		}
+
+		out += len;
+	}
+
+	// The literals after the last match finish the bytes.
+	if (lits_left != n - out || extra != s->size[LZ_EXTRA])
+		return 0;
+
+	memcpy(dest + out, lits, lits_left);
+
+	return 1;
+}
@@ -0,0 +1,152 @@
+#include "ans_tests.h"
+
+int ans_round_trip_test()
+{
+	jep_byte_buffer* raw;
+	jep_byte_buffer* encoded;
+	jep_byte_buffer* decoded;
+	uint32_t x;
+	size_t n;
+	size_t i;
+	int res;
+
+	raw = jep_create_byte_buffer();
+
+	if (raw == NULL)
+		return 0;
+
+	res = 1;
+	x = 7;
+
+	// Empty input, a single byte, a single repeated byte, and inputs
+	// that use a few or all of the byte values.
+	for (n = 0; res && n <= 3000; n = n < 4 ? n + 1 : n * 3)
+	{
+		jep_clear_byte_buffer(raw);
+
+		for (i = 0; i < n; i++)
+		{
+			x = x * 1664525U + 1013904223U;
+			jep_append_byte(raw, n == 3 ? 'z'
+				: (jep_byte)((x >> 24) % (n % 2 ? 256 : 5)));
+		}
+
+		encoded = jep_ans_encode(raw);
+		decoded = encoded != NULL ? jep_ans_decode(encoded) : NULL;
+
+		if (encoded == NULL || encoded->size > jep_ans_bound(n)
+			|| decoded == NULL || decoded->size != n
+			|| (n > 0 && memcmp(decoded->buffer, raw->buffer, n)))
+		{
+			res = 0;
+		}
+
+		jep_destroy_byte_buffer(encoded);
+		jep_destroy_byte_buffer(decoded);
+	}
+
+	jep_destroy_byte_buffer(raw);
+
+	return res;
+}
+
+int ans_skew_test()
+{
+	jep_byte bytes[10000];
+	jep_byte out[10000];
+	jep_byte* frame;
+	size_t bound;
+	size_t size;
+	uint32_t x;
+	size_t i;
+	int res;
+
+	// Nearly every byte is the same, so it costs a small fraction of
+	// a bit, while any Huffman code would cost at least one bit.
+	x = 3;
+	for (i = 0; i < sizeof(bytes); i++)
+	{
+		x = x * 1664525U + 1013904223U;
+		bytes[i] = (x >> 24) < 8 ? (jep_byte)(x >> 16) : 'e';
+	}
+
+	bound = jep_ans_bound(sizeof(bytes));
+	frame = jep_alloc(jep_byte, bound);
+
+	if (frame == NULL)
+		return 0;
+
+	res = 1;
+
+	if (!jep_ans_encode_to(bytes, sizeof(bytes), frame, bound, &size)
+		|| size >= sizeof(bytes) / 8
+		|| !jep_ans_decode_to(frame, size, out, sizeof(out), &size)
+		|| size != sizeof(bytes) || memcmp(out, bytes, sizeof(bytes)))
+	{
+		res = 0;
+	}
+
+	free(frame);
+
+	return res;
+}
+
+int ans_damage_test()
+{
+	jep_byte_buffer encoded;
+	jep_byte bytes[1000];
+	jep_byte frame[2000];
+	jep_byte out[1000];
+	size_t n;
+	size_t size;
+	size_t i;
+	int res;
+
+	for (i = 0; i < sizeof(bytes); i++)
+		bytes[i] = (jep_byte)("a man a plan a canal panama"[i % 27]);
+
+	if (!jep_ans_encode_to(bytes, sizeof(bytes), frame, sizeof(frame), &n))
+		return 0;
+
+	res = 1;
+
+	// The frame does not fit in less space than it takes.
+	if (jep_ans_encode_to(bytes, sizeof(bytes), frame, n - 1, &size))
+		res = 0;
+
+	// Nor do the decoded bytes.
+	if (jep_ans_decode_to(frame, n, out, sizeof(out) - 1, &size))
+		res = 0;
+
+	// A frame that is cut short is rejected.
+	for (i = 0; i < n; i++)
+	{
+		if (jep_ans_decode_to(frame, i, out, sizeof(out), &size))
+			res = 0;
+	}
+
+	// A frame that claims more bytes than its bits can hold is rejected
+	// before any room is made for them.
+	frame[3] = 0xFF;
+	encoded.buffer = frame;
+	encoded.size = encoded.cap = n;
+
+	if (jep_ans_measure(frame, n, &size) || jep_ans_decode(&encoded) != NULL)
+		res = 0;
+
+	frame[3] = 0;
+
+	if (!jep_ans_measure(frame, n, &size) || size != sizeof(bytes))
+		res = 0;
+
+	// So is a frame whose frequencies do not add up.
+	frame[6]++;
+
+	if (jep_ans_decode_to(frame, n, out, sizeof(out), &size)
+		|| jep_ans_measure(frame, n, &size))
+	{
+		res = 0;
+	}
+
+	return res;
+}
@@ -0,0 +1,12 @@
+#ifndef JEP_ANS_TESTS_H
+#define JEP_ANS_TESTS_H
+
+#include "jep_utils/ans.h"
+
+int ans_round_trip_test();
+
+int ans_skew_test();
+
+int ans_damage_test();
+
+#endif
@@ -0,0 +1,85 @@
+#include "crc_tests.h"
+
+/**
+ * Computes a checksum one bit at a time, straight from the definition.
+ */
+static uint32_t crc_bitwise(const jep_byte* src, size_t n)
+{
+	uint32_t crc;
+	size_t i;
+	int k;
+
+	crc = 0xFFFFFFFF;
+	for (i = 0; i < n; i++)
+	{
+		crc ^= src[i];
+		for (k = 0; k < 8; k++)
+			crc = (crc >> 1) ^ (crc & 1 ? 0x82F63B78 : 0);
+	}
+
+	return ~crc;
+}
+
+int crc_vector_test()
+{
+	const char* check = "123456789";
+	jep_byte zeros[32];
+	int res;
+
+	res = 1;
+
+	// The standard check value of CRC-32C.
+	if (jep_crc32c(0, (const jep_byte*)check, 9) != 0xE3069283)
+		res = 0;
+
+	// A published vector from RFC 3720.
+	memset(zeros, 0, sizeof(zeros));
+	if (jep_crc32c(0, zeros, sizeof(zeros)) != 0x8A9136AA)
+		res = 0;
+
+	if (jep_crc32c(0, NULL, 0) != 0 || jep_crc32c(0, zeros, 0) != 0)
+		res = 0;
+
+	return res;
+}
+
+int crc_split_test()
+{
+	jep_byte bytes[1031];
+	uint32_t expected;
+	uint32_t crc;
+	uint32_t x;
+	size_t n;
+	size_t i;
+	int res;
+
+	res = 1;
+
+	x = 7;
+	for (i = 0; i < sizeof(bytes); i++)
+	{
+		x = x * 1664525U + 1013904223U;
+		bytes[i] = (jep_byte)(x >> 24);
+	}
+
+	// Lengths that do not end on a whole slice are finished
+	// a byte at a time.
+	for (n = 0; res && n <= sizeof(bytes); n += 103)
+	{
+		if (jep_crc32c(0, bytes, n) != crc_bitwise(bytes, n))
+			res = 0;
+	}
+
+	// A checksum computed in pieces matches one computed at once.
+	expected = crc_bitwise(bytes, sizeof(bytes));
+	for (n = 1; res && n < sizeof(bytes); n += 97)
+	{
+		crc = jep_crc32c(0, bytes, n);
+		crc = jep_crc32c(crc, bytes + n, sizeof(bytes) - n);
+
+		if (crc != expected)
+			res = 0;
+	}
+
+	return res;
+}
@@ -0,0 +1,10 @@
+#ifndef JEP_CRC_TESTS_H
+#define JEP_CRC_TESTS_H
+
+#include "jep_utils/crc.h"
+
+int crc_vector_test();
+
+int crc_split_test();
+
+#endif
@@ -0,0 +1,70 @@
+#include "histogram_tests.h"
+
+int histogram_count_test()
+{
+	jep_byte bytes[5003];
+	uint32_t counts[JEP_HISTOGRAM_SIZE];
+	uint32_t expected[JEP_HISTOGRAM_SIZE];
+	uint32_t x;
+	size_t n;
+	size_t i;
+	int res;
+
+	res = 1;
+
+	x = 1;
+	for (i = 0; i < sizeof(bytes); i++)
+	{
+		x = x * 1664525U + 1013904223U;
+		bytes[i] = (jep_byte)(x >> 24);
+	}
+
+	// Count inputs that are too small to be split among tables,
+	// and inputs that do not end on a whole word.
+	for (n = 0; res && n <= sizeof(bytes); n += 1001)
+	{
+		for (i = 0; i < JEP_HISTOGRAM_SIZE; i++)
+			expected[i] = 0;
+
+		for (i = 0; i < n; i++)
+			expected[bytes[i]]++;
+
+		// The counters are overwritten.
+		counts[0] = 12345;
+
+		if (!jep_byte_histogram(bytes, n, counts)
+			|| memcmp(counts, expected, sizeof(counts)))
+		{
+			res = 0;
+		}
+	}
+
+	if (jep_byte_histogram(bytes, sizeof(bytes), NULL))
+		res = 0;
+
+	return res;
+}
+
+int histogram_run_test()
+{
+	jep_byte bytes[4099];
+	uint32_t counts[JEP_HISTOGRAM_SIZE];
+	size_t i;
+	int res;
+
+	memset(bytes, 'a', sizeof(bytes));
+	bytes[sizeof(bytes) - 1] = 'b';
+
+	if (!jep_byte_histogram(bytes, sizeof(bytes), counts))
+		return 0;
+
+	res = counts['a'] == sizeof(bytes) - 1 && counts['b'] == 1;
+
+	for (i = 0; i < JEP_HISTOGRAM_SIZE; i++)
+	{
+		if (i != 'a' && i != 'b' && counts[i] != 0)
+			res = 0;
+	}
+
+	return res;
+}
@@ -0,0 +1,10 @@
+#ifndef JEP_HISTOGRAM_TESTS_H
+#define JEP_HISTOGRAM_TESTS_H
+
+#include "jep_utils/histogram.h"
+
+int histogram_count_test();
+
+int histogram_run_test();
+
+#endif
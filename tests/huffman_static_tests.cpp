@@ -0,0 +1,174 @@
+#include "jep_utils/huffman.hpp"
+#include "huffman_static_tests.h"
+
+/**
+ * Counts letters roughly as often as they occur in English text,
+ * with spaces and a few punctuation marks.
+ */
+static constexpr uint32_t text_counts[UCHAR_MAX + 1] = {
+	/* 0x00 */ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 20, 0, 0, 0, 0, 0,
+	/* 0x10 */ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	/* 0x20 */ 180, 1, 2, 0, 0, 0, 0, 3, 1, 1, 0, 0, 12, 2, 10, 0,
+	/* 0x30 */ 4, 4, 3, 2, 2, 2, 2, 2, 2, 2, 1, 1, 0, 0, 0, 1,
+	/* 0x40 */ 0, 6, 2, 3, 2, 3, 2, 2, 3, 5, 1, 1, 2, 3, 2, 2,
+	/* 0x50 */ 2, 1, 2, 4, 6, 1, 1, 2, 1, 1, 1, 0, 0, 0, 0, 0,
+	/* 0x60 */ 0, 82, 15, 28, 43, 127, 22, 20, 61, 70, 2, 8, 40, 24, 67, 75,
+	/* 0x70 */ 19, 1, 60, 63, 91, 28, 10, 24, 2, 20, 1
+};
+
+/* the table is built while compiling */
+static constexpr jep::huff_static_table text_table =
+	jep::make_huff_table(text_counts);
+
+static_assert(text_table.valid, "the text table has no codes");
+static_assert(text_table.lengths[' '] < text_table.lengths['z'],
+	"spaces are more common than z");
+
+int huff_static_round_trip_test()
+{
+	const char* text = "The quick brown fox jumps over the lazy dog.\n"
+		"Pack my box with five dozen liquor jugs, 1234567890 times!\n";
+	jep_byte raw[1024];
+	jep_byte encoded[1024];
+	jep_byte decoded[1024];
+	size_t enc_size;
+	size_t dec_size;
+	size_t n;
+	uint32_t used;
+	int res;
+
+	res = 1;
+
+	// The text is repeated so that its codes outweigh the header.
+	for (n = 0; n + strlen(text) <= sizeof(raw); n += strlen(text))
+		memcpy(raw + n, text, strlen(text));
+
+	// The codes fit in the decoding table.
+	used = 0;
+	for (int c = 0; c <= UCHAR_MAX; c++)
+	{
+		if (text_table.lengths[c] > jep::huff_static_bits
+			|| (text_table.lengths[c] == 0) != (text_counts[c] == 0))
+		{
+			res = 0;
+		}
+
+		if (text_table.lengths[c] > 0)
+			used += jep::huff_static_size >> text_table.lengths[c];
+	}
+
+	if (used > jep::huff_static_size)
+		res = 0;
+
+	if (!jep::huff_encode_static(text_table, raw, n, encoded,
+		sizeof(encoded), &enc_size)
+		|| enc_size >= n)
+	{
+		return 0;
+	}
+
+	// The static decoder and the C decoder agree.
+	if (!jep::huff_decode_static(text_table, encoded, enc_size, decoded,
+		sizeof(decoded), &dec_size)
+		|| dec_size != n || memcmp(decoded, raw, n))
+	{
+		res = 0;
+	}
+
+	memset(decoded, 0, sizeof(decoded));
+
+	if (!jep_huff_decode_to(encoded, enc_size, decoded, sizeof(decoded),
+		&dec_size) || dec_size != n || memcmp(decoded, raw, n))
+	{
+		res = 0;
+	}
+
+	// A byte without a code cannot be encoded.
+	if (jep::huff_encode_static(text_table, (const jep_byte*)"tab\t", 4,
+		encoded, sizeof(encoded), &enc_size))
+	{
+		res = 0;
+	}
+
+	// Empty input gives the same empty block as the C encoder.
+	if (!jep::huff_encode_static(text_table, raw, 0, encoded,
+		sizeof(encoded), &enc_size)
+		|| !jep_huff_encode_to(raw, 0, decoded, sizeof(decoded), &dec_size)
+		|| enc_size != dec_size || memcmp(encoded, decoded, enc_size)
+		|| !jep::huff_decode_static(text_table, encoded, enc_size, decoded,
+			sizeof(decoded), &dec_size)
+		|| dec_size != 0)
+	{
+		res = 0;
+	}
+
+	return res;
+}
+
+int huff_static_interop_test()
+{
+	static constexpr uint32_t one[UCHAR_MAX + 1] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+	static constexpr uint32_t none[UCHAR_MAX + 1] = {};
+	constexpr jep::huff_static_table single = jep::make_huff_table(one);
+	constexpr jep::huff_static_table empty = jep::make_huff_table(none);
+	jep_byte raw[3000];
+	jep_byte encoded[4096];
+	jep_byte decoded[3000];
+	size_t enc_size;
+	size_t dec_size;
+	int res;
+
+	static_assert(single.valid && single.lengths[7] == 1, "one code");
+	static_assert(!empty.valid, "no codes");
+
+	res = 1;
+
+	for (size_t i = 0; i < sizeof(raw); i++)
+		raw[i] = (jep_byte)("static tables"[i % 13]);
+
+	// Blocks written by the C encoder fall back to the C decoder.
+	if (!jep_huff_encode_to(raw, sizeof(raw), encoded, sizeof(encoded),
+		&enc_size)
+		|| !jep::huff_decode_static(text_table, encoded, enc_size, decoded,
+			sizeof(decoded), &dec_size)
+		|| dec_size != sizeof(raw) || memcmp(decoded, raw, sizeof(raw)))
+	{
+		res = 0;
+	}
+
+	// A block that is cut short, or that holds more bytes than
+	// there is room for, is rejected by the static decoder.
+	if (!jep::huff_encode_static(text_table, raw, sizeof(raw), encoded,
+		sizeof(encoded), &enc_size))
+	{
+		return 0;
+	}
+
+	if (jep::huff_decode_static(text_table, encoded, enc_size - 1, decoded,
+		sizeof(decoded), &dec_size)
+		|| jep::huff_decode_static(text_table, encoded, enc_size, decoded,
+			sizeof(decoded) - 1, &dec_size))
+	{
+		res = 0;
+	}
+
+	// A single byte value is given a one bit code.
+	memset(raw, 7, 100);
+
+	if (!jep::huff_encode_static(single, raw, 100, encoded, sizeof(encoded),
+		&enc_size)
+		|| !jep_huff_decode_to(encoded, enc_size, decoded, sizeof(decoded),
+			&dec_size)
+		|| dec_size != 100 || memcmp(decoded, raw, 100))
+	{
+		res = 0;
+	}
+
+	if (jep::huff_encode_static(empty, raw, 100, encoded, sizeof(encoded),
+		&enc_size))
+	{
+		res = 0;
+	}
+
+	return res;
+}
@@ -0,0 +1,16 @@
+#ifndef JEP_HUFFMAN_STATIC_TESTS_H
+#define JEP_HUFFMAN_STATIC_TESTS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int huff_static_round_trip_test();
+
+int huff_static_interop_test();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -2,7 +2,10 @@
 
 int huff_encode_test()
 {
-	jep_byte data[6] = {
+	jep_byte data[24] = {
+		0x43, 0x41, 0x42, 0x43, 0x43, 0x42,
+		0x43, 0x41, 0x42, 0x43, 0x43, 0x42,
+		0x43, 0x41, 0x42, 0x43, 0x43, 0x42,
 		0x43, 0x41, 0x42, 0x43, 0x43, 0x42
 	};
 
@@ -17,7 +20,7 @@ int huff_encode_test()
 		return 0;
 	}
 
-	jep_append_bytes(raw, data, 6);
+	jep_append_bytes(raw, data, 24);
 
 	encoded = jep_huff_encode(raw);
 
@@ -30,14 +33,26 @@ int huff_encode_test()
 
 	res = 1;
 
-	if (encoded->buffer[2] != 0x41)
+	// The header, followed by the lowest and highest
+	// bytes in the dictionary. Fewer bytes would be stored
+	// rather than coded.
+	if (encoded->size != 21)
+		res = 0;
+	else if (encoded->buffer[0] != 0x4A || encoded->buffer[1] != 0x03)
+		res = 0;
+	else if (encoded->buffer[4] != 0x41 || encoded->buffer[5] != 0x43)
 		res = 0;
 
-	if (encoded->buffer[15] != 0x42)
+	// The code lengths of A, B and C packed into two bytes.
+	else if (encoded->buffer[6] != 0x22 || encoded->buffer[7] != 0x01)
 		res = 0;
 
-	if (encoded->buffer[28] != 0x43)
+	// The number of bytes that the data decodes to.
+	else if (encoded->buffer[8] != 24 || encoded->buffer[9] != 0
+		|| encoded->buffer[10] != 0 || encoded->buffer[11] != 0)
+	{
 		res = 0;
+	}
 
 	jep_destroy_byte_buffer(encoded);
 
@@ -163,3 +178,1947 @@ int huff_read_test()
 
 	return res;
 }
+
+int huff_round_trip_test()
+{
+	jep_byte_buffer* raw;
+	jep_byte_buffer* encoded;
+	jep_byte_buffer* decoded;
+	uint32_t i;
+	jep_byte b;
+	int res;
+
+	raw = jep_create_byte_buffer();
+
+	if (raw == NULL)
+		return 0;
+
+	// Each symbol is twice as frequent as the next, so the
+	// rarest symbols receive codes that are too long to be
+	// resolved with a single table lookup.
+	for (i = 1; i < 100000; i++)
+	{
+		b = 0;
+		while (b < 20 && !(i & (1U << b)))
+			b++;
+
+		jep_append_byte(raw, (jep_byte)('a' + b));
+	}
+
+	encoded = jep_huff_encode_limited(raw, JEP_HUFF_MAX_CODE_LENGTH);
+
+	if (encoded == NULL)
+	{
+		jep_destroy_byte_buffer(raw);
+		return 0;
+	}
+
+	decoded = jep_huff_decode(encoded);
+
+	jep_destroy_byte_buffer(encoded);
+
+	if (decoded == NULL)
+	{
+		jep_destroy_byte_buffer(raw);
+		return 0;
+	}
+
+	res = 1;
+
+	if (decoded->size != raw->size)
+		res = 0;
+	else if (memcmp(decoded->buffer, raw->buffer, raw->size))
+		res = 0;
+
+	jep_destroy_byte_buffer(raw);
+	jep_destroy_byte_buffer(decoded);
+
+	return res;
+}
+
+int huff_read_canonical_test()
+{
+	// The byte sequence 0x43, 0x41, 0x42, 0x43, 0x43, 0x42
+	// encoded using canonical Huffman codes
+	jep_byte data[14] = {
+		0x4A, 0x02, 0x00, 0x04, 0x41,
+		0x43, 0x22, 0x01, 0x09, 0x00,
+		0x00, 0x00, 0x9A, 0x01
+	};
+
+	jep_byte_buffer* raw;
+	jep_huff_code* huff;
+	int res;
+
+	raw = jep_create_byte_buffer();
+
+	if (raw == NULL)
+		return 0;
+
+	jep_append_bytes(raw, data, 14);
+
+	huff = jep_huff_read(raw);
+
+	jep_destroy_byte_buffer(raw);
+
+	if (huff == NULL)
+		return 0;
+
+	res = 1;
+
+	if (huff->data->bit_count != 9)
+		res = 0;
+
+	if (huff->dict->count != 3)
+		res = 0;
+
+	// C has the shortest code, so it is assigned 0.
+	// A and B follow in order of byte value with 10 and 11.
+	if (huff->dict->symbols[2].b != 0x43
+		|| huff->dict->symbols[2].code->bit_count != 1
+		|| jep_get_bit(huff->dict->symbols[2].code, 0) != 0)
+	{
+		res = 0;
+	}
+
+	if (huff->dict->symbols[0].b != 0x41
+		|| huff->dict->symbols[0].code->bit_count != 2
+		|| jep_get_bit(huff->dict->symbols[0].code, 0) != 1
+		|| jep_get_bit(huff->dict->symbols[0].code, 1) != 0)
+	{
+		res = 0;
+	}
+
+	if (huff->dict->symbols[1].b != 0x42
+		|| jep_get_bit(huff->dict->symbols[1].code, 1) != 1)
+	{
+		res = 0;
+	}
+
+	jep_destroy_huff_code(huff);
+
+	return res;
+}
+
+int huff_limit_test()
+{
+	jep_byte_buffer* raw;
+	jep_byte_buffer* encoded;
+	jep_byte_buffer* decoded;
+	jep_huff_code* huff;
+	uint32_t i;
+	jep_byte b;
+	int res;
+
+	raw = jep_create_byte_buffer();
+
+	if (raw == NULL)
+		return 0;
+
+	// Without a limit, the rarest of these symbols
+	// would receive codes of 16 bits or more.
+	for (i = 1; i < 100000; i++)
+	{
+		b = 0;
+		while (b < 20 && !(i & (1U << b)))
+			b++;
+
+		jep_append_byte(raw, (jep_byte)('a' + b));
+	}
+
+	res = 1;
+
+	// Four bits cannot give 17 symbols their own code.
+	encoded = jep_huff_encode_limited(raw, 4);
+
+	if (encoded != NULL)
+	{
+		jep_destroy_byte_buffer(encoded);
+		res = 0;
+	}
+
+	encoded = jep_huff_encode_limited(raw, 8);
+
+	if (encoded == NULL)
+	{
+		jep_destroy_byte_buffer(raw);
+		return 0;
+	}
+
+	huff = jep_huff_read(encoded);
+	decoded = jep_huff_decode(encoded);
+
+	jep_destroy_byte_buffer(encoded);
+
+	if (huff == NULL || decoded == NULL)
+		res = 0;
+
+	for (i = 0; res && i < huff->dict->count; i++)
+	{
+		if (huff->dict->symbols[i].code->bit_count > 8)
+			res = 0;
+	}
+
+	if (res && (decoded->size != raw->size
+		|| memcmp(decoded->buffer, raw->buffer, raw->size)))
+	{
+		res = 0;
+	}
+
+	jep_destroy_huff_code(huff);
+	jep_destroy_byte_buffer(decoded);
+	jep_destroy_byte_buffer(raw);
+
+	return res;
+}
+
+int huff_stream_test()
+{
+	jep_huff_stream* stream;
+	jep_byte_buffer* encoded;
+	jep_byte_buffer* decoded;
+	jep_byte raw[10000];
+	uint32_t x;
+	size_t i;
+	size_t n;
+	int res;
+
+	// Each block of this input favors different bytes.
+	x = 1;
+	for (i = 0; i < sizeof(raw); i++)
+	{
+		x = x * 1664525U + 1013904223U;
+		raw[i] = (jep_byte)('a' + (i / 3000) * 8 + (x >> 29));
+	}
+
+	encoded = jep_create_byte_buffer();
+	decoded = jep_create_byte_buffer();
+	stream = jep_huff_encode_init(3000);
+
+	if (encoded == NULL || decoded == NULL || stream == NULL)
+	{
+		jep_destroy_byte_buffer(encoded);
+		jep_destroy_byte_buffer(decoded);
+		jep_destroy_huff_stream(stream);
+		return 0;
+	}
+
+	res = 1;
+
+	// Feed the encoder pieces of uneven size, some of which
+	// cover whole blocks.
+	for (i = 0, n = 1; i < sizeof(raw); i += n, n = n * 7 % 4001 + 1)
+	{
+		if (n > sizeof(raw) - i)
+			n = sizeof(raw) - i;
+
+		if (!jep_huff_encode_update(stream, raw + i, n, encoded))
+			res = 0;
+	}
+
+	if (!jep_huff_encode_finish(stream, encoded))
+		res = 0;
+
+	jep_destroy_huff_stream(stream);
+
+	stream = jep_huff_decode_init();
+
+	if (stream == NULL)
+		res = 0;
+
+	// Feed the decoder one byte at a time, then the rest at once.
+	for (i = 0; res && i < encoded->size; i++)
+	{
+		n = i < 500 ? 1 : encoded->size - i;
+
+		if (!jep_huff_decode_update(stream, encoded->buffer + i, n, decoded))
+			res = 0;
+
+		i += n - 1;
+	}
+
+	if (res && !jep_huff_decode_finish(stream))
+		res = 0;
+
+	if (res && (decoded->size != sizeof(raw)
+		|| memcmp(decoded->buffer, raw, sizeof(raw))))
+	{
+		res = 0;
+	}
+
+	// A stream that ends in the middle of a block is incomplete.
+	if (res && (!jep_huff_decode_update(stream, encoded->buffer,
+		encoded->size - 1, decoded)
+		|| jep_huff_decode_finish(stream)))
+	{
+		res = 0;
+	}
+
+	jep_destroy_huff_stream(stream);
+	jep_destroy_byte_buffer(encoded);
+	jep_destroy_byte_buffer(decoded);
+
+	return res;
+}
+
+int huff_blocks_test()
+{
+	jep_byte_buffer* raw;
+	jep_byte_buffer* encoded;
+	jep_byte_buffer* serial;
+	jep_byte_buffer* decoded;
+	uint32_t x;
+	size_t i;
+	int res;
+
+	raw = jep_create_byte_buffer();
+
+	if (raw == NULL)
+		return 0;
+
+	x = 7;
+	for (i = 0; i < 25000; i++)
+	{
+		x = x * 1664525U + 1013904223U;
+		jep_append_byte(raw, (jep_byte)('a' + (i / 4096) + (x >> 30)));
+	}
+
+	// The container does not depend on the number of threads.
+	encoded = jep_huff_encode_blocks(raw, 4096, 4);
+	serial = jep_huff_encode_blocks(raw, 4096, 1);
+	decoded = encoded != NULL ? jep_huff_decode(encoded) : NULL;
+
+	res = encoded != NULL && serial != NULL && decoded != NULL;
+
+	// There are seven blocks, the last of which is partial.
+	if (res && (encoded->size != serial->size
+		|| memcmp(encoded->buffer, serial->buffer, encoded->size)
+		|| encoded->buffer[2] != 0x01
+		|| encoded->buffer[7] != 7))
+	{
+		res = 0;
+	}
+
+	if (res && (decoded->size != raw->size
+		|| memcmp(decoded->buffer, raw->buffer, raw->size)))
+	{
+		res = 0;
+	}
+
+	// A container that has lost its last byte is rejected.
+	if (res)
+	{
+		jep_destroy_byte_buffer(decoded);
+		encoded->size--;
+		decoded = jep_huff_decode(encoded);
+
+		if (decoded != NULL)
+			res = 0;
+	}
+
+	jep_destroy_byte_buffer(raw);
+	jep_destroy_byte_buffer(encoded);
+	jep_destroy_byte_buffer(serial);
+	jep_destroy_byte_buffer(decoded);
+
+	return res;
+}
+
+int huff_random_access_test()
+{
+	jep_byte_buffer* raw;
+	jep_byte_buffer* encoded;
+	jep_byte_buffer* decoded;
+	jep_byte_buffer* block;
+	size_t offsets[] = { 0, 4095, 4096, 20000, 24999 };
+	size_t start;
+	uint32_t x;
+	size_t i;
+	int res;
+
+	raw = jep_create_byte_buffer();
+
+	if (raw == NULL)
+		return 0;
+
+	x = 11;
+	for (i = 0; i < 25000; i++)
+	{
+		x = x * 1664525U + 1013904223U;
+		jep_append_byte(raw, (jep_byte)('a' + (i / 4096) + (x >> 30)));
+	}
+
+	encoded = jep_huff_encode_blocks(raw, 4096, 2);
+	decoded = encoded != NULL ? jep_huff_decode_blocks(encoded, 3) : NULL;
+
+	res = decoded != NULL && decoded->size == raw->size
+		&& !memcmp(decoded->buffer, raw->buffer, raw->size);
+
+	// Destroy the first block. Only the block that is requested
+	// should be read, so the others can still be decoded.
+	if (res)
+		encoded->buffer[19 + 8 * 8 + 3] ^= 0xFF;
+
+	for (i = 0; res && i < sizeof(offsets) / sizeof(offsets[0]); i++)
+	{
+		block = jep_huff_decode_at(encoded, offsets[i], &start);
+
+		if (offsets[i] < 4096)
+		{
+			if (block != NULL)
+				res = 0;
+		}
+		else if (block == NULL || start != offsets[i] / 4096 * 4096
+			|| block->size != (start + 4096 > raw->size ? raw->size - start : 4096)
+			|| memcmp(block->buffer, raw->buffer + start, block->size))
+		{
+			res = 0;
+		}
+
+		jep_destroy_byte_buffer(block);
+	}
+
+	// There is no block beyond the end of the data.
+	if (res && jep_huff_decode_at(encoded, raw->size, &start) != NULL)
+		res = 0;
+
+	jep_destroy_byte_buffer(raw);
+	jep_destroy_byte_buffer(encoded);
+	jep_destroy_byte_buffer(decoded);
+
+	return res;
+}
+
+int huff_split_test()
+{
+	jep_byte_buffer* raw;
+	jep_byte_buffer* encoded;
+	jep_byte_buffer* decoded;
+	jep_huff_code* huff;
+	uint32_t limits[] = { JEP_HUFF_DEFAULT_CODE_LENGTH, JEP_HUFF_MAX_CODE_LENGTH };
+	uint32_t x;
+	size_t i;
+	int res;
+	int k;
+
+	raw = jep_create_byte_buffer();
+
+	if (raw == NULL)
+		return 0;
+
+	// The rarest bytes receive codes longer than the decoding table
+	// when the code length is not limited. The size does not divide
+	// evenly among the bitstreams.
+	x = 3;
+	for (i = 0; i < 70001; i++)
+	{
+		x = x * 1664525U + 1013904223U;
+		k = 0;
+		while (k < 20 && (x >> (31 - k)) & 1)
+			k++;
+
+		jep_append_byte(raw, (jep_byte)('a' + k));
+	}
+
+	res = 1;
+
+	for (k = 0; res && k < 2; k++)
+	{
+		encoded = jep_huff_encode_limited(raw, limits[k]);
+
+		if (encoded == NULL)
+		{
+			res = 0;
+			break;
+		}
+
+		decoded = jep_huff_decode(encoded);
+		huff = jep_huff_read(encoded);
+
+		if (encoded->buffer[2] != 0x02 || decoded == NULL
+			|| decoded->size != raw->size
+			|| memcmp(decoded->buffer, raw->buffer, raw->size))
+		{
+			res = 0;
+		}
+
+		// The bitstreams can also be read as a single bitstring.
+		if (huff == NULL || huff->data == NULL)
+			res = 0;
+
+		jep_destroy_byte_buffer(decoded);
+		jep_destroy_huff_code(huff);
+
+		// Losing the last byte loses part of the last bitstream.
+		encoded->size--;
+		decoded = jep_huff_decode(encoded);
+
+		if (decoded != NULL)
+			res = 0;
+
+		jep_destroy_byte_buffer(decoded);
+		jep_destroy_byte_buffer(encoded);
+	}
+
+	jep_destroy_byte_buffer(raw);
+
+	return res;
+}
+
+int huff_shared_test()
+{
+	jep_byte_buffer* samples[3];
+	jep_byte_buffer* written;
+	jep_byte_buffer* encoded;
+	jep_byte_buffer* decoded;
+	jep_byte_buffer* inline_dict;
+	jep_huff_table* trained;
+	jep_huff_table* table;
+	const char* text[] = {
+		"{\"id\":1,\"method\":\"get\",\"params\":[\"user\"]}",
+		"{\"id\":2,\"method\":\"put\",\"params\":[\"user\",\"name\"]}",
+		"{\"id\":3,\"method\":\"get\",\"params\":[\"group\"]}"
+	};
+	const char* message = "{\"id\":4,\"method\":\"del\",\"params\":[\"user\"]}";
+	jep_byte unseen[] = { 0x00, 0xFF, 0x80, 0x7F, 0x00 };
+	size_t n;
+	size_t first;
+	int res;
+	int i;
+
+	res = 1;
+
+	for (i = 0; i < 3; i++)
+	{
+		samples[i] = jep_create_byte_buffer();
+
+		if (samples[i] != NULL)
+			jep_append_bytes(samples[i], (jep_byte*)text[i], (int)strlen(text[i]));
+	}
+
+	trained = jep_huff_train(samples, 3);
+	written = jep_create_byte_buffer();
+	encoded = jep_create_byte_buffer();
+	decoded = jep_create_byte_buffer();
+
+	// The table is written separately and read back before use.
+	if (trained == NULL || written == NULL || encoded == NULL
+		|| decoded == NULL || !jep_huff_write_table(trained, written))
+	{
+		table = NULL;
+		res = 0;
+	}
+	else
+	{
+		table = jep_huff_read_table(written);
+	}
+
+	if (table == NULL)
+		res = 0;
+
+	n = strlen(message);
+
+	if (res)
+	{
+		// A message carries no dictionary, so it is smaller than
+		// the same message encoded on its own.
+		jep_append_bytes(decoded, (jep_byte*)message, (int)n);
+		inline_dict = jep_huff_encode(decoded);
+		jep_clear_byte_buffer(decoded);
+
+		jep_huff_encode_shared(table, (const jep_byte*)message, n, encoded);
+		first = encoded->size;
+
+		if (first == 0 || first >= n || inline_dict == NULL
+			|| first >= inline_dict->size)
+		{
+			res = 0;
+		}
+
+		jep_destroy_byte_buffer(inline_dict);
+
+		// Bytes that were never seen in the samples and empty
+		// messages can still be encoded.
+		if (!jep_huff_encode_shared(table, unseen, sizeof(unseen), encoded)
+			|| !jep_huff_encode_shared(table, NULL, 0, encoded))
+		{
+			res = 0;
+		}
+
+		// Each message decodes on its own.
+		if (!jep_huff_decode_shared(trained, encoded->buffer, first, decoded)
+			|| decoded->size != n
+			|| memcmp(decoded->buffer, message, n))
+		{
+			res = 0;
+		}
+
+		if (!jep_huff_decode_shared(table, encoded->buffer + first,
+				encoded->size - first - 1, decoded)
+			|| decoded->size != n + sizeof(unseen)
+			|| memcmp(decoded->buffer + n, unseen, sizeof(unseen)))
+		{
+			res = 0;
+		}
+
+		if (!jep_huff_decode_shared(table, encoded->buffer + encoded->size - 1,
+				1, decoded)
+			|| decoded->size != n + sizeof(unseen))
+		{
+			res = 0;
+		}
+
+		// A truncated message fails without changing the output.
+		if (jep_huff_decode_shared(table, encoded->buffer, first - 1, decoded)
+			|| decoded->size != n + sizeof(unseen))
+		{
+			res = 0;
+		}
+
+		// A table cannot be read from an ordinary encoding.
+		if (jep_huff_read_table(encoded) != NULL)
+			res = 0;
+	}
+
+	for (i = 0; i < 3; i++)
+		jep_destroy_byte_buffer(samples[i]);
+
+	jep_destroy_huff_table(trained);
+	jep_destroy_huff_table(table);
+	jep_destroy_byte_buffer(written);
+	jep_destroy_byte_buffer(encoded);
+	jep_destroy_byte_buffer(decoded);
+
+	return res;
+}
+
+int huff_raw_test()
+{
+	jep_byte_buffer* raw;
+	jep_byte_buffer* encoded;
+	jep_byte_buffer* decoded;
+	jep_huff_stream* enc;
+	jep_huff_stream* dec;
+	uint32_t x;
+	size_t i;
+	int res;
+
+	raw = jep_create_byte_buffer();
+
+	if (raw == NULL)
+		return 0;
+
+	// Bytes with every value equally likely cannot be made smaller.
+	x = 7;
+	for (i = 0; i < 10000; i++)
+	{
+		x = x * 1664525U + 1013904223U;
+		jep_append_byte(raw, (jep_byte)(x >> 24));
+	}
+
+	res = 1;
+	encoded = jep_huff_encode(raw);
+	decoded = encoded != NULL ? jep_huff_decode(encoded) : NULL;
+
+	if (encoded == NULL || encoded->buffer[2] != 0x04
+		|| encoded->size != raw->size + 7 || decoded == NULL
+		|| decoded->size != raw->size
+		|| memcmp(decoded->buffer, raw->buffer, raw->size))
+	{
+		res = 0;
+	}
+
+	jep_destroy_byte_buffer(decoded);
+
+	// A stored block that is cut short cannot be decoded.
+	if (encoded != NULL)
+	{
+		encoded->size--;
+		decoded = jep_huff_decode(encoded);
+
+		if (decoded != NULL)
+			res = 0;
+
+		jep_destroy_byte_buffer(decoded);
+	}
+
+	jep_destroy_byte_buffer(encoded);
+
+	// A stream of the random bytes followed by a repeated byte
+	// mixes stored blocks and run blocks.
+	for (i = 0; i < 10000; i++)
+		jep_append_byte(raw, 0x2A);
+
+	enc = jep_huff_encode_init(4096);
+	dec = jep_huff_decode_init();
+	encoded = jep_create_byte_buffer();
+	decoded = jep_create_byte_buffer();
+
+	if (enc == NULL || dec == NULL || encoded == NULL || decoded == NULL
+		|| !jep_huff_encode_update(enc, raw->buffer, raw->size, encoded)
+		|| !jep_huff_encode_finish(enc, encoded)
+		|| !jep_huff_decode_update(dec, encoded->buffer, encoded->size,
+			decoded)
+		|| !jep_huff_decode_finish(dec)
+		|| decoded->size != raw->size
+		|| memcmp(decoded->buffer, raw->buffer, raw->size))
+	{
+		res = 0;
+	}
+
+	jep_destroy_huff_stream(enc);
+	jep_destroy_huff_stream(dec);
+	jep_destroy_byte_buffer(encoded);
+	jep_destroy_byte_buffer(decoded);
+
+	// A single repeated byte is written once with its count.
+	jep_clear_byte_buffer(raw);
+	for (i = 0; i < 100000; i++)
+		jep_append_byte(raw, 0x2A);
+
+	encoded = jep_huff_encode(raw);
+	decoded = encoded != NULL ? jep_huff_decode(encoded) : NULL;
+
+	if (encoded == NULL || encoded->size != 8 || encoded->buffer[2] != 0x05
+		|| encoded->buffer[3] != 0x2A || decoded == NULL
+		|| decoded->size != raw->size
+		|| memcmp(decoded->buffer, raw->buffer, raw->size))
+	{
+		res = 0;
+	}
+
+	jep_destroy_byte_buffer(raw);
+	jep_destroy_byte_buffer(encoded);
+	jep_destroy_byte_buffer(decoded);
+
+	return res;
+}
+
+int huff_into_test()
+{
+	jep_byte_buffer* raw;
+	jep_byte_buffer* encoded;
+	jep_byte* dest;
+	jep_byte* out;
+	size_t bound;
+	size_t size;
+	size_t out_size;
+	uint32_t x;
+	int res;
+	int k;
+	int i;
+
+	raw = jep_create_byte_buffer();
+
+	if (raw == NULL)
+		return 0;
+
+	res = 1;
+
+	// A block is never larger than the bytes it would store.
+	if (jep_huff_compress_bound(0) != 7 || jep_huff_compress_bound(100) != 107)
+		res = 0;
+
+	dest = jep_alloc(jep_byte, jep_huff_compress_bound(20000));
+	out = jep_alloc(jep_byte, 20000);
+
+	if (dest == NULL || out == NULL)
+	{
+		free(dest);
+		free(out);
+		jep_destroy_byte_buffer(raw);
+		return 0;
+	}
+
+	// Empty, skewed, random, and repeated bytes each produce
+	// a different kind of block.
+	for (k = 0; k < 4; k++)
+	{
+		jep_clear_byte_buffer(raw);
+		x = 7;
+
+		for (i = 0; k > 0 && i < 20000; i++)
+		{
+			x = x * 1664525U + 1013904223U;
+
+			if (k == 1)
+				jep_append_byte(raw, (jep_byte)('a' + (x >> 29)));
+			else if (k == 2)
+				jep_append_byte(raw, (jep_byte)(x >> 24));
+			else
+				jep_append_byte(raw, 0x2A);
+		}
+
+		bound = jep_huff_compress_bound(raw->size);
+		encoded = jep_huff_encode(raw);
+
+		if (encoded == NULL
+			|| !jep_huff_encode_to(raw->buffer, raw->size, dest, bound, &size)
+			|| size != encoded->size
+			|| memcmp(dest, encoded->buffer, size)
+			|| !jep_huff_decode_to(dest, size, out, raw->size, &out_size)
+			|| out_size != raw->size
+			|| (raw->size > 0 && memcmp(out, raw->buffer, raw->size)))
+		{
+			res = 0;
+		}
+
+		jep_destroy_byte_buffer(encoded);
+
+		// Decoding fails rather than writing past the end.
+		if (raw->size > 0
+			&& jep_huff_decode_to(dest, size, out, raw->size - 1, &out_size))
+		{
+			res = 0;
+		}
+	}
+
+	// A run block does not fit in fewer than 8 bytes, and random
+	// bytes need every byte of the bound.
+	if (jep_huff_encode_to(raw->buffer, raw->size, dest, 7, &size))
+		res = 0;
+
+	x = 7;
+	jep_clear_byte_buffer(raw);
+	for (i = 0; i < 20000; i++)
+	{
+		x = x * 1664525U + 1013904223U;
+		jep_append_byte(raw, (jep_byte)(x >> 24));
+	}
+
+	if (jep_huff_encode_to(raw->buffer, raw->size, dest,
+		jep_huff_compress_bound(raw->size) - 1, &size))
+	{
+		res = 0;
+	}
+
+	// The blocks of a container are decoded in place.
+	for (i = 0; i < 20000; i++)
+		raw->buffer[i] = (jep_byte)('a' + i % 7);
+
+	encoded = jep_huff_encode_blocks(raw, 4096, 1);
+
+	if (encoded == NULL
+		|| !jep_huff_decode_to(encoded->buffer, encoded->size, out, 20000,
+			&out_size)
+		|| out_size != raw->size || memcmp(out, raw->buffer, raw->size)
+		|| jep_huff_decode_to(encoded->buffer, encoded->size, out, 19999,
+			&out_size))
+	{
+		res = 0;
+	}
+
+	jep_destroy_byte_buffer(encoded);
+	jep_destroy_byte_buffer(raw);
+	free(dest);
+	free(out);
+
+	return res;
+}
+
+int huff_sized_test()
+{
+	// The byte sequence 0x43, 0x41, 0x42, 0x43, 0x43, 0x42
+	// encoded by the previous version, which did not record
+	// the number of decoded bytes
+	jep_byte data[14] = {
+		0x4A, 0x02, 0x00, 0x04, 0x41,
+		0x43, 0x22, 0x01, 0x09, 0x00,
+		0x00, 0x00, 0x9A, 0x01
+	};
+
+	jep_byte expected[6] = { 0x43, 0x41, 0x42, 0x43, 0x43, 0x42 };
+
+	jep_byte_buffer* raw;
+	jep_byte_buffer* written;
+	jep_byte_buffer* decoded;
+	jep_huff_code* huff;
+	int res;
+
+	raw = jep_create_byte_buffer();
+	written = jep_create_byte_buffer();
+
+	if (raw == NULL || written == NULL)
+	{
+		jep_destroy_byte_buffer(raw);
+		jep_destroy_byte_buffer(written);
+		return 0;
+	}
+
+	jep_append_bytes(raw, data, 14);
+
+	res = 1;
+
+	// Blocks of the previous version can still be decoded.
+	decoded = jep_huff_decode(raw);
+
+	if (decoded == NULL || decoded->size != 6
+		|| memcmp(decoded->buffer, expected, 6))
+	{
+		res = 0;
+	}
+
+	jep_destroy_byte_buffer(decoded);
+
+	// Writing them again adds the byte count after the code lengths.
+	huff = jep_huff_read(raw);
+
+	if (huff == NULL || !jep_huff_write(huff, written)
+		|| written->size != 18 || written->buffer[1] != 0x03
+		|| written->buffer[8] != 6 || written->buffer[9] != 0
+		|| written->buffer[12] != 9)
+	{
+		res = 0;
+	}
+
+	jep_destroy_huff_code(huff);
+
+	decoded = res ? jep_huff_decode(written) : NULL;
+
+	if (decoded == NULL || decoded->size != 6
+		|| memcmp(decoded->buffer, expected, 6))
+	{
+		res = 0;
+	}
+
+	jep_destroy_byte_buffer(decoded);
+
+	// A byte count that does not match the bits is rejected,
+	// as is one that the bits could never hold.
+	if (res)
+	{
+		written->buffer[8] = 5;
+		decoded = jep_huff_decode(written);
+
+		if (decoded != NULL)
+			res = 0;
+
+		jep_destroy_byte_buffer(decoded);
+
+		written->buffer[8] = 7;
+		decoded = jep_huff_decode(written);
+
+		if (decoded != NULL)
+			res = 0;
+
+		jep_destroy_byte_buffer(decoded);
+
+		written->buffer[8] = 0;
+		written->buffer[11] = 0x80;
+		decoded = jep_huff_decode(written);
+
+		if (decoded != NULL)
+			res = 0;
+
+		jep_destroy_byte_buffer(decoded);
+	}
+
+	jep_destroy_byte_buffer(raw);
+	jep_destroy_byte_buffer(written);
+
+	return res;
+}
+
+int huff_context_test()
+{
+	jep_byte_buffer* raw;
+	jep_byte_buffer* plain;
+	jep_byte_buffer* encoded;
+	jep_byte_buffer* decoded;
+	jep_huff_stream* dec;
+	jep_byte* out;
+	size_t size;
+	uint32_t x;
+	jep_byte b;
+	int res;
+	int i;
+
+	raw = jep_create_byte_buffer();
+
+	if (raw == NULL)
+		return 0;
+
+	// Every byte is usually determined by the byte before it,
+	// although each of 64 bytes is about as common as any other.
+	x = 11;
+	b = 0;
+	for (i = 0; i < 20000; i++)
+	{
+		x = x * 1664525U + 1013904223U;
+		b = (x >> 28) == 0 ? (jep_byte)(x >> 10) % 64 : (b * 5 + 3) % 64;
+		jep_append_byte(raw, (jep_byte)('0' + b));
+	}
+
+	plain = jep_huff_encode(raw);
+	encoded = jep_huff_encode_context(raw);
+	decoded = encoded != NULL ? jep_huff_decode(encoded) : NULL;
+
+	res = 1;
+
+	if (plain == NULL || encoded == NULL || encoded->buffer[2] != 0x06
+		|| encoded->size >= plain->size || decoded == NULL
+		|| decoded->size != raw->size
+		|| memcmp(decoded->buffer, raw->buffer, raw->size))
+	{
+		res = 0;
+	}
+
+	jep_destroy_byte_buffer(plain);
+	jep_destroy_byte_buffer(decoded);
+
+	// The block can be decoded into a fixed array
+	// and from a stream that arrives a few bytes at a time.
+	out = jep_alloc(jep_byte, raw->size);
+
+	if (out == NULL || encoded == NULL
+		|| !jep_huff_decode_to(encoded->buffer, encoded->size, out,
+			raw->size, &size)
+		|| size != raw->size || memcmp(out, raw->buffer, raw->size)
+		|| jep_huff_decode_to(encoded->buffer, encoded->size, out,
+			raw->size - 1, &size))
+	{
+		res = 0;
+	}
+
+	free(out);
+
+	dec = jep_huff_decode_init();
+	decoded = jep_create_byte_buffer();
+
+	for (i = 0; res && dec != NULL && decoded != NULL
+		&& (size_t)i < encoded->size; i += 7)
+	{
+		if (!jep_huff_decode_update(dec, encoded->buffer + i,
+			encoded->size - i < 7 ? encoded->size - i : 7, decoded))
+		{
+			res = 0;
+		}
+	}
+
+	if (dec == NULL || decoded == NULL || !jep_huff_decode_finish(dec)
+		|| decoded->size != raw->size
+		|| memcmp(decoded->buffer, raw->buffer, raw->size))
+	{
+		res = 0;
+	}
+
+	jep_destroy_huff_stream(dec);
+	jep_destroy_byte_buffer(decoded);
+
+	// A block that is cut short cannot be decoded.
+	if (encoded != NULL)
+	{
+		encoded->size--;
+		decoded = jep_huff_decode(encoded);
+
+		if (decoded != NULL)
+			res = 0;
+
+		jep_destroy_byte_buffer(decoded);
+	}
+
+	jep_destroy_byte_buffer(encoded);
+
+	// Bytes without any context fall back to a single table,
+	// or are stored as they are.
+	for (i = 0; i < 20000; i++)
+	{
+		x = x * 1664525U + 1013904223U;
+		raw->buffer[i] = (jep_byte)(x >> 24);
+	}
+
+	encoded = jep_huff_encode_context(raw);
+	decoded = encoded != NULL ? jep_huff_decode(encoded) : NULL;
+
+	if (encoded == NULL || encoded->buffer[2] == 0x06 || decoded == NULL
+		|| decoded->size != raw->size
+		|| memcmp(decoded->buffer, raw->buffer, raw->size))
+	{
+		res = 0;
+	}
+
+	jep_destroy_byte_buffer(encoded);
+	jep_destroy_byte_buffer(decoded);
+	jep_destroy_byte_buffer(raw);
+
+	if (jep_huff_encode_context(NULL) != NULL)
+		res = 0;
+
+	return res;
+}
+
+int huff_coder_test()
+{
+	jep_byte_buffer* raw;
+	jep_byte_buffer* plain;
+	jep_byte_buffer* encoded;
+	jep_byte_buffer* decoded;
+	jep_huff_stream* enc;
+	jep_huff_stream* dec;
+	jep_byte* out;
+	size_t first;
+	size_t size;
+	uint32_t x;
+	int res;
+	int i;
+
+	raw = jep_create_byte_buffer();
+
+	if (raw == NULL)
+		return 0;
+
+	// Most bytes are the same, which ANS encodes in less than a bit.
+	x = 5;
+	for (i = 0; i < 9000; i++)
+	{
+		x = x * 1664525U + 1013904223U;
+		jep_append_byte(raw, (x >> 24) < 24 ? (jep_byte)(x >> 16) : ' ');
+	}
+
+	plain = jep_huff_encode(raw);
+	encoded = jep_huff_encode_ans(raw);
+	decoded = encoded != NULL ? jep_huff_decode(encoded) : NULL;
+
+	res = 1;
+
+	if (plain == NULL || encoded == NULL || encoded->buffer[2] != 0x07
+		|| encoded->size >= plain->size || decoded == NULL
+		|| decoded->size != raw->size
+		|| memcmp(decoded->buffer, raw->buffer, raw->size))
+	{
+		res = 0;
+	}
+
+	jep_destroy_byte_buffer(plain);
+	jep_destroy_byte_buffer(decoded);
+
+	out = jep_alloc(jep_byte, raw->size);
+
+	if (out == NULL || encoded == NULL
+		|| !jep_huff_decode_to(encoded->buffer, encoded->size, out,
+			raw->size, &size)
+		|| size != raw->size || memcmp(out, raw->buffer, raw->size)
+		|| jep_huff_decode_to(encoded->buffer, encoded->size, out,
+			raw->size - 1, &size))
+	{
+		res = 0;
+	}
+
+	free(out);
+
+	// A block that is cut short cannot be decoded.
+	if (encoded != NULL)
+	{
+		encoded->size--;
+		decoded = jep_huff_decode(encoded);
+
+		if (decoded != NULL)
+			res = 0;
+
+		jep_destroy_byte_buffer(decoded);
+	}
+
+	jep_destroy_byte_buffer(encoded);
+
+	// A stream can change coders between blocks.
+	enc = jep_huff_encode_init(4096);
+	encoded = jep_create_byte_buffer();
+
+	if (enc == NULL || encoded == NULL
+		|| !jep_huff_encode_update(enc, raw->buffer, 4096, encoded))
+	{
+		jep_destroy_huff_stream(enc);
+		jep_destroy_byte_buffer(encoded);
+		jep_destroy_byte_buffer(raw);
+		return 0;
+	}
+
+	first = encoded->size;
+
+	if (!jep_huff_encode_select(enc, JEP_HUFF_CODER_ANS)
+		|| jep_huff_encode_select(enc, JEP_HUFF_CODER_ANS + 1)
+		|| !jep_huff_encode_update(enc, raw->buffer + 4096,
+			raw->size - 4096, encoded)
+		|| !jep_huff_encode_finish(enc, encoded))
+	{
+		jep_destroy_huff_stream(enc);
+		jep_destroy_byte_buffer(encoded);
+		jep_destroy_byte_buffer(raw);
+		return 0;
+	}
+
+	jep_destroy_huff_stream(enc);
+
+	dec = jep_huff_decode_init();
+	decoded = jep_create_byte_buffer();
+
+	for (i = 0; res && dec != NULL && decoded != NULL
+		&& (size_t)i < encoded->size; i += 11)
+	{
+		if (!jep_huff_decode_update(dec, encoded->buffer + i,
+			encoded->size - i < 11 ? encoded->size - i : 11, decoded))
+		{
+			res = 0;
+		}
+	}
+
+	// The first block has codes and the others are encoded with ANS.
+	if (dec == NULL || decoded == NULL || !jep_huff_decode_finish(dec)
+		|| encoded->buffer[2] != 0x02 || encoded->buffer[first + 2] != 0x07
+		|| decoded->size != raw->size
+		|| memcmp(decoded->buffer, raw->buffer, raw->size))
+	{
+		res = 0;
+	}
+
+	jep_destroy_huff_stream(dec);
+	jep_destroy_byte_buffer(decoded);
+	jep_destroy_byte_buffer(encoded);
+	jep_destroy_byte_buffer(raw);
+
+	return res;
+}
+
+int huff_stats_test()
+{
+	jep_byte_buffer* raw;
+	jep_byte_buffer* encoded;
+	jep_byte_buffer* decoded;
+	jep_huff_stats enc;
+	jep_huff_stats dec;
+	int res;
+	int i;
+
+	raw = jep_create_byte_buffer();
+
+	if (raw == NULL)
+		return 0;
+
+	// Four bytes that are equally common need exactly two bits each.
+	for (i = 0; i < 4000; i++)
+		jep_append_byte(raw, (jep_byte)("abcd"[i % 4]));
+
+	encoded = jep_huff_encode_stats(raw, &enc);
+	decoded = encoded != NULL ? jep_huff_decode_stats(encoded, &dec) : NULL;
+
+	res = 1;
+
+	if (encoded == NULL || decoded == NULL || decoded->size != raw->size
+		|| memcmp(decoded->buffer, raw->buffer, raw->size)
+		|| enc.raw_bytes != 4000 || enc.counts['a'] != 1000
+		|| enc.counts['e'] != 0 || enc.entropy != 2.0
+		|| enc.average_length != 2.0 || enc.max_length != 2
+		|| enc.payload_bytes != 1000
+		|| enc.header_bytes + enc.payload_bytes != encoded->size)
+	{
+		res = 0;
+	}
+
+	// Decoding reports the same block.
+	if (decoded != NULL && (dec.raw_bytes != enc.raw_bytes
+		|| memcmp(dec.counts, enc.counts, sizeof(enc.counts))
+		|| dec.entropy != enc.entropy
+		|| dec.average_length != enc.average_length
+		|| dec.max_length != enc.max_length
+		|| dec.header_bytes != enc.header_bytes
+		|| dec.payload_bytes != enc.payload_bytes))
+	{
+		res = 0;
+	}
+
+	jep_destroy_byte_buffer(encoded);
+	jep_destroy_byte_buffer(decoded);
+
+	// A run block has no payload.
+	memset(raw->buffer, 'a', raw->size);
+	encoded = jep_huff_encode_stats(raw, &enc);
+
+	if (encoded == NULL || enc.entropy != 0.0 || enc.payload_bytes != 0
+		|| enc.header_bytes != encoded->size || enc.average_length != 0.0)
+	{
+		res = 0;
+	}
+
+	jep_destroy_byte_buffer(encoded);
+	jep_destroy_byte_buffer(raw);
+
+	if (jep_huff_encode_stats(NULL, &enc) != NULL)
+		res = 0;
+
+	return res;
+}
+
+int huff_arena_test()
+{
+	jep_huff_arena* arena;
+	jep_byte_buffer* raw;
+	jep_byte_buffer* expected;
+	jep_byte_buffer* out;
+	jep_byte_buffer view;
+	jep_byte* output;
+	jep_byte copy[4096];
+	int res;
+	int i;
+	int j;
+
+	arena = jep_create_huff_arena();
+	raw = jep_create_byte_buffer();
+
+	if (arena == NULL || raw == NULL)
+	{
+		jep_destroy_huff_arena(arena);
+		jep_destroy_byte_buffer(raw);
+		return 0;
+	}
+
+	res = 1;
+
+	for (i = 0; i < 3000; i++)
+		jep_append_byte(raw, (jep_byte)("an arena of small messages"[i % 26]));
+
+	// Once the output has grown, smaller messages reuse it.
+	if (jep_huff_arena_encode(arena, raw) == NULL)
+		res = 0;
+
+	output = arena->output->buffer;
+
+	view.buffer = copy;
+	view.cap = sizeof(copy);
+
+	for (i = 0; i < 20 && res; i++)
+	{
+		raw->size = 0;
+		for (j = 0; j < 100 + i * 50; j++)
+			jep_append_byte(raw, (jep_byte)('a' + (j * j + i) % (i + 2)));
+
+		expected = i % 2 ? jep_huff_encode(raw)
+			: jep_huff_encode_context(raw);
+		out = i % 2 ? jep_huff_arena_encode(arena, raw)
+			: jep_huff_arena_encode_context(arena, raw);
+
+		if (expected == NULL || out == NULL || out->size != expected->size
+			|| out->size > sizeof(copy)
+			|| memcmp(out->buffer, expected->buffer, expected->size))
+		{
+			res = 0;
+		}
+
+		jep_destroy_byte_buffer(expected);
+
+		if (!res)
+			break;
+
+		// The encoded bytes are copied out before the output is reused.
+		memcpy(copy, out->buffer, out->size);
+		view.size = out->size;
+
+		out = jep_huff_arena_decode(arena, &view);
+
+		if (out == NULL || out->size != raw->size
+			|| memcmp(out->buffer, raw->buffer, raw->size))
+		{
+			res = 0;
+		}
+	}
+
+	if (arena->output->buffer != output)
+		res = 0;
+
+	// Indexed containers decode into the arena too.
+	expected = jep_huff_encode_blocks(raw, 256, 1);
+	out = expected != NULL ? jep_huff_arena_decode(arena, expected) : NULL;
+
+	if (out == NULL || out->size != raw->size
+		|| memcmp(out->buffer, raw->buffer, raw->size))
+	{
+		res = 0;
+	}
+
+	jep_destroy_byte_buffer(expected);
+
+	jep_huff_reset_arena(arena);
+
+	if (arena->output->size != 0 || arena->output->buffer != output)
+		res = 0;
+
+	if (jep_huff_arena_encode(NULL, raw) != NULL
+		|| jep_huff_arena_decode(arena, NULL) != NULL)
+	{
+		res = 0;
+	}
+
+	jep_destroy_huff_arena(arena);
+	jep_destroy_byte_buffer(raw);
+
+	return res;
+}
+
+int huff_checked_test()
+{
+	jep_huff_stream* stream;
+	jep_byte_buffer* raw;
+	jep_byte_buffer* encoded;
+	jep_byte_buffer* decoded;
+	jep_byte_buffer* out;
+	size_t i;
+	int res;
+
+	raw = jep_create_byte_buffer();
+
+	if (raw == NULL)
+		return 0;
+
+	for (i = 0; i < 5000; i++)
+		jep_append_byte(raw, (jep_byte)("checksums catch damage"[i % 22]));
+
+	res = 1;
+
+	encoded = jep_huff_encode_checked(raw);
+	decoded = encoded != NULL ? jep_huff_decode(encoded) : NULL;
+
+	if (encoded == NULL || decoded == NULL || encoded->size < 11
+		|| encoded->buffer[2] != 0x08 || decoded->size != raw->size
+		|| memcmp(decoded->buffer, raw->buffer, raw->size))
+	{
+		res = 0;
+	}
+
+	jep_destroy_byte_buffer(decoded);
+
+	// A flipped bit anywhere after the type is found before decoding.
+	for (i = 3; res && i < encoded->size; i += 7)
+	{
+		encoded->buffer[i] ^= 0x10;
+		decoded = jep_huff_decode(encoded);
+
+		if (decoded != NULL)
+			res = 0;
+
+		jep_destroy_byte_buffer(decoded);
+		encoded->buffer[i] ^= 0x10;
+	}
+
+	jep_destroy_byte_buffer(encoded);
+
+	// A stream can add a checksum to each of its blocks.
+	stream = jep_huff_encode_init(1024);
+	encoded = jep_create_byte_buffer();
+	decoded = jep_create_byte_buffer();
+
+	if (stream == NULL || encoded == NULL || decoded == NULL
+		|| !jep_huff_encode_checksum(stream, 1)
+		|| !jep_huff_encode_update(stream, raw->buffer, raw->size, encoded)
+		|| !jep_huff_encode_finish(stream, encoded))
+	{
+		res = 0;
+	}
+
+	jep_destroy_huff_stream(stream);
+	stream = jep_huff_decode_init();
+
+	if (res && (stream == NULL
+		|| !jep_huff_decode_update(stream, encoded->buffer, encoded->size,
+			decoded)
+		|| !jep_huff_decode_finish(stream)
+		|| decoded->size != raw->size
+		|| memcmp(decoded->buffer, raw->buffer, raw->size)))
+	{
+		res = 0;
+	}
+
+	// Each block is checked as it arrives.
+	if (res)
+	{
+		out = jep_create_byte_buffer();
+		encoded->buffer[encoded->size - 1] ^= 0x01;
+
+		jep_destroy_huff_stream(stream);
+		stream = jep_huff_decode_init();
+
+		if (out == NULL || stream == NULL
+			|| jep_huff_decode_update(stream, encoded->buffer,
+				encoded->size, out))
+		{
+			res = 0;
+		}
+
+		jep_destroy_byte_buffer(out);
+	}
+
+	jep_destroy_huff_stream(stream);
+	jep_destroy_byte_buffer(encoded);
+	jep_destroy_byte_buffer(decoded);
+	jep_destroy_byte_buffer(raw);
+
+	return res;
+}
+
+int huff_push_test()
+{
+	jep_huff_stream* stream;
+	jep_byte_buffer* encoded;
+	jep_byte_buffer* decoded;
+	jep_byte raw[40000];
+	uint32_t x;
+	size_t i;
+	size_t n;
+	size_t step;
+	int res;
+
+	// A split block of text, a small coded block,
+	// and a stored block of random bytes.
+	x = 5;
+	for (i = 0; i < sizeof(raw); i++)
+	{
+		x = x * 1664525U + 1013904223U;
+
+		if (i < 30000)
+			raw[i] = (jep_byte)("decoded as it arrives "[(x >> 27) % 22]);
+		else if (i < 30500)
+			raw[i] = (jep_byte)('a' + (x >> 30));
+		else
+			raw[i] = (jep_byte)(x >> 24);
+	}
+
+	encoded = jep_create_byte_buffer();
+	decoded = jep_create_byte_buffer();
+	stream = jep_huff_encode_init(30000);
+
+	if (encoded == NULL || decoded == NULL || stream == NULL
+		|| !jep_huff_encode_update(stream, raw, 30000, encoded)
+		|| !jep_huff_encode_finish(stream, encoded)
+		|| !jep_huff_encode_update(stream, raw + 30000, 500, encoded)
+		|| !jep_huff_encode_finish(stream, encoded)
+		|| !jep_huff_encode_update(stream, raw + 30500, 9500, encoded)
+		|| !jep_huff_encode_finish(stream, encoded))
+	{
+		jep_destroy_byte_buffer(encoded);
+		jep_destroy_byte_buffer(decoded);
+		jep_destroy_huff_stream(stream);
+		return 0;
+	}
+
+	jep_destroy_huff_stream(stream);
+
+	res = 1;
+
+	for (step = 1; res && step < 6000; step = step * 5 + 3)
+	{
+		stream = jep_huff_decode_init();
+		decoded->size = 0;
+
+		if (stream == NULL)
+		{
+			res = 0;
+			break;
+		}
+
+		for (i = 0; res && i < encoded->size; i += n)
+		{
+			n = encoded->size - i < step ? encoded->size - i : step;
+
+			if (!jep_huff_decode_update(stream, encoded->buffer + i, n,
+				decoded))
+			{
+				res = 0;
+			}
+
+			// Part of the first block is decoded before the rest
+			// of it arrives.
+			if (i < encoded->size / 4 && i + n >= encoded->size / 4
+				&& (decoded->size == 0 || decoded->size >= 30000))
+			{
+				res = 0;
+			}
+		}
+
+		if (res && (!jep_huff_decode_finish(stream)
+			|| decoded->size != sizeof(raw)
+			|| memcmp(decoded->buffer, raw, sizeof(raw))))
+		{
+			res = 0;
+		}
+
+		jep_destroy_huff_stream(stream);
+	}
+
+	// A stream that stops partway through a block is incomplete.
+	stream = jep_huff_decode_init();
+
+	if (res && (stream == NULL
+		|| !jep_huff_decode_update(stream, encoded->buffer,
+			encoded->size / 4, decoded)
+		|| jep_huff_decode_finish(stream)))
+	{
+		res = 0;
+	}
+
+	jep_destroy_huff_stream(stream);
+	jep_destroy_byte_buffer(encoded);
+	jep_destroy_byte_buffer(decoded);
+
+	return res;
+}
+
+int huff_multi_test()
+{
+	jep_byte_buffer* raw;
+	jep_byte_buffer* encoded;
+	jep_byte_buffer* written;
+	jep_byte_buffer* decoded;
+	jep_huff_code* huff;
+	jep_byte* out;
+	size_t sizes[3] = { 16383, 16384, 70001 };
+	size_t out_size;
+	uint32_t x;
+	jep_byte b;
+	size_t i, j;
+	int res;
+
+	raw = jep_create_byte_buffer();
+	out = (jep_byte*)malloc(70001);
+
+	if (raw == NULL || out == NULL)
+	{
+		jep_destroy_byte_buffer(raw);
+		free(out);
+		return 0;
+	}
+
+	res = 1;
+
+	for (j = 0; res && j < 3; j++)
+	{
+		// Each byte is half as likely as the one before it, so most
+		// codes are short, but the rarest are longer than a table
+		// lookup can resolve.
+		raw->size = 0;
+		x = 11;
+		for (i = 0; i < sizes[j]; i++)
+		{
+			x = x * 1664525U + 1013904223U;
+			b = 0;
+			while (b < 24 && (x >> (31 - b)) & 1)
+				b++;
+
+			jep_append_byte(raw, (jep_byte)('a' + b));
+		}
+
+		// Split blocks with short codes and with long ones.
+		encoded = jep_huff_encode(raw);
+		decoded = jep_huff_decode(encoded);
+
+		if (decoded == NULL || decoded->size != raw->size
+			|| memcmp(decoded->buffer, raw->buffer, raw->size))
+		{
+			res = 0;
+		}
+
+		jep_destroy_byte_buffer(encoded);
+		jep_destroy_byte_buffer(decoded);
+
+		encoded = jep_huff_encode_limited(raw, 20);
+		decoded = jep_huff_decode(encoded);
+
+		if (decoded == NULL || decoded->size != raw->size
+			|| memcmp(decoded->buffer, raw->buffer, raw->size))
+		{
+			res = 0;
+		}
+
+		jep_destroy_byte_buffer(decoded);
+
+		// Joining the bitstreams gives a single coded block,
+		// which must decode exactly into its own size.
+		written = jep_create_byte_buffer();
+		huff = jep_huff_read(encoded);
+
+		if (written == NULL || huff == NULL || !jep_huff_write(huff, written)
+			|| written->buffer[2] != 0x00
+			|| !jep_huff_decode_to(written->buffer, written->size, out,
+				raw->size, &out_size)
+			|| out_size != raw->size || memcmp(out, raw->buffer, raw->size)
+			|| jep_huff_decode_to(written->buffer, written->size, out,
+				raw->size - 1, &out_size)
+			|| jep_huff_decode_to(written->buffer, written->size - 1, out,
+				raw->size, &out_size))
+		{
+			res = 0;
+		}
+
+		jep_destroy_huff_code(huff);
+		jep_destroy_byte_buffer(written);
+		jep_destroy_byte_buffer(encoded);
+	}
+
+	jep_destroy_byte_buffer(raw);
+	free(out);
+
+	return res;
+}
+
+/**
+ * Reads the contents of a file into a byte buffer.
+ * Returns NULL if the file cannot be read.
+ */
+static jep_byte_buffer* read_test_file(const char* path)
+{
+	jep_byte_buffer* bb;
+	jep_byte chunk[4096];
+	size_t n;
+	FILE* f;
+
+	f = fopen(path, "rb");
+
+	if (f == NULL)
+		return NULL;
+
+	bb = jep_create_byte_buffer();
+
+	while (bb != NULL && (n = fread(chunk, 1, sizeof(chunk), f)) > 0)
+	{
+		if (!jep_append_bytes(bb, chunk, n))
+		{
+			jep_destroy_byte_buffer(bb);
+			bb = NULL;
+		}
+	}
+
+	fclose(f);
+
+	return bb;
+}
+
+/**
+ * Writes an array of bytes to a file, replacing its contents.
+ * Returns 1 on success or 0 on failure.
+ */
+static int write_test_file(const char* path, const jep_byte* src, size_t n)
+{
+	FILE* f;
+	int res;
+
+	f = fopen(path, "wb");
+
+	if (f == NULL)
+		return 0;
+
+	res = fwrite(src, 1, n, f) == n;
+
+	return fclose(f) == 0 && res;
+}
+
+int huff_file_test()
+{
+	const char* raw_path = "huff_file_test.raw";
+	const char* huff_path = "huff_file_test.huff";
+	const char* out_path = "huff_file_test.out";
+	jep_huff_stream* stream;
+	jep_byte_buffer* expected;
+	jep_byte_buffer* read;
+	jep_byte* raw;
+	size_t n;
+	uint32_t x;
+	size_t i;
+	int res;
+
+	// Text and then random bytes, which give several blocks of each
+	// kind and more than one batch of writes in each direction.
+	n = 2 * 1024 * 1024 + 777;
+	raw = (jep_byte*)malloc(n);
+	expected = jep_create_byte_buffer();
+	stream = jep_huff_encode_init(0);
+
+	if (raw == NULL || expected == NULL || stream == NULL)
+	{
+		free(raw);
+		jep_destroy_byte_buffer(expected);
+		jep_destroy_huff_stream(stream);
+		return 0;
+	}
+
+	x = 17;
+	for (i = 0; i < n; i++)
+	{
+		x = x * 1664525U + 1013904223U;
+
+		if (i < n / 2)
+			raw[i] = (jep_byte)("mapped into memory "[(x >> 27) % 19]);
+		else
+			raw[i] = (jep_byte)(x >> 24);
+	}
+
+	res = write_test_file(raw_path, raw, n)
+		&& jep_huff_encode_update(stream, raw, n, expected)
+		&& jep_huff_encode_finish(stream, expected);
+
+	jep_destroy_huff_stream(stream);
+
+	// The file holds the same blocks as a stream,
+	// and it decompresses to the original bytes.
+	res = res && jep_huff_compress_file(raw_path, huff_path);
+	read = res ? read_test_file(huff_path) : NULL;
+
+	if (read == NULL || read->size != expected->size
+		|| memcmp(read->buffer, expected->buffer, expected->size))
+	{
+		res = 0;
+	}
+
+	jep_destroy_byte_buffer(read);
+
+	res = res && jep_huff_decompress_file(huff_path, out_path);
+	read = res ? read_test_file(out_path) : NULL;
+
+	if (read == NULL || read->size != n || memcmp(read->buffer, raw, n))
+		res = 0;
+
+	jep_destroy_byte_buffer(read);
+	read = NULL;
+
+	// An incomplete last block fails, and leaves no output.
+	if (res && (!write_test_file(huff_path, expected->buffer,
+			expected->size - 1)
+		|| jep_huff_decompress_file(huff_path, out_path)
+		|| (read = read_test_file(out_path)) != NULL))
+	{
+		jep_destroy_byte_buffer(read);
+		read = NULL;
+		res = 0;
+	}
+
+	// A file cannot be written over itself.
+	if (res && (jep_huff_compress_file(raw_path, raw_path)
+		|| (read = read_test_file(raw_path)) == NULL
+		|| read->size != n))
+	{
+		res = 0;
+	}
+
+	jep_destroy_byte_buffer(read);
+	read = NULL;
+
+	// Empty files stay empty, and missing files fail.
+	if (res && (!write_test_file(raw_path, raw, 0)
+		|| !jep_huff_compress_file(raw_path, huff_path)
+		|| !jep_huff_decompress_file(huff_path, out_path)
+		|| (read = read_test_file(out_path)) == NULL
+		|| read->size != 0))
+	{
+		res = 0;
+	}
+
+	jep_destroy_byte_buffer(read);
+
+	remove(raw_path);
+	remove(huff_path);
+	remove(out_path);
+
+	if (res && jep_huff_compress_file(raw_path, huff_path))
+		res = 0;
+
+	remove(huff_path);
+
+	jep_destroy_byte_buffer(expected);
+	free(raw);
+
+	return res;
+}
+
+int huff_file_large_test()
+{
+	const char* huff_path = "huff_file_large_test.huff";
+	const char* out_path = "huff_file_large_test.out";
+	jep_byte_buffer* text;
+	jep_byte_buffer* coded;
+	jep_byte_buffer* file;
+	jep_byte_buffer* read;
+	jep_byte head[8];
+	size_t run;
+	size_t stored;
+	size_t i;
+	uint32_t x;
+	int res;
+
+	// A run, a stored block, and a coded block that each decode to
+	// several batches of writes, so each is decoded a piece at a time.
+	run = 5 * 1024 * 1024 + 3;
+	stored = 3 * 1024 * 1024 + 5;
+	text = jep_create_byte_buffer();
+	file = jep_create_byte_buffer();
+	coded = NULL;
+	read = NULL;
+	res = text != NULL && file != NULL;
+
+	x = 29;
+	for (i = 0; res && i < 3 * 1024 * 1024 + 11; i++)
+	{
+		x = x * 1664525U + 1013904223U;
+		res = jep_append_byte(text,
+			(jep_byte)("decoded in pieces "[(x >> 27) % 18]));
+	}
+
+	coded = res ? jep_huff_encode(text) : NULL;
+	res = coded != NULL;
+
+	head[0] = 0x4A;
+	head[1] = 0x03;
+	head[2] = 0x05;
+	head[3] = 'r';
+	jep_split_u32((uint32_t)run, (head + 4));
+	res = res && jep_append_bytes(file, head, 8);
+
+	head[2] = 0x04;
+	jep_split_u32((uint32_t)stored, (head + 3));
+	res = res && jep_append_bytes(file, head, 7)
+		&& jep_append_bytes(file, text->buffer, stored)
+		&& jep_append_bytes(file, coded->buffer, coded->size);
+
+	res = res && write_test_file(huff_path, file->buffer, file->size)
+		&& jep_huff_decompress_file(huff_path, out_path);
+
+	read = res ? read_test_file(out_path) : NULL;
+
+	if (read == NULL || read->size != run + stored + text->size)
+		res = 0;
+
+	for (i = 0; res && i < run; i++)
+	{
+		if (read->buffer[i] != 'r')
+			res = 0;
+	}
+
+	if (res && (memcmp(read->buffer + run, text->buffer, stored)
+		|| memcmp(read->buffer + run + stored, text->buffer, text->size)))
+	{
+		res = 0;
+	}
+
+	jep_destroy_byte_buffer(read);
+	read = NULL;
+
+	// A coded block whose data is damaged fails part way through,
+	// and leaves no output.
+	if (res)
+	{
+		file->buffer[file->size - coded->size / 2] ^= 0x5A;
+
+		if (!write_test_file(huff_path, file->buffer, file->size)
+			|| jep_huff_decompress_file(huff_path, out_path)
+			|| (read = read_test_file(out_path)) != NULL)
+		{
+			res = 0;
+		}
+	}
+
+	jep_destroy_byte_buffer(read);
+
+	remove(huff_path);
+	remove(out_path);
+
+	jep_destroy_byte_buffer(text);
+	jep_destroy_byte_buffer(coded);
+	jep_destroy_byte_buffer(file);
+
+	return res;
+}
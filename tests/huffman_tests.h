@@ -9,4 +9,44 @@ int huff_decode_test();
 
 int huff_read_test();
 
+int huff_round_trip_test();
+
+int huff_read_canonical_test();
+
+int huff_limit_test();
+
+int huff_stream_test();
+
+int huff_blocks_test();
+
+int huff_random_access_test();
+
+int huff_split_test();
+
+int huff_shared_test();
+
+int huff_raw_test();
+
+int huff_into_test();
+
+int huff_sized_test();
+
+int huff_context_test();
+
+int huff_coder_test();
+
+int huff_stats_test();
+
+int huff_arena_test();
+
+int huff_checked_test();
+
+int huff_push_test();
+
+int huff_multi_test();
+
+int huff_file_test();
+
+int huff_file_large_test();
+
 #endif
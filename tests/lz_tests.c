@@ -0,0 +1,209 @@
+#include "lz_tests.h"
+#include "jep_utils/huffman.h"
+
+int lz_round_trip_test()
+{
+	jep_byte_buffer* raw;
+	jep_byte_buffer* plain;
+	jep_byte_buffer* encoded;
+	jep_byte_buffer* decoded;
+	char line[128];
+	uint32_t level;
+	uint32_t x;
+	int len;
+	int res;
+	int i;
+
+	raw = jep_create_byte_buffer();
+
+	if (raw == NULL)
+		return 0;
+
+	// Records that repeat the same keys, which Huffman Coding alone
+	// can only encode a byte at a time.
+	x = 1;
+	for (i = 0; i < 500; i++)
+	{
+		x = x * 1664525U + 1013904223U;
+		len = sprintf(line, "{\"id\":%d,\"name\":\"user%u\",\"active\":%s}\n",
+			i, (x >> 20) % 50, (x >> 8) % 3 ? "true" : "false");
+		jep_append_bytes(raw, (jep_byte*)line, len);
+	}
+
+	plain = jep_huff_encode(raw);
+	res = plain != NULL;
+
+	for (level = JEP_LZ_MIN_LEVEL; res && level <= JEP_LZ_MAX_LEVEL; level++)
+	{
+		encoded = jep_lz_compress(raw, level);
+		decoded = encoded != NULL ? jep_lz_decompress(encoded) : NULL;
+
+		if (encoded == NULL || encoded->size >= plain->size / 2
+			|| decoded == NULL || decoded->size != raw->size
+			|| memcmp(decoded->buffer, raw->buffer, raw->size))
+		{
+			res = 0;
+		}
+
+		jep_destroy_byte_buffer(encoded);
+		jep_destroy_byte_buffer(decoded);
+	}
+
+	jep_destroy_byte_buffer(plain);
+
+	// Inputs too short to hold a match, and a single repeated byte,
+	// whose matches overlap the bytes they copy.
+	for (i = 0; res && i < 4; i++)
+	{
+		jep_clear_byte_buffer(raw);
+
+		if (i < 3)
+		{
+			jep_append_bytes(raw, (jep_byte*)"abc", i);
+		}
+		else
+		{
+			for (len = 0; len < 1000; len++)
+				jep_append_byte(raw, 'z');
+		}
+
+		encoded = jep_lz_compress(raw, JEP_LZ_DEFAULT_LEVEL);
+		decoded = encoded != NULL ? jep_lz_decompress(encoded) : NULL;
+
+		if (decoded == NULL || decoded->size != raw->size
+			|| memcmp(decoded->buffer, raw->buffer, raw->size))
+		{
+			res = 0;
+		}
+
+		jep_destroy_byte_buffer(encoded);
+		jep_destroy_byte_buffer(decoded);
+	}
+
+	// The level must be in range.
+	if (jep_lz_compress(raw, JEP_LZ_MIN_LEVEL - 1) != NULL
+		|| jep_lz_compress(raw, JEP_LZ_MAX_LEVEL + 1) != NULL
+		|| jep_lz_compress(NULL, JEP_LZ_DEFAULT_LEVEL) != NULL)
+	{
+		res = 0;
+	}
+
+	jep_destroy_byte_buffer(raw);
+
+	return res;
+}
+
+int lz_window_test()
+{
+	jep_byte_buffer* raw;
+	jep_byte_buffer* encoded;
+	jep_byte_buffer* decoded;
+	uint32_t x;
+	size_t i;
+	int res;
+
+	raw = jep_create_byte_buffer();
+
+	if (raw == NULL)
+		return 0;
+
+	// A block of random bytes is repeated just within the window, and
+	// again just beyond it, where it can no longer be referenced.
+	x = 9;
+	for (i = 0; i < 1000; i++)
+	{
+		x = x * 1664525U + 1013904223U;
+		jep_append_byte(raw, (jep_byte)(x >> 24));
+	}
+
+	for (i = 1000; i < JEP_LZ_WINDOW_SIZE; i++)
+		jep_append_byte(raw, (jep_byte)(i % 7));
+
+	jep_append_bytes(raw, raw->buffer, 1000);
+
+	for (i = 0; i < 2000; i++)
+		jep_append_byte(raw, (jep_byte)(i % 7));
+
+	jep_append_bytes(raw, raw->buffer, 1000);
+
+	encoded = jep_lz_compress(raw, JEP_LZ_MAX_LEVEL);
+	decoded = encoded != NULL ? jep_lz_decompress(encoded) : NULL;
+
+	res = 1;
+
+	if (decoded == NULL || decoded->size != raw->size
+		|| memcmp(decoded->buffer, raw->buffer, raw->size))
+	{
+		res = 0;
+	}
+
+	jep_destroy_byte_buffer(encoded);
+	jep_destroy_byte_buffer(decoded);
+	jep_destroy_byte_buffer(raw);
+
+	return res;
+}
+
+int lz_damage_test()
+{
+	jep_byte_buffer* raw;
+	jep_byte_buffer* encoded;
+	jep_byte_buffer* decoded;
+	size_t size;
+	int res;
+	int i;
+
+	raw = jep_create_byte_buffer();
+
+	if (raw == NULL)
+		return 0;
+
+	for (i = 0; i < 200; i++)
+		jep_append_bytes(raw, (jep_byte*)"to be or not to be, ", 20);
+
+	encoded = jep_lz_compress(raw, JEP_LZ_DEFAULT_LEVEL);
+
+	if (encoded == NULL)
+	{
+		jep_destroy_byte_buffer(raw);
+		return 0;
+	}
+
+	res = 1;
+	size = encoded->size;
+
+	// A frame that is cut short is rejected.
+	for (encoded->size = 0; encoded->size < size; encoded->size++)
+	{
+		decoded = jep_lz_decompress(encoded);
+
+		if (decoded != NULL)
+			res = 0;
+
+		jep_destroy_byte_buffer(decoded);
+	}
+
+	// So is a frame that claims more bytes than it holds.
+	encoded->buffer[2]++;
+	decoded = jep_lz_decompress(encoded);
+
+	if (decoded != NULL)
+		res = 0;
+
+	jep_destroy_byte_buffer(decoded);
+
+	// And one that claims far more bytes than its sections can
+	// rebuild, which fails before room is made for them.
+	encoded->buffer[2]--;
+	encoded->buffer[5] = 0xF0;
+	decoded = jep_lz_decompress(encoded);
+
+	if (decoded != NULL)
+		res = 0;
+
+	jep_destroy_byte_buffer(decoded);
+	jep_destroy_byte_buffer(encoded);
+	jep_destroy_byte_buffer(raw);
+
+	return res;
+}
@@ -0,0 +1,12 @@
+#ifndef JEP_LZ_TESTS_H
+#define JEP_LZ_TESTS_H
+
+#include "jep_utils/lz.h"
+
+int lz_round_trip_test();
+
+int lz_window_test();
+
+int lz_damage_test();
+
+#endif
@@ -5,8 +5,13 @@
 #include "char_buffer_tests.h"
 #include "json_tests.h"
 #include "huffman_tests.h"
+#include "huffman_static_tests.h"
+#include "histogram_tests.h"
+#include "ans_tests.h"
+#include "lz_tests.h"
+#include "crc_tests.h"
 
-#define MAX_PASSES 39
+#define MAX_PASSES 71
 
 int main(int argc, char** argv)
 {
@@ -60,10 +65,50 @@ int main(int argc, char** argv)
 	passes += json_parse_test();
 	passes += json_field_test();
 
-	// Huffman Coding (3 tests)
+	// Huffman Coding (25 tests)
 	passes += huff_encode_test();
 	passes += huff_decode_test();
 	passes += huff_read_test();
+	passes += huff_round_trip_test();
+	passes += huff_read_canonical_test();
+	passes += huff_limit_test();
+	passes += huff_stream_test();
+	passes += huff_blocks_test();
+	passes += huff_random_access_test();
+	passes += huff_split_test();
+	passes += huff_shared_test();
+	passes += huff_raw_test();
+	passes += huff_into_test();
+	passes += huff_sized_test();
+	passes += huff_context_test();
+	passes += huff_coder_test();
+	passes += huff_stats_test();
+	passes += huff_arena_test();
+	passes += huff_checked_test();
+	passes += huff_push_test();
+	passes += huff_multi_test();
+	passes += huff_file_test();
+	passes += huff_file_large_test();
+	passes += huff_static_round_trip_test();
+	passes += huff_static_interop_test();
+
+	// histogram (2 tests)
+	passes += histogram_count_test();
+	passes += histogram_run_test();
+
+	// ANS (3 tests)
+	passes += ans_round_trip_test();
+	passes += ans_skew_test();
+	passes += ans_damage_test();
+
+	// LZ77 (3 tests)
+	passes += lz_round_trip_test();
+	passes += lz_window_test();
+	passes += lz_damage_test();
+
+	// CRC-32C (2 tests)
+	passes += crc_vector_test();
+	passes += crc_split_test();
 
 	printf("%d/%d tests passed\n", passes, MAX_PASSES);
 